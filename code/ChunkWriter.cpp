@@ -0,0 +1,132 @@
+#include "ChunkWriter.h"
+#include "utils/ThreadRoles.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace mandeye
+{
+ChunkWriter::ChunkWriter(const std::function<void(bool success)>& onDone, size_t maxQueuedJobs)
+	: m_onDone(onDone)
+	, m_maxQueuedJobs(std::max<size_t>(maxQueuedJobs, 1))
+	, m_durationMetric(mandeye_utils::metrics::Registry::Instance().AddHistogram(
+		  "mandeye_chunk_save_duration_seconds", "Duration of saving a chunk", {0.25, 0.5, 1, 2, 3, 5, 10, 30}))
+	, m_queueDepthMetric(mandeye_utils::metrics::Registry::Instance().AddGauge("mandeye_writer_queue_depth", "Chunks queued or being saved"))
+	, m_backpressureMetric(mandeye_utils::metrics::Registry::Instance().AddCounter(
+		  "mandeye_writer_backpressure_total", "Chunks that waited for room in the full writer queue"))
+{
+	m_thread = std::thread(&ChunkWriter::worker, this);
+}
+
+ChunkWriter::~ChunkWriter()
+{
+	// queued chunks are still saved
+	WaitForIdle();
+	m_running = false;
+	m_jobAvailable.notify_all();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void ChunkWriter::Enqueue(std::function<void()> job)
+{
+	{
+		std::unique_lock<std::mutex> lck(m_mutex);
+		if(m_jobs.size() >= m_maxQueuedJobs)
+		{
+			std::cerr << "ChunkWriter: queue full with " << m_jobs.size() << " chunks, waiting for the drive" << std::endl;
+			m_backpressureMetric.Add();
+			const auto start = std::chrono::steady_clock::now();
+			m_jobTaken.wait(lck, [this]() { return m_jobs.size() < m_maxQueuedJobs; });
+			m_backpressureWaits++;
+			m_backpressureSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		m_jobs.push_back(std::move(job));
+		m_queueDepthMetric.Set(m_jobs.size() + (m_jobInProgress ? 1 : 0));
+	}
+	m_jobAvailable.notify_one();
+}
+
+size_t ChunkWriter::GetPendingJobs()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	return m_jobs.size() + (m_jobInProgress ? 1 : 0);
+}
+
+void ChunkWriter::WaitForIdle()
+{
+	std::unique_lock<std::mutex> lck(m_mutex);
+	m_idle.wait(lck, [this]() { return m_jobs.empty() && !m_jobInProgress; });
+}
+
+nlohmann::json ChunkWriter::produceStatus()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	nlohmann::json data;
+	data["pending"] = m_jobs.size() + (m_jobInProgress ? 1 : 0);
+	data["done"] = m_doneJobs;
+	data["failed"] = m_failedJobs;
+	data["last_duration_sec"] = m_lastJobDurationSec;
+	data["max_queued"] = m_maxQueuedJobs;
+	data["backpressure_waits"] = m_backpressureWaits;
+	data["backpressure_sec"] = m_backpressureSec;
+	return data;
+}
+
+void ChunkWriter::worker()
+{
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Writer);
+	while(true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lck(m_mutex);
+			m_jobAvailable.wait(lck, [this]() { return !m_jobs.empty() || !m_running; });
+			if(m_jobs.empty())
+			{
+				break;
+			}
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+			m_jobInProgress = true;
+		}
+		m_jobTaken.notify_all();
+
+		bool success = true;
+		const auto start = std::chrono::steady_clock::now();
+		try
+		{
+			job();
+		}
+		catch(const std::exception& e)
+		{
+			std::cerr << "ChunkWriter: failed to save chunk : " << e.what() << std::endl;
+			success = false;
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		m_durationMetric.Observe(elapsed.count());
+
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			m_jobInProgress = false;
+			m_queueDepthMetric.Set(m_jobs.size());
+			m_lastJobDurationSec = elapsed.count();
+			if(success)
+			{
+				m_doneJobs++;
+			}
+			else
+			{
+				m_failedJobs++;
+			}
+		}
+		if(m_onDone)
+		{
+			m_onDone(success);
+		}
+		m_idle.notify_all();
+	}
+}
+} // namespace mandeye
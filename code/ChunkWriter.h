@@ -0,0 +1,70 @@
+#pragma once
+
+#include "utils/Metrics.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <thread>
+
+namespace mandeye
+{
+
+//! Saves chunks in background, so the state machine stays responsive while LAZ is compressed.
+//! Jobs are executed one by one in the order they were queued.
+//! The queue is bounded: when the drive cannot keep up, Enqueue blocks instead of piling up chunks in memory.
+class ChunkWriter
+{
+public:
+	//! @param onDone called from the writer thread after each job, with false if job has thrown
+	//! @param maxQueuedJobs number of jobs waiting behind the one in progress before Enqueue blocks
+	explicit ChunkWriter(const std::function<void(bool success)>& onDone, size_t maxQueuedJobs = DefaultMaxQueuedJobs);
+	~ChunkWriter();
+
+	ChunkWriter(const ChunkWriter&) = delete;
+	ChunkWriter& operator=(const ChunkWriter&) = delete;
+
+	//! Chunks of 5 s at 200k points/s take about 40 MB each
+	static constexpr size_t DefaultMaxQueuedJobs = 4;
+
+	//! Queue job saving a chunk, blocks while the queue is full (back-pressure)
+	void Enqueue(std::function<void()> job);
+
+	//! Number of jobs queued or in progress
+	size_t GetPendingJobs();
+
+	//! Blocks until all queued jobs are done
+	void WaitForIdle();
+
+	nlohmann::json produceStatus();
+
+private:
+	void worker();
+
+	std::function<void(bool)> m_onDone;
+
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_idle;
+	std::condition_variable m_jobTaken;
+	std::deque<std::function<void()>> m_jobs;
+	const size_t m_maxQueuedJobs;
+	bool m_jobInProgress{false};
+
+	uint64_t m_doneJobs{0};
+	uint64_t m_failedJobs{0};
+	double m_lastJobDurationSec{0};
+	//! Enqueue calls that found the queue full and the time they waited
+	uint64_t m_backpressureWaits{0};
+	double m_backpressureSec{0};
+
+	mandeye_utils::metrics::Histogram& m_durationMetric;
+	mandeye_utils::metrics::Gauge& m_queueDepthMetric;
+	mandeye_utils::metrics::Counter& m_backpressureMetric;
+
+	std::atomic<bool> m_running{true};
+	std::thread m_thread;
+};
+} // namespace mandeye
@@ -0,0 +1,786 @@
+#include "DownloadServer.h"
+#include "utils/ThreadRoles.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mandeye
+{
+namespace
+{
+constexpr size_t MaxRequestSize = 8192;
+constexpr size_t SendBlockSize = 256 * 1024;
+constexpr size_t QueuedConnectionsPerThread = 4;
+constexpr int ReceiveTimeoutSec = 10;
+constexpr int SendTimeoutSec = 30;
+constexpr char SessionsPrefix[] = "/sessions";
+constexpr char ArchiveSuffix[] = ".tar";
+constexpr size_t TarBlockSize = 512;
+//! written by the spool migrator and the session index while copying or saving, renamed away when done
+constexpr char PartialSuffix[] = ".part";
+//! replaced after every chunk, archived from a copy taken when the archive starts
+constexpr char SessionIndexName[] = "session_index.json";
+const std::vector<std::string> SessionDirectoryPrefixes{"continousScanning_", "stopScans_"};
+
+const char* ReasonPhrase(int code)
+{
+	switch(code)
+	{
+	case 200:
+		return "OK";
+	case 206:
+		return "Partial Content";
+	case 400:
+		return "Bad Request";
+	case 404:
+		return "Not Found";
+	case 405:
+		return "Method Not Allowed";
+	case 416:
+		return "Range Not Satisfiable";
+	case 503:
+		return "Service Unavailable";
+	default:
+		return "Internal Server Error";
+	}
+}
+
+bool SendAll(int socket, const char* data, size_t size)
+{
+	while(size > 0)
+	{
+		const ssize_t sent = ::send(socket, data, size, MSG_NOSIGNAL);
+		if(sent < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		data += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+std::string PercentDecode(const std::string& text)
+{
+	std::string decoded;
+	decoded.reserve(text.size());
+	for(size_t i = 0; i < text.size(); i++)
+	{
+		if(text[i] == '%' && i + 2 < text.size() && std::isxdigit(text[i + 1]) && std::isxdigit(text[i + 2]))
+		{
+			decoded.push_back(static_cast<char>(std::stoi(text.substr(i + 1, 2), nullptr, 16)));
+			i += 2;
+		}
+		else
+		{
+			decoded.push_back(text[i]);
+		}
+	}
+	return decoded;
+}
+
+//! Single path component that cannot leave its directory
+bool IsPlainName(const std::string& name)
+{
+	return !name.empty() && name[0] != '.' && name.find('/') == std::string::npos && name.find('\0') == std::string::npos;
+}
+
+//! File still being copied or saved, not offered for download
+bool IsPartialName(const std::string& name)
+{
+	return name.size() > strlen(PartialSuffix) && name.compare(name.size() - strlen(PartialSuffix), strlen(PartialSuffix), PartialSuffix) == 0;
+}
+
+std::string HttpDate(time_t time)
+{
+	char buffer[64];
+	struct tm tm;
+	gmtime_r(&time, &tm);
+	strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+	return buffer;
+}
+
+enum class RangeResult
+{
+	Full,
+	Partial,
+	Unsatisfiable
+};
+
+//! Parses "bytes=first-last", "bytes=first-" or "bytes=-suffix". Multiple ranges and invalid ones (last < first)
+//! are answered with the whole file.
+RangeResult ParseRange(const std::string& value, uint64_t size, uint64_t& first, uint64_t& last)
+{
+	constexpr char Unit[] = "bytes=";
+	if(value.compare(0, sizeof(Unit) - 1, Unit) != 0 || value.find(',') != std::string::npos)
+	{
+		return RangeResult::Full;
+	}
+	const std::string spec = value.substr(sizeof(Unit) - 1);
+	const size_t dash = spec.find('-');
+	if(dash == std::string::npos)
+	{
+		return RangeResult::Full;
+	}
+	const std::string firstText = spec.substr(0, dash);
+	const std::string lastText = spec.substr(dash + 1);
+	const auto isNumber = [](const std::string& text) {
+		return !text.empty() && text.size() < 20 && std::all_of(text.begin(), text.end(), [](char c) { return std::isdigit(c); });
+	};
+	if(firstText.empty())
+	{
+		if(!isNumber(lastText))
+		{
+			return RangeResult::Full;
+		}
+		const uint64_t suffix = std::stoull(lastText);
+		if(suffix == 0 || size == 0)
+		{
+			return RangeResult::Unsatisfiable;
+		}
+		first = size - std::min(suffix, size);
+		last = size - 1;
+		return RangeResult::Partial;
+	}
+	if(!isNumber(firstText) || (!lastText.empty() && !isNumber(lastText)))
+	{
+		return RangeResult::Full;
+	}
+	if(!lastText.empty() && std::stoull(lastText) < std::stoull(firstText))
+	{
+		// syntactically invalid, RFC 7233 2.1: the header is ignored
+		return RangeResult::Full;
+	}
+	first = std::stoull(firstText);
+	last = lastText.empty() ? size - 1 : std::min<uint64_t>(std::stoull(lastText), size - 1);
+	if(first >= size)
+	{
+		return RangeResult::Unsatisfiable;
+	}
+	return RangeResult::Partial;
+}
+
+struct FileEntry
+{
+	std::string name;
+	uint64_t size{0};
+	time_t mtime{0};
+};
+
+//! Regular files of the directory, sorted by name, without files being migrated from the spool
+std::vector<FileEntry> ListFiles(const std::filesystem::path& directory)
+{
+	std::vector<FileEntry> files;
+	std::error_code ec;
+	for(const auto& entry : std::filesystem::directory_iterator(directory, ec))
+	{
+		const std::string name = entry.path().filename().string();
+		struct stat st;
+		if(IsPlainName(name) && !IsPartialName(name) && ::stat(entry.path().c_str(), &st) == 0 && S_ISREG(st.st_mode))
+		{
+			files.push_back({name, static_cast<uint64_t>(st.st_size), st.st_mtim.tv_sec});
+		}
+	}
+	std::sort(files.begin(), files.end(), [](const FileEntry& a, const FileEntry& b) { return a.name < b.name; });
+	return files;
+}
+
+nlohmann::json FilesToJson(const std::vector<FileEntry>& files, uint64_t& totalBytes)
+{
+	nlohmann::json data = nlohmann::json::array();
+	for(const auto& file : files)
+	{
+		data.push_back({{"name", file.name}, {"size", file.size}});
+		totalBytes += file.size;
+	}
+	return data;
+}
+
+//! Writes number as octal into field of tar header, base-256 if it does not fit (GNU extension)
+void TarNumber(char* field, size_t fieldSize, uint64_t value)
+{
+	if(value < (uint64_t{1} << (3 * (fieldSize - 1))))
+	{
+		snprintf(field, fieldSize, "%0*llo", int(fieldSize - 1), static_cast<unsigned long long>(value));
+		return;
+	}
+	std::memset(field, 0, fieldSize);
+	for(size_t i = fieldSize - 1; i > 0 && value > 0; i--)
+	{
+		field[i] = static_cast<char>(value & 0xff);
+		value >>= 8;
+	}
+	field[0] = static_cast<char>(0x80);
+}
+
+//! ustar header of prefix/name, name up to 100 characters
+void TarHeader(char* block, const std::string& prefix, const std::string& name, uint64_t size, time_t mtime, char type)
+{
+	std::memset(block, 0, TarBlockSize);
+	std::memcpy(block, name.data(), std::min<size_t>(name.size(), 100));
+	TarNumber(block + 100, 8, type == '5' ? 0755 : 0644); // mode
+	TarNumber(block + 108, 8, 0); // uid
+	TarNumber(block + 116, 8, 0); // gid
+	TarNumber(block + 124, 12, size);
+	TarNumber(block + 136, 12, static_cast<uint64_t>(mtime));
+	block[156] = type;
+	std::memcpy(block + 257, "ustar", 6);
+	std::memcpy(block + 263, "00", 2);
+	std::memcpy(block + 345, prefix.data(), std::min<size_t>(prefix.size(), 155));
+	// checksum is computed with its own field filled with spaces
+	std::memset(block + 148, ' ', 8);
+	unsigned int checksum = 0;
+	for(size_t i = 0; i < TarBlockSize; i++)
+	{
+		checksum += static_cast<unsigned char>(block[i]);
+	}
+	snprintf(block + 148, 8, "%06o", checksum);
+}
+} // namespace
+
+DownloadServer::DownloadServer(const std::string& repositoryRoot, const nlohmann::json& config)
+	: m_repositoryRoot(repositoryRoot)
+	, m_port(config.value("port", 8004))
+	, m_threads(std::clamp(config.value("threads", 2), 1, 8))
+	, m_rateLimitMBs(config.value("rate_limit_mb_s", 4.0))
+{
+	// sendfile has no MSG_NOSIGNAL, a client closing the connection must not kill the program
+	std::signal(SIGPIPE, SIG_IGN);
+
+	m_listenSocket = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	const int reuse = 1;
+	setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(m_port);
+	if(m_listenSocket < 0 || ::bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+	   ::listen(m_listenSocket, 16) != 0)
+	{
+		std::cerr << "DownloadServer: cannot listen on port " << m_port << " : " << strerror(errno) << std::endl;
+		if(m_listenSocket >= 0)
+		{
+			::close(m_listenSocket);
+			m_listenSocket = -1;
+		}
+		return;
+	}
+	m_acceptor = std::thread(&DownloadServer::acceptor, this);
+	for(size_t i = 0; i < m_threads; i++)
+	{
+		m_workers.emplace_back(&DownloadServer::worker, this);
+	}
+}
+
+DownloadServer::~DownloadServer()
+{
+	m_running = false;
+	m_connectionAvailable.notify_all();
+	if(m_acceptor.joinable())
+	{
+		m_acceptor.join();
+	}
+	for(auto& worker : m_workers)
+	{
+		worker.join();
+	}
+	for(int socket : m_connections)
+	{
+		::close(socket);
+	}
+	if(m_listenSocket >= 0)
+	{
+		::close(m_listenSocket);
+	}
+}
+
+void DownloadServer::SetThrottled(bool throttled)
+{
+	m_throttled = throttled;
+}
+
+nlohmann::json DownloadServer::produceStatus()
+{
+	nlohmann::json data;
+	data["port"] = m_port;
+	data["listening"] = m_listenSocket >= 0;
+	data["threads"] = m_threads;
+	data["throttled"] = m_throttled.load();
+	data["rate_limit_mb_s"] = m_rateLimitMBs;
+	data["active_transfers"] = m_activeTransfers.load();
+	data["requests"] = m_requests.load();
+	data["range_requests"] = m_rangeRequests.load();
+	data["rejected"] = m_rejected.load();
+	data["archives"] = m_archives.load();
+	data["failed"] = m_failed.load();
+	data["sent_mb"] = static_cast<double>(m_sentBytes.load()) / (1024 * 1024);
+	return data;
+}
+
+void DownloadServer::acceptor()
+{
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Download);
+	while(m_running)
+	{
+		pollfd pfd{m_listenSocket, POLLIN, 0};
+		if(::poll(&pfd, 1, 500) <= 0)
+		{
+			continue;
+		}
+		const int socket = ::accept4(m_listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+		if(socket < 0)
+		{
+			continue;
+		}
+		const timeval receiveTimeout{ReceiveTimeoutSec, 0};
+		const timeval sendTimeout{SendTimeoutSec, 0};
+		setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &receiveTimeout, sizeof(receiveTimeout));
+		setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+
+		std::unique_lock<std::mutex> lck(m_mutex);
+		if(m_connections.size() >= m_threads * QueuedConnectionsPerThread)
+		{
+			lck.unlock();
+			m_rejected++;
+			SendResponse(socket, 503, "text/plain", "Too many downloads\n");
+			::close(socket);
+			continue;
+		}
+		m_connections.push_back(socket);
+		lck.unlock();
+		m_connectionAvailable.notify_one();
+	}
+}
+
+void DownloadServer::worker()
+{
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Download);
+	while(true)
+	{
+		int socket = -1;
+		{
+			std::unique_lock<std::mutex> lck(m_mutex);
+			m_connectionAvailable.wait(lck, [this]() { return !m_running || !m_connections.empty(); });
+			if(!m_running)
+			{
+				return;
+			}
+			socket = m_connections.front();
+			m_connections.pop_front();
+		}
+		HandleConnection(socket);
+		::close(socket);
+	}
+}
+
+void DownloadServer::HandleConnection(int socket)
+{
+	Request request;
+	if(!ReadRequest(socket, request))
+	{
+		SendResponse(socket, 400, "text/plain", "Bad request\n");
+		return;
+	}
+	m_requests++;
+	if(request.method != "GET" && request.method != "HEAD")
+	{
+		SendResponse(socket, 405, "text/plain", "Only GET and HEAD are supported\n");
+		return;
+	}
+
+	// /sessions, /sessions/<session>/, /sessions/<session>.tar, /sessions/<session>/<file>
+	const std::string prefix = SessionsPrefix;
+	if(request.path == prefix || request.path == prefix + "/")
+	{
+		ServeListing(socket, request);
+		return;
+	}
+	if(request.path.compare(0, prefix.size() + 1, prefix + "/") == 0)
+	{
+		const std::string rest = request.path.substr(prefix.size() + 1);
+		const size_t slash = rest.find('/');
+		const std::string session = rest.substr(0, slash);
+		const std::string file = slash == std::string::npos ? "" : rest.substr(slash + 1);
+		const std::string suffix = ArchiveSuffix;
+		if(slash == std::string::npos && session.size() > suffix.size() &&
+		   session.compare(session.size() - suffix.size(), suffix.size(), suffix) == 0)
+		{
+			ServeArchive(socket, request, session.substr(0, session.size() - suffix.size()));
+		}
+		else if(file.empty())
+		{
+			ServeSession(socket, request, session);
+		}
+		else
+		{
+			ServeFile(socket, request, session, file);
+		}
+		return;
+	}
+	SendResponse(socket, 404, "text/plain", "Not found\n", request.method == "HEAD");
+}
+
+bool DownloadServer::ReadRequest(int socket, Request& request)
+{
+	std::string buffer;
+	char block[1024];
+	size_t headerEnd = std::string::npos;
+	while((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos)
+	{
+		if(buffer.size() > MaxRequestSize)
+		{
+			return false;
+		}
+		const ssize_t received = ::recv(socket, block, sizeof(block), 0);
+		if(received <= 0)
+		{
+			if(received < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		buffer.append(block, received);
+	}
+
+	std::istringstream lines(buffer.substr(0, headerEnd));
+	std::string line;
+	std::getline(lines, line);
+	std::istringstream requestLine(line);
+	std::string target;
+	std::string version;
+	if(!(requestLine >> request.method >> target >> version) || version.compare(0, 5, "HTTP/") != 0 || target.empty() ||
+	   target[0] != '/')
+	{
+		return false;
+	}
+	request.path = PercentDecode(target.substr(0, target.find('?')));
+	while(std::getline(lines, line))
+	{
+		if(!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		const size_t colon = line.find(':');
+		if(colon == std::string::npos)
+		{
+			continue;
+		}
+		std::string name = line.substr(0, colon);
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+		const size_t valueStart = line.find_first_not_of(" \t", colon + 1);
+		request.headers[name] = valueStart == std::string::npos ? "" : line.substr(valueStart);
+	}
+	return true;
+}
+
+std::filesystem::path DownloadServer::SessionPath(const std::string& session) const
+{
+	if(!IsPlainName(session) || std::none_of(SessionDirectoryPrefixes.begin(), SessionDirectoryPrefixes.end(), [&](const std::string& p) {
+		   return session.compare(0, p.size(), p) == 0;
+	   }))
+	{
+		return {};
+	}
+	std::error_code ec;
+	const auto path = m_repositoryRoot / session;
+	return std::filesystem::is_directory(path, ec) ? path : std::filesystem::path();
+}
+
+void DownloadServer::ServeListing(int socket, const Request& request)
+{
+	std::vector<std::string> sessions;
+	std::error_code ec;
+	for(const auto& entry : std::filesystem::directory_iterator(m_repositoryRoot, ec))
+	{
+		const std::string name = entry.path().filename().string();
+		if(!SessionPath(name).empty())
+		{
+			sessions.push_back(name);
+		}
+	}
+	std::sort(sessions.begin(), sessions.end());
+
+	nlohmann::json data = nlohmann::json::array();
+	for(const auto& session : sessions)
+	{
+		uint64_t totalBytes = 0;
+		const auto files = FilesToJson(ListFiles(m_repositoryRoot / session), totalBytes);
+		data.push_back({{"name", session}, {"files", files.size()}, {"size", totalBytes}});
+	}
+	SendResponse(socket, 200, "application/json", data.dump(), request.method == "HEAD");
+}
+
+void DownloadServer::ServeSession(int socket, const Request& request, const std::string& session)
+{
+	const auto path = SessionPath(session);
+	if(path.empty())
+	{
+		SendResponse(socket, 404, "text/plain", "No such session\n", request.method == "HEAD");
+		return;
+	}
+	uint64_t totalBytes = 0;
+	nlohmann::json data;
+	data["name"] = session;
+	data["files"] = FilesToJson(ListFiles(path), totalBytes);
+	data["size"] = totalBytes;
+	SendResponse(socket, 200, "application/json", data.dump(), request.method == "HEAD");
+}
+
+void DownloadServer::ServeFile(int socket, const Request& request, const std::string& session, const std::string& file)
+{
+	const bool headOnly = request.method == "HEAD";
+	const auto directory = SessionPath(session);
+	if(directory.empty() || !IsPlainName(file) || IsPartialName(file))
+	{
+		SendResponse(socket, 404, "text/plain", "Not found\n", headOnly);
+		return;
+	}
+	const auto path = directory / file;
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if(fd < 0 || ::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		if(fd >= 0)
+		{
+			::close(fd);
+		}
+		SendResponse(socket, 404, "text/plain", "Not found\n", headOnly);
+		return;
+	}
+	const uint64_t size = st.st_size;
+	std::ostringstream etag;
+	etag << '"' << std::hex << size << '-' << st.st_mtim.tv_sec << '.' << st.st_mtim.tv_nsec << '"';
+	const std::string lastModified = HttpDate(st.st_mtim.tv_sec);
+
+	uint64_t first = 0;
+	uint64_t last = size > 0 ? size - 1 : 0;
+	RangeResult range = RangeResult::Full;
+	const auto rangeHeader = request.headers.find("range");
+	if(rangeHeader != request.headers.end())
+	{
+		// resume only if the file is still the one the client has the beginning of
+		const auto ifRange = request.headers.find("if-range");
+		if(ifRange == request.headers.end() || ifRange->second == etag.str() || ifRange->second == lastModified)
+		{
+			range = ParseRange(rangeHeader->second, size, first, last);
+		}
+	}
+	if(range == RangeResult::Unsatisfiable)
+	{
+		::close(fd);
+		std::ostringstream head;
+		head << "HTTP/1.1 416 " << ReasonPhrase(416) << "\r\nContent-Range: bytes */" << size
+			 << "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		SendAll(socket, head.str().data(), head.str().size());
+		return;
+	}
+
+	const uint64_t length = size > 0 ? last - first + 1 : 0;
+	const int code = range == RangeResult::Partial ? 206 : 200;
+	std::ostringstream head;
+	head << "HTTP/1.1 " << code << ' ' << ReasonPhrase(code) << "\r\n";
+	head << "Content-Type: application/octet-stream\r\n";
+	head << "Content-Disposition: attachment; filename=\"" << file << "\"\r\n";
+	head << "Content-Length: " << length << "\r\n";
+	if(range == RangeResult::Partial)
+	{
+		head << "Content-Range: bytes " << first << '-' << last << '/' << size << "\r\n";
+		m_rangeRequests++;
+	}
+	head << "Accept-Ranges: bytes\r\n";
+	head << "ETag: " << etag.str() << "\r\n";
+	head << "Last-Modified: " << lastModified << "\r\n";
+	head << "Connection: close\r\n\r\n";
+
+	m_activeTransfers++;
+	posix_fadvise(fd, first, length, POSIX_FADV_SEQUENTIAL);
+	bool ok = SendAll(socket, head.str().data(), head.str().size());
+	if(ok && !headOnly)
+	{
+		ok = SendFileRange(socket, fd, first, length) == length;
+	}
+	m_activeTransfers--;
+	::close(fd);
+	if(!ok)
+	{
+		m_failed++;
+		std::cerr << "DownloadServer: transfer of " << path << " interrupted" << std::endl;
+	}
+}
+
+void DownloadServer::ServeArchive(int socket, const Request& request, const std::string& session)
+{
+	const bool headOnly = request.method == "HEAD";
+	const auto directory = SessionPath(session);
+	if(directory.empty())
+	{
+		SendResponse(socket, 404, "text/plain", "No such session\n", headOnly);
+		return;
+	}
+
+	// sizes are taken now, files growing meanwhile (session being recorded) are cut at that size,
+	// files that got shorter or disappeared are padded with zeros, as the length is already sent
+	auto files = ListFiles(directory);
+	files.erase(std::remove_if(files.begin(), files.end(), [](const FileEntry& f) { return f.name.size() > 100; }), files.end());
+	std::string sessionIndex;
+	for(auto& file : files)
+	{
+		if(file.name == SessionIndexName)
+		{
+			std::ifstream indexStream(directory / file.name, std::ios::binary);
+			sessionIndex.assign(std::istreambuf_iterator<char>(indexStream), std::istreambuf_iterator<char>());
+			file.size = sessionIndex.size();
+		}
+	}
+	time_t sessionTime = 0;
+	uint64_t length = TarBlockSize + 2 * TarBlockSize; // directory entry and end of archive
+	for(const auto& file : files)
+	{
+		length += TarBlockSize + (file.size + TarBlockSize - 1) / TarBlockSize * TarBlockSize;
+		sessionTime = std::max(sessionTime, file.mtime);
+	}
+
+	std::ostringstream head;
+	head << "HTTP/1.1 200 " << ReasonPhrase(200) << "\r\n";
+	head << "Content-Type: application/x-tar\r\n";
+	head << "Content-Disposition: attachment; filename=\"" << session << ArchiveSuffix << "\"\r\n";
+	head << "Content-Length: " << length << "\r\n";
+	head << "Cache-Control: no-cache\r\n";
+	head << "Connection: close\r\n\r\n";
+	if(!SendAll(socket, head.str().data(), head.str().size()) || headOnly)
+	{
+		return;
+	}
+
+	m_activeTransfers++;
+	m_archives++;
+	char block[TarBlockSize];
+	TarHeader(block, "", session + "/", 0, sessionTime, '5');
+	bool ok = SendAll(socket, block, TarBlockSize);
+	for(size_t i = 0; ok && i < files.size(); i++)
+	{
+		const auto& file = files[i];
+		const auto path = directory / file.name;
+		TarHeader(block, session, file.name, file.size, file.mtime, '0');
+		ok = SendAll(socket, block, TarBlockSize);
+		uint64_t sent = 0;
+		if(ok && file.name == SessionIndexName)
+		{
+			ok = SendAll(socket, sessionIndex.data(), sessionIndex.size());
+			sent = sessionIndex.size();
+		}
+		else if(ok)
+		{
+			const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if(fd >= 0)
+			{
+				posix_fadvise(fd, 0, file.size, POSIX_FADV_SEQUENTIAL);
+				sent = SendFileRange(socket, fd, 0, file.size);
+				// archived chunks are not read again, leave the page cache to the chunk writer
+				posix_fadvise(fd, 0, file.size, POSIX_FADV_DONTNEED);
+				::close(fd);
+			}
+		}
+		if(ok && sent < file.size && m_running)
+		{
+			std::cerr << "DownloadServer: " << path << " changed while archived, " << file.size - sent << " bytes padded with zeros" << std::endl;
+		}
+		// zeros for the missing part of the file and up to the end of its last block
+		uint64_t zeros = file.size - sent + (TarBlockSize - file.size % TarBlockSize) % TarBlockSize;
+		std::memset(block, 0, TarBlockSize);
+		while(ok && zeros > 0 && m_running)
+		{
+			const size_t size = std::min<uint64_t>(zeros, TarBlockSize);
+			ok = SendAll(socket, block, size);
+			zeros -= size;
+		}
+		ok = ok && zeros == 0;
+	}
+	std::memset(block, 0, TarBlockSize);
+	ok = ok && SendAll(socket, block, TarBlockSize) && SendAll(socket, block, TarBlockSize);
+	m_activeTransfers--;
+	if(!ok)
+	{
+		m_failed++;
+		std::cerr << "DownloadServer: archive of " << directory << " interrupted" << std::endl;
+	}
+}
+
+void DownloadServer::SendResponse(int socket, int code, const std::string& contentType, const std::string& body, bool headOnly)
+{
+	std::ostringstream head;
+	head << "HTTP/1.1 " << code << ' ' << ReasonPhrase(code) << "\r\n";
+	head << "Content-Type: " << contentType << "\r\n";
+	head << "Content-Length: " << body.size() << "\r\n";
+	head << "Cache-Control: no-cache\r\n";
+	head << "Connection: close\r\n\r\n";
+	if(SendAll(socket, head.str().data(), head.str().size()) && !headOnly)
+	{
+		SendAll(socket, body.data(), body.size());
+	}
+}
+
+uint64_t DownloadServer::SendFileRange(int socket, int file, uint64_t offset, uint64_t length)
+{
+	off_t position = offset;
+	uint64_t total = 0;
+	while(total < length && m_running)
+	{
+		const size_t block = std::min<uint64_t>(length - total, SendBlockSize);
+		Pace(block);
+		const ssize_t sent = ::sendfile(socket, file, &position, block);
+		if(sent < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+		if(sent == 0)
+		{
+			// file got shorter than announced
+			break;
+		}
+		total += sent;
+		m_sentBytes += sent;
+	}
+	return total;
+}
+
+void DownloadServer::Pace(size_t bytes)
+{
+	if(!m_throttled || m_rateLimitMBs <= 0)
+	{
+		return;
+	}
+	const auto duration =
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(bytes / (m_rateLimitMBs * 1024 * 1024)));
+	std::chrono::steady_clock::time_point slot;
+	{
+		std::lock_guard<std::mutex> lck(m_paceMutex);
+		slot = std::max(std::chrono::steady_clock::now(), m_nextSlot);
+		m_nextSlot = slot + duration;
+	}
+	std::this_thread::sleep_until(slot);
+}
+} // namespace mandeye
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mandeye
+{
+
+//! HTTP server for session downloads, on its own port and threads so a long transfer never
+//! holds the Pistache thread that serves the status and the page.
+//! GET/HEAD /sessions - sessions in the repository with their files
+//! GET/HEAD /sessions/<session>/ - files of a session
+//! GET/HEAD /sessions/<session>/<file> - file, sent with sendfile; single Range requests and
+//! If-Range are supported, so interrupted downloads can be resumed (curl -C -, wget -c).
+//! GET/HEAD /sessions/<session>.tar - whole session as ustar archive, generated while sending:
+//! headers are built in a single block, file contents go out with sendfile, no temporary file.
+//! While throttled (scan in progress) all transfers together are paced to the configured rate.
+class DownloadServer
+{
+public:
+	//! @param repositoryRoot root directory of the repository (MANDEYE_REPO)
+	//! @param config "download" section of the config: port, threads, rate_limit_mb_s
+	DownloadServer(const std::string& repositoryRoot, const nlohmann::json& config);
+	~DownloadServer();
+
+	DownloadServer(const DownloadServer&) = delete;
+	DownloadServer& operator=(const DownloadServer&) = delete;
+
+	//! Limits transfers to rate_limit_mb_s, called by the state machine while scanning
+	void SetThrottled(bool throttled);
+
+	nlohmann::json produceStatus();
+
+private:
+	struct Request
+	{
+		std::string method;
+		std::string path; //! decoded, without query
+		std::map<std::string, std::string> headers; //! names in lower case
+	};
+
+	void acceptor();
+	void worker();
+
+	void HandleConnection(int socket);
+	bool ReadRequest(int socket, Request& request);
+	void ServeListing(int socket, const Request& request);
+	void ServeSession(int socket, const Request& request, const std::string& session);
+	void ServeFile(int socket, const Request& request, const std::string& session, const std::string& file);
+	void ServeArchive(int socket, const Request& request, const std::string& session);
+	void SendResponse(int socket, int code, const std::string& contentType, const std::string& body, bool headOnly = false);
+
+	//! Sends length bytes of file from offset, paced while throttled.
+	//! Returns bytes sent, less than length if the socket failed, the file got shorter or the server stops.
+	uint64_t SendFileRange(int socket, int file, uint64_t offset, uint64_t length);
+	//! Waits for the slot of the next block while throttled, shared by all transfers
+	void Pace(size_t bytes);
+
+	//! Session directory name or empty if the name is not a session in the repository
+	std::filesystem::path SessionPath(const std::string& session) const;
+
+	std::filesystem::path m_repositoryRoot;
+	int m_port;
+	size_t m_threads;
+	double m_rateLimitMBs;
+	std::atomic<bool> m_throttled{false};
+
+	std::mutex m_paceMutex;
+	std::chrono::steady_clock::time_point m_nextSlot;
+
+	std::mutex m_mutex;
+	std::condition_variable m_connectionAvailable;
+	std::deque<int> m_connections;
+
+	std::atomic<uint64_t> m_requests{0};
+	std::atomic<uint64_t> m_rangeRequests{0};
+	std::atomic<uint64_t> m_rejected{0};
+	std::atomic<uint64_t> m_archives{0};
+	std::atomic<uint64_t> m_failed{0};
+	std::atomic<uint64_t> m_sentBytes{0};
+	std::atomic<int> m_activeTransfers{0};
+
+	int m_listenSocket{-1};
+	std::atomic<bool> m_running{true};
+	std::thread m_acceptor;
+	std::vector<std::thread> m_workers;
+};
+} // namespace mandeye
@@ -0,0 +1,50 @@
+#include "EventQueue.h"
+
+namespace mandeye
+{
+void EventQueue::Push(Events event)
+{
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_events.push_back({event, std::chrono::steady_clock::now()});
+	}
+	m_eventAvailable.notify_one();
+}
+
+Events EventQueue::WaitForEvent(std::chrono::steady_clock::time_point deadline)
+{
+	std::unique_lock<std::mutex> lck(m_mutex);
+	auto isEventAvailable = [this]() { return !m_events.empty(); };
+	if(deadline == std::chrono::steady_clock::time_point::max())
+	{
+		m_eventAvailable.wait(lck, isEventAvailable);
+	}
+	else if(!m_eventAvailable.wait_until(lck, deadline, isEventAvailable))
+	{
+		m_timerCount++;
+		return Events::TIMER;
+	}
+
+	const QueuedEvent event = m_events.front();
+	m_events.pop_front();
+	const std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - event.m_pushed;
+	m_lastLatencyMs = latency.count();
+	m_maxLatencyMs = std::max(m_maxLatencyMs, m_lastLatencyMs);
+	m_lastEvent = event.m_event;
+	m_eventCount++;
+	return event.m_event;
+}
+
+nlohmann::json EventQueue::produceStatus()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	nlohmann::json data;
+	data["queued"] = m_events.size();
+	data["events"] = m_eventCount;
+	data["timer_wakeups"] = m_timerCount;
+	data["last_event"] = EventsToString.at(m_lastEvent);
+	data["last_latency_ms"] = m_lastLatencyMs;
+	data["max_latency_ms"] = m_maxLatencyMs;
+	return data;
+}
+} // namespace mandeye
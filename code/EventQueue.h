@@ -0,0 +1,46 @@
+#pragma once
+
+#include "state.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <nlohmann/json.hpp>
+
+namespace mandeye
+{
+
+//! Queue of events for the state machine. Producers (HTTP, GPIO, chunk writer) push events,
+//! the state machine thread sleeps on the condition variable until an event or its next deadline.
+class EventQueue
+{
+public:
+	//! Push event and wake up the state machine
+	void Push(Events event);
+
+	//! Waits for the next event
+	//! @param deadline time when the state machine needs to run anyway, time_point::max() waits for an event only
+	//! @returns the oldest queued event or Events::TIMER if deadline has passed
+	Events WaitForEvent(std::chrono::steady_clock::time_point deadline);
+
+	nlohmann::json produceStatus();
+
+private:
+	struct QueuedEvent
+	{
+		Events m_event;
+		std::chrono::steady_clock::time_point m_pushed;
+	};
+
+	std::mutex m_mutex;
+	std::condition_variable m_eventAvailable;
+	std::deque<QueuedEvent> m_events;
+
+	uint64_t m_eventCount{0};
+	uint64_t m_timerCount{0};
+	Events m_lastEvent{Events::TIMER};
+	//! time from push to the state machine picking the event up
+	double m_lastLatencyMs{0};
+	double m_maxLatencyMs{0};
+};
+} // namespace mandeye
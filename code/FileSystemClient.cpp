@@ -1,17 +1,43 @@
 #include "FileSystemClient.h"
+#include "utils/ThreadRoles.h"
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <poll.h>
 #include <sstream>
 #include <stdbool.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
 #include <unistd.h>
 namespace mandeye
 {
 
 FileSystemClient::FileSystemClient(const std::string& repository)
 	: m_repository(repository)
+	, m_storageBenchmark(repository)
 {
 	m_nextId = GetIdFromManifest();
+	m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(m_inotifyFd < 0)
+	{
+		std::cerr << "FileSystemClient: inotify not available, catalog sees only files of the writer" << std::endl;
+		return;
+	}
+	m_catalogThread = std::thread(&FileSystemClient::catalogWatcher, this);
+}
+
+FileSystemClient::~FileSystemClient()
+{
+	m_running = false;
+	if(m_catalogThread.joinable())
+	{
+		m_catalogThread.join();
+	}
+	if(m_inotifyFd >= 0)
+	{
+		close(m_inotifyFd);
+	}
 }
 nlohmann::json FileSystemClient::produceStatus()
 {
@@ -50,6 +76,11 @@ nlohmann::json FileSystemClient::produceStatus()
 	try
 	{
 		data["FileSystemClient"]["dirs"] = GetDirectories();
+		std::unique_lock<std::mutex> lck(m_mutex);
+		data["FileSystemClient"]["catalog"]["files"] = m_catalog.size();
+		data["FileSystemClient"]["catalog"]["bytes"] = m_catalogBytes;
+		data["FileSystemClient"]["catalog"]["inotify"] = m_catalogWatch >= 0;
+		data["FileSystemClient"]["catalog"]["inotify_events"] = m_catalogEvents;
 	}
 	catch(std::filesystem::filesystem_error& e)
 	{
@@ -146,6 +177,7 @@ bool FileSystemClient::CreateDirectoryForContinousScanning(std::string& writable
 			{
 				writable_dir = newDirPath.string();
 				m_currentContinousScanDirectory = writable_dir;
+				SetCatalogDirectory(writable_dir);
 				return true;
 			}
 			else
@@ -206,24 +238,137 @@ std::vector<std::string> FileSystemClient::GetDirectories()
 {
 	std::unique_lock<std::mutex> lck(m_mutex);
 	std::vector<std::string> fn;
-	if(m_currentContinousScanDirectory.empty() || !std::filesystem::exists(m_currentContinousScanDirectory) ||
-	   !std::filesystem::is_directory(m_currentContinousScanDirectory))
+	const size_t first = m_catalog.size() > statusCatalogEntries ? m_catalog.size() - statusCatalogEntries : 0;
+	for(size_t i = first; i < m_catalog.size(); i++)
 	{
-		// Directory is not set or invalid, return empty vector
-		return fn;
+		const std::filesystem::path path = std::filesystem::path(m_catalogDirectory) / m_catalog[i].name;
+		float fsize = static_cast<float>(m_catalog[i].size) / (1024 * 1024);
+		fn.push_back(path.string() + " " + std::to_string(fsize) + " Mb");
 	}
-	for(const auto& entry : std::filesystem::directory_iterator(m_currentContinousScanDirectory))
+	return fn;
+}
+
+void FileSystemClient::CatalogFiles(const std::string& sessionDirectory, const std::vector<std::string>& files)
+{
+	std::unique_lock<std::mutex> lck(m_mutex);
+	if(sessionDirectory != m_catalogDirectory)
 	{
-		if(entry.is_regular_file())
+		return;
+	}
+	for(const auto& file : files)
+	{
+		UpdateCatalogEntry(std::filesystem::path(file).filename().string(), file);
+	}
+}
+
+nlohmann::json FileSystemClient::GetCatalogPage(size_t offset, size_t limit)
+{
+	std::unique_lock<std::mutex> lck(m_mutex);
+	nlohmann::json data;
+	data["directory"] = m_catalogDirectory;
+	data["total"] = m_catalog.size();
+	data["total_bytes"] = m_catalogBytes;
+	data["offset"] = offset;
+	data["files"] = nlohmann::json::array();
+	for(size_t i = offset; i < m_catalog.size() && i - offset < limit; i++)
+	{
+		data["files"].push_back({{"name", m_catalog[i].name}, {"size", m_catalog[i].size}});
+	}
+	return data;
+}
+
+void FileSystemClient::SetCatalogDirectory(const std::string& directory)
+{
+	std::vector<CatalogEntry> catalog;
+	uint64_t catalogBytes = 0;
+	std::error_code ec;
+	for(const auto& entry : std::filesystem::directory_iterator(directory, ec))
+	{
+		if(entry.is_regular_file(ec))
 		{
-			auto size = std::filesystem::file_size(entry);
-			float fsize = static_cast<float>(size) / (1024 * 1204);
-			fn.push_back(entry.path().string() + " " + std::to_string(fsize) + " Mb");
+			catalog.push_back({entry.path().filename().string(), entry.file_size(ec)});
+			catalogBytes += catalog.back().size;
 		}
 	}
+	std::sort(catalog.begin(), catalog.end(), [](const CatalogEntry& a, const CatalogEntry& b) { return a.name < b.name; });
 
-	std::sort(fn.begin(), fn.end());
-	return fn;
+	std::unique_lock<std::mutex> lck(m_mutex);
+	if(m_inotifyFd >= 0)
+	{
+		if(m_catalogWatch >= 0)
+		{
+			inotify_rm_watch(m_inotifyFd, m_catalogWatch);
+		}
+		m_catalogWatch = inotify_add_watch(m_inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+	}
+	m_catalogDirectory = directory;
+	m_catalog = std::move(catalog);
+	m_catalogBytes = catalogBytes;
+}
+
+void FileSystemClient::UpdateCatalogEntry(const std::string& name, const std::string& path)
+{
+	struct stat st;
+	const bool exists = stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+	// chunks are named in increasing order, so new entries are appended
+	auto it = std::lower_bound(m_catalog.begin(), m_catalog.end(), name, [](const CatalogEntry& e, const std::string& n) { return e.name < n; });
+	const bool found = it != m_catalog.end() && it->name == name;
+	if(found)
+	{
+		m_catalogBytes -= it->size;
+		if(!exists)
+		{
+			m_catalog.erase(it);
+			return;
+		}
+		it->size = st.st_size;
+	}
+	else if(exists)
+	{
+		it = m_catalog.insert(it, {name, static_cast<uint64_t>(st.st_size)});
+	}
+	if(exists)
+	{
+		m_catalogBytes += it->size;
+	}
+}
+
+void FileSystemClient::catalogWatcher()
+{
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Catalog);
+	alignas(struct inotify_event) char buffer[4096];
+	while(m_running)
+	{
+		pollfd pfd{m_inotifyFd, POLLIN, 0};
+		if(poll(&pfd, 1, 500) <= 0)
+		{
+			continue;
+		}
+		const ssize_t length = read(m_inotifyFd, buffer, sizeof(buffer));
+		if(length <= 0)
+		{
+			continue;
+		}
+		std::unique_lock<std::mutex> lck(m_mutex);
+		for(ssize_t offset = 0; offset < length;)
+		{
+			const auto* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+			offset += sizeof(struct inotify_event) + event->len;
+			if(event->mask & IN_Q_OVERFLOW)
+			{
+				// events were lost, next SetCatalogDirectory or writer update corrects the entries
+				std::cerr << "FileSystemClient: inotify queue overflow" << std::endl;
+				continue;
+			}
+			if(event->wd != m_catalogWatch || event->len == 0 || (event->mask & IN_ISDIR))
+			{
+				continue;
+			}
+			m_catalogEvents++;
+			const std::string name = event->name;
+			UpdateCatalogEntry(name, (std::filesystem::path(m_catalogDirectory) / name).string());
+		}
+	}
 }
 
 bool FileSystemClient::GetIsWritable()
@@ -304,4 +449,24 @@ double FileSystemClient::BenchmarkWriteSpeed(const std::string& filename, size_t
 	return mbps;
 }
 
+bool FileSystemClient::StartStorageBenchmark(const nlohmann::json& options)
+{
+	return m_storageBenchmark.Start(StorageBenchmark::OptionsFromJson(options));
+}
+
+void FileSystemClient::CancelStorageBenchmark()
+{
+	m_storageBenchmark.Cancel();
+}
+
+nlohmann::json FileSystemClient::GetStorageBenchmarkStatus()
+{
+	return m_storageBenchmark.produceStatus();
+}
+
+StorageBenchmark::Policy FileSystemClient::GetStoragePolicy()
+{
+	return m_storageBenchmark.GetPolicy();
+}
+
 } // namespace mandeye
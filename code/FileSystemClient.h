@@ -1,9 +1,13 @@
 #pragma once
 
+#include "StorageBenchmark.h"
+#include <atomic>
 #include <deque>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace mandeye
 {
@@ -14,8 +18,12 @@ class FileSystemClient
 	constexpr static char config[]{"mandeye_config.json"};
 	constexpr static char versionFilename[]{"version.txt"};
 
+	//! Newest catalog entries reported in the status, the rest is paged with GetCatalogPage
+	constexpr static size_t statusCatalogEntries{100};
+
 public:
 	FileSystemClient(const std::string& repository);
+	~FileSystemClient();
 	nlohmann::json produceStatus();
 
 	//! Test is writable
@@ -30,17 +38,60 @@ public:
 	//! Get is writable
 	bool GetIsWritable();
 
+	//! Newest files of the current continuous scan directory, from the catalog
 	std::vector<std::string> GetDirectories();
 
+	//! Records files written for the session directory (repository path), called by the writer after closing them.
+	//! Files may be in the spool counterpart of the directory, they are cataloged by name.
+	void CatalogFiles(const std::string& sessionDirectory, const std::vector<std::string>& files);
+
+	//! Page of the catalog of the current continuous scan directory, sorted by file name
+	nlohmann::json GetCatalogPage(size_t offset, size_t limit);
+
 	bool CreateDirectoryForContinousScanning(std::string&, const int&);
 
 	bool CreateDirectoryForStopScans(std::string&, int& id_manifest);
 
 	double BenchmarkWriteSpeed(const std::string& filename, size_t fileSizeMB);
 
+	//! Starts the storage benchmark of the repository drive in background, false if it is already running.
+	//! @param options "storage_benchmark" config section, see StorageBenchmark::OptionsFromJson
+	bool StartStorageBenchmark(const nlohmann::json& options);
+
+	void CancelStorageBenchmark();
+
+	//! Progress of the running benchmark and the stored result of the repository drive
+	nlohmann::json GetStorageBenchmarkStatus();
+
+	//! Chunk writer settings derived from the stored benchmark result of the repository drive
+	StorageBenchmark::Policy GetStoragePolicy();
+
 	nlohmann::json GetConfig();
 
 private:
+	//! Catalog of the current continuous scan directory, kept in memory so listing never walks the directory.
+	//! Updated by the writer (CatalogFiles) and by inotify for changes made by others (spool migration, deletes).
+	struct CatalogEntry
+	{
+		std::string name;
+		uint64_t size{0};
+	};
+
+	//! Starts cataloging directory, replacing the previous one
+	void SetCatalogDirectory(const std::string& directory);
+	//! Inserts or updates entry, or removes it if the file does not exist. Caller holds m_mutex.
+	void UpdateCatalogEntry(const std::string& name, const std::string& path);
+	void catalogWatcher();
+
+	std::string m_catalogDirectory;
+	std::vector<CatalogEntry> m_catalog;
+	uint64_t m_catalogBytes{0};
+	int m_inotifyFd{-1};
+	int m_catalogWatch{-1};
+	uint64_t m_catalogEvents{0};
+	std::atomic<bool> m_running{true};
+	std::thread m_catalogThread;
+
 	int32_t m_nextId{0};
 	std::string ConvertToText(float mb);
 	std::string m_repository;
@@ -50,5 +101,6 @@ private:
 	std::string m_error;
 	std::mutex m_mutex;
 	double m_benchmarkWriteSpeed{-1.f};
+	StorageBenchmark m_storageBenchmark;
 };
 } // namespace mandeye
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mandeye
+{
+
+//! Sentence stored in GnssLog::text
+struct GnssSentenceRecord
+{
+	uint64_t laserTimestampNs;
+	int64_t systemTimeMs;
+	uint32_t offset;
+	uint32_t length;
+};
+
+//! What GNSSClient logged since the last retrieval. The serial thread only appends records,
+//! text lines of the gnss files are formatted by the chunk writer.
+struct GnssLog
+{
+	//! decoded sentences back to back, RecordHeader and payload as in the .gnsb file, see utils/GnssFormat.h
+	std::string records;
+	std::vector<GnssSentenceRecord> sentences;
+	std::string text; //! sentences back to back, as received including the line end
+
+	bool empty() const
+	{
+		return records.empty() && sentences.empty();
+	}
+
+	//! The .gnsb file: file header followed by the records
+	void writeRecords(std::ostream& out) const;
+
+	//! Lines of the .gnss file from the GGA records: laser timestamp [ns], lat, lon, alt, hdop, satellites, height, dgps age, time, fix quality, system time [ms]
+	void writeFixes(std::ostream& out) const;
+
+	//! Lines of the .nmea file: laser timestamp [ns], system time [ms], sentence
+	void writeSentences(std::ostream& out) const;
+};
+} // namespace mandeye
@@ -0,0 +1,227 @@
+#include "PreviewStream.h"
+#include "utils/ThreadRoles.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace mandeye
+{
+namespace
+{
+constexpr float CoordinateScale = 0.01f; // centimeters fit lidar range in int16
+constexpr float MaxCoordinate = INT16_MAX * CoordinateScale;
+
+//! 21 bits per axis, wraps for points further than ~100000 voxels, good enough for preview
+uint64_t voxelKey(float x, float y, float z, float voxelSize)
+{
+	constexpr uint64_t mask = (1u << 21) - 1;
+	const uint64_t kx = static_cast<uint64_t>(static_cast<int64_t>(std::floor(x / voxelSize))) & mask;
+	const uint64_t ky = static_cast<uint64_t>(static_cast<int64_t>(std::floor(y / voxelSize))) & mask;
+	const uint64_t kz = static_cast<uint64_t>(static_cast<int64_t>(std::floor(z / voxelSize))) & mask;
+	return (kx << 42) | (ky << 21) | kz;
+}
+
+//! Voxel table slots per point of the frame budget, the table is filled to at most half
+constexpr size_t VoxelSlotsPerPoint = 16;
+//! Stride keeps the considered points of a frame under this many times the budget
+constexpr uint64_t CandidatesPerPoint = 4;
+
+uint64_t nextRandom(uint64_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+} // namespace
+
+PreviewStream::PreviewStream(const nlohmann::json& config)
+	: m_port(config.value("port", 5558))
+	, m_rateHz(std::clamp(config.value("rate_hz", 4.0), 1.0, 10.0))
+	, m_voxelSize(std::max(config.value("voxel_size", 0.2f), 0.01f))
+	, m_context(1)
+	, m_socket(m_context, ZMQ_PUB)
+{
+	const double bandwidthKbits = std::max(config.value("bandwidth_kbit_s", 2000.0), 10.0);
+	const double bytesPerFrame = bandwidthKbits * 1000.0 / 8.0 / m_rateHz - sizeof(mandeye_utils::preview::Header);
+	m_maxPointsPerFrame = static_cast<size_t>(std::max(bytesPerFrame, 0.0) / sizeof(mandeye_utils::preview::Point));
+	m_maxPointsPerFrame = std::max<size_t>(m_maxPointsPerFrame, 1);
+	m_points.reserve(m_maxPointsPerFrame);
+	size_t voxelSlots = 1024;
+	while(voxelSlots < m_maxPointsPerFrame * VoxelSlotsPerPoint)
+	{
+		voxelSlots *= 2;
+	}
+	m_voxels.assign(voxelSlots, EmptyVoxel);
+
+	// slow client gets the newest frames, old ones are dropped
+	m_socket.setsockopt(ZMQ_SNDHWM, 2);
+	m_socket.bind("tcp://*:" + std::to_string(m_port));
+	m_thread = std::thread(&PreviewStream::worker, this);
+}
+
+PreviewStream::~PreviewStream()
+{
+	m_running = false;
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	m_socket.close();
+}
+
+void PreviewStream::Feed(const LidarPoint* points, size_t count)
+{
+	m_fedPoints.fetch_add(count, std::memory_order_relaxed);
+	std::unique_lock<std::mutex> lck(m_mutex, std::try_to_lock);
+	if(!lck.owns_lock())
+	{
+		m_skippedBatches.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	m_frameFedPoints += count;
+	for(size_t i = 0; i < count; i++)
+	{
+		if(m_strideCounter++ % m_stride != 0)
+		{
+			continue;
+		}
+		const LidarPoint& p = points[i];
+		if(std::abs(p.x) >= MaxCoordinate || std::abs(p.y) >= MaxCoordinate || std::abs(p.z) >= MaxCoordinate)
+		{
+			continue;
+		}
+		if(!InsertVoxel(voxelKey(p.x, p.y, p.z, m_voxelSize)))
+		{
+			continue;
+		}
+		mandeye_utils::preview::Point point;
+		point.x = static_cast<int16_t>(std::lround(p.x / CoordinateScale));
+		point.y = static_cast<int16_t>(std::lround(p.y / CoordinateScale));
+		point.z = static_cast<int16_t>(std::lround(p.z / CoordinateScale));
+		point.intensity = static_cast<uint8_t>(std::clamp(p.intensity, 0.0f, 255.0f));
+		m_frameCandidates++;
+		if(m_points.size() < m_maxPointsPerFrame)
+		{
+			m_points.push_back(point);
+			continue;
+		}
+		// reservoir sampling: every candidate of the frame has the same chance to be sent
+		m_droppedPoints++;
+		const uint64_t slot = nextRandom(m_random) % m_frameCandidates;
+		if(slot < m_maxPointsPerFrame)
+		{
+			m_points[slot] = point;
+		}
+	}
+	if(count > 0)
+	{
+		m_lastTimestamp = points[count - 1].timestamp;
+	}
+}
+
+bool PreviewStream::InsertVoxel(uint64_t key)
+{
+	if(m_voxelCount >= m_voxels.size() / 2)
+	{
+		return true;
+	}
+	const size_t mask = m_voxels.size() - 1;
+	for(size_t slot = ((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;; slot = (slot + 1) & mask)
+	{
+		if(m_voxels[slot] == key)
+		{
+			return false;
+		}
+		if(m_voxels[slot] == EmptyVoxel)
+		{
+			m_voxels[slot] = key;
+			m_voxelCount++;
+			return true;
+		}
+	}
+}
+
+nlohmann::json PreviewStream::produceStatus()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	nlohmann::json data;
+	data["port"] = m_port;
+	data["rate_hz"] = m_rateHz;
+	data["voxel_size"] = m_voxelSize;
+	data["max_points_per_frame"] = m_maxPointsPerFrame;
+	data["stride"] = m_stride;
+	data["fed_points"] = m_fedPoints.load(std::memory_order_relaxed);
+	data["skipped_batches"] = m_skippedBatches.load(std::memory_order_relaxed);
+	data["dropped_points"] = m_totalDroppedPoints + m_droppedPoints;
+	data["sent_frames"] = m_sentFrames;
+	data["sent_mb"] = double(m_sentBytes) / (1024 * 1024);
+	data["last_frame_points"] = m_lastFramePoints;
+	return data;
+}
+
+void PreviewStream::worker()
+{
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Publisher);
+	const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / m_rateHz));
+	auto nextFrame = std::chrono::steady_clock::now() + period;
+	// swapped with m_points, both keep their capacity so ingest threads never allocate
+	std::vector<mandeye_utils::preview::Point> points;
+	points.reserve(m_maxPointsPerFrame);
+	std::vector<uint8_t> payload;
+	uint32_t sequence = 0;
+	while(m_running)
+	{
+		std::this_thread::sleep_until(nextFrame);
+		nextFrame += period;
+
+		mandeye_utils::preview::Header header;
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			std::swap(points, m_points);
+			std::fill(m_voxels.begin(), m_voxels.end(), EmptyVoxel);
+			m_voxelCount = 0;
+			// next frame considers about CandidatesPerPoint times the budget, if the rate stays the same
+			m_stride = std::max<uint64_t>(1, m_frameFedPoints / (CandidatesPerPoint * m_maxPointsPerFrame));
+			m_frameFedPoints = 0;
+			m_frameCandidates = 0;
+			header.timestampNs = m_lastTimestamp;
+			header.droppedPoints = static_cast<uint32_t>(std::min<uint64_t>(m_droppedPoints, UINT32_MAX));
+			m_totalDroppedPoints += m_droppedPoints;
+			m_droppedPoints = 0;
+		}
+		if(points.empty())
+		{
+			continue;
+		}
+		header.sequence = sequence++;
+		header.pointCount = static_cast<uint32_t>(points.size());
+		header.voxelSize = m_voxelSize;
+		header.scale = CoordinateScale;
+
+		payload.resize(sizeof(header) + points.size() * sizeof(mandeye_utils::preview::Point));
+		std::memcpy(payload.data(), &header, sizeof(header));
+		std::memcpy(payload.data() + sizeof(header), points.data(), points.size() * sizeof(mandeye_utils::preview::Point));
+		const size_t framePoints = points.size();
+		points.clear();
+
+		try
+		{
+			m_socket.send(zmq::buffer(mandeye_utils::preview::Topic, sizeof(mandeye_utils::preview::Topic) - 1),
+						  zmq::send_flags::sndmore | zmq::send_flags::dontwait);
+			m_socket.send(zmq::buffer(payload.data(), payload.size()), zmq::send_flags::dontwait);
+		}
+		catch(const zmq::error_t& e)
+		{
+			std::cerr << "PreviewStream: failed to send frame : " << e.what() << std::endl;
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_sentFrames++;
+		m_sentBytes += payload.size();
+		m_lastFramePoints = framePoints;
+	}
+}
+} // namespace mandeye
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "lidars/BaseLidarClient.h"
+#include "utils/PreviewFormat.h"
+#include <atomic>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <thread>
+#include <vector>
+#include <zmq.hpp>
+
+namespace mandeye
+{
+
+//! Decimated live preview of incoming points, published on its own ZeroMQ socket (topic "preview").
+//! Ingest threads hand over batches they have just appended (see BaseLidarClient::SetLidarTap),
+//! points are reduced to one per voxel and limited to the bandwidth budget of a frame.
+//! Over the budget, points are reservoir sampled, so the frame covers its whole period evenly
+//! instead of only the first packets. At high rates every n-th point is considered (stride, from the previous frame).
+//! Nothing is allocated on the ingest threads: voxels go to a preallocated open-addressing table.
+//! Frames are sent at a fixed rate in the format of mandeye_utils::preview.
+class PreviewStream
+{
+public:
+	//! @param config "preview" section of the config: port, rate_hz, voxel_size, bandwidth_kbit_s
+	explicit PreviewStream(const nlohmann::json& config);
+	~PreviewStream();
+
+	PreviewStream(const PreviewStream&) = delete;
+	PreviewStream& operator=(const PreviewStream&) = delete;
+
+	//! Called from ingest threads, never blocks: batch is skipped if the frame is being sent
+	void Feed(const LidarPoint* points, size_t count);
+
+	nlohmann::json produceStatus();
+
+private:
+	void worker();
+	//! Marks voxel as used in this frame, false if it already was. When the table is at its load limit,
+	//! voxels are not deduplicated any more (true). Caller holds m_mutex.
+	bool InsertVoxel(uint64_t key);
+
+	//! Empty slot of the voxel table, no voxel key has all bits set
+	static constexpr uint64_t EmptyVoxel = ~uint64_t{0};
+
+	int m_port;
+	double m_rateHz;
+	float m_voxelSize;
+	size_t m_maxPointsPerFrame;
+
+	std::mutex m_mutex;
+	std::vector<uint64_t> m_voxels; //! open addressing, linear probing, size is a power of two
+	size_t m_voxelCount{0};
+	std::vector<mandeye_utils::preview::Point> m_points;
+	uint64_t m_frameFedPoints{0}; //! points fed in this frame
+	uint64_t m_frameCandidates{0}; //! points of new voxels in this frame, m_points is a sample of them
+	uint64_t m_strideCounter{0};
+	uint64_t m_stride{1};
+	uint64_t m_random{0x9E3779B97F4A7C15ULL}; //! xorshift state of the reservoir sampling
+	uint64_t m_lastTimestamp{0};
+	uint64_t m_droppedPoints{0};
+
+	std::atomic<uint64_t> m_fedPoints{0};
+	std::atomic<uint64_t> m_skippedBatches{0};
+	uint64_t m_sentFrames{0};
+	uint64_t m_sentBytes{0};
+	uint64_t m_totalDroppedPoints{0};
+	size_t m_lastFramePoints{0};
+
+	zmq::context_t m_context;
+	zmq::socket_t m_socket;
+	std::atomic<bool> m_running{true};
+	std::thread m_thread;
+};
+} // namespace mandeye
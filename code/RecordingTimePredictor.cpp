@@ -0,0 +1,158 @@
+#include "RecordingTimePredictor.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+namespace mandeye
+{
+namespace
+{
+constexpr double MB = 1024.0 * 1024.0;
+//! weight of the newest chunk in the average of the chunk rate
+constexpr double ChunkRateWeight = 0.3;
+//! free space decline is measured over this window, once it spans at least MinSpaceWindow
+constexpr auto SpaceWindow = std::chrono::seconds(60);
+constexpr auto MinSpaceWindow = std::chrono::seconds(20);
+//! recording time the reserve has to hold on top of the check period: chunks queued for the writer and the final one saved on stop
+constexpr double StopMarginSec = 15;
+
+double Round(double value)
+{
+	return std::round(value * 100.0) / 100.0;
+}
+
+const char* LevelToString(RecordingTimePredictor::Level level)
+{
+	switch(level)
+	{
+	case RecordingTimePredictor::Level::Warning:
+		return "warning";
+	case RecordingTimePredictor::Level::Stop:
+		return "stop";
+	default:
+		return "ok";
+	}
+}
+} // namespace
+
+RecordingTimePredictor::RecordingTimePredictor(const std::string& repository, const nlohmann::json& config)
+	: m_repository(repository)
+	, m_warnSec(60.0 * (config.is_object() ? config.value("warn_minutes", 10.0) : 10.0))
+	, m_reserveBytes(static_cast<int64_t>(MB * (config.is_object() ? config.value("reserve_mb", 256.0) : 256.0)))
+{ }
+
+void RecordingTimePredictor::ReportChunk(uint64_t bytes, double durationSec)
+{
+	if(durationSec <= 0)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lck(m_mutex);
+	const double rate = bytes / durationSec;
+	m_chunkRate = m_chunkRate > 0 ? ChunkRateWeight * rate + (1 - ChunkRateWeight) * m_chunkRate : rate;
+}
+
+RecordingTimePredictor::Level RecordingTimePredictor::Update(uint64_t pendingBytes, double storageWriteMBs, std::chrono::milliseconds checkPeriod)
+{
+	const auto now = std::chrono::steady_clock::now();
+	const auto measured = Available(pendingBytes);
+	std::lock_guard<std::mutex> lck(m_mutex);
+	m_pendingBytes = pendingBytes;
+	m_storageWriteMBs = storageWriteMBs;
+	m_checkPeriodSec = std::chrono::duration<double>(checkPeriod).count();
+	if(!measured)
+	{
+		return m_level;
+	}
+	const int64_t available = *measured;
+	m_samples.push_back({now, available});
+	while(m_samples.size() > 1 && now - m_samples.front().time > SpaceWindow)
+	{
+		m_samples.pop_front();
+	}
+	const auto window = now - m_samples.front().time;
+	if(window >= MinSpaceWindow)
+	{
+		const double windowSec = std::chrono::duration<double>(window).count();
+		m_spaceRate = std::max(0.0, (m_samples.front().available - available) / windowSec);
+	}
+
+	const double rate = Rate();
+	const int64_t reserve = Reserve();
+	if(available <= reserve)
+	{
+		m_level = Level::Stop;
+		m_stopped = true;
+	}
+	else if(rate > 0 && (available - reserve) / rate < m_warnSec)
+	{
+		m_level = Level::Warning;
+	}
+	else
+	{
+		m_level = Level::Ok;
+	}
+	return m_level;
+}
+
+void RecordingTimePredictor::Reset()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	// chunk rate of the last scan is the best guess until the new one has saved chunks
+	m_samples.clear();
+	m_spaceRate = 0;
+	m_level = Level::Ok;
+	m_stopped = false;
+}
+
+nlohmann::json RecordingTimePredictor::produceStatus()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	const auto available = Available(m_pendingBytes);
+	const double rate = Rate();
+	const int64_t reserve = Reserve();
+	nlohmann::json data;
+	data["level"] = LevelToString(m_level);
+	data["stopped_for_space"] = m_stopped;
+	data["rate_mb_min"] = Round(rate * 60 / MB);
+	data["chunk_rate_mb_min"] = Round(m_chunkRate * 60 / MB);
+	data["space_rate_mb_min"] = Round(m_spaceRate * 60 / MB);
+	data["available_mb"] = available ? Round(*available / MB) : -1;
+	data["pending_mb"] = Round(m_pendingBytes / MB);
+	data["reserve_mb"] = Round(reserve / MB);
+	data["check_period_sec"] = m_checkPeriodSec;
+	data["warn_minutes"] = m_warnSec / 60;
+	data["remaining_min"] = nullptr;
+	if(rate > 0 && available)
+	{
+		data["remaining_min"] = Round(std::max<int64_t>(0, *available - reserve) / rate / 60);
+	}
+	if(rate > 0 && m_storageWriteMBs > 0)
+	{
+		// above 1 the drive does not keep up, the spool backlog grows
+		data["drive_load"] = Round(rate / (m_storageWriteMBs * MB));
+	}
+	return data;
+}
+
+std::optional<int64_t> RecordingTimePredictor::Available(uint64_t pendingBytes) const
+{
+	std::error_code ec;
+	const auto space = std::filesystem::space(m_repository, ec);
+	if(ec)
+	{
+		return std::nullopt;
+	}
+	return static_cast<int64_t>(space.available) - static_cast<int64_t>(pendingBytes);
+}
+
+double RecordingTimePredictor::Rate() const
+{
+	return std::max(m_chunkRate, m_spaceRate);
+}
+
+int64_t RecordingTimePredictor::Reserve() const
+{
+	return std::max(m_reserveBytes, static_cast<int64_t>(Rate() * (m_checkPeriodSec + StopMarginSec)));
+}
+} // namespace mandeye
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+
+namespace mandeye
+{
+
+//! Predicts how long the recording can go on before the repository drive is full.
+//! The data rate is the larger of two measurements:
+//! - bytes of the files saved per chunk (point cloud, IMU, GNSS, status), averaged over recent chunks
+//! - decline of the free space while scanning, which also sees files written by other processes (camera)
+//! Data still in the spool counts as written. The state machine calls Update while scanning and stops the
+//! scan cleanly when the free space reaches the reserve, so the last chunk is saved instead of failing mid-write.
+class RecordingTimePredictor
+{
+public:
+	enum class Level
+	{
+		Ok,
+		Warning, //! less than warn_minutes left
+		Stop, //! free space is down to the reserve, the scan has to stop now
+	};
+
+	//! @param repository root of the repository, its free space is measured
+	//! @param config "recording_time" section of the config: warn_minutes, reserve_mb
+	RecordingTimePredictor(const std::string& repository, const nlohmann::json& config);
+
+	//! Size of the files saved for a chunk that covers durationSec of recording, called by the chunk writer
+	void ReportChunk(uint64_t bytes, double durationSec);
+
+	//! Called by the state machine while scanning.
+	//! @param pendingBytes saved but not yet on the drive (spool backlog)
+	//! @param storageWriteMBs sustained write rate of the drive from the storage benchmark, 0 if unknown
+	//! @param checkPeriod time until the next call (chunk interval), the reserve has to hold what is recorded meanwhile
+	Level Update(uint64_t pendingBytes, double storageWriteMBs, std::chrono::milliseconds checkPeriod);
+
+	//! Forgets the free space history, called when a scan starts
+	void Reset();
+
+	nlohmann::json produceStatus();
+
+private:
+	struct Sample
+	{
+		std::chrono::steady_clock::time_point time;
+		int64_t available; //! free space minus pending bytes
+	};
+
+	//! Free space of the drive minus pending bytes, empty if it cannot be read
+	std::optional<int64_t> Available(uint64_t pendingBytes) const;
+	//! Bytes per second of the recording, 0 if not measured yet. Caller holds m_mutex.
+	double Rate() const;
+	//! Space that has to stay free, grows with the data rate and the check period to fit the data
+	//! recorded until the next check and the last chunk. Caller holds m_mutex.
+	int64_t Reserve() const;
+
+	std::string m_repository;
+	double m_warnSec;
+	int64_t m_reserveBytes;
+
+	std::mutex m_mutex;
+	double m_chunkRate{0}; //! bytes/s from the saved chunks
+	double m_spaceRate{0}; //! bytes/s from the free space decline
+	std::deque<Sample> m_samples;
+	uint64_t m_pendingBytes{0};
+	double m_storageWriteMBs{0};
+	double m_checkPeriodSec{0};
+	Level m_level{Level::Ok};
+	bool m_stopped{false};
+};
+} // namespace mandeye
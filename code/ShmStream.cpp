@@ -0,0 +1,239 @@
+#include "ShmStream.h"
+#include "utils/ThreadRoles.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace mandeye
+{
+namespace
+{
+uint64_t roundUpToPowerOfTwo(uint64_t value)
+{
+	uint64_t result = 1;
+	while(result < value)
+	{
+		result <<= 1;
+	}
+	return result;
+}
+
+mandeye_utils::shm::Point toShmPoint(const LidarPoint& p)
+{
+	mandeye_utils::shm::Point point;
+	point.timestamp = p.timestamp;
+	point.x = p.x;
+	point.y = p.y;
+	point.z = p.z;
+	point.intensity = p.intensity;
+	point.laser_id = p.laser_id;
+	point.line_id = p.line_id;
+	point.tag = p.tag;
+	return point;
+}
+
+mandeye_utils::shm::Imu toShmImu(const LidarIMU& s)
+{
+	mandeye_utils::shm::Imu imu;
+	imu.timestamp = s.timestamp;
+	imu.gyro_x = s.gyro_x;
+	imu.gyro_y = s.gyro_y;
+	imu.gyro_z = s.gyro_z;
+	imu.acc_x = s.acc_x;
+	imu.acc_y = s.acc_y;
+	imu.acc_z = s.acc_z;
+	imu.laser_id = s.laser_id;
+	return imu;
+}
+} // namespace
+
+ShmStream::ShmStream(const nlohmann::json& config)
+	: m_notifyInterval(std::max(config.value("notify_interval_ms", 5), 1))
+	, m_context(1)
+	, m_socket(m_context, ZMQ_PUB)
+{
+	m_points.name = mandeye_utils::shm::PointsName;
+	m_imu.name = mandeye_utils::shm::ImuName;
+	Open(m_points, config.value("points_capacity", uint64_t{1} << 20), sizeof(mandeye_utils::shm::Point));
+	Open(m_imu, config.value("imu_capacity", uint64_t{1} << 16), sizeof(mandeye_utils::shm::Imu));
+
+	m_socket.bind(mandeye_utils::shm::NotifyEndpoint);
+	m_thread = std::thread(&ShmStream::notifier, this);
+}
+
+ShmStream::~ShmStream()
+{
+	{
+		std::lock_guard<std::mutex> lck(m_wakeMutex);
+		m_running = false;
+	}
+	m_wake.notify_all();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	m_socket.close();
+	Close(m_points);
+	Close(m_imu);
+}
+
+bool ShmStream::Open(Ring& ring, uint64_t capacity, uint32_t recordSize)
+{
+	capacity = roundUpToPowerOfTwo(std::max<uint64_t>(capacity, 1024));
+	// readers of a previous run keep their mapping of the unlinked segment and notice the new session
+	shm_unlink(ring.name.c_str());
+	const int fd = shm_open(ring.name.c_str(), O_CREAT | O_RDWR, 0644);
+	if(fd < 0)
+	{
+		std::cerr << "ShmStream: shm_open " << ring.name << " failed : " << strerror(errno) << std::endl;
+		return false;
+	}
+	const size_t size = mandeye_utils::shm::segmentSize(capacity, recordSize);
+	if(ftruncate(fd, size) != 0)
+	{
+		std::cerr << "ShmStream: ftruncate " << ring.name << " failed : " << strerror(errno) << std::endl;
+		close(fd);
+		shm_unlink(ring.name.c_str());
+		return false;
+	}
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(memory == MAP_FAILED)
+	{
+		std::cerr << "ShmStream: mmap " << ring.name << " failed : " << strerror(errno) << std::endl;
+		shm_unlink(ring.name.c_str());
+		return false;
+	}
+
+	auto* header = new(memory) mandeye_utils::shm::RingHeader();
+	header->recordSize = recordSize;
+	header->capacity = capacity;
+	header->sessionId = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count()) ^ getpid();
+	ring.header = header;
+	ring.size = size;
+	std::cout << "ShmStream: " << ring.name << " " << capacity << " records of " << recordSize << " bytes" << std::endl;
+	return true;
+}
+
+void ShmStream::Close(Ring& ring)
+{
+	if(ring.header)
+	{
+		munmap(ring.header, ring.size);
+		shm_unlink(ring.name.c_str());
+		ring.header = nullptr;
+	}
+}
+
+void ShmStream::WritePoints(const LidarPoint* points, size_t count)
+{
+	if(!m_points.header)
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lck(m_points.writerMutex);
+		mandeye_utils::shm::write<mandeye_utils::shm::Point>(m_points.header, points, count, toShmPoint);
+	}
+	WakeNotifier();
+}
+
+void ShmStream::WriteImu(const LidarIMU* samples, size_t count)
+{
+	if(!m_imu.header)
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lck(m_imu.writerMutex);
+		mandeye_utils::shm::write<mandeye_utils::shm::Imu>(m_imu.header, samples, count, toShmImu);
+	}
+	WakeNotifier();
+}
+
+void ShmStream::WakeNotifier()
+{
+	if(!m_pending.exchange(true))
+	{
+		// taking the lock orders the flag with the predicate check of the notifier, so the wakeup is not lost
+		{
+			std::lock_guard<std::mutex> lck(m_wakeMutex);
+		}
+		m_wake.notify_one();
+	}
+}
+
+void ShmStream::Notify(Ring& ring)
+{
+	if(!ring.header)
+	{
+		return;
+	}
+	const uint64_t writeIndex = ring.header->writeIndex.load(std::memory_order_acquire);
+	if(writeIndex == ring.notifiedIndex)
+	{
+		return;
+	}
+	ring.notifiedIndex = writeIndex;
+	try
+	{
+		m_socket.send(zmq::buffer(ring.name.data(), ring.name.size()), zmq::send_flags::sndmore | zmq::send_flags::dontwait);
+		m_socket.send(zmq::buffer(&writeIndex, sizeof(writeIndex)), zmq::send_flags::dontwait);
+		m_notifications.fetch_add(1, std::memory_order_relaxed);
+	}
+	catch(const zmq::error_t& e)
+	{
+		std::cerr << "ShmStream: failed to notify " << ring.name << " : " << e.what() << std::endl;
+	}
+}
+
+void ShmStream::notifier()
+{
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Publisher);
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lck(m_wakeMutex);
+			m_wake.wait(lck, [this]() { return m_pending || !m_running; });
+			if(!m_running)
+			{
+				break;
+			}
+		}
+		// cleared before reading write indices, a write after this point wakes the next round
+		m_pending = false;
+		Notify(m_points);
+		Notify(m_imu);
+		// throttle to the notify interval, writes meanwhile are announced together
+		std::unique_lock<std::mutex> lck(m_wakeMutex);
+		m_wake.wait_for(lck, m_notifyInterval, [this]() { return !m_running; });
+	}
+}
+
+nlohmann::json ShmStream::produceStatus()
+{
+	nlohmann::json data;
+	for(const Ring* ring : {&m_points, &m_imu})
+	{
+		nlohmann::json ringData;
+		ringData["open"] = ring->header != nullptr;
+		if(ring->header)
+		{
+			ringData["capacity"] = ring->header->capacity;
+			ringData["record_size"] = ring->header->recordSize;
+			ringData["written"] = ring->header->writeIndex.load(std::memory_order_relaxed);
+			ringData["size_mb"] = double(ring->size) / (1024 * 1024);
+		}
+		data[ring->name] = ringData;
+	}
+	data["notifications"] = m_notifications.load(std::memory_order_relaxed);
+	data["notify_endpoint"] = mandeye_utils::shm::NotifyEndpoint;
+	return data;
+}
+} // namespace mandeye
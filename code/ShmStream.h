@@ -0,0 +1,67 @@
+#pragma once
+
+#include "lidars/BaseLidarClient.h"
+#include "utils/ShmRing.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <zmq.hpp>
+
+namespace mandeye
+{
+
+//! Live point and IMU stream for processes on the same device, in POSIX shared-memory rings
+//! (layout in mandeye_utils::shm). Ingest threads convert batches straight into the rings
+//! (see BaseLidarClient::SetLidarTap), readers map the segments and read in place.
+//! New data is announced on a ZeroMQ ipc socket at most every notify interval, the notifier sleeps while idle.
+class ShmStream
+{
+public:
+	//! @param config "shm" section of the config: points_capacity, imu_capacity, notify_interval_ms
+	explicit ShmStream(const nlohmann::json& config);
+	~ShmStream();
+
+	ShmStream(const ShmStream&) = delete;
+	ShmStream& operator=(const ShmStream&) = delete;
+
+	//! Called from ingest threads
+	void WritePoints(const LidarPoint* points, size_t count);
+	void WriteImu(const LidarIMU* samples, size_t count);
+
+	nlohmann::json produceStatus();
+
+private:
+	//! One shared-memory segment
+	struct Ring
+	{
+		std::string name;
+		mandeye_utils::shm::RingHeader* header{nullptr};
+		size_t size{0};
+		std::mutex writerMutex; //! ingest threads of different lidars write concurrently
+		uint64_t notifiedIndex{0};
+	};
+
+	static bool Open(Ring& ring, uint64_t capacity, uint32_t recordSize);
+	static void Close(Ring& ring);
+	void notifier();
+	void Notify(Ring& ring);
+	//! Wakes the notifier, only the first write after a notification takes the lock
+	void WakeNotifier();
+
+	Ring m_points;
+	Ring m_imu;
+	std::chrono::milliseconds m_notifyInterval;
+	std::atomic<uint64_t> m_notifications{0};
+
+	zmq::context_t m_context;
+	zmq::socket_t m_socket;
+	std::atomic<bool> m_running{true};
+	std::atomic<bool> m_pending{false}; //! rings written since the notifier last looked
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wake;
+	std::thread m_thread;
+};
+} // namespace mandeye
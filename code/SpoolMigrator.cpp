@@ -0,0 +1,372 @@
+#include "SpoolMigrator.h"
+#include "utils/ThreadRoles.h"
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+namespace mandeye
+{
+namespace
+{
+constexpr size_t CopyBlockSize = 1024 * 1024;
+constexpr char PartialSuffix[] = ".part";
+
+//! FNV-1a, good enough to catch torn or corrupted copies
+uint64_t UpdateChecksum(uint64_t hash, const char* data, size_t size)
+{
+	for(size_t i = 0; i < size; i++)
+	{
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+constexpr uint64_t ChecksumSeed = 14695981039346656037ULL;
+
+bool WriteAll(int fd, const char* data, size_t size)
+{
+	while(size > 0)
+	{
+		const ssize_t written = ::write(fd, data, size);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+//! Reads back the file bypassing page cache (as far as possible) and computes checksum
+bool ChecksumFile(const std::filesystem::path& path, uint64_t& checksum, uint64_t& size)
+{
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+	{
+		return false;
+	}
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	std::vector<char> buffer(CopyBlockSize);
+	checksum = ChecksumSeed;
+	size = 0;
+	ssize_t readBytes = 0;
+	while((readBytes = ::read(fd, buffer.data(), buffer.size())) > 0)
+	{
+		checksum = UpdateChecksum(checksum, buffer.data(), readBytes);
+		size += readBytes;
+	}
+	::close(fd);
+	return readBytes == 0;
+}
+} // namespace
+
+SpoolMigrator::SpoolMigrator(const std::string& spoolRoot,
+							 const std::string& repositoryRoot,
+							 double rateLimitMBs,
+							 const std::function<void(const std::string& error)>& onGiveUp)
+	: m_spoolRoot(spoolRoot)
+	, m_repositoryRoot(repositoryRoot)
+	, m_rateLimitMBs(rateLimitMBs)
+	, m_onGiveUp(onGiveUp)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(m_spoolRoot, ec);
+	if(ec)
+	{
+		std::cerr << "SpoolMigrator: cannot create spool " << m_spoolRoot << " : " << ec.message() << std::endl;
+	}
+	RecoverSpool();
+	m_thread = std::thread(&SpoolMigrator::worker, this);
+}
+
+SpoolMigrator::~SpoolMigrator()
+{
+	m_running = false;
+	m_jobAvailable.notify_all();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+nlohmann::json SpoolMigrator::produceStatus()
+{
+	nlohmann::json data;
+	std::lock_guard<std::mutex> lck(m_mutex);
+	data["spool"] = m_spoolRoot.string();
+	data["repository"] = m_repositoryRoot.string();
+	data["rate_limit_mb_s"] = m_rateLimitMBs;
+	data["backlog_files"] = m_jobs.size() + (m_jobInProgress ? 1 : 0);
+	data["backlog_mb"] = static_cast<double>(m_backlogBytes) / (1024 * 1024);
+	data["migrated_files"] = m_migratedFiles;
+	data["migrated_mb"] = static_cast<double>(m_migratedBytes) / (1024 * 1024);
+	data["failed_files"] = m_failedFiles;
+	data["abandoned_files"] = m_abandonedFiles;
+	data["last_rate_mb_s"] = m_lastRateMBs;
+	data["last_error"] = m_lastError;
+	return data;
+}
+
+std::string SpoolMigrator::GetSpoolDirectory(const std::string& repositoryDirectory)
+{
+	const std::filesystem::path spoolDirectory = m_spoolRoot / std::filesystem::path(repositoryDirectory).filename();
+	std::error_code ec;
+	std::filesystem::create_directories(spoolDirectory, ec);
+	if(ec)
+	{
+		std::cerr << "SpoolMigrator: cannot create " << spoolDirectory << " : " << ec.message() << std::endl;
+		return "";
+	}
+	return spoolDirectory.string();
+}
+
+void SpoolMigrator::EnqueueDirectory(const std::string& spoolDirectory)
+{
+	const std::filesystem::path targetDirectory = m_repositoryRoot / std::filesystem::path(spoolDirectory).filename();
+	std::vector<Job> jobs;
+	std::error_code ec;
+	for(const auto& entry : std::filesystem::directory_iterator(spoolDirectory, ec))
+	{
+		if(!entry.is_regular_file())
+		{
+			continue;
+		}
+		Job job;
+		job.m_source = entry.path();
+		job.m_target = targetDirectory / entry.path().filename();
+		job.m_size = entry.file_size(ec);
+		jobs.push_back(job);
+	}
+	if(ec)
+	{
+		std::cerr << "SpoolMigrator: cannot list " << spoolDirectory << " : " << ec.message() << std::endl;
+	}
+
+	std::lock_guard<std::mutex> lck(m_mutex);
+	for(auto& job : jobs)
+	{
+		if(m_queuedSources.insert(job.m_source).second)
+		{
+			m_backlogBytes += job.m_size;
+			m_jobs.push_back(std::move(job));
+		}
+	}
+	m_jobAvailable.notify_one();
+}
+
+bool SpoolMigrator::WaitForEmptyBacklog(std::chrono::seconds timeout)
+{
+	std::unique_lock<std::mutex> lck(m_mutex);
+	return m_backlogEmpty.wait_for(lck, timeout, [this]() { return m_jobs.empty() && !m_jobInProgress; });
+}
+
+size_t SpoolMigrator::GetBacklogFiles()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	return m_jobs.size() + (m_jobInProgress ? 1 : 0);
+}
+
+uint64_t SpoolMigrator::GetBacklogBytes()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	return m_backlogBytes;
+}
+
+void SpoolMigrator::RecoverSpool()
+{
+	std::error_code ec;
+	for(const auto& entry : std::filesystem::directory_iterator(m_spoolRoot, ec))
+	{
+		if(entry.is_directory())
+		{
+			std::cout << "SpoolMigrator: recovering " << entry.path() << std::endl;
+			EnqueueDirectory(entry.path().string());
+		}
+	}
+}
+
+void SpoolMigrator::worker()
+{
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Spool);
+	while(m_running)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lck(m_mutex);
+			m_jobAvailable.wait(lck, [this]() { return !m_jobs.empty() || !m_running; });
+			if(!m_running)
+			{
+				break;
+			}
+			job = m_jobs.front();
+			m_jobs.pop_front();
+			m_jobInProgress = true;
+		}
+
+		bool rewritten = false;
+		const bool success = MigrateFile(job, rewritten);
+
+		std::unique_lock<std::mutex> lck(m_mutex);
+		m_jobInProgress = false;
+		if(success)
+		{
+			m_backlogBytes -= std::min(m_backlogBytes, job.m_size);
+			m_migratedFiles++;
+			m_migratedBytes += job.m_size;
+			if(rewritten)
+			{
+				// enqueues during the copy were dropped as duplicates, so the newer content is queued here
+				std::error_code ec;
+				job.m_size = std::filesystem::file_size(job.m_source, ec);
+				job.m_attempts = 0;
+				m_backlogBytes += ec ? 0 : job.m_size;
+				m_jobs.push_back(job);
+			}
+			else
+			{
+				m_queuedSources.erase(job.m_source);
+			}
+		}
+		else if(m_running)
+		{
+			// keep the file in spool and retry later, USB could be temporarily unavailable
+			m_failedFiles++;
+			job.m_attempts++;
+			if(job.m_attempts < MaxAttempts)
+			{
+				m_jobs.push_back(job);
+				const auto backoff = std::min<std::chrono::seconds>(std::chrono::seconds(1 << (job.m_attempts - 1)), MaxBackoff);
+				m_jobAvailable.wait_for(lck, backoff, [this]() { return !m_running; });
+			}
+			else
+			{
+				// left in spool, the next EnqueueDirectory of its directory or the next start picks it up again
+				m_queuedSources.erase(job.m_source);
+				m_backlogBytes -= std::min(m_backlogBytes, job.m_size);
+				m_abandonedFiles++;
+				const std::string error = "giving up on " + job.m_source.string() + " after " + std::to_string(job.m_attempts) +
+										  " attempts, last error: " + m_lastError;
+				m_lastError = error;
+				lck.unlock();
+				std::cerr << "SpoolMigrator: " << error << std::endl;
+				if(m_onGiveUp)
+				{
+					m_onGiveUp(error);
+				}
+				lck.lock();
+			}
+		}
+		if(m_jobs.empty() && !m_jobInProgress)
+		{
+			m_backlogEmpty.notify_all();
+		}
+	}
+}
+
+bool SpoolMigrator::MigrateFile(const Job& job, bool& rewritten)
+{
+	rewritten = false;
+	auto setError = [this](const std::string& error) {
+		std::cerr << "SpoolMigrator: " << error << std::endl;
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_lastError = error;
+	};
+
+	std::error_code ec;
+	std::filesystem::create_directories(job.m_target.parent_path(), ec);
+	if(ec)
+	{
+		setError("cannot create " + job.m_target.parent_path().string() + " : " + ec.message());
+		return false;
+	}
+
+	const int sourceFd = ::open(job.m_source.c_str(), O_RDONLY);
+	if(sourceFd < 0)
+	{
+		setError("cannot open " + job.m_source.string());
+		return false;
+	}
+	posix_fadvise(sourceFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	const auto sourceWriteTime = std::filesystem::last_write_time(job.m_source, ec);
+
+	const std::filesystem::path partialPath = job.m_target.string() + PartialSuffix;
+	const int targetFd = ::open(partialPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(targetFd < 0)
+	{
+		::close(sourceFd);
+		setError("cannot open " + partialPath.string());
+		return false;
+	}
+
+	std::vector<char> buffer(CopyBlockSize);
+	uint64_t sourceChecksum = ChecksumSeed;
+	uint64_t copiedBytes = 0;
+	bool ok = true;
+	const auto start = std::chrono::steady_clock::now();
+	ssize_t readBytes = 0;
+	// interrupted on shutdown, the file stays in spool
+	while(m_running && (readBytes = ::read(sourceFd, buffer.data(), buffer.size())) > 0)
+	{
+		if(!WriteAll(targetFd, buffer.data(), readBytes))
+		{
+			ok = false;
+			break;
+		}
+		sourceChecksum = UpdateChecksum(sourceChecksum, buffer.data(), readBytes);
+		copiedBytes += readBytes;
+
+		if(m_rateLimitMBs > 0)
+		{
+			const auto due = start + std::chrono::duration<double>(copiedBytes / (m_rateLimitMBs * 1024 * 1024));
+			std::this_thread::sleep_until(std::chrono::time_point_cast<std::chrono::steady_clock::duration>(due));
+		}
+	}
+	ok = ok && m_running && readBytes == 0;
+	ok = ok && ::fdatasync(targetFd) == 0;
+	::close(targetFd);
+	::close(sourceFd);
+	if(!ok)
+	{
+		setError("failed to copy " + job.m_source.string() + " to " + partialPath.string());
+		return false;
+	}
+
+	uint64_t targetChecksum = 0;
+	uint64_t targetSize = 0;
+	if(!ChecksumFile(partialPath, targetChecksum, targetSize) || targetSize != copiedBytes || targetChecksum != sourceChecksum)
+	{
+		setError("verification failed for " + partialPath.string());
+		std::filesystem::remove(partialPath, ec);
+		return false;
+	}
+
+	std::filesystem::rename(partialPath, job.m_target, ec);
+	if(ec)
+	{
+		setError("cannot rename " + partialPath.string() + " : " + ec.message());
+		return false;
+	}
+	// file rewritten during copy (e.g. session index) stays in spool and is migrated again
+	if(std::filesystem::last_write_time(job.m_source, ec) == sourceWriteTime)
+	{
+		std::filesystem::remove(job.m_source, ec);
+	}
+	else
+	{
+		rewritten = true;
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::lock_guard<std::mutex> lck(m_mutex);
+	m_lastRateMBs = elapsed.count() > 0 ? (copiedBytes / (1024.0 * 1024.0)) / elapsed.count() : 0;
+	return true;
+}
+
+} // namespace mandeye
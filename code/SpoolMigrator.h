@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace mandeye
+{
+
+//! Two-tier storage: chunks are written to a fast local spool (NVMe/SD) and moved
+//! in background to the repository (usually slow USB stick).
+class SpoolMigrator
+{
+	struct Job
+	{
+		std::filesystem::path m_source;
+		std::filesystem::path m_target;
+		uint64_t m_size{0};
+		int m_attempts{0};
+	};
+
+public:
+	//! @param spoolRoot root directory of the fast local tier
+	//! @param repositoryRoot root directory of the repository (MANDEYE_REPO)
+	//! @param rateLimitMBs maximum migration rate in MB/s, zero or negative means unlimited
+	//! @param onGiveUp called from the migration thread when a file failed MaxAttempts times, it stays in the spool
+	//! and is retried with the next chunk of its directory or on the next start
+	SpoolMigrator(const std::string& spoolRoot, const std::string& repositoryRoot, double rateLimitMBs,
+				  const std::function<void(const std::string& error)>& onGiveUp = {});
+	~SpoolMigrator();
+
+	SpoolMigrator(const SpoolMigrator&) = delete;
+	SpoolMigrator& operator=(const SpoolMigrator&) = delete;
+
+	nlohmann::json produceStatus();
+
+	//! Returns spool counterpart of a repository directory (e.g. continousScanning_0001), creates it if needed
+	//! @returns empty string if directory cannot be created
+	std::string GetSpoolDirectory(const std::string& repositoryDirectory);
+
+	//! Enqueue all files in the spool directory to be moved to its repository counterpart
+	void EnqueueDirectory(const std::string& spoolDirectory);
+
+	//! Blocks until migration backlog is empty or timeout passes
+	//! @returns true if backlog is empty
+	bool WaitForEmptyBacklog(std::chrono::seconds timeout);
+
+	//! Failed migration of a file is retried after 1 s, 2 s, 4 s ... up to MaxBackoff, at most MaxAttempts times
+	static constexpr int MaxAttempts = 8;
+	static constexpr std::chrono::seconds MaxBackoff{30};
+
+	//! Number of files waiting for migration (including one in progress)
+	size_t GetBacklogFiles();
+
+	//! Number of bytes waiting for migration (including one in progress)
+	uint64_t GetBacklogBytes();
+
+private:
+	void worker();
+
+	//! Copy, verify and remove source of single file
+	//! @param rewritten set if the source changed during the copy, it is kept in spool then
+	bool MigrateFile(const Job& job, bool& rewritten);
+
+	//! Re-enqueue files left in spool by previous run
+	void RecoverSpool();
+
+	std::filesystem::path m_spoolRoot;
+	std::filesystem::path m_repositoryRoot;
+	double m_rateLimitMBs{0};
+	std::function<void(const std::string&)> m_onGiveUp;
+
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_backlogEmpty;
+	std::deque<Job> m_jobs;
+	std::set<std::filesystem::path> m_queuedSources;
+	bool m_jobInProgress{false};
+	uint64_t m_backlogBytes{0};
+
+	uint64_t m_migratedFiles{0};
+	uint64_t m_migratedBytes{0};
+	uint64_t m_failedFiles{0}; //! failed attempts
+	uint64_t m_abandonedFiles{0}; //! files given up after MaxAttempts
+	double m_lastRateMBs{0};
+	std::string m_lastError;
+
+	std::atomic<bool> m_running{true};
+	std::thread m_thread;
+};
+} // namespace mandeye
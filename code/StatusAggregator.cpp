@@ -0,0 +1,199 @@
+#include "StatusAggregator.h"
+#include "utils/ThreadRoles.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace mandeye
+{
+
+StatusAggregator::StatusAggregator()
+	: m_snapshot(Build(false))
+	, m_snapshotFull(Build(true))
+{ }
+
+StatusAggregator::~StatusAggregator()
+{
+	Stop();
+}
+
+void StatusAggregator::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_running = false;
+	}
+	m_wakeup.notify_one();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void StatusAggregator::AddSource(const std::string& name, std::chrono::milliseconds period, Producer producer, bool fullOnly)
+{
+	auto source = std::make_unique<Source>();
+	source->name = name;
+	source->period = period;
+	source->producer = std::move(producer);
+	source->fullOnly = fullOnly;
+	m_sources.push_back(std::move(source));
+}
+
+void StatusAggregator::Start()
+{
+	RefreshDue(std::chrono::steady_clock::time_point::max());
+	Rebuild();
+	m_running = true;
+	m_thread = std::thread(&StatusAggregator::worker, this);
+}
+
+void StatusAggregator::Invalidate(const std::string& name)
+{
+	for(auto& source : m_sources)
+	{
+		if(source->name == name)
+		{
+			{
+				std::lock_guard<std::mutex> lck(m_mutex);
+				source->invalidated = true;
+			}
+			m_wakeup.notify_one();
+			return;
+		}
+	}
+}
+
+StatusAggregator::SnapshotPtr StatusAggregator::GetSnapshot(bool full) const
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	return full ? m_snapshotFull : m_snapshot;
+}
+
+void StatusAggregator::worker()
+{
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Status);
+	while(m_running)
+	{
+		auto next = std::chrono::steady_clock::time_point::max();
+		for(const auto& source : m_sources)
+		{
+			next = std::min(next, source->nextRefresh);
+		}
+		{
+			std::unique_lock<std::mutex> lck(m_mutex);
+			m_wakeup.wait_until(lck, next, [this]() {
+				return !m_running || std::any_of(m_sources.begin(), m_sources.end(), [](const auto& s) { return s->invalidated.load(); });
+			});
+		}
+		if(!m_running)
+		{
+			break;
+		}
+		if(RefreshDue(std::chrono::steady_clock::now()))
+		{
+			Rebuild();
+		}
+	}
+}
+
+bool StatusAggregator::RefreshDue(std::chrono::steady_clock::time_point now)
+{
+	bool changed = false;
+	for(auto& source : m_sources)
+	{
+		const bool invalidated = source->invalidated.exchange(false);
+		if(now < source->nextRefresh && !invalidated)
+		{
+			continue;
+		}
+		const auto start = std::chrono::steady_clock::now();
+		nlohmann::json value;
+		try
+		{
+			value = source->producer();
+		}
+		catch(const std::exception& e)
+		{
+			std::cerr << "StatusAggregator: source " << source->name << " failed : " << e.what() << std::endl;
+			value = source->value;
+		}
+		const auto end = std::chrono::steady_clock::now();
+		source->nextRefresh = end + source->period;
+		if(value != source->value)
+		{
+			source->value = std::move(value);
+			changed = true;
+		}
+
+		const double durationMs = std::chrono::duration<double, std::milli>(end - start).count();
+		std::lock_guard<std::mutex> lck(m_mutex);
+		source->refreshes++;
+		source->lastDurationMs = durationMs;
+		source->maxDurationMs = std::max(source->maxDurationMs, durationMs);
+	}
+	return changed;
+}
+
+StatusAggregator::SnapshotPtr StatusAggregator::Build(bool full) const
+{
+	nlohmann::json j;
+	for(const auto& source : m_sources)
+	{
+		if(source->fullOnly && !full)
+		{
+			continue;
+		}
+		if(source->value.is_object())
+		{
+			j.update(source->value);
+		}
+		else
+		{
+			j[source->name] = source->value;
+		}
+	}
+	auto snapshot = std::make_shared<Snapshot>();
+	std::ostringstream s;
+	s << std::setw(4) << j;
+	snapshot->body = s.str();
+	std::ostringstream etag;
+	etag << '"' << std::hex << std::hash<std::string>{}(snapshot->body) << '"';
+	snapshot->etag = etag.str();
+	snapshot->built = std::chrono::steady_clock::now();
+	return snapshot;
+}
+
+void StatusAggregator::Rebuild()
+{
+	// sources are only written by this thread, so they are read without lock
+	SnapshotPtr snapshot = Build(false);
+	SnapshotPtr snapshotFull = Build(true);
+	std::lock_guard<std::mutex> lck(m_mutex);
+	m_snapshot = std::move(snapshot);
+	m_snapshotFull = std::move(snapshotFull);
+	m_rebuilds++;
+}
+
+nlohmann::json StatusAggregator::produceStatus()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	nlohmann::json data;
+	data["rebuilds"] = m_rebuilds;
+	if(m_snapshotFull)
+	{
+		data["snapshot_bytes"] = m_snapshotFull->body.size();
+	}
+	for(const auto& source : m_sources)
+	{
+		auto& s = data["sources"][source->name];
+		s["period_ms"] = source->period.count();
+		s["refreshes"] = source->refreshes;
+		s["last_duration_ms"] = source->lastDurationMs;
+		s["max_duration_ms"] = source->maxDurationMs;
+		s["full_only"] = source->fullOnly;
+	}
+	return data;
+}
+} // namespace mandeye
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mandeye
+{
+
+//! Builds the HTTP status in background. Each source is refreshed on its own period, the merged
+//! status is serialized once per change and served as an immutable snapshot with an ETag,
+//! so requests never call into lidar, GNSS or file system clients.
+class StatusAggregator
+{
+public:
+	//! Serialized status
+	struct Snapshot
+	{
+		std::string body;
+		std::string etag; //! quoted, as sent in the ETag header
+		std::chrono::steady_clock::time_point built;
+	};
+	using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+	//! Returns JSON object, its keys are merged into the top level of the status
+	using Producer = std::function<nlohmann::json()>;
+
+	//! Snapshots are empty objects until Start
+	StatusAggregator();
+	~StatusAggregator();
+
+	StatusAggregator(const StatusAggregator&) = delete;
+	StatusAggregator& operator=(const StatusAggregator&) = delete;
+
+	//! Adds source refreshed every period. Sources with fullOnly are left out of the short status.
+	//! Has to be called before Start.
+	void AddSource(const std::string& name, std::chrono::milliseconds period, Producer producer, bool fullOnly = false);
+
+	//! Refreshes all sources once, then keeps refreshing them in background.
+	//! Sources are called from the background thread, what they read has to be set up before.
+	void Start();
+
+	//! Stops and joins the background thread, has to be called before anything the sources read is destroyed.
+	//! The last snapshot stays available.
+	void Stop();
+
+	//! Refresh source as soon as possible, e.g. on state change
+	void Invalidate(const std::string& name);
+
+	//! Latest snapshot, never blocks on sources
+	SnapshotPtr GetSnapshot(bool full) const;
+
+	nlohmann::json produceStatus();
+
+private:
+	struct Source
+	{
+		std::string name;
+		std::chrono::milliseconds period;
+		Producer producer;
+		bool fullOnly;
+		nlohmann::json value;
+		std::chrono::steady_clock::time_point nextRefresh;
+		std::atomic<bool> invalidated{false};
+		// statistics, guarded by m_mutex
+		uint64_t refreshes{0};
+		double lastDurationMs{0};
+		double maxDurationMs{0};
+	};
+
+	void worker();
+	//! Refreshes due sources, returns true if any value has changed
+	bool RefreshDue(std::chrono::steady_clock::time_point now);
+	void Rebuild();
+	SnapshotPtr Build(bool full) const;
+
+	std::vector<std::unique_ptr<Source>> m_sources;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wakeup;
+	SnapshotPtr m_snapshot;
+	SnapshotPtr m_snapshotFull;
+	uint64_t m_rebuilds{0};
+
+	std::atomic<bool> m_running{false};
+	std::thread m_thread;
+};
+} // namespace mandeye
@@ -0,0 +1,312 @@
+#include "StatusPushServer.h"
+#include "utils/ThreadRoles.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace mandeye
+{
+namespace
+{
+constexpr size_t MaxRequestSize = 8192;
+constexpr size_t MaxPendingBytes = 1024 * 1024;
+constexpr auto KeepaliveInterval = std::chrono::seconds(15);
+constexpr char EventsPath[] = "/events";
+
+//! JSON merge patch (RFC 7386) turning from into to
+nlohmann::json MergePatch(const nlohmann::json& from, const nlohmann::json& to)
+{
+	if(!from.is_object() || !to.is_object())
+	{
+		return to;
+	}
+	nlohmann::json patch = nlohmann::json::object();
+	for(auto it = to.begin(); it != to.end(); ++it)
+	{
+		const auto old = from.find(it.key());
+		if(old == from.end())
+		{
+			patch[it.key()] = it.value();
+		}
+		else if(*old != it.value())
+		{
+			patch[it.key()] = MergePatch(*old, it.value());
+		}
+	}
+	for(auto it = from.begin(); it != from.end(); ++it)
+	{
+		if(!to.contains(it.key()))
+		{
+			patch[it.key()] = nullptr;
+		}
+	}
+	return patch;
+}
+
+std::string Event(uint64_t id, const char* name, const nlohmann::json& data)
+{
+	// dump without indentation has no line breaks, the payload fits a single data line
+	return "id: " + std::to_string(id) + "\nevent: " + name + "\ndata: " + data.dump() + "\n\n";
+}
+} // namespace
+
+StatusPushServer::StatusPushServer(const StatusAggregator& aggregator, const nlohmann::json& config)
+	: m_aggregator(aggregator)
+	, m_port(config.value("port", 8005))
+	, m_interval(static_cast<int>(1000.0 / std::clamp(config.value("rate_hz", 5.0), 0.2, 20.0)))
+	, m_maxClients(std::clamp(config.value("max_clients", 16), 1, 256))
+{
+	m_listenSocket = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	const int reuse = 1;
+	setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(m_port);
+	if(m_listenSocket < 0 || ::bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+	   ::listen(m_listenSocket, 16) != 0)
+	{
+		std::cerr << "StatusPushServer: cannot listen on port " << m_port << " : " << strerror(errno) << std::endl;
+		if(m_listenSocket >= 0)
+		{
+			::close(m_listenSocket);
+			m_listenSocket = -1;
+		}
+		return;
+	}
+	m_thread = std::thread(&StatusPushServer::worker, this);
+}
+
+StatusPushServer::~StatusPushServer()
+{
+	m_running = false;
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	for(auto& client : m_clientList)
+	{
+		::close(client.socket);
+	}
+	if(m_listenSocket >= 0)
+	{
+		::close(m_listenSocket);
+	}
+}
+
+nlohmann::json StatusPushServer::produceStatus()
+{
+	nlohmann::json data;
+	data["port"] = m_port;
+	data["path"] = EventsPath;
+	data["listening"] = m_listenSocket >= 0;
+	data["rate_hz"] = 1000.0 / m_interval.count();
+	data["clients"] = m_clients.load();
+	data["events"] = m_events.load();
+	data["sent_mb"] = static_cast<double>(m_sentBytes.load()) / (1024 * 1024);
+	data["dropped_clients"] = m_dropped.load();
+	data["last_status_bytes"] = m_lastStatusBytes.load();
+	data["last_delta_bytes"] = m_lastDeltaBytes.load();
+	return data;
+}
+
+void StatusPushServer::worker()
+{
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Status);
+	Publish();
+	auto nextTick = std::chrono::steady_clock::now() + m_interval;
+	std::vector<pollfd> pfds;
+	while(m_running)
+	{
+		pfds.clear();
+		pfds.push_back({m_listenSocket, POLLIN, 0});
+		for(const auto& client : m_clientList)
+		{
+			pfds.push_back({client.socket, static_cast<short>(POLLIN | (client.pending.empty() ? 0 : POLLOUT)), 0});
+		}
+		const auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(nextTick - std::chrono::steady_clock::now());
+		::poll(pfds.data(), pfds.size(), std::clamp<int>(timeout.count(), 0, 500));
+
+		for(size_t i = 0; i < m_clientList.size(); i++)
+		{
+			auto& client = m_clientList[i];
+			const short events = pfds[i + 1].revents;
+			bool keep = true;
+			if(events & (POLLERR | POLLHUP | POLLNVAL))
+			{
+				keep = false;
+			}
+			else if(events & POLLIN)
+			{
+				if(client.streaming)
+				{
+					// EventSource sends nothing after the request, readable means closed
+					char buffer[256];
+					keep = ::recv(client.socket, buffer, sizeof(buffer), MSG_DONTWAIT) > 0;
+				}
+				else
+				{
+					keep = ReadRequest(client);
+				}
+			}
+			if(keep && (events & POLLOUT))
+			{
+				keep = Flush(client);
+			}
+			if(!keep)
+			{
+				::close(client.socket);
+				client.socket = -1;
+			}
+		}
+		if(pfds[0].revents & POLLIN)
+		{
+			Accept();
+		}
+
+		if(std::chrono::steady_clock::now() >= nextTick)
+		{
+			Publish();
+			nextTick = std::max(nextTick + m_interval, std::chrono::steady_clock::now());
+		}
+		m_clientList.erase(std::remove_if(m_clientList.begin(), m_clientList.end(), [](const Client& c) { return c.socket < 0; }),
+						   m_clientList.end());
+		m_clients = m_clientList.size();
+	}
+}
+
+void StatusPushServer::Accept()
+{
+	while(true)
+	{
+		const int socket = ::accept4(m_listenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(socket < 0)
+		{
+			return;
+		}
+		if(m_clientList.size() >= m_maxClients)
+		{
+			constexpr char Busy[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+			::send(socket, Busy, sizeof(Busy) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+			::close(socket);
+			continue;
+		}
+		Client client;
+		client.socket = socket;
+		m_clientList.push_back(std::move(client));
+	}
+}
+
+bool StatusPushServer::ReadRequest(Client& client)
+{
+	char buffer[1024];
+	const ssize_t received = ::recv(client.socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+	if(received <= 0)
+	{
+		return received < 0 && (errno == EAGAIN || errno == EINTR);
+	}
+	client.request.append(buffer, received);
+	if(client.request.find("\r\n\r\n") == std::string::npos)
+	{
+		return client.request.size() <= MaxRequestSize;
+	}
+
+	const std::string prefix = std::string("GET ") + EventsPath;
+	const bool valid = client.request.compare(0, prefix.size(), prefix) == 0 &&
+					   (client.request[prefix.size()] == ' ' || client.request[prefix.size()] == '?');
+	if(!valid)
+	{
+		constexpr char NotFound[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		::send(client.socket, NotFound, sizeof(NotFound) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+		return false;
+	}
+	client.request.clear();
+	client.request.shrink_to_fit();
+	client.streaming = true;
+	// page is served by Pistache on another port
+	Queue(client,
+		  "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+		  "Access-Control-Allow-Origin: *\r\nConnection: keep-alive\r\n\r\nretry: 2000\n\n");
+	Queue(client, m_statusEvent);
+	return Flush(client);
+}
+
+bool StatusPushServer::Flush(Client& client)
+{
+	while(!client.pending.empty())
+	{
+		const ssize_t sent = ::send(client.socket, client.pending.data(), client.pending.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+		if(sent < 0)
+		{
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+		client.pending.erase(0, sent);
+		m_sentBytes += sent;
+	}
+	return true;
+}
+
+void StatusPushServer::Queue(Client& client, const std::string& data)
+{
+	client.pending += data;
+}
+
+void StatusPushServer::Publish()
+{
+	const auto snapshot = m_aggregator.GetSnapshot(true);
+	const auto now = std::chrono::steady_clock::now();
+	std::string event;
+	if(snapshot && snapshot->etag != m_lastEtag)
+	{
+		// parsed once per change, whatever the number of clients
+		nlohmann::json status = nlohmann::json::parse(snapshot->body, nullptr, false);
+		if(!status.is_discarded())
+		{
+			m_eventId++;
+			event = Event(m_eventId, "delta", MergePatch(m_lastStatus, status));
+			m_statusEvent = Event(m_eventId, "status", status);
+			m_lastStatus = std::move(status);
+			m_lastEtag = snapshot->etag;
+			m_lastStatusBytes = m_statusEvent.size();
+			m_lastDeltaBytes = event.size();
+			m_events++;
+		}
+	}
+	if(event.empty() && now - m_lastSend >= KeepaliveInterval)
+	{
+		// keeps proxies and idle connection timeouts from closing the stream
+		event = ":\n\n";
+	}
+	if(event.empty())
+	{
+		return;
+	}
+	m_lastSend = now;
+	for(auto& client : m_clientList)
+	{
+		if(!client.streaming || client.socket < 0)
+		{
+			continue;
+		}
+		if(client.pending.size() + event.size() > MaxPendingBytes)
+		{
+			m_dropped++;
+			::close(client.socket);
+			client.socket = -1;
+			continue;
+		}
+		Queue(client, event);
+		if(!Flush(client))
+		{
+			::close(client.socket);
+			client.socket = -1;
+		}
+	}
+}
+} // namespace mandeye
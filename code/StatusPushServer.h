@@ -0,0 +1,75 @@
+#pragma once
+
+#include "StatusAggregator.h"
+#include <atomic>
+#include <chrono>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mandeye
+{
+
+//! Pushes the full status to browsers as Server-Sent Events (GET /events on its own port).
+//! A single thread polls the snapshot of StatusAggregator at a fixed rate and, when it has changed,
+//! serializes one event for all clients, so the cost does not grow with the number of tabs.
+//! A new client gets event "status" with the whole status, then events "delta" with a JSON merge
+//! patch (RFC 7386) against the previous status: only changed fields, null for removed ones.
+//! Clients that do not keep up are disconnected, EventSource reconnects them and they start over.
+class StatusPushServer
+{
+public:
+	//! @param config "status_push" section of the config: port, rate_hz, max_clients
+	StatusPushServer(const StatusAggregator& aggregator, const nlohmann::json& config);
+	~StatusPushServer();
+
+	StatusPushServer(const StatusPushServer&) = delete;
+	StatusPushServer& operator=(const StatusPushServer&) = delete;
+
+	nlohmann::json produceStatus();
+
+private:
+	struct Client
+	{
+		int socket{-1};
+		std::string request; //! received until the end of the request header
+		std::string pending; //! not yet sent
+		bool streaming{false};
+	};
+
+	void worker();
+	void Accept();
+	//! Reads request of a client that is not streaming yet, returns false if it has to be dropped
+	bool ReadRequest(Client& client);
+	//! Sends as much of pending output as the socket takes, returns false if it has to be dropped
+	bool Flush(Client& client);
+	//! Builds events if the status has changed and queues them to the clients
+	void Publish();
+	void Queue(Client& client, const std::string& data);
+
+	const StatusAggregator& m_aggregator;
+	int m_port;
+	std::chrono::milliseconds m_interval;
+	size_t m_maxClients;
+
+	// owned by the worker
+	std::vector<Client> m_clientList;
+	std::string m_lastEtag;
+	nlohmann::json m_lastStatus;
+	std::string m_statusEvent;
+	uint64_t m_eventId{0};
+	std::chrono::steady_clock::time_point m_lastSend;
+
+	std::atomic<size_t> m_clients{0};
+	std::atomic<uint64_t> m_events{0};
+	std::atomic<uint64_t> m_sentBytes{0};
+	std::atomic<uint64_t> m_dropped{0};
+	std::atomic<size_t> m_lastStatusBytes{0};
+	std::atomic<size_t> m_lastDeltaBytes{0};
+
+	int m_listenSocket{-1};
+	std::atomic<bool> m_running{true};
+	std::thread m_thread;
+};
+} // namespace mandeye
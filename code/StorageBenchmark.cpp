@@ -0,0 +1,676 @@
+#include "StorageBenchmark.h"
+#include "utils/ThreadRoles.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+namespace mandeye
+{
+namespace
+{
+constexpr char WorkDirectoryName[] = ".storage_benchmark";
+constexpr char ResultsFilename[] = "storage_benchmark.json";
+constexpr double MB = 1024.0 * 1024.0;
+constexpr size_t WriteBlockSize = 4 * 1024 * 1024;
+//! sustained write is flushed every 16 MB, so the samples see the drive and not the page cache
+constexpr size_t BlocksPerSync = 4;
+constexpr size_t SmallFileSize = 4096;
+constexpr auto ReadBackMaxDuration = std::chrono::seconds(30);
+//! sustained write rate below this share of the initial one is a cliff (SLC cache full, throttling)
+constexpr double CliffRatio = 0.6;
+//! files created and synced for every chunk: point cloud, IMU, GNSS, raw GNSS, status, session index
+constexpr double FilesPerChunk = 6;
+//! chunk interval is lengthened until fixed per chunk costs take at most this share of it
+constexpr double MaxChunkOverhead = 0.1;
+constexpr auto MaxChunkInterval = std::chrono::milliseconds(30000);
+
+using Clock = std::chrono::steady_clock;
+
+double Seconds(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<double>(to - from).count();
+}
+
+double Round(double value, double digits = 100.0)
+{
+	return std::round(value * digits) / digits;
+}
+
+//! p in [0, 1], nearest rank
+double Percentile(std::vector<double> values, double p)
+{
+	if(values.empty())
+	{
+		return 0;
+	}
+	std::sort(values.begin(), values.end());
+	return values[static_cast<size_t>(std::lround(p * (values.size() - 1)))];
+}
+
+//! Data that does not compress, some drive controllers compress or deduplicate
+std::vector<char> RandomBlock(size_t size)
+{
+	std::vector<char> block(size);
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	for(size_t i = 0; i + sizeof(state) <= size; i += sizeof(state))
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		std::memcpy(block.data() + i, &state, sizeof(state));
+	}
+	return block;
+}
+
+bool WriteAll(int fd, const char* data, size_t size)
+{
+	while(size > 0)
+	{
+		const ssize_t written = ::write(fd, data, size);
+		if(written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(written <= 0)
+		{
+			return false;
+		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+std::string ReadLine(const std::filesystem::path& path)
+{
+	std::ifstream file(path);
+	std::string line;
+	std::getline(file, line);
+	const auto first = line.find_first_not_of(" \t");
+	const auto last = line.find_last_not_of(" \t\r");
+	return first == std::string::npos ? "" : line.substr(first, last - first + 1);
+}
+} // namespace
+
+StorageBenchmark::StorageBenchmark(const std::string& repository)
+	: m_repository(repository)
+	, m_workDirectory((std::filesystem::path(repository) / WorkDirectoryName).string())
+	, m_resultsFile((std::filesystem::path(repository) / ResultsFilename).string())
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	m_serial = DeviceSerial(m_repository);
+	LoadResults();
+}
+
+StorageBenchmark::~StorageBenchmark()
+{
+	m_cancel = true;
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+StorageBenchmark::Options StorageBenchmark::OptionsFromJson(const nlohmann::json& config)
+{
+	Options options;
+	if(!config.is_object())
+	{
+		return options;
+	}
+	options.sustainedSec = std::clamp(config.value("duration_sec", options.sustainedSec), 10.0, 1800.0);
+	options.sustainedMaxMB = std::clamp<size_t>(config.value("max_mb", options.sustainedMaxMB), 64, 256 * 1024);
+	options.fsyncSamples = std::clamp<size_t>(config.value("fsync_samples", options.fsyncSamples), 10, 10000);
+	options.smallFiles = std::clamp<size_t>(config.value("small_files", options.smallFiles), 10, 100000);
+	return options;
+}
+
+bool StorageBenchmark::Start(const Options& options)
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	if(m_running)
+	{
+		return false;
+	}
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	// drive may have been replaced since the last run
+	m_serial = DeviceSerial(m_repository);
+	LoadResults();
+	m_error.clear();
+	m_cancel = false;
+	m_running = true;
+	m_thread = std::thread(&StorageBenchmark::worker, this, options);
+	return true;
+}
+
+void StorageBenchmark::Cancel()
+{
+	m_cancel = true;
+}
+
+bool StorageBenchmark::IsRunning() const
+{
+	return m_running;
+}
+
+StorageBenchmark::Policy StorageBenchmark::GetPolicy()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	return m_policy;
+}
+
+nlohmann::json StorageBenchmark::produceStatus()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	nlohmann::json data;
+	data["serial"] = m_serial;
+	data["running"] = m_running.load();
+	data["phase"] = m_phase;
+	data["progress"] = Round(m_progress);
+	if(m_running)
+	{
+		data["current_mb_s"] = Round(m_currentMBs.load());
+	}
+	if(!m_error.empty())
+	{
+		data["error"] = m_error;
+	}
+	data["result"] = m_result;
+	if(m_policy.valid)
+	{
+		data["policy"]["sustained_write_mb_s"] = Round(m_policy.sustainedWriteMBs);
+		data["policy"]["chunk_interval_sec"] = m_policy.chunkInterval.count() / 1000.0;
+	}
+	return data;
+}
+
+std::string StorageBenchmark::DeviceSerial(const std::string& path)
+{
+	namespace fs = std::filesystem;
+	struct stat st
+	{ };
+	if(::stat(path.c_str(), &st) != 0)
+	{
+		return "unknown";
+	}
+	std::error_code ec;
+	const fs::path device =
+		fs::canonical("/sys/dev/block/" + std::to_string(major(st.st_dev)) + ":" + std::to_string(minor(st.st_dev)), ec);
+	// partition -> disk -> SCSI target -> USB interface -> USB device, or partition -> disk -> MMC card
+	for(fs::path dir = device; !ec && dir.string().rfind("/sys/devices/", 0) == 0; dir = dir.parent_path())
+	{
+		// root hubs (usbN) have the serial of the host controller
+		if(dir.filename().string().rfind("usb", 0) == 0)
+		{
+			break;
+		}
+		const std::string serial = ReadLine(dir / "serial");
+		if(!serial.empty())
+		{
+			return serial;
+		}
+	}
+	for(const auto& entry : fs::directory_iterator("/dev/disk/by-uuid", ec))
+	{
+		struct stat link
+		{ };
+		if(::stat(entry.path().c_str(), &link) == 0 && S_ISBLK(link.st_mode) && link.st_rdev == st.st_dev)
+		{
+			return "uuid-" + entry.path().filename().string();
+		}
+	}
+	return "unknown";
+}
+
+void StorageBenchmark::worker(Options options)
+{
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Benchmark);
+	std::cout << "Storage benchmark of " << m_repository << " started" << std::endl;
+	const auto start = std::chrono::system_clock::now();
+
+	std::error_code ec;
+	std::filesystem::remove_all(m_workDirectory, ec);
+	std::filesystem::create_directories(m_workDirectory, ec);
+	nlohmann::json result;
+	if(ec)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_error = "cannot create " + m_workDirectory + " : " + ec.message();
+	}
+	else
+	{
+		result["sustained_write"] = SustainedWrite(options);
+		if(!result["sustained_write"].is_null() && !m_cancel)
+		{
+			result["fsync"] = FsyncLatency(options);
+		}
+		if(!result["fsync"].is_null() && !m_cancel)
+		{
+			result["small_files"] = SmallFiles(options);
+		}
+		if(!result["small_files"].is_null() && !m_cancel)
+		{
+			result["read_back"] = ReadBack();
+		}
+	}
+	std::filesystem::remove_all(m_workDirectory, ec);
+
+	const bool complete = !m_cancel && result.is_object() && !result["read_back"].is_null();
+	if(complete)
+	{
+		result["timestamp"] = std::chrono::duration_cast<std::chrono::seconds>(start.time_since_epoch()).count();
+		result["duration_sec"] = Round(std::chrono::duration<double>(std::chrono::system_clock::now() - start).count());
+		result["options"]["duration_sec"] = options.sustainedSec;
+		result["options"]["max_mb"] = options.sustainedMaxMB;
+		result["options"]["fsync_samples"] = options.fsyncSamples;
+		result["options"]["small_files"] = options.smallFiles;
+		if(!StoreResult(result))
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			m_error = "cannot store result to " + m_resultsFile;
+		}
+	}
+	std::string error;
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		if(complete)
+		{
+			m_result = result;
+			m_policy = PolicyFromResult(result);
+		}
+		error = m_error;
+	}
+	SetPhase(m_cancel ? "cancelled" : (complete ? "done" : "failed"), 1.0);
+	std::cout << "Storage benchmark " << (m_cancel ? "cancelled" : (complete ? "done" : "failed: " + error)) << std::endl;
+	m_currentMBs = 0;
+	m_running = false;
+}
+
+nlohmann::json StorageBenchmark::SustainedWrite(const Options& options)
+{
+	SetPhase("sustained_write", 0);
+	const std::string path = m_workDirectory + "/sustained.bin";
+	const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(fd < 0)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_error = "cannot create " + path + " : " + strerror(errno);
+		return {};
+	}
+	// never more than half of the free space
+	uint64_t limit = static_cast<uint64_t>(options.sustainedMaxMB) * 1024 * 1024;
+	std::error_code ec;
+	const auto space = std::filesystem::space(m_repository, ec);
+	if(!ec)
+	{
+		limit = std::min<uint64_t>(limit, space.available / 2);
+	}
+
+	const std::vector<char> block = RandomBlock(WriteBlockSize);
+	std::vector<double> samples; // MB/s
+	std::vector<double> sampleEndSec;
+	std::vector<double> sampleEndMB;
+	uint64_t written = 0;
+	uint64_t sampleBytes = 0;
+	bool ok = true;
+	const auto begin = Clock::now();
+	const auto deadline = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.sustainedSec));
+	auto sampleStart = begin;
+	while(ok && !m_cancel && Clock::now() < deadline && written + block.size() <= limit)
+	{
+		for(size_t i = 0; ok && i < BlocksPerSync && written + block.size() <= limit; i++)
+		{
+			ok = WriteAll(fd, block.data(), block.size());
+			written += block.size();
+			sampleBytes += block.size();
+		}
+		ok = ok && ::fdatasync(fd) == 0;
+		// pages are clean after the sync, do not let gigabytes of them push out everything else
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+		const auto now = Clock::now();
+		const double elapsed = Seconds(sampleStart, now);
+		if(elapsed >= 1.0)
+		{
+			samples.push_back(sampleBytes / MB / elapsed);
+			sampleEndSec.push_back(Seconds(begin, now));
+			sampleEndMB.push_back(written / MB);
+			m_currentMBs = samples.back();
+			sampleBytes = 0;
+			sampleStart = now;
+			SetPhase("sustained_write", std::min(1.0, std::max(Seconds(begin, now) / options.sustainedSec, written / double(limit))));
+		}
+	}
+	const auto end = Clock::now();
+	const double duration = Seconds(begin, end);
+	if(ok && sampleBytes > 0)
+	{
+		// tail of the test shorter than a second
+		samples.push_back(sampleBytes / MB / std::max(Seconds(sampleStart, end), 1e-3));
+		sampleEndSec.push_back(duration);
+		sampleEndMB.push_back(written / MB);
+	}
+	::close(fd);
+	if(!ok)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_error = "write to " + path + " failed : " + strerror(errno);
+		return {};
+	}
+	if(m_cancel)
+	{
+		return {};
+	}
+	if(samples.empty())
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_error = "not enough free space for the sustained write test";
+		return {};
+	}
+
+	const size_t head = std::max<size_t>(1, samples.size() / 10);
+	const size_t tail = std::max<size_t>(1, samples.size() / 4);
+	const double initial = Percentile(std::vector<double>(samples.begin(), samples.begin() + head), 0.5);
+	const double sustained = Percentile(std::vector<double>(samples.end() - tail, samples.end()), 0.5);
+
+	nlohmann::json data;
+	data["mb"] = Round(written / MB);
+	data["duration_sec"] = Round(duration);
+	data["mean_mb_s"] = Round(written / MB / duration);
+	data["initial_mb_s"] = Round(initial);
+	data["sustained_mb_s"] = Round(sustained);
+	data["min_mb_s"] = Round(*std::min_element(samples.begin(), samples.end()));
+	data["max_mb_s"] = Round(*std::max_element(samples.begin(), samples.end()));
+	data["samples_mb_s"] = nlohmann::json::array();
+	for(const double sample : samples)
+	{
+		data["samples_mb_s"].push_back(Round(sample, 10.0));
+	}
+	// first sample from which on the rate stays below the cliff ratio
+	data["cliff"] = nullptr;
+	for(size_t i = 0; i < samples.size(); i++)
+	{
+		if(samples[i] < CliffRatio * initial && Percentile(std::vector<double>(samples.begin() + i, samples.end()), 0.5) < CliffRatio * initial)
+		{
+			data["cliff"]["after_sec"] = Round(i > 0 ? sampleEndSec[i - 1] : 0);
+			data["cliff"]["after_mb"] = Round(i > 0 ? sampleEndMB[i - 1] : 0);
+			data["cliff"]["ratio"] = Round(sustained / initial);
+			break;
+		}
+	}
+	return data;
+}
+
+nlohmann::json StorageBenchmark::FsyncLatency(const Options& options)
+{
+	SetPhase("fsync", 0);
+	const std::string path = m_workDirectory + "/fsync.bin";
+	const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(fd < 0)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_error = "cannot create " + path + " : " + strerror(errno);
+		return {};
+	}
+	const std::vector<char> block = RandomBlock(SmallFileSize);
+	std::vector<double> latencies; // ms
+	latencies.reserve(options.fsyncSamples);
+	bool ok = true;
+	for(size_t i = 0; ok && !m_cancel && i < options.fsyncSamples; i++)
+	{
+		ok = WriteAll(fd, block.data(), block.size());
+		const auto begin = Clock::now();
+		ok = ok && ::fdatasync(fd) == 0;
+		latencies.push_back(Seconds(begin, Clock::now()) * 1000.0);
+		if(i % 10 == 0)
+		{
+			SetPhase("fsync", double(i) / options.fsyncSamples);
+		}
+	}
+	::close(fd);
+	if(!ok)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_error = "fdatasync of " + path + " failed : " + strerror(errno);
+		return {};
+	}
+	if(m_cancel)
+	{
+		return {};
+	}
+	double sum = 0;
+	for(const double latency : latencies)
+	{
+		sum += latency;
+	}
+	nlohmann::json data;
+	data["samples"] = latencies.size();
+	data["mean_ms"] = Round(sum / latencies.size(), 1000.0);
+	data["p50_ms"] = Round(Percentile(latencies, 0.5), 1000.0);
+	data["p90_ms"] = Round(Percentile(latencies, 0.9), 1000.0);
+	data["p99_ms"] = Round(Percentile(latencies, 0.99), 1000.0);
+	data["max_ms"] = Round(Percentile(latencies, 1.0), 1000.0);
+	return data;
+}
+
+nlohmann::json StorageBenchmark::SmallFiles(const Options& options)
+{
+	SetPhase("small_files", 0);
+	const std::filesystem::path directory = std::filesystem::path(m_workDirectory) / "small";
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	const int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(ec || directoryFd < 0)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_error = "cannot create " + directory.string();
+		return {};
+	}
+	const std::vector<char> block = RandomBlock(SmallFileSize);
+	auto name = [](size_t i) {
+		char buffer[16];
+		snprintf(buffer, sizeof(buffer), "%06zu.bin", i);
+		return std::string(buffer);
+	};
+
+	// like a chunk save: files are written, then the filesystem is synced
+	bool ok = true;
+	size_t created = 0;
+	const auto createBegin = Clock::now();
+	for(; ok && !m_cancel && created < options.smallFiles; created++)
+	{
+		const int fd = ::openat(directoryFd, name(created).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		ok = fd >= 0 && WriteAll(fd, block.data(), block.size());
+		if(fd >= 0)
+		{
+			::close(fd);
+		}
+		if(created % 50 == 0)
+		{
+			SetPhase("small_files", 0.5 * created / options.smallFiles);
+		}
+	}
+	ok = ok && ::syncfs(directoryFd) == 0;
+	const double createSec = Seconds(createBegin, Clock::now());
+
+	const auto deleteBegin = Clock::now();
+	for(size_t i = 0; i < created; i++)
+	{
+		::unlinkat(directoryFd, name(i).c_str(), 0);
+	}
+	::syncfs(directoryFd);
+	const double deleteSec = Seconds(deleteBegin, Clock::now());
+	::close(directoryFd);
+	SetPhase("small_files", 1.0);
+	if(!ok)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_error = "creating small files in " + directory.string() + " failed : " + strerror(errno);
+		return {};
+	}
+	if(m_cancel)
+	{
+		return {};
+	}
+	nlohmann::json data;
+	data["files"] = created;
+	data["file_size"] = SmallFileSize;
+	data["create_ms_per_file"] = Round(createSec * 1000.0 / created, 1000.0);
+	data["delete_ms_per_file"] = Round(deleteSec * 1000.0 / created, 1000.0);
+	data["files_per_sec"] = Round(created / createSec);
+	return data;
+}
+
+nlohmann::json StorageBenchmark::ReadBack()
+{
+	SetPhase("read_back", 0);
+	const std::string path = m_workDirectory + "/sustained.bin";
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st
+	{ };
+	if(fd < 0 || ::fstat(fd, &st) != 0)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_error = "cannot open " + path + " : " + strerror(errno);
+		if(fd >= 0)
+		{
+			::close(fd);
+		}
+		return {};
+	}
+	// the file was synced, its cached pages are clean and can be dropped, reads go to the drive
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	std::vector<char> block(WriteBlockSize);
+	uint64_t read = 0;
+	bool ok = true;
+	const auto begin = Clock::now();
+	while(!m_cancel && Clock::now() - begin < ReadBackMaxDuration)
+	{
+		const ssize_t count = ::read(fd, block.data(), block.size());
+		if(count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(count <= 0)
+		{
+			ok = count == 0;
+			break;
+		}
+		read += count;
+		m_currentMBs = read / MB / std::max(Seconds(begin, Clock::now()), 1e-3);
+		SetPhase("read_back", double(read) / std::max<off_t>(st.st_size, 1));
+	}
+	const double duration = Seconds(begin, Clock::now());
+	::close(fd);
+	if(!ok || read == 0)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_error = "reading " + path + " failed : " + strerror(errno);
+		return {};
+	}
+	if(m_cancel)
+	{
+		return {};
+	}
+	nlohmann::json data;
+	data["mb"] = Round(read / MB);
+	data["duration_sec"] = Round(duration);
+	data["mb_s"] = Round(read / MB / duration);
+	return data;
+}
+
+void StorageBenchmark::SetPhase(const std::string& phase, double progress)
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	m_phase = phase;
+	m_progress = progress;
+}
+
+bool StorageBenchmark::LoadResults()
+{
+	m_result = nullptr;
+	m_policy = Policy();
+	std::ifstream file(m_resultsFile);
+	if(!file.is_open())
+	{
+		return false;
+	}
+	const nlohmann::json results = nlohmann::json::parse(file, nullptr, false);
+	if(!results.is_object() || !results.contains(m_serial))
+	{
+		return false;
+	}
+	m_result = results[m_serial];
+	m_policy = PolicyFromResult(m_result);
+	return true;
+}
+
+bool StorageBenchmark::StoreResult(const nlohmann::json& result)
+{
+	std::string serial;
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		serial = m_serial;
+	}
+	// results of other drives that were used with this one stay
+	nlohmann::json results;
+	{
+		std::ifstream file(m_resultsFile);
+		if(file.is_open())
+		{
+			results = nlohmann::json::parse(file, nullptr, false);
+		}
+	}
+	if(!results.is_object())
+	{
+		results = nlohmann::json::object();
+	}
+	results[serial] = result;
+
+	const std::string temporary = m_resultsFile + ".tmp";
+	{
+		std::ofstream file(temporary);
+		file << results.dump(1);
+		if(!file.good())
+		{
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(temporary, m_resultsFile, ec);
+	return !ec;
+}
+
+StorageBenchmark::Policy StorageBenchmark::PolicyFromResult(const nlohmann::json& result)
+{
+	Policy policy;
+	double createMs = 0;
+	double fsyncMs = 0;
+	try
+	{
+		policy.sustainedWriteMBs = result.at("sustained_write").at("sustained_mb_s").get<double>();
+		createMs = result.at("small_files").at("create_ms_per_file").get<double>();
+		fsyncMs = result.at("fsync").at("p90_ms").get<double>();
+	}
+	catch(const nlohmann::json::exception&)
+	{
+		return Policy();
+	}
+	const double fixedMs = FilesPerChunk * (createMs + fsyncMs);
+	policy.chunkInterval = std::min(MaxChunkInterval, std::chrono::milliseconds(static_cast<int64_t>(fixedMs / MaxChunkOverhead)));
+	policy.valid = policy.sustainedWriteMBs > 0;
+	return policy;
+}
+} // namespace mandeye
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mandeye
+{
+
+//! Benchmark of the drive the repository is on, run on demand since it writes gigabytes.
+//! Tests, in order:
+//! - sustained sequential write for minutes, flushed with fdatasync every few blocks and sampled about once
+//!   a second, to catch thermal throttling of USB drives and the end of the SLC cache
+//! - fdatasync latency distribution of small appends, what every chunk save pays
+//! - small file create cost: open, write 4 KB and close per file, then one syncfs like a chunk save
+//! - read back rate of the sustained write file, with its pages dropped from the page cache first
+//! Results are stored in the repository keyed by the serial number of the drive, so a drive is measured
+//! once and its numbers stay with it. GetPolicy() turns them into settings for the chunk writer.
+class StorageBenchmark
+{
+public:
+	struct Options
+	{
+		double sustainedSec{120};
+		size_t sustainedMaxMB{8192};
+		size_t fsyncSamples{200};
+		size_t smallFiles{500};
+	};
+
+	//! Settings derived from the stored result of the drive
+	struct Policy
+	{
+		bool valid{false};
+		//! write rate at the end of the sustained test, after cache cliffs and throttling
+		double sustainedWriteMBs{0};
+		//! shortest chunk interval keeping fixed per chunk costs (file creates, syncs) under a tenth of it
+		std::chrono::milliseconds chunkInterval{0};
+	};
+
+	//! @param repository root of the repository, test files go to its hidden subdirectory
+	explicit StorageBenchmark(const std::string& repository);
+	~StorageBenchmark();
+
+	StorageBenchmark(const StorageBenchmark&) = delete;
+	StorageBenchmark& operator=(const StorageBenchmark&) = delete;
+
+	//! Options from the "storage_benchmark" config section: duration_sec, max_mb, fsync_samples, small_files
+	static Options OptionsFromJson(const nlohmann::json& config);
+
+	//! Starts the benchmark in background, returns false if it is already running
+	bool Start(const Options& options);
+	void Cancel();
+	bool IsRunning() const;
+
+	//! Policy from the stored result of the drive, not valid if the drive has not been benchmarked
+	Policy GetPolicy();
+
+	nlohmann::json produceStatus();
+
+	//! Serial number of the drive the path is on, looked up in sysfs.
+	//! Falls back to the filesystem UUID and to "unknown" when the drive has no serial.
+	static std::string DeviceSerial(const std::string& path);
+
+private:
+	void worker(Options options);
+
+	//! Each test returns its part of the result, empty when cancelled or failed (m_error is set)
+	nlohmann::json SustainedWrite(const Options& options);
+	nlohmann::json FsyncLatency(const Options& options);
+	nlohmann::json SmallFiles(const Options& options);
+	nlohmann::json ReadBack();
+
+	void SetPhase(const std::string& phase, double progress);
+	//! Loads the stored result of m_serial, caller holds m_mutex
+	bool LoadResults();
+	bool StoreResult(const nlohmann::json& result);
+	static Policy PolicyFromResult(const nlohmann::json& result);
+
+	std::string m_repository;
+	std::string m_workDirectory;
+	std::string m_resultsFile;
+
+	std::mutex m_mutex;
+	std::string m_serial;
+	std::string m_phase{"idle"};
+	double m_progress{0};
+	std::string m_error;
+	nlohmann::json m_result; //! stored result of the drive, null if there is none
+	Policy m_policy;
+
+	std::atomic<double> m_currentMBs{0};
+	std::atomic<bool> m_running{false};
+	std::atomic<bool> m_cancel{false};
+	std::thread m_thread;
+};
+} // namespace mandeye
@@ -1,8 +1,15 @@
 #include "gnss.h"
 #include "minmea.h"
+#include "utils/ThreadRoles.h"
+#include <cerrno>
+#include <cstring>
 #include <exception>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <poll.h>
 #include <thread>
+#include <unistd.h>
 
 namespace mandeye
 {
@@ -27,12 +34,132 @@ std::string sanitizeLine(const std::string& line)
 	return sanitizedLine.str();
 }
 
+namespace gnss = mandeye_utils::gnss;
+namespace ubx = mandeye_utils::ubx;
+
+namespace
+{
+gnss::Float ToRecord(const minmea_float& f)
+{
+	return {static_cast<int32_t>(f.value), static_cast<int32_t>(f.scale)};
+}
+
+gnss::Time ToRecord(const minmea_time& t)
+{
+	return {static_cast<int8_t>(t.hours), static_cast<int8_t>(t.minutes), static_cast<int8_t>(t.seconds), static_cast<int32_t>(t.microseconds)};
+}
+
+gnss::Date ToRecord(const minmea_date& d)
+{
+	return {static_cast<int8_t>(d.day), static_cast<int8_t>(d.month), static_cast<int16_t>(d.year)};
+}
+
+gnss::Gga ToRecord(const minmea_sentence_gga& gga)
+{
+	return {ToRecord(gga.time),
+			ToRecord(gga.latitude),
+			ToRecord(gga.longitude),
+			static_cast<int8_t>(gga.fix_quality),
+			static_cast<int8_t>(gga.satellites_tracked),
+			ToRecord(gga.hdop),
+			ToRecord(gga.altitude),
+			ToRecord(gga.height),
+			ToRecord(gga.dgps_age)};
+}
+
+gnss::Rmc ToRecord(const minmea_sentence_rmc& rmc)
+{
+	return {ToRecord(rmc.time),
+			ToRecord(rmc.date),
+			static_cast<uint8_t>(rmc.valid),
+			ToRecord(rmc.latitude),
+			ToRecord(rmc.longitude),
+			ToRecord(rmc.speed),
+			ToRecord(rmc.course),
+			ToRecord(rmc.variation)};
+}
+
+gnss::Gst ToRecord(const minmea_sentence_gst& gst)
+{
+	return {ToRecord(gst.time),
+			ToRecord(gst.rms_deviation),
+			ToRecord(gst.semi_major_deviation),
+			ToRecord(gst.semi_minor_deviation),
+			ToRecord(gst.semi_major_orientation),
+			ToRecord(gst.latitude_error_deviation),
+			ToRecord(gst.longitude_error_deviation),
+			ToRecord(gst.altitude_error_deviation)};
+}
+
+gnss::Gsa ToRecord(const minmea_sentence_gsa& gsa)
+{
+	gnss::Gsa record{};
+	record.mode = gsa.mode;
+	record.fixType = static_cast<int8_t>(gsa.fix_type);
+	for(size_t i = 0; i < std::size(record.sats); i++)
+	{
+		record.sats[i] = static_cast<uint16_t>(gsa.sats[i]);
+	}
+	record.pdop = ToRecord(gsa.pdop);
+	record.hdop = ToRecord(gsa.hdop);
+	record.vdop = ToRecord(gsa.vdop);
+	return record;
+}
+
+gnss::Vtg ToRecord(const minmea_sentence_vtg& vtg)
+{
+	return {ToRecord(vtg.true_track_degrees),
+			ToRecord(vtg.magnetic_track_degrees),
+			ToRecord(vtg.speed_knots),
+			ToRecord(vtg.speed_kph),
+			static_cast<char>(vtg.faa_mode)};
+}
+
+//! First '$' of a sentence or sync char of a UBX frame in [begin, end), nullptr if there is none
+const char* FindMessageStart(const char* begin, const char* end)
+{
+	for(const char* c = begin; c < end; c++)
+	{
+		if(*c == '$' || static_cast<uint8_t>(*c) == ubx::Sync1)
+		{
+			return c;
+		}
+	}
+	return nullptr;
+}
+
+gnss::RecordHeader MakeRecordHeader(gnss::RecordType type, uint16_t size, uint64_t laserTimestampNs, int64_t systemTimeMs)
+{
+	gnss::RecordHeader header;
+	header.type = static_cast<uint16_t>(type);
+	header.size = size;
+	header.talker[0] = '\0';
+	header.talker[1] = '\0';
+	header.laserTimestampNs = laserTimestampNs;
+	header.systemTimeMs = systemTimeMs;
+	return header;
+}
+
+//! Writes header and payload of a record to buffer, returns the record size
+template <typename Payload>
+size_t EncodeRecord(char* buffer, gnss::RecordType type, const char* sentence, uint64_t laserTimestampNs, int64_t systemTimeMs, const Payload& payload)
+{
+	gnss::RecordHeader header = MakeRecordHeader(type, sizeof(Payload), laserTimestampNs, systemTimeMs);
+	// "$GPGGA": talker follows the '$'
+	header.talker[0] = sentence[1];
+	header.talker[1] = sentence[2];
+	memcpy(buffer, &header, sizeof(header));
+	memcpy(buffer + sizeof(header), &payload, sizeof(payload));
+	return sizeof(header) + sizeof(payload);
+}
+} // namespace
+
 nlohmann::json GNSSClient::produceStatus()
 {
 	nlohmann::json data;
 	data["init_success"] = init_succes;
 	std::lock_guard<std::mutex> lock(m_bufferMutex);
-	data["nmea"]["last_line"] = sanitizeLine(m_lastLine);
+	data["nmea"]["last_line"] = sanitizeLine(m_lastLine.data());
 	data["gga"]["time"]["h"] = lastGGA.time.hours;
 	data["gga"]["time"]["m"] = lastGGA.time.minutes;
 	data["gga"]["time"]["s"] = lastGGA.time.seconds;
@@ -45,9 +172,36 @@ nlohmann::json GNSSClient::produceStatus()
 	data["gga"]["altitude"] = minmea_tofloat(&lastGGA.altitude);
 	data["gga"]["height"] = minmea_tofloat(&lastGGA.height);
 	data["gga"]["dgps_age"] = minmea_tofloat(&lastGGA.dgps_age);
+	data["gst"]["latitude_error"] = gnss::toDouble(m_lastGst.latitudeErrorDeviation);
+	data["gst"]["longitude_error"] = gnss::toDouble(m_lastGst.longitudeErrorDeviation);
+	data["gst"]["altitude_error"] = gnss::toDouble(m_lastGst.altitudeErrorDeviation);
+	data["rmc"]["valid"] = m_lastRmc.valid != 0;
+	data["rmc"]["speed_knots"] = gnss::toDouble(m_lastRmc.speedKnots);
+	data["rmc"]["course"] = gnss::toDouble(m_lastRmc.course);
+	if(m_lastNavPvt.iTOW != 0)
+	{
+		data["ubx"]["nav_pvt"]["fix_type"] = m_lastNavPvt.fixType;
+		data["ubx"]["nav_pvt"]["carrier_solution"] = m_lastNavPvt.flags >> 6;
+		data["ubx"]["nav_pvt"]["satellites"] = m_lastNavPvt.numSV;
+		data["ubx"]["nav_pvt"]["latitude"] = m_lastNavPvt.lat * 1e-7;
+		data["ubx"]["nav_pvt"]["longitude"] = m_lastNavPvt.lon * 1e-7;
+		data["ubx"]["nav_pvt"]["altitude"] = m_lastNavPvt.hMSL * 1e-3;
+		data["ubx"]["nav_pvt"]["horizontal_accuracy"] = m_lastNavPvt.hAcc * 1e-3;
+		data["ubx"]["nav_pvt"]["vertical_accuracy"] = m_lastNavPvt.vAcc * 1e-3;
+		data["ubx"]["nav_pvt"]["speed"] = m_lastNavPvt.gSpeed * 1e-3;
+	}
+	if(m_lastHpposllh.iTOW != 0)
+	{
+		data["ubx"]["hpposllh"]["latitude"] = m_lastHpposllh.lat * 1e-7 + m_lastHpposllh.latHp * 1e-9;
+		data["ubx"]["hpposllh"]["longitude"] = m_lastHpposllh.lon * 1e-7 + m_lastHpposllh.lonHp * 1e-9;
+		data["ubx"]["hpposllh"]["altitude"] = m_lastHpposllh.hMSL * 1e-3 + m_lastHpposllh.hMSLHp * 1e-4;
+		data["ubx"]["hpposllh"]["horizontal_accuracy"] = m_lastHpposllh.hAcc * 1e-4;
+		data["ubx"]["hpposllh"]["vertical_accuracy"] = m_lastHpposllh.vAcc * 1e-4;
+	}
 	data["is_logging"] = m_isLogging;
 	data["message_count"] = m_messageCount.load();
-	data["buffer_size"] = m_buffer.size();
+	data["buffer_size"] = m_log.records.size();
+	data["sentences_buffered"] = m_log.sentences.size();
 	return data;
 }
 
@@ -80,51 +234,295 @@ bool GNSSClient::startListener(const std::string& portName, LibSerial::BaudRate
 
 void GNSSClient::worker()
 {
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Gnss);
 	std::cout << "Worker started" << std::endl;
+	const int fd = m_serialPort.GetFileDescriptor();
+	// one byte of room for the terminator HandleSentence puts after a sentence
+	std::array<char, ReadBufferSize + 1> buffer;
+	size_t used = 0;
 	while(m_serialPort.IsOpen())
 	{
-		std::string line;
-		m_serialPort.ReadLine(line);
+		pollfd pfd{fd, POLLIN, 0};
+		if(::poll(&pfd, 1, 500) <= 0)
 		{
-			std::lock_guard<std::mutex> lock(m_bufferMutex);
-			m_lastLine = line;
+			continue;
 		}
-		bool is_vaild = minmea_check(line.c_str(), true);
-		if(is_vaild)
+		const ssize_t count = ::read(fd, buffer.data() + used, ReadBufferSize - used);
+		if(count < 0 && (errno == EINTR || errno == EAGAIN))
 		{
-			const double laserTimestamp = GetTimeStamp();
-			m_rawbuffer.emplace_back(RawEntryToLine(line, GetTimeStamp()));
-			minmea_sentence_gga gga;
-			bool isGGA = minmea_parse_gga(&gga, line.c_str());
-			if(isGGA)
-			{
-				if(m_dataCallback)
-				{
-					m_dataCallback(gga);
-				}
+			continue;
+		}
+		if(count <= 0)
+		{
+			std::cout << "GNSS serial port read failed : " << (count < 0 ? strerror(errno) : "end of file") << std::endl;
+			break;
+		}
+		used = FrameMessages(buffer.data(), used + count);
+	}
+}
 
-				std::string csvline = GgaToCsvLine(gga, laserTimestamp);
-				std::lock_guard<std::mutex> lock(m_bufferMutex);
-				std::swap(m_lastLine, line);
-				lastGGA = gga;
-				m_messageCount++;
-				if(m_isLogging)
+size_t GNSSClient::FrameMessages(char* buffer, size_t size)
+{
+	size_t start = 0;
+	while(start < size)
+	{
+		// anything before the start of a sentence or frame is line noise
+		const char* begin = FindMessageStart(buffer + start, buffer + size);
+		if(begin == nullptr)
+		{
+			start = size;
+			break;
+		}
+		start = begin - buffer;
+		if(static_cast<uint8_t>(*begin) == ubx::Sync1)
+		{
+			// UBX frame: binary, taken by its length whatever bytes it contains
+			if(size - start < ubx::HeaderSize)
+			{
+				break;
+			}
+			const uint8_t* frame = reinterpret_cast<const uint8_t*>(begin);
+			const size_t payloadSize = frame[4] | (frame[5] << 8);
+			if(frame[1] != ubx::Sync2 || payloadSize > ubx::MaxPayloadSize)
+			{
+				if(frame[1] == ubx::Sync2)
 				{
-					m_buffer.emplace_back(csvline);
+					m_ubxInvalidMetric.Add();
 				}
+				start++;
+				continue;
+			}
+			const size_t length = ubx::HeaderSize + payloadSize + ubx::ChecksumSize;
+			if(size - start < length)
+			{
+				break;
+			}
+			// on a bad checksum the sync chars were probably part of something else, search again right after them
+			start += HandleUbxFrame(frame, length) ? length : 1;
+			continue;
+		}
+		const char* end = static_cast<const char*>(memchr(begin, '\n', size - start));
+		// a sentence cut short by a new one or by a UBX frame is dropped, the new one is kept
+		const char* next = FindMessageStart(begin + 1, end ? end : buffer + size);
+		if(next != nullptr)
+		{
+			m_invalidMetric.Add();
+			start = next - buffer;
+			continue;
+		}
+		if(end == nullptr)
+		{
+			if(size - start > MaxSentenceLength)
+			{
+				m_invalidMetric.Add();
+				start = size;
 			}
+			break;
+		}
+		const size_t length = end - begin + 1;
+		if(length <= MaxSentenceLength)
+		{
+			HandleSentence(buffer + start, length);
 		}
 		else
 		{
-			std::cout << "Invalid line: " << line << std::endl;
+			m_invalidMetric.Add();
 		}
+		start += length;
 	}
+	memmove(buffer, buffer + start, size - start);
+	return size - start;
 }
+
+void GNSSClient::HandleSentence(char* sentence, size_t length)
+{
+	const double laserTimestamp = GetTimeStamp();
+	const int64_t systemTimeMs =
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	const uint64_t laserTimestampNs = static_cast<uint64_t>(laserTimestamp * 1000000000.0);
+
+	// minmea wants a terminated string, the byte after the sentence belongs to the next one
+	const char next = sentence[length];
+	sentence[length] = '\0';
+	const bool isValid = minmea_check(sentence, true);
+	// decoded outside of the lock, appended to the log below
+	std::array<char, MaxRecordSize> record;
+	size_t recordSize = 0;
+	minmea_sentence_gga gga;
+	bool isGGA = false;
+	const auto type = isValid ? minmea_sentence_id(sentence, true) : MINMEA_INVALID;
+	switch(type)
+	{
+	case MINMEA_SENTENCE_GGA:
+		isGGA = minmea_parse_gga(&gga, sentence);
+		if(isGGA)
+		{
+			recordSize = EncodeRecord(record.data(), gnss::RecordType::Gga, sentence, laserTimestampNs, systemTimeMs, ToRecord(gga));
+		}
+		break;
+	case MINMEA_SENTENCE_RMC: {
+		minmea_sentence_rmc rmc;
+		if(minmea_parse_rmc(&rmc, sentence))
+		{
+			recordSize = EncodeRecord(record.data(), gnss::RecordType::Rmc, sentence, laserTimestampNs, systemTimeMs, ToRecord(rmc));
+		}
+		break;
+	}
+	case MINMEA_SENTENCE_GST: {
+		minmea_sentence_gst gst;
+		if(minmea_parse_gst(&gst, sentence))
+		{
+			recordSize = EncodeRecord(record.data(), gnss::RecordType::Gst, sentence, laserTimestampNs, systemTimeMs, ToRecord(gst));
+		}
+		break;
+	}
+	case MINMEA_SENTENCE_GSA: {
+		minmea_sentence_gsa gsa;
+		if(minmea_parse_gsa(&gsa, sentence))
+		{
+			recordSize = EncodeRecord(record.data(), gnss::RecordType::Gsa, sentence, laserTimestampNs, systemTimeMs, ToRecord(gsa));
+		}
+		break;
+	}
+	case MINMEA_SENTENCE_VTG: {
+		minmea_sentence_vtg vtg;
+		if(minmea_parse_vtg(&vtg, sentence))
+		{
+			recordSize = EncodeRecord(record.data(), gnss::RecordType::Vtg, sentence, laserTimestampNs, systemTimeMs, ToRecord(vtg));
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	if(!isValid)
+	{
+		m_invalidMetric.Add();
+		std::cout << "Invalid line: " << sentence << std::endl;
+	}
+	sentence[length] = next;
+
+	if(isGGA && m_dataCallback)
+	{
+		m_dataCallback(gga);
+	}
+
+	std::lock_guard<std::mutex> lock(m_bufferMutex);
+	const size_t copied = std::min(length, MaxSentenceLength);
+	memcpy(m_lastLine.data(), sentence, copied);
+	m_lastLine[copied] = '\0';
+	if(!isValid)
+	{
+		return;
+	}
+	m_sentencesMetric.Add();
+	if(recordSize > 0)
+	{
+		const char* payload = record.data() + sizeof(gnss::RecordHeader);
+		switch(type)
+		{
+		case MINMEA_SENTENCE_GGA:
+			lastGGA = gga;
+			m_messageCount++;
+			m_ggaMetric.Add();
+			break;
+		case MINMEA_SENTENCE_RMC:
+			memcpy(&m_lastRmc, payload, sizeof(m_lastRmc));
+			m_rmcMetric.Add();
+			break;
+		case MINMEA_SENTENCE_GST:
+			memcpy(&m_lastGst, payload, sizeof(m_lastGst));
+			m_gstMetric.Add();
+			break;
+		case MINMEA_SENTENCE_GSA:
+			m_gsaMetric.Add();
+			break;
+		case MINMEA_SENTENCE_VTG:
+			m_vtgMetric.Add();
+			break;
+		default:
+			break;
+		}
+	}
+	if(m_isLogging)
+	{
+		m_log.sentences.push_back({laserTimestampNs, systemTimeMs, static_cast<uint32_t>(m_log.text.size()), static_cast<uint32_t>(length)});
+		m_log.text.append(sentence, length);
+		m_log.records.append(record.data(), recordSize);
+	}
+}
+
+bool GNSSClient::HandleUbxFrame(const uint8_t* frame, size_t length)
+{
+	const double laserTimestamp = GetTimeStamp();
+	const int64_t systemTimeMs =
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	uint8_t checksumA;
+	uint8_t checksumB;
+	ubx::checksum(frame + 2, length - 2 - ubx::ChecksumSize, checksumA, checksumB);
+	if(checksumA != frame[length - 2] || checksumB != frame[length - 1])
+	{
+		m_ubxInvalidMetric.Add();
+		return false;
+	}
+	m_ubxMetric.Add();
+
+	const uint8_t* payload = frame + ubx::HeaderSize;
+	const size_t payloadSize = length - ubx::HeaderSize - ubx::ChecksumSize;
+	gnss::RecordType type;
+	size_t recordSize;
+	if(frame[2] == ubx::ClassNav && frame[3] == ubx::IdNavPvt)
+	{
+		type = gnss::RecordType::UbxNavPvt;
+		recordSize = sizeof(ubx::NavPvt);
+	}
+	else if(frame[2] == ubx::ClassNav && frame[3] == ubx::IdNavHpposllh)
+	{
+		type = gnss::RecordType::UbxNavHpposllh;
+		recordSize = sizeof(ubx::NavHpposllh);
+	}
+	else if(frame[2] == ubx::ClassTim && frame[3] == ubx::IdTimTp)
+	{
+		type = gnss::RecordType::UbxTimTp;
+		recordSize = sizeof(ubx::TimTp);
+	}
+	else
+	{
+		return true;
+	}
+	if(payloadSize < recordSize)
+	{
+		m_ubxInvalidMetric.Add();
+		return true;
+	}
+
+	const gnss::RecordHeader header =
+		MakeRecordHeader(type, static_cast<uint16_t>(recordSize), static_cast<uint64_t>(laserTimestamp * 1000000000.0), systemTimeMs);
+	std::lock_guard<std::mutex> lock(m_bufferMutex);
+	if(type == gnss::RecordType::UbxNavPvt)
+	{
+		memcpy(&m_lastNavPvt, payload, sizeof(m_lastNavPvt));
+	}
+	else if(type == gnss::RecordType::UbxNavHpposllh)
+	{
+		memcpy(&m_lastHpposllh, payload, sizeof(m_lastHpposllh));
+	}
+	if(m_isLogging)
+	{
+		// payload goes from the read buffer to the log as it is, newer receivers may send longer payloads
+		m_log.records.append(reinterpret_cast<const char*>(&header), sizeof(header));
+		m_log.records.append(reinterpret_cast<const char*>(payload), recordSize);
+	}
+	return true;
+}
+
 void GNSSClient::startLog()
 {
 	std::lock_guard<std::mutex> lock(m_bufferMutex);
-	m_buffer.clear();
-	m_rawbuffer.clear();
+	m_log.records.clear();
+	m_log.sentences.clear();
+	m_log.text.clear();
 	m_isLogging = true;
 }
 
@@ -134,54 +532,52 @@ void GNSSClient::stopLog()
 	m_isLogging = false;
 }
 
-std::deque<std::string> GNSSClient::retrieveData()
+GnssLog GNSSClient::retrieveLog()
 {
+	// the next log gets the capacity of this one, reserved outside of the lock so the serial thread does not wait for it
+	GnssLog log;
+	{
+		std::lock_guard<std::mutex> lock(m_bufferMutex);
+		log.records.reserve(m_log.records.capacity());
+		log.sentences.reserve(m_log.sentences.capacity());
+		log.text.reserve(m_log.text.capacity());
+	}
 	std::lock_guard<std::mutex> lock(m_bufferMutex);
-	std::deque<std::string> ret;
-	std::swap(ret, m_buffer);
-	return ret;
+	std::swap(log, m_log);
+	return log;
 }
 
-std::deque<std::string> GNSSClient::retrieveRawData()
+void GnssLog::writeRecords(std::ostream& out) const
 {
-	std::lock_guard<std::mutex> lock(m_bufferMutex);
-	std::deque<std::string> ret;
-	std::swap(ret, m_rawbuffer);
-	return ret;
-}
-//! Convert a minmea_sentence_gga to a CSV line
-std::string GNSSClient::GgaToCsvLine(const minmea_sentence_gga& gga, double laserTimestamp)
-{
-	auto now = std::chrono::system_clock::now();
-	auto duration = now.time_since_epoch();
-	auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration);
-
-	std::stringstream oss;
-	oss << std::setprecision(20) << static_cast<uint_least64_t>(laserTimestamp * 1000000000.0) << " ";
-	oss << minmea_tocoord(&gga.latitude) << " ";
-	oss << minmea_tocoord(&gga.longitude) << " ";
-	oss << minmea_tofloat(&gga.altitude) << " ";
-	oss << minmea_tofloat(&gga.hdop) << " ";
-	oss << gga.satellites_tracked << " ";
-	oss << minmea_tofloat(&gga.height) << " ";
-	oss << minmea_tofloat(&gga.dgps_age) << " ";
-	oss << gga.time.hours << ":" << gga.time.minutes << ":" << gga.time.seconds << " ";
-	oss << gga.fix_quality << " ";
-	oss << millis.count() << "\n";
-	return oss.str();
-}
-
-std::string GNSSClient::RawEntryToLine(const std::string& line, double laserTimestamp)
-{
-	auto now = std::chrono::system_clock::now();
-	auto duration = now.time_since_epoch();
-	auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration);
-
-	std::stringstream oss;
-	oss << std::setprecision(20) << static_cast<uint_least64_t>(laserTimestamp * 1000000000.0) << " ";
-	oss << millis.count() << " ";
-	oss << line << " ";
-	return oss.str();
+	const gnss::FileHeader header;
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(records.data(), records.size());
+}
+
+void GnssLog::writeFixes(std::ostream& out) const
+{
+	out << std::setprecision(20);
+	gnss::RecordHeader header;
+	const uint8_t* payload;
+	for(auto reader = gnss::Reader::Records(records.data(), records.size()); reader.next(header, payload);)
+	{
+		if(header.type == static_cast<uint16_t>(gnss::RecordType::Gga))
+		{
+			gnss::writeGnssLine(out, header, gnss::Reader::get<gnss::Gga>(header, payload));
+		}
+	}
+}
+
+void GnssLog::writeSentences(std::ostream& out) const
+{
+	out << std::setprecision(20);
+	for(const auto& sentence : sentences)
+	{
+		out << sentence.laserTimestampNs << " ";
+		out << sentence.systemTimeMs << " ";
+		out.write(text.data() + sentence.offset, sentence.length);
+		out << " ";
+	}
 }
 
 void GNSSClient::setDataCallback(const std::function<void(const minmea_sentence_gga& gga)>& callback)
@@ -1,11 +1,14 @@
 #pragma once
 
-#include <deque>
+#include <array>
 #include <mutex>
 #include <nlohmann/json.hpp>
 
+#include "GnssLog.h"
 #include "minmea.h"
 #include "thread"
+#include "utils/GnssFormat.h"
+#include "utils/Metrics.h"
 #include "utils/TimeStampReceiver.h"
 #include <SerialPort.h>
 #include <SerialStream.h>
@@ -27,23 +30,32 @@ public:
 	//! Stop logging into the buffers
 	void stopLog();
 
-	//! Retrieve all data from the buffer, in form of CSV lines
-	std::deque<std::string> retrieveData();
-
-	//! Retrieve all data from the buffer, in form of CSV lines
-	std::deque<std::string> retrieveRawData();
+	//! Retrieve everything logged since the last call: decoded records and the sentences as received
+	GnssLog retrieveLog();
 
 	//! Addcallback on data received
 	void setDataCallback(const std::function<void(const minmea_sentence_gga& gga)>& callback);
 
 private:
+	//! Longest sentence accepted, NMEA allows 82 characters, proprietary sentences are longer
+	constexpr static size_t MaxSentenceLength{256};
+	//! Serial data is read in blocks into this buffer, sentences and UBX frames are framed and parsed in place
+	constexpr static size_t ReadBufferSize{4096};
+	static_assert(ReadBufferSize > mandeye_utils::ubx::HeaderSize + mandeye_utils::ubx::MaxPayloadSize + mandeye_utils::ubx::ChecksumSize,
+				  "an incomplete UBX frame has to leave room for reading");
+
 	std::mutex m_bufferMutex;
-	std::deque<std::string> m_buffer;
-	std::deque<std::string> m_rawbuffer;
+	GnssLog m_log;
 
-	std::string m_lastLine;
+	std::array<char, MaxSentenceLength + 1> m_lastLine{};
 	bool m_isLogging{false};
 	minmea_sentence_gga lastGGA;
+	//! latest accuracy estimate and velocity, for the status; scale 0 until received
+	mandeye_utils::gnss::Gst m_lastGst{};
+	mandeye_utils::gnss::Rmc m_lastRmc{};
+	//! latest UBX solutions, for the status; iTOW 0 until received
+	mandeye_utils::ubx::NavPvt m_lastNavPvt{};
+	mandeye_utils::ubx::NavHpposllh m_lastHpposllh{};
 	LibSerial::SerialPort m_serialPort;
 	LibSerial::SerialStream m_serialPortStream;
 	std::thread m_serialPortThread;
@@ -51,15 +63,45 @@ private:
 	int m_baudRate{0};
 	void worker();
 
-	bool init_succes{false};
+	//! Frames NMEA sentences and UBX frames in buffer, handles complete ones and moves the incomplete rest to the front.
+	//! Returns the number of bytes left. buffer has one byte of room after size.
+	size_t FrameMessages(char* buffer, size_t size);
+	//! Checks, parses and logs a sentence, sentence[length] can be overwritten temporarily
+	void HandleSentence(char* sentence, size_t length);
+	//! Checks and logs a UBX frame, payloads of known messages go to the log as they are.
+	//! Returns false if the checksum does not match.
+	bool HandleUbxFrame(const uint8_t* frame, size_t length);
 
-	//! Convert a minmea_sentence_gga to a CSV line
-	std::string GgaToCsvLine(const minmea_sentence_gga& gga, double laserTimestamp);
+	//! Largest record decoded from a sentence, RecordHeader and payload
+	constexpr static size_t MaxRecordSize{sizeof(mandeye_utils::gnss::RecordHeader) +
+										  std::max({sizeof(mandeye_utils::gnss::Gga),
+													sizeof(mandeye_utils::gnss::Rmc),
+													sizeof(mandeye_utils::gnss::Gst),
+													sizeof(mandeye_utils::gnss::Gsa),
+													sizeof(mandeye_utils::gnss::Vtg)})};
 
-	//! Convert a raw entry to a CSV line
-	std::string RawEntryToLine(const std::string& line, double laserTimestamp);
+	bool init_succes{false};
 	//! Callbacks to call when new data is received
 	std::function<void(const minmea_sentence_gga& gga)> m_dataCallback;
 	std::atomic<unsigned uint32_t> m_messageCount{0};
+
+	mandeye_utils::metrics::Counter& m_sentencesMetric{mandeye_utils::metrics::Registry::Instance().AddCounter(
+		"mandeye_gnss_nmea_valid_total", "Valid NMEA sentences received from GNSS, of any type")};
+	mandeye_utils::metrics::Counter& m_ggaMetric{mandeye_utils::metrics::Registry::Instance().AddCounter(
+		"mandeye_gnss_messages_total", "NMEA sentences received from GNSS", "type=\"gga\"")};
+	mandeye_utils::metrics::Counter& m_rmcMetric{mandeye_utils::metrics::Registry::Instance().AddCounter(
+		"mandeye_gnss_messages_total", "NMEA sentences received from GNSS", "type=\"rmc\"")};
+	mandeye_utils::metrics::Counter& m_gstMetric{mandeye_utils::metrics::Registry::Instance().AddCounter(
+		"mandeye_gnss_messages_total", "NMEA sentences received from GNSS", "type=\"gst\"")};
+	mandeye_utils::metrics::Counter& m_gsaMetric{mandeye_utils::metrics::Registry::Instance().AddCounter(
+		"mandeye_gnss_messages_total", "NMEA sentences received from GNSS", "type=\"gsa\"")};
+	mandeye_utils::metrics::Counter& m_vtgMetric{mandeye_utils::metrics::Registry::Instance().AddCounter(
+		"mandeye_gnss_messages_total", "NMEA sentences received from GNSS", "type=\"vtg\"")};
+	mandeye_utils::metrics::Counter& m_ubxMetric{mandeye_utils::metrics::Registry::Instance().AddCounter(
+		"mandeye_gnss_messages_total", "NMEA sentences received from GNSS", "type=\"ubx\"")};
+	mandeye_utils::metrics::Counter& m_ubxInvalidMetric{mandeye_utils::metrics::Registry::Instance().AddCounter(
+		"mandeye_gnss_messages_total", "NMEA sentences received from GNSS", "type=\"ubx_invalid\"")};
+	mandeye_utils::metrics::Counter& m_invalidMetric{mandeye_utils::metrics::Registry::Instance().AddCounter(
+		"mandeye_gnss_messages_total", "NMEA sentences received from GNSS", "type=\"invalid\"")};
 };
 } // namespace mandeye
\ No newline at end of file
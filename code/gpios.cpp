@@ -1,8 +1,16 @@
 #include "hardware_config/mandeye.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <fstream>
 #include <gpiod.h>
 #include <gpios.h>
 #include <iostream>
+#include <optional>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utils/ThreadRoles.h>
 namespace mandeye
 {
 using namespace hardware;
@@ -23,13 +31,6 @@ bool GpioClient::ButtonData::GetButtonState(const GpioClient::ButtonData& button
 		return rawButtonState == 1;
 	}
 }
-void GpioClient::ButtonData::CallUserCallbacks()
-{
-	for(auto& [name, callback] : m_callbacks)
-	{
-		callback();
-	}
-}
 
 GpioClient::GpioClient(bool sim)
 	: m_useSimulatedGPIO(sim)
@@ -113,12 +114,17 @@ GpioClient::GpioClient(bool sim)
 				{
 					flags = GPIOD_LINE_REQUEST_FLAG_BIAS_PULL_DOWN;
 				}
-				int ret = gpiod_line_request_input_flags(buttonData.m_line, buttonData.m_name.c_str(), flags);
+				int ret = gpiod_line_request_both_edges_events_flags(buttonData.m_line, buttonData.m_name.c_str(), flags);
 				if(ret < 0)
 				{
 					std::cerr << "Failed to create line at pin " << buttonData.m_pin << " of " << buttonData.m_name << std::endl;
+					buttonData.m_line = nullptr;
 					continue;
 				}
+				buttonData.m_eventFd = gpiod_line_event_get_fd(buttonData.m_line);
+				// a button held at start counts as pressed once it is debounced, as any other press
+				buttonData.m_rawPressed = ButtonData::GetButtonState(buttonData);
+				buttonData.m_lastEdge = std::chrono::steady_clock::now();
 			}
 		}
 	}
@@ -127,46 +133,41 @@ GpioClient::GpioClient(bool sim)
 	{
 		{
 			addButtonCallback(buttonID, "DBG" + ButtonName, [this, ButtonName]() {
-				auto buzzerGPIO = m_ledGpio[LED::BUZZER];
-				setLed(buzzerGPIO, true);
-				std::this_thread::sleep_for(std::chrono::milliseconds(100));
-				setLed(buzzerGPIO, false);
+				pulse(LED::BUZZER, std::chrono::milliseconds(100));
 				std::cout << "Button :  " << ButtonName << std::endl;
 			});
 		}
 	};
 
-	m_gpioReadBackThread = std::thread([this]() {
-		while(m_running)
-		{
-			for(auto& [buttonID, buttonData] : m_buttons)
-			{
-				bool rawButtonState = ButtonData::GetButtonState(buttonData);
-				if(rawButtonState == true)
-				{
-					buttonData.m_pressedTime++;
-					if(buttonData.m_pressedTime == buttonData.DEBOUNCE_TIME)
-					{
-						buttonData.m_pressed = true;
-						buttonData.CallUserCallbacks();
-					}
-				}
-				else
-				{
-					buttonData.m_pressedTime = 0;
-				}
-			}
-			std::this_thread::sleep_for(std::chrono::milliseconds(25));
-		}
-	});
+	m_schedulerThread = std::thread(&GpioClient::schedulerWorker, this);
+
+	m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	m_gpioReadBackThread = std::thread(&GpioClient::buttonWorker, this);
 }
 GpioClient::~GpioClient()
 {
-	if(m_gpioReadBackThread.joinable())
 	{
+		std::lock_guard<std::mutex> lck{m_scheduleLock};
 		m_running.store(false);
+	}
+	m_scheduleCondition.notify_all();
+	if(m_wakeFd >= 0)
+	{
+		const uint64_t one = 1;
+		[[maybe_unused]] const ssize_t written = ::write(m_wakeFd, &one, sizeof(one));
+	}
+	if(m_gpioReadBackThread.joinable())
+	{
 		m_gpioReadBackThread.join();
 	}
+	if(m_wakeFd >= 0)
+	{
+		::close(m_wakeFd);
+	}
+	if(m_schedulerThread.joinable())
+	{
+		m_schedulerThread.join();
+	}
 	if(m_chip)
 	{
 		for(auto& [led, ledData] : m_ledGpio)
@@ -210,6 +211,7 @@ nlohmann::json GpioClient::produceStatus()
 		if(it != m_buttons.end())
 		{
 			data["buttons"][buttonname] = it->second.m_pressed;
+			data["button_edges"][buttonname] = it->second.m_edges;
 		}
 		else
 		{
@@ -248,32 +250,217 @@ void GpioClient::addButtonCallback(hardware::BUTTON btn, const std::string& call
 	it->second.m_callbacks[callbackName] = callback;
 }
 
-void GpioClient::beep(const std::vector<int>& durations)
+bool GpioClient::injectEdge(hardware::BUTTON button, bool pressed, std::chrono::milliseconds delay)
+{
+	if(!m_useSimulatedGPIO || m_buttons.find(button) == m_buttons.end())
+	{
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lck{m_lock};
+		m_simulatedEdges.emplace(std::chrono::steady_clock::now() + delay, SimulatedEdge{button, pressed});
+	}
+	const uint64_t one = 1;
+	[[maybe_unused]] const ssize_t written = ::write(m_wakeFd, &one, sizeof(one));
+	return true;
+}
+
+bool GpioClient::injectEdge(const std::string& buttonName, bool pressed, std::chrono::milliseconds delay)
+{
+	const auto it = NameToButton.find(buttonName);
+	return it != NameToButton.end() && injectEdge(it->second, pressed, delay);
+}
+
+std::chrono::steady_clock::time_point GpioClient::EdgeTime(const timespec& timestamp)
+{
+	const auto now = std::chrono::steady_clock::now();
+	// kernels before 5.7 stamp line events with the realtime clock, newer ones with the monotonic clock
+	for(const clockid_t clock : {CLOCK_MONOTONIC, CLOCK_REALTIME})
+	{
+		timespec clockNow;
+		clock_gettime(clock, &clockNow);
+		const auto age = std::chrono::seconds(clockNow.tv_sec - timestamp.tv_sec) + std::chrono::nanoseconds(clockNow.tv_nsec - timestamp.tv_nsec);
+		if(age >= std::chrono::nanoseconds(0) && age < std::chrono::seconds(1))
+		{
+			return now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(age);
+		}
+	}
+	return now;
+}
+
+void GpioClient::onEdge(ButtonData& button, bool pressed, std::chrono::steady_clock::time_point time)
+{
+	button.m_edges++;
+	button.m_rawPressed = pressed;
+	button.m_lastEdge = time;
+}
+
+void GpioClient::buttonWorker()
 {
-	//std::lock_guard<std::mutex> lck{m_lock};
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Gpio);
+	std::vector<pollfd> fds;
+	std::vector<ButtonData*> fdButtons;
+	fds.push_back({m_wakeFd, POLLIN, 0});
+	for(auto& [buttonID, buttonData] : m_buttons)
+	{
+		if(buttonData.m_eventFd >= 0)
+		{
+			fds.push_back({buttonData.m_eventFd, POLLIN, 0});
+			fdButtons.push_back(&buttonData);
+		}
+	}
 
-	if(!m_useSimulatedGPIO)
+	while(m_running)
 	{
-		bool isOn = false;
-		auto& buzzerGpio = m_ledGpio[LED::BUZZER];
-		for(auto& duration : durations)
+		// sleep until an edge comes, or until the state after the last edge has lasted the debounce time
+		int timeoutMs = -1;
 		{
-			const auto sleepDuration = std::chrono::milliseconds(duration);
-			if(!isOn)
+			std::lock_guard<std::mutex> lck{m_lock};
+			std::optional<std::chrono::steady_clock::time_point> deadline;
+			if(!m_simulatedEdges.empty())
 			{
-				setLed(buzzerGpio, true);
-				std::this_thread::sleep_for(sleepDuration);
-				isOn = true;
+				deadline = m_simulatedEdges.begin()->first;
 			}
-			else
+			for(const auto& [buttonID, buttonData] : m_buttons)
+			{
+				if(buttonData.m_rawPressed != buttonData.m_pressed)
+				{
+					const auto settled = buttonData.m_lastEdge + ButtonData::DEBOUNCE_TIME;
+					deadline = deadline ? std::min(*deadline, settled) : settled;
+				}
+			}
+			if(deadline)
+			{
+				const auto wait = std::chrono::ceil<std::chrono::milliseconds>(*deadline - std::chrono::steady_clock::now());
+				timeoutMs = static_cast<int>(std::max<int64_t>(0, wait.count()));
+			}
+		}
+		if(::poll(fds.data(), fds.size(), timeoutMs) < 0 && errno != EINTR)
+		{
+			std::cerr << "Waiting for button events failed : " << strerror(errno) << std::endl;
+			break;
+		}
+		if(fds[0].revents & POLLIN)
+		{
+			uint64_t count;
+			[[maybe_unused]] const ssize_t bytes = ::read(m_wakeFd, &count, sizeof(count));
+		}
+
+		std::vector<Callbacks> pressed;
+		{
+			std::lock_guard<std::mutex> lck{m_lock};
+			for(size_t i = 1; i < fds.size(); i++)
+			{
+				if(fds[i].revents & POLLIN)
+				{
+					ButtonData& button = *fdButtons[i - 1];
+					gpiod_line_event event;
+					if(gpiod_line_event_read(button.m_line, &event) == 0)
+					{
+						const bool falling = event.event_type == GPIOD_LINE_EVENT_FALLING_EDGE;
+						onEdge(button, button.m_pullMode == GPIO::GPIO_PULL::UP ? falling : !falling, EdgeTime(event.ts));
+					}
+				}
+			}
+			const auto now = std::chrono::steady_clock::now();
+			while(!m_simulatedEdges.empty() && m_simulatedEdges.begin()->first <= now)
+			{
+				const auto edge = m_simulatedEdges.begin();
+				onEdge(m_buttons[edge->second.m_button], edge->second.m_pressed, edge->first);
+				m_simulatedEdges.erase(edge);
+			}
+			for(auto& [buttonID, buttonData] : m_buttons)
+			{
+				if(buttonData.m_rawPressed != buttonData.m_pressed && now - buttonData.m_lastEdge >= ButtonData::DEBOUNCE_TIME)
+				{
+					buttonData.m_pressed = buttonData.m_rawPressed;
+					if(buttonData.m_pressed)
+					{
+						pressed.push_back(buttonData.m_callbacks);
+					}
+				}
+			}
+		}
+		// called without the lock, callbacks use the client
+		for(const auto& callbacks : pressed)
+		{
+			for(const auto& [name, callback] : callbacks)
 			{
-				setLed(buzzerGpio, false);
-				std::this_thread::sleep_for(sleepDuration);
-				isOn = false;
+				callback();
 			}
 		}
-		// make sure that is off;
-		setLed(buzzerGpio, false);
+	}
+}
+
+void GpioClient::pulse(hardware::LED led, std::chrono::milliseconds duration)
+{
+	const auto now = std::chrono::steady_clock::now();
+	schedule(led, {{now, true}, {now + duration, false}}, false);
+}
+
+std::chrono::milliseconds GpioClient::beep(const std::vector<int>& durations)
+{
+	auto time = std::chrono::steady_clock::now();
+	const auto start = time;
+	std::vector<std::pair<std::chrono::steady_clock::time_point, bool>> states;
+	bool isOn = true;
+	for(const int duration : durations)
+	{
+		states.emplace_back(time, isOn);
+		time += std::chrono::milliseconds(duration);
+		isOn = !isOn;
+	}
+	// make sure that is off
+	states.emplace_back(time, false);
+	schedule(LED::BUZZER, states, true);
+	return std::chrono::duration_cast<std::chrono::milliseconds>(time - start);
+}
+
+bool GpioClient::schedule(hardware::LED led, const std::vector<std::pair<std::chrono::steady_clock::time_point, bool>>& states, bool pattern)
+{
+	{
+		std::lock_guard<std::mutex> lck{m_scheduleLock};
+		if(!pattern && std::any_of(m_schedule.begin(), m_schedule.end(), [led](const auto& scheduled) {
+			   return scheduled.second.m_led == led && scheduled.second.m_pattern;
+		   }))
+		{
+			return false;
+		}
+		for(auto it = m_schedule.begin(); it != m_schedule.end();)
+		{
+			it = it->second.m_led == led ? m_schedule.erase(it) : std::next(it);
+		}
+		for(const auto& [time, state] : states)
+		{
+			m_schedule.emplace(time, ScheduledState{led, state, pattern});
+		}
+	}
+	m_scheduleCondition.notify_one();
+	return true;
+}
+
+void GpioClient::schedulerWorker()
+{
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Gpio);
+	std::unique_lock<std::mutex> lck{m_scheduleLock};
+	while(m_running)
+	{
+		if(m_schedule.empty())
+		{
+			m_scheduleCondition.wait(lck);
+			continue;
+		}
+		const auto next = m_schedule.begin();
+		if(next->first > std::chrono::steady_clock::now())
+		{
+			m_scheduleCondition.wait_until(lck, next->first);
+			continue;
+		}
+		const ScheduledState scheduled = next->second;
+		m_schedule.erase(next);
+		lck.unlock();
+		setLed(scheduled.m_led, scheduled.m_state);
+		lck.lock();
 	}
 }
 
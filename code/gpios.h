@@ -2,6 +2,10 @@
 
 #include "hardware_config/hardware_common.h"
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <map>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <thread>
@@ -26,14 +30,17 @@ class GpioClient
 		std::string m_name; //! button name
 		int m_pin; //! pin number
 		gpiod_line* m_line{nullptr};
-		uint32_t m_pressedTime{0}; //! time when button was pressed
+		int m_eventFd{-1}; //! edge events of the line, -1 without hardware
 		GPIO::GPIO_PULL m_pullMode; //! pull up or down
-		bool m_pressed; //! is button pressed
+		bool m_rawPressed{false}; //! state after the last edge
+		std::chrono::steady_clock::time_point m_lastEdge; //! time of the last edge
+		bool m_pressed{false}; //! debounced state
+		uint32_t m_edges{0}; //! edges seen, a high count per press means a bouncing button
 		Callbacks m_callbacks; //! callbacks to call when button is pressed
-		static constexpr int DEBOUNCE_TIME = 2; //! debounce time in cycles
+		//! the line has to stay in a state this long after its last edge to count
+		static constexpr std::chrono::milliseconds DEBOUNCE_TIME{30};
 
 		static bool GetButtonState(const ButtonData& button);
-		void CallUserCallbacks();
 	};
 
 	struct LedData
@@ -65,11 +72,54 @@ public:
 	//! addcalback
 	void addButtonCallback(hardware::BUTTON btn, const std::string& callbackName, const std::function<void()>& callback);
 
-	//! allow to beep the buzzer with a given duration
-	void beep(const std::vector<int>& durations);
+	//! Simulated GPIO only: queues an edge of the button, delay after now, handled like one of the hardware.
+	//! Returns false without simulated GPIO or for an unknown button.
+	bool injectEdge(hardware::BUTTON button, bool pressed, std::chrono::milliseconds delay = std::chrono::milliseconds(0));
+	bool injectEdge(const std::string& buttonName, bool pressed, std::chrono::milliseconds delay = std::chrono::milliseconds(0));
+
+	//! turns led on for duration in background. A newer pulse extends a pending one, a pending beep pattern
+	//! is not interrupted: the pulse is dropped then.
+	void pulse(hardware::LED led, std::chrono::milliseconds duration);
+
+	//! beeps the buzzer in background, durations in ms alternate on and off. Replaces pending pulses and beeps.
+	//! Returns the length of the pattern, for callers that want to wait for it.
+	std::chrono::milliseconds beep(const std::vector<int>& durations);
 
 private:
+	struct ScheduledState
+	{
+		hardware::LED m_led;
+		bool m_state;
+		bool m_pattern; //! part of a beep pattern, not replaced by pulses
+	};
+
+	//! replaces pending states of led with states, applied by the scheduler thread at their time.
+	//! States that are not a pattern are dropped while a pattern of the led is pending, returns false then.
+	bool schedule(hardware::LED led, const std::vector<std::pair<std::chrono::steady_clock::time_point, bool>>& states, bool pattern);
+	void schedulerWorker();
+
+	struct SimulatedEdge
+	{
+		hardware::BUTTON m_button;
+		bool m_pressed;
+	};
+
+	//! waits for edge events of the buttons, debounces them and calls the callbacks
+	void buttonWorker();
+	//! records an edge of the button, caller holds m_lock
+	void onEdge(ButtonData& button, bool pressed, std::chrono::steady_clock::time_point time);
+	//! time an edge event was stamped with by the kernel, on the steady clock
+	static std::chrono::steady_clock::time_point EdgeTime(const timespec& timestamp);
+
 	std::thread m_gpioReadBackThread;
+	//! wakes the button thread for simulated edges and on shutdown
+	int m_wakeFd{-1};
+	std::multimap<std::chrono::steady_clock::time_point, SimulatedEdge> m_simulatedEdges;
+	//! applies scheduled led states, so no caller sleeps on a pulse
+	std::thread m_schedulerThread;
+	std::mutex m_scheduleLock;
+	std::condition_variable m_scheduleCondition;
+	std::multimap<std::chrono::steady_clock::time_point, ScheduledState> m_schedule;
 	gpiod_chip* m_chip{nullptr}; //!< GPIO chip
 
 	//! use simulated GPIOs instead real one
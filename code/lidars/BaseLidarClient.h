@@ -1,9 +1,14 @@
 #pragma once
+#include "utils/IngestBuffer.h"
+#include "utils/LidarClock.h"
+#include "utils/ThreadRoles.h"
 #include "utils/TimeStampProvider.h"
 #include <deque>
+#include <functional>
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <stdint.h>
+#include <vector>
 namespace mandeye
 {
 struct LidarPoint
@@ -32,13 +37,14 @@ struct LidarIMU
 	uint64_t epoch_time;
 };
 
-using LidarPointsBuffer = std::deque<LidarPoint>;
-using LidarPointsBufferPtr = std::shared_ptr<std::deque<LidarPoint>>;
-using LidarPointsBufferConstPtr = std::shared_ptr<const std::deque<LidarPoint>>;
+//! Buffers are vectors, so recycled buffers keep their capacity (see BufferPool)
+using LidarPointsBuffer = std::vector<LidarPoint>;
+using LidarPointsBufferPtr = std::shared_ptr<LidarPointsBuffer>;
+using LidarPointsBufferConstPtr = std::shared_ptr<const LidarPointsBuffer>;
 
-using LidarIMUBuffer = std::deque<LidarIMU>;
-using LidarIMUBufferPtr = std::shared_ptr<std::deque<LidarIMU>>;
-using LidarIMUBufferConstPtr = std::shared_ptr<const std::deque<LidarIMU>>;
+using LidarIMUBuffer = std::vector<LidarIMU>;
+using LidarIMUBufferPtr = std::shared_ptr<LidarIMUBuffer>;
+using LidarIMUBufferConstPtr = std::shared_ptr<const LidarIMUBuffer>;
 
 using BaseLidarClientPtr = std::shared_ptr<class BaseLidarClient>;
 using BaseLidarClientConstPtr = std::shared_ptr<const class BaseLidarClient>;
@@ -46,6 +52,16 @@ using BaseLidarClientConstPtr = std::shared_ptr<const class BaseLidarClient>;
 class BaseLidarClient : public mandeye_utils::TimeStampProvider
 {
 public:
+	BaseLidarClient()
+	{
+		auto& registry = mandeye_utils::metrics::Registry::Instance();
+		m_lidarIngest.SetMetrics(
+			&registry.AddIndexedCounter("mandeye_ingest_points_total", "Lidar points received by ingest threads", "lidar"),
+			&registry.AddCounter("mandeye_ingest_dropped_total", "Samples dropped by ingest threads", "stream=\"lidar\""));
+		m_imuIngest.SetMetrics(&registry.AddIndexedCounter("mandeye_ingest_imu_samples_total", "IMU samples received by ingest threads", "lidar"),
+							   &registry.AddCounter("mandeye_ingest_dropped_total", "Samples dropped by ingest threads", "stream=\"imu\""));
+	}
+
 	//! Initialize the client with a configuration
 	virtual void Init(const nlohmann::json& config) {};
 	virtual ~BaseLidarClient() = default;
@@ -60,18 +76,29 @@ public:
 	virtual void stopListener() {};
 
 	//! Start logging data from the Lidar and IMU
-	virtual void startLog() = 0;
+	virtual void startLog()
+	{
+		m_lidarIngest.Start();
+		m_imuIngest.Start();
+	}
 
 	//! Stop logging data from the Lidar and IMU
-	virtual void stopLog() = 0;
+	virtual void stopLog()
+	{
+		m_lidarIngest.Stop();
+		m_imuIngest.Stop();
+	}
 
 	//! Move the data from the internal buffers to the caller, preparing new buffers
-	virtual std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr> retrieveData() = 0;
+	virtual std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr> retrieveData()
+	{
+		return {m_lidarIngest.Retrieve(), m_imuIngest.Retrieve()};
+	}
 
-	//! gets a buffer size
+	//! gets a buffer size, lock-free so it can be polled from the metrics and status threads
 	virtual uint64_t GetBufferSize() const
 	{
-		return 0;
+		return m_lidarIngest.Size();
 	}
 	//! Get the current mapping from serial number to lidar id
 	virtual std::unordered_map<uint32_t, std::string> getSerialNumberToLidarIdMapping() const
@@ -84,6 +111,83 @@ public:
 	{
 		return false;
 	}
+
+	// mandeye_utils::TimeStampProvider overrides, lock free reads of m_clock
+	double getTimestamp() override
+	{
+		return double(m_clock.GetTimestampNs()) / 1e9;
+	}
+
+	double getSessionDuration() override
+	{
+		return double(m_clock.GetSessionElapsedNs()) / 1e9;
+	}
+
+	double getSessionStart() override
+	{
+		return m_clock.HasSession() ? double(m_clock.GetSessionStartNs()) / 1e9 : -1.0;
+	}
+
+	void initializeDuration() override
+	{
+		m_clock.InitializeSession();
+	}
+
+	mandeye_utils::ClockModel getClockModel() override
+	{
+		return m_clock.GetClockModel();
+	}
+
+	//! Set function used to register threads delivering lidar data in the thread-role registry of the host program.
+	//! Has to be set before startListener.
+	void SetThreadRoleRegistrar(const std::function<void(const std::string& role)>& registrar)
+	{
+		m_threadRoleRegistrar = registrar;
+	}
+
+	//! Set observer of lidar point batches as they are ingested, also when not logging (e.g. live preview).
+	//! Called on ingest threads, has to be cheap. Has to be set before startListener.
+	void SetLidarTap(const mandeye_utils::IngestBuffer<LidarPoint>::Tap& tap)
+	{
+		m_lidarIngest.SetTap(tap);
+	}
+
+	//! Same as SetLidarTap for IMU samples
+	void SetImuTap(const mandeye_utils::IngestBuffer<LidarIMU>::Tap& tap)
+	{
+		m_imuIngest.SetTap(tap);
+	}
+
+	//! Produce status of the ingest buffers and their pools
+	nlohmann::json produceIngestStatus()
+	{
+		nlohmann::json data;
+		data["lidar"] = m_lidarIngest.produceStatus();
+		data["imu"] = m_imuIngest.produceStatus();
+		return data;
+	}
+
+protected:
+	//! Ingest buffers adapters append to, see mandeye_utils::IngestBuffer
+	mandeye_utils::IngestBuffer<LidarPoint> m_lidarIngest;
+	mandeye_utils::IngestBuffer<LidarIMU> m_imuIngest;
+
+	//! Lidar time, adapters call m_clock.Update on each packet
+	mandeye_utils::LidarClock m_clock;
+
+	//! Registers calling thread (e.g. SDK callback thread) with the role, once per thread
+	void registerCurrentThread(const char* role)
+	{
+		thread_local bool registered = false;
+		if(!registered && m_threadRoleRegistrar)
+		{
+			registered = true;
+			m_threadRoleRegistrar(role);
+		}
+	}
+
+private:
+	std::function<void(const std::string& role)> m_threadRoleRegistrar;
 };
 
 } // namespace mandeye
\ No newline at end of file
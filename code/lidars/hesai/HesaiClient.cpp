@@ -12,6 +12,7 @@ nlohmann::json HesaiClient::produceStatus()
 	nlohmann::json data_status;
 	data_status["init_success"] = true;
 	data["is_synced"] = isSynced();
+	std::lock_guard<std::mutex> lock(m_stateMutex);
 	data_status["is_done"] = isDone.load(); // Current status of the data thread
 	data_status["received_point_messages"] = m_recivedPointMessages.load(); // Number of received point messages
 	data_status["received_imu_messages"] = m_recivedIMUMessages.load(); // Number of received IMU messages
@@ -22,8 +23,9 @@ nlohmann::json HesaiClient::produceStatus()
 	data_status["hardware_vers"] = m_hardware_vers;
 	data_status["laser_num"] = m_laser_num;
 	data_status["channel_num"] = m_channel_num;
-	data_status["timestamp_sec"] = m_timestamp;
-	data_status["time_diff"] = m_time_diff;
+	data_status["timestamp_sec"] = getTimestamp();
+	data_status["time_diff"] = m_clock.GetHostOffsetSec();
+	data_status["clock"] = m_clock.produceStatus();
 	nlohmann::json faults;
 	for(auto& fault : m_faults)
 	{
@@ -49,51 +51,11 @@ nlohmann::json HesaiClient::produceStatus()
 bool HesaiClient::startListener(const std::string& interfaceIp)
 {
 	std::cout << "HesaiClient: startListener called with interfaceIp: " << interfaceIp << std::endl;
-	std::lock_guard<std::mutex> lock(m_bufferImuMutex);
 	// Simulate starting the listener
 	m_watchThread = std::thread(&HesaiClient::DataThreadFunction, this);
 	return true; // Simulate success
 }
 
-void HesaiClient::startLog()
-{
-	std::cout << "HesaiClient: startLog called" << std::endl;
-	// Initialize buffers
-	std::lock_guard<std::mutex> lock1(m_bufferImuMutex);
-	std::lock_guard<std::mutex> lock2(m_bufferPointMutex);
-
-	m_bufferLidarPtr = std::make_shared<LidarPointsBuffer>();
-	m_bufferIMUPtr = std::make_shared<LidarIMUBuffer>();
-	// Simulate starting log
-	std::cout << "HesaiClient: Logging started" << std::endl;
-}
-
-void HesaiClient::stopLog()
-{
-	std::lock_guard<std::mutex> lock1(m_bufferImuMutex);
-	std::lock_guard<std::mutex> lock2(m_bufferPointMutex);
-
-	// Stop the data thread
-	m_bufferLidarPtr.reset();
-	m_bufferIMUPtr.reset();
-	std::cout << "HesaiClient: stopLog called" << std::endl;
-}
-
-std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr> HesaiClient::retrieveData()
-{
-	std::cout << "HesaiClient: retrieveData called" << std::endl;
-	// Return empty buffers for now
-
-	std::lock_guard<std::mutex> lock1(m_bufferImuMutex);
-	std::lock_guard<std::mutex> lock2(m_bufferPointMutex);
-
-	LidarPointsBufferPtr returnPointerLidar{std::make_shared<LidarPointsBuffer>()};
-	LidarIMUBufferPtr returnPointerImu{std::make_shared<LidarIMUBuffer>()};
-	std::swap(m_bufferIMUPtr, returnPointerImu);
-	std::swap(m_bufferLidarPtr, returnPointerLidar);
-	return std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr>(returnPointerLidar, returnPointerImu);
-}
-
 void HesaiClient::DataThreadFunction()
 {
 	std::cout << "HesaiClient: DataThreadFunction started" << std::endl;
@@ -139,28 +101,28 @@ void HesaiClient::DataThreadFunction()
 
 void HesaiClient::CallbackFrame(const LidarDecodedFrame<LidarPointXYZICRT>& dataFrame)
 {
+	registerCurrentThread(mandeye_utils::ThreadRole::Ingest);
 	m_recivedPointMessages.fetch_add(1);
-	m_lidar_state = dataFrame.lidar_state;
-	m_work_mode = dataFrame.work_mode;
-	m_packet_num = dataFrame.packet_num;
-	m_software_vers = dataFrame.software_version;
-	m_hardware_vers = dataFrame.hardware_version;
-	m_laser_num = dataFrame.laser_num;
-	m_channel_num = dataFrame.channel_num;
+	{
+		std::lock_guard<std::mutex> lock(m_stateMutex);
+		m_lidar_state = dataFrame.lidar_state;
+		m_work_mode = dataFrame.work_mode;
+		m_packet_num = dataFrame.packet_num;
+		m_software_vers = dataFrame.software_version;
+		m_hardware_vers = dataFrame.hardware_version;
+		m_laser_num = dataFrame.laser_num;
+		m_channel_num = dataFrame.channel_num;
+	}
 	if(dataFrame.points_num > 0)
 	{
-		m_timestamp = dataFrame.points[0].timestamp;
-		//get current timestamp
-		using namespace std::chrono;
-		const auto now = system_clock::now();
-		auto duration = now.time_since_epoch();
-		double tp = std::chrono::duration<double>(duration).count();
-		m_time_diff = std::abs(tp - m_timestamp);
+		m_clock.Update(dataFrame.points[0].timestamp * 1e9); // convert to nanosecs
 	}
 
-	std::lock_guard<std::mutex> lock(m_bufferPointMutex);
-	if(m_bufferLidarPtr)
+	if(m_lidarIngest.IsAccepting())
 	{
+		// frame is converted without lock and appended in one batch
+		thread_local LidarPointsBuffer staged;
+		staged.reserve(dataFrame.points_num);
 		for(size_t i = 0; i < dataFrame.points_num; ++i)
 		{
 			const auto& point = dataFrame.points[i];
@@ -171,26 +133,17 @@ void HesaiClient::CallbackFrame(const LidarDecodedFrame<LidarPointXYZICRT>& data
 			data.intensity = point.intensity;
 			data.laser_id = 0;
 			data.timestamp = point.timestamp * 1e9; // convert to nanosecs
-			m_bufferLidarPtr->push_back(data);
+			staged.push_back(data);
 		}
+		m_lidarIngest.Flush(staged);
 	}
 }
 
-uint64_t HesaiClient::GetBufferSize() const
-{
-	std::lock_guard<std::mutex> lock(m_bufferPointMutex);
-	if(!m_bufferLidarPtr)
-	{
-		return 0;
-	}
-	return m_bufferLidarPtr->size();
-}
-
 void HesaiClient::CallbackIMU(const LidarImuData& dataFrame)
 {
+	registerCurrentThread(mandeye_utils::ThreadRole::Ingest);
 	m_recivedIMUMessages.fetch_add(1);
-	std::lock_guard<std::mutex> lock(m_bufferImuMutex);
-	if(m_bufferIMUPtr)
+	if(m_imuIngest.IsAccepting())
 	{
 		auto now = std::chrono::system_clock::now();
 		auto duration = now.time_since_epoch();
@@ -206,13 +159,14 @@ void HesaiClient::CallbackIMU(const LidarImuData& dataFrame)
 		data.gyro_z = M_PI * dataFrame.imu_ang_vel_z / 180.0;
 		data.laser_id = 0;
 		data.epoch_time = millis.count();
-		m_bufferIMUPtr->push_back(data);
+		m_imuIngest.Append(data);
 	}
 }
 
 void HesaiClient::CallbackFault(const FaultMessageInfo& fault_message_info)
 {
 	std::cerr << "HesaiClient: CallbackFault called with fault message: " << fault_message_info.fault_state << std::endl;
+	std::lock_guard<std::mutex> lock(m_stateMutex);
 	m_faults.push_back(fault_message_info);
 	if(m_faults.size() > 10)
 	{
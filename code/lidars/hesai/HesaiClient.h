@@ -23,36 +23,11 @@ public:
 	//! starts ButterLidar, interface is IP of listen interface (IP of network cards with ButterLidar connected
 	bool startListener(const std::string& interfaceIp) override;
 
-	//! Start log to memory data from Lidar and IMU
-	void startLog() override;
-
-	//! Stops log to memory data from Lidar and IMU
-	void stopLog() override;
-
-	std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr> retrieveData() override;
-
-	// TimestampProvider overrides ...
-	double getTimestamp() override
-	{
-		return m_timestamp;
-	} // Dummy implementation
-	double getSessionDuration() override
-	{
-		return 0.0;
-	} // Dummy implementation
-	double getSessionStart() override
-	{
-		return 0.0;
-	} // Dummy implementation
-	void initializeDuration() override { } // Dummy implementation
-
 	bool isSynced() override
 	{
-		return m_time_diff < 1.0; // laser report time with computer's timestamp
+		return m_clock.GetHostOffsetSec() < 1.0; // laser report time with computer's timestamp
 	}
 
-	uint64_t GetBufferSize() const override;
-
 private:
 	void DataThreadFunction();
 	void CallbackFrame(const LidarDecodedFrame<LidarPointXYZICRT>& dataFrame);
@@ -60,15 +35,13 @@ private:
 	void CallbackFault(const FaultMessageInfo& fault_message_info);
 
 	// Add any private members or methods if needed
-	mutable std::mutex m_bufferImuMutex;
-	mutable std::mutex m_bufferPointMutex;
-	LidarPointsBufferPtr m_bufferLidarPtr;
-	LidarIMUBufferPtr m_bufferIMUPtr;
 	std::thread m_watchThread;
 	std::atomic_bool isDone{false}; // Flag to control the data thread
 	std::atomic_int m_recivedPointMessages{0}; // Counter for received point messages
 	std::atomic_int m_recivedIMUMessages{0}; // Counter for received IMU messages
 	std::unique_ptr<HesaiLidarSdk<LidarPointXYZICRT>> m_lidar;
+	//! guards lidar state reported in frames and faults, written from SDK threads
+	mutable std::mutex m_stateMutex;
 	std::deque<FaultMessageInfo> m_faults;
 	int16_t m_lidar_state;
 	int16_t m_work_mode;
@@ -77,8 +50,6 @@ private:
 	std::string m_hardware_vers;
 	uint16_t m_laser_num;
 	uint16_t m_channel_num;
-	double m_timestamp;
-	double m_time_diff;
 };
 
 } // namespace mandeye
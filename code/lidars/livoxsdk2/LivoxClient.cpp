@@ -2,6 +2,7 @@
 #include "fstream"
 #include "livox_lidar_api.h"
 #include "livox_lidar_def.h"
+#include <algorithm>
 #include <iostream>
 #include <thread>
 
@@ -89,15 +90,16 @@ nlohmann::json LivoxClient::produceStatus()
 		data["counters"]["lidar"] = 0;
 	}
 
-	std::lock_guard<std::mutex> lcK1(m_bufferLidarMutex);
-	std::lock_guard<std::mutex> lcK2(m_bufferImuMutex);
-	data["LivoxLidarInfo"]["timestamp"] = m_timestamp;
-	data["LivoxLidarInfo"]["timestamp_s"] = double(m_timestamp) / 1e9;
-	data["LivoxLidarInfo"]["m_sessionStart"] = m_sessionStart.value_or(-1.f);
-	data["LivoxLidarInfo"]["m_sessionStart_s"] = double(m_sessionStart.value_or(-1.f)) / 1e9;
-	data["LivoxLidarInfo"]["m_elapsed"] = m_elapsed;
-	data["LivoxLidarInfo"]["m_elapsed_s"] = double(m_elapsed) / 1e9;
-	data["LivoxLidarInfo"]["m_time_diff"] = m_time_diff;
+	const uint64_t timestamp = m_clock.GetTimestampNs();
+	const uint64_t elapsed = m_clock.GetSessionElapsedNs();
+	data["LivoxLidarInfo"]["timestamp"] = timestamp;
+	data["LivoxLidarInfo"]["timestamp_s"] = double(timestamp) / 1e9;
+	data["LivoxLidarInfo"]["m_sessionStart"] = m_clock.HasSession() ? double(m_clock.GetSessionStartNs()) : -1.0;
+	data["LivoxLidarInfo"]["m_sessionStart_s"] = getSessionStart();
+	data["LivoxLidarInfo"]["m_elapsed"] = elapsed;
+	data["LivoxLidarInfo"]["m_elapsed_s"] = double(elapsed) / 1e9;
+	data["LivoxLidarInfo"]["m_time_diff"] = m_clock.GetHostOffsetSec();
+	data["clock"] = m_clock.produceStatus();
 	auto arrayworkMode = nlohmann::json::array();
 	for(auto& mode : m_LivoxLidarWorkMode)
 	{
@@ -124,9 +126,9 @@ nlohmann::json LivoxClient::produceStatus()
 	data["multi"]["timesyncmode"] = arrayTimeSync;
 
 	auto array = nlohmann::json::array();
-	for(auto& timestamp : m_handleToLastTimestamp)
+	for(size_t id = 0; id < std::min(m_serialNumbers.size(), MaxLidars); id++)
 	{
-		array.push_back(timestamp.second);
+		array.push_back(m_lidarIdToLastTimestamp[id].load(std::memory_order_relaxed));
 	}
 	data["multi"]["timestamps"] = array;
 
@@ -137,51 +139,19 @@ nlohmann::json LivoxClient::produceStatus()
 	}
 	data["multi"]["sn"] = arraysn;
 
-	if(m_bufferLivoxPtr)
+	if(m_lidarIngest.IsLogging())
 	{
-		data["buffers"]["point"]["counter"] = m_bufferLivoxPtr->size();
+		data["buffers"]["point"]["counter"] = m_lidarIngest.Size();
+		data["buffers"]["IMU"]["counter"] = m_imuIngest.Size();
 	}
 	else
 	{
 		data["buffers"]["point"]["counter"] = "NULL";
-	}
-	if(m_bufferIMUPtr)
-	{
-		data["buffers"]["IMU"]["counter"] = m_bufferIMUPtr->size();
-	}
-	else
-	{
 		data["buffers"]["IMU"]["counter"] = "NULL";
 	}
 	return data;
 }
 
-void LivoxClient::startLog()
-{
-	std::lock_guard<std::mutex> lcK1(m_bufferLidarMutex);
-	std::lock_guard<std::mutex> lcK2(m_bufferImuMutex);
-	m_bufferLivoxPtr = std::make_shared<LidarPointsBuffer>();
-	m_bufferIMUPtr = std::make_shared<LidarIMUBuffer>();
-}
-
-void LivoxClient::stopLog()
-{
-	std::lock_guard<std::mutex> lcK1(m_bufferLidarMutex);
-	std::lock_guard<std::mutex> lcK2(m_bufferImuMutex);
-	m_bufferLivoxPtr = nullptr;
-	m_bufferIMUPtr = nullptr;
-}
-
-std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr> LivoxClient::retrieveData()
-{
-	std::lock_guard<std::mutex> lck1(m_bufferLidarMutex);
-	std::lock_guard<std::mutex> lck2(m_bufferImuMutex);
-	LidarPointsBufferPtr returnPointerLidar{std::make_shared<LidarPointsBuffer>()};
-	LidarIMUBufferPtr returnPointerImu{std::make_shared<LidarIMUBuffer>()};
-	std::swap(m_bufferIMUPtr, returnPointerImu);
-	std::swap(m_bufferLivoxPtr, returnPointerLidar);
-	return std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr>(returnPointerLidar, returnPointerImu);
-}
 void LivoxClient::testThread()
 {
 	std::this_thread::sleep_for(std::chrono::milliseconds(1000));
@@ -238,23 +208,6 @@ union ToUint64
 	uint8_t array[8];
 };
 
-void LivoxClient::saveTimeStamp(LivoxClient* client, uint64_t timestamp)
-{
-	assert(client);
-	std::lock_guard<std::mutex> lcK(client->m_timestampMutex);
-	client->m_timestamp = timestamp;
-
-	if(client->m_sessionStart != std::nullopt)
-	{
-		client->m_elapsed = client->m_timestamp - client->m_sessionStart.value();
-	}
-	using namespace std::chrono;
-	const auto now = system_clock::now();
-	auto duration = now.time_since_epoch();
-	double tp = std::chrono::duration<double>(duration).count();
-	client->m_time_diff = std::abs(tp - double(client->m_timestamp) / 1e9);
-}
-
 void LivoxClient::PointCloudCallback(uint32_t handle, const uint8_t dev_type, LivoxLidarEthernetPacket* data, void* client_data)
 {
 	if(data == nullptr || client_data == nullptr)
@@ -263,6 +216,7 @@ void LivoxClient::PointCloudCallback(uint32_t handle, const uint8_t dev_type, Li
 	}
 
 	LivoxClient* this_ptr = (LivoxClient*)client_data;
+	this_ptr->registerCurrentThread(mandeye_utils::ThreadRole::Ingest);
 
 	this_ptr->m_recivedPointMessages[handle]++;
 	const auto laser_id = this_ptr->handleToLidarId(handle);
@@ -272,21 +226,21 @@ void LivoxClient::PointCloudCallback(uint32_t handle, const uint8_t dev_type, Li
 	if(data->data_type == kLivoxLidarCartesianCoordinateHighData)
 	{
 		LivoxLidarCartesianHighRawPoint* p_point_data = (LivoxLidarCartesianHighRawPoint*)data->data;
-		std::lock_guard<std::mutex> lcK(this_ptr->m_bufferLidarMutex);
 		ToUint64 toUint64;
 		std::memcpy(toUint64.array, data->timestamp, sizeof(uint64_t));
+		this_ptr->m_clock.Update(toUint64.data);
+		if(laser_id < MaxLidars)
 		{
-			const auto& timestamp = toUint64.data;
-			saveTimeStamp(this_ptr, timestamp);
-			this_ptr->m_handleToLastTimestamp[handle] = toUint64.data;
+			this_ptr->m_lidarIdToLastTimestamp[laser_id].store(toUint64.data, std::memory_order_relaxed);
 		}
 
-		if(this_ptr->m_bufferLivoxPtr == nullptr)
+		if(!this_ptr->m_lidarIngest.IsAccepting())
 		{
 			return;
 		}
-		auto& buffer = this_ptr->m_bufferLivoxPtr;
-		// buffer->resize(buffer->size() + data->dot_num);
+		// packet is converted without lock and appended in one batch
+		thread_local LidarPointsBuffer staged;
+		staged.reserve(data->dot_num);
 		for(uint32_t i = 0; i < data->dot_num; i++)
 		{
 			LidarPoint point;
@@ -299,9 +253,10 @@ void LivoxClient::PointCloudCallback(uint32_t handle, const uint8_t dev_type, Li
 				toUint64.data + static_cast<uint64_t>(i) * (double(data->time_interval * 100) / data->dot_num); //unit for interval is 0.1 us = 100 ns
 			if(point.timestamp > 0)
 			{
-				buffer->push_back(point);
+				staged.push_back(point);
 			}
 		}
+		this_ptr->m_lidarIngest.Flush(staged);
 	}
 	else if(data->data_type == kLivoxLidarCartesianCoordinateLowData)
 	{
@@ -344,6 +299,7 @@ void LivoxClient::ImuDataCallback(uint32_t handle, const uint8_t dev_type, Livox
 	auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration);
 
 	LivoxClient* this_ptr = (LivoxClient*)client_data;
+	this_ptr->registerCurrentThread(mandeye_utils::ThreadRole::Ingest);
 	// std::cout << "m_time_diff " <<this_ptr->m_time_diff << std::endl;
 
 	if(data->data_type == kLivoxLidarImuData)
@@ -351,17 +307,14 @@ void LivoxClient::ImuDataCallback(uint32_t handle, const uint8_t dev_type, Livox
 		const auto laser_id = this_ptr->handleToLidarId(handle);
 		this_ptr->m_recivedImuMsgs[handle]++;
 		LivoxLidarImuRawPoint* p_imu_data = (LivoxLidarImuRawPoint*)data->data;
-		std::lock_guard<std::mutex> lcK(this_ptr->m_bufferImuMutex);
 		ToUint64 toUint64;
 		std::memcpy(toUint64.array, data->timestamp, sizeof(uint64_t));
-		saveTimeStamp(this_ptr, toUint64.data);
+		this_ptr->m_clock.Update(toUint64.data);
 
-		if(this_ptr->m_bufferIMUPtr == nullptr)
+		if(!this_ptr->m_imuIngest.IsAccepting())
 		{
 			return;
 		}
-		auto& buffer = this_ptr->m_bufferIMUPtr;
-		// buffer->resize(buffer->size() + 1);
 		LidarIMU point;
 		point.acc_x = p_imu_data->acc_x;
 		point.acc_y = p_imu_data->acc_y;
@@ -375,7 +328,7 @@ void LivoxClient::ImuDataCallback(uint32_t handle, const uint8_t dev_type, Livox
 		point.epoch_time = millis.count();
 		if(point.timestamp > 0)
 		{
-			buffer->push_back(point);
+			this_ptr->m_imuIngest.Append(point);
 		}
 	}
 }
@@ -508,43 +461,12 @@ void LivoxClient::LidarInfoChangeCallback(const uint32_t handle, const LivoxLida
 		this_ptr->m_LivoxLidarInfo[handle] = *info;
 		this_ptr->m_recivedImuMsgs[handle] = 0;
 		this_ptr->m_recivedPointMessages[handle] = 0;
-		this_ptr->m_handleToLastTimestamp[handle] = 0;
 		const std::string sn(info->sn);
 		this_ptr->m_handleToSerialNumber[handle] = sn;
 		this_ptr->m_serialNumbers.insert(sn);
 		std::cout << " **** Adding lidar " << sn << " handle " << handle << std::endl;
 	}
 }
-double LivoxClient::getTimestamp()
-{
-	std::lock_guard<std::mutex> lcK(m_timestampMutex);
-	return double(m_timestamp) / 1e9;
-}
-
-double LivoxClient::getSessionDuration()
-{
-	std::lock_guard<std::mutex> lcK(m_timestampMutex);
-	return double(m_elapsed) / 1e9;
-}
-
-double LivoxClient::getSessionStart()
-{
-	std::lock_guard<std::mutex> lcK(m_timestampMutex);
-	if(m_sessionStart.has_value())
-	{
-		return double(*m_sessionStart) / 1e9;
-	}
-	return -1;
-}
-
-void LivoxClient::initializeDuration()
-{
-	std::lock_guard<std::mutex> lcK(m_timestampMutex);
-	if(m_sessionStart == std::nullopt)
-	{
-		m_sessionStart = m_timestamp;
-	}
-}
 
 std::unordered_map<uint32_t, std::string> LivoxClient::getSerialNumberToLidarIdMapping() const
 {
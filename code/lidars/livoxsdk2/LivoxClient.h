@@ -3,6 +3,8 @@
 #include "lidars/BaseLidarClient.h"
 #include "livox_lidar_def.h"
 #include "utils/TimeStampProvider.h"
+#include <array>
+#include <atomic>
 #include <deque>
 #include <mutex>
 #include <nlohmann/json.hpp>
@@ -20,43 +22,18 @@ public:
 	//! starts LivoxSDK2, interface is IP of listen interface (IP of network cards with Livox connected
 	bool startListener(const std::string& interfaceIp) override;
 
-	//! Start log to memory data from Lidar and IMU
-	void startLog() override;
-
-	//! Stops log to memory data from Lidar and IMU
-	void stopLog() override;
-
-	std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr> retrieveData() override;
-
 	//! Return current mapping from serial number to lidar id
 	std::unordered_map<uint32_t, std::string> getSerialNumberToLidarIdMapping() const override;
 
 	//! Returns if Lidar is synced (PPS or PTP)
 	bool isSynced() override;
 
-	// mandeye_utils::TimeStampProvider overrides ...
-	double getTimestamp() override;
-	double getSessionDuration() override;
-	double getSessionStart() override;
-	void initializeDuration() override;
 	// periodically ask lidars for status
 	void testThread();
 
 private:
 	bool isDone{false};
 	std::thread m_livoxWatchThread;
-	std::mutex m_bufferImuMutex;
-	std::mutex m_bufferLidarMutex;
-
-	LidarPointsBufferPtr m_bufferLivoxPtr{nullptr};
-	LidarIMUBufferPtr m_bufferIMUPtr{nullptr};
-
-	std::mutex m_timestampMutex;
-	uint64_t m_timestamp;
-	uint64_t m_elapsed;
-	std::optional<uint64_t> m_sessionStart;
-
-	static void saveTimeStamp(LivoxClient* client, uint64_t timestamp);
 	//! Multilovx support
 	mutable std::mutex m_lidarInfoMutex;
 	std::unordered_map<uint32_t, uint64_t> m_recivedImuMsgs;
@@ -65,9 +42,10 @@ private:
 	std::unordered_map<uint32_t, int32_t> m_LivoxLidarWorkMode;
 	std::unordered_map<uint32_t, int32_t> m_LivoxLidarTimeSync;
 
-	std::unordered_map<uint32_t, uint64_t> m_handleToLastTimestamp;
+	//! Last packet timestamp per lidar id, written from the receive thread without lock
+	static constexpr size_t MaxLidars = 16;
+	std::array<std::atomic<uint64_t>, MaxLidars> m_lidarIdToLastTimestamp{};
 	std::unordered_map<uint32_t, std::string> m_handleToSerialNumber;
-	double m_time_diff;
 	//! This is a set of serial numbers that we have already seen, its used to find lidarId
 	std::set<std::string> m_serialNumbers;
 
@@ -41,17 +41,12 @@ public:
 	std::thread m_dataThread;
 	std::atomic<bool> m_isDone{false};
 
-	// Data buffers
-	mutable std::mutex m_lidarBufferMutex;
-	mutable std::mutex m_imuBufferMutex;
-	LidarPointsBufferPtr m_lidarBuffer{nullptr};
-	LidarIMUBufferPtr m_imuBuffer{nullptr};
-
-	// Timestamps and session tracking
-	mutable std::mutex m_timestampMutex;
-	uint64_t m_currentTimestamp{0};
-	std::optional<uint64_t> m_sessionStart;
-	uint64_t m_sessionElapsed{0};
+	// Data buffers, owned by OusterClient
+	mandeye_utils::IngestBuffer<LidarPoint>* m_lidarIngest{nullptr};
+	mandeye_utils::IngestBuffer<LidarIMU>* m_imuIngest{nullptr};
+
+	// Timestamps and session tracking, owned by OusterClient
+	mandeye_utils::LidarClock* m_clock{nullptr};
 
 	// Statistics
 	mutable std::mutex m_statsMutex;
@@ -69,7 +64,6 @@ public:
 	// Private methods
 	void dataThreadFunction();
 	void processScan(const ouster::LidarScan& scan);
-	void updateTimestamp(uint64_t timestamp);
 };
 
 OusterClientImpl::OusterClientImpl()
@@ -88,7 +82,11 @@ OusterClientImpl::~OusterClientImpl()
 
 OusterClient::OusterClient()
 	: m_impl(std::make_unique<OusterClientImpl>())
-{ }
+{
+	m_impl->m_lidarIngest = &m_lidarIngest;
+	m_impl->m_imuIngest = &m_imuIngest;
+	m_impl->m_clock = &m_clock;
+}
 
 OusterClient::~OusterClient()
 {
@@ -157,37 +155,27 @@ nlohmann::json OusterClient::produceStatus()
 
 	// Timestamp information
 	{
-		std::lock_guard<std::mutex> lock(m_impl->m_timestampMutex);
-		status["timestamp"] = m_impl->m_currentTimestamp;
-		status["timestamp_s"] = double(m_impl->m_currentTimestamp) / 1e9;
-		status["session_start"] = m_impl->m_sessionStart.value_or(-1);
-		status["session_start_s"] = m_impl->m_sessionStart.has_value() ? double(*m_impl->m_sessionStart) / 1e9 : -1.0;
-		status["session_elapsed"] = m_impl->m_sessionElapsed;
-		status["session_elapsed_s"] = double(m_impl->m_sessionElapsed) / 1e9;
+		const uint64_t timestamp = m_clock.GetTimestampNs();
+		const uint64_t elapsed = m_clock.GetSessionElapsedNs();
+		status["timestamp"] = timestamp;
+		status["timestamp_s"] = double(timestamp) / 1e9;
+		status["session_start"] = m_clock.HasSession() ? double(m_clock.GetSessionStartNs()) : -1.0;
+		status["session_start_s"] = getSessionStart();
+		status["session_elapsed"] = elapsed;
+		status["session_elapsed_s"] = double(elapsed) / 1e9;
+		status["clock"] = m_clock.produceStatus();
 	}
 
 	// Buffer status
+	if(m_lidarIngest.IsLogging())
 	{
-		std::lock_guard<std::mutex> lidarLock(m_impl->m_lidarBufferMutex);
-		std::lock_guard<std::mutex> imuLock(m_impl->m_imuBufferMutex);
-
-		if(m_impl->m_lidarBuffer)
-		{
-			status["buffers"]["lidar"]["count"] = m_impl->m_lidarBuffer->size();
-		}
-		else
-		{
-			status["buffers"]["lidar"]["count"] = "NULL";
-		}
-
-		if(m_impl->m_imuBuffer)
-		{
-			status["buffers"]["imu"]["count"] = m_impl->m_imuBuffer->size();
-		}
-		else
-		{
-			status["buffers"]["imu"]["count"] = "NULL";
-		}
+		status["buffers"]["lidar"]["count"] = m_lidarIngest.Size();
+		status["buffers"]["imu"]["count"] = m_imuIngest.Size();
+	}
+	else
+	{
+		status["buffers"]["lidar"]["count"] = "NULL";
+		status["buffers"]["imu"]["count"] = "NULL";
 	}
 
 	return status;
@@ -200,7 +188,10 @@ bool OusterClient::startListener(const std::string& interfaceIp)
 
 		// Start data processing thread
 		m_impl->m_isDone = false;
-		m_impl->m_dataThread = std::thread(&OusterClientImpl::dataThreadFunction, m_impl.get());
+		m_impl->m_dataThread = std::thread([this]() {
+			registerCurrentThread(mandeye_utils::ThreadRole::Ingest);
+			m_impl->dataThreadFunction();
+		});
 
 		std::this_thread::sleep_for(std::chrono::seconds(5)); // Allow some time for the thread to start
 		if(!m_impl->m_initSuccess)
@@ -217,45 +208,6 @@ bool OusterClient::startListener(const std::string& interfaceIp)
 	}
 }
 
-void OusterClient::startLog()
-{
-	assert(m_impl);
-	std::lock_guard<std::mutex> lidarLock(m_impl->m_lidarBufferMutex);
-	std::lock_guard<std::mutex> imuLock(m_impl->m_imuBufferMutex);
-
-	m_impl->m_lidarBuffer = std::make_shared<LidarPointsBuffer>();
-	m_impl->m_imuBuffer = std::make_shared<LidarIMUBuffer>();
-
-	std::cout << "Started Ouster data logging" << std::endl;
-}
-
-void OusterClient::stopLog()
-{
-	assert(m_impl);
-	std::lock_guard<std::mutex> lidarLock(m_impl->m_lidarBufferMutex);
-	std::lock_guard<std::mutex> imuLock(m_impl->m_imuBufferMutex);
-
-	m_impl->m_lidarBuffer = nullptr;
-	m_impl->m_imuBuffer = nullptr;
-
-	std::cout << "Stopped Ouster data logging" << std::endl;
-}
-
-std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr> OusterClient::retrieveData()
-{
-	assert(m_impl);
-	std::lock_guard<std::mutex> lidarLock(m_impl->m_lidarBufferMutex);
-	std::lock_guard<std::mutex> imuLock(m_impl->m_imuBufferMutex);
-
-	LidarPointsBufferPtr returnLidarBuffer = std::make_shared<LidarPointsBuffer>();
-	LidarIMUBufferPtr returnImuBuffer = std::make_shared<LidarIMUBuffer>();
-
-	std::swap(m_impl->m_lidarBuffer, returnLidarBuffer);
-	std::swap(m_impl->m_imuBuffer, returnImuBuffer);
-
-	return {returnLidarBuffer, returnImuBuffer};
-}
-
 std::unordered_map<uint32_t, std::string> OusterClient::getSerialNumberToLidarIdMapping() const
 {
 	assert(m_impl);
@@ -263,41 +215,6 @@ std::unordered_map<uint32_t, std::string> OusterClient::getSerialNumberToLidarId
 	return m_impl->m_sensorIdToSerial;
 }
 
-double OusterClient::getTimestamp()
-{
-	assert(m_impl);
-	std::lock_guard<std::mutex> lock(m_impl->m_timestampMutex);
-	return double(m_impl->m_currentTimestamp) / 1e9;
-}
-
-double OusterClient::getSessionDuration()
-{
-	assert(m_impl);
-	std::lock_guard<std::mutex> lock(m_impl->m_timestampMutex);
-	return double(m_impl->m_sessionElapsed) / 1e9;
-}
-
-double OusterClient::getSessionStart()
-{
-	assert(m_impl);
-	std::lock_guard<std::mutex> lock(m_impl->m_timestampMutex);
-	if(m_impl->m_sessionStart.has_value())
-	{
-		return double(*m_impl->m_sessionStart) / 1e9;
-	}
-	return -1.0;
-}
-
-void OusterClient::initializeDuration()
-{
-	assert(m_impl);
-	std::lock_guard<std::mutex> lock(m_impl->m_timestampMutex);
-	if(!m_impl->m_sessionStart.has_value())
-	{
-		m_impl->m_sessionStart = m_impl->m_currentTimestamp;
-	}
-}
-
 void OusterClientImpl::dataThreadFunction()
 {
 	std::cout << "Ouster data thread started" << std::endl;
@@ -397,13 +314,15 @@ void OusterClientImpl::dataThreadFunction()
 				const auto& ip = static_cast<ouster::sensor::ImuPacket&>(p.packet());
 
 				// Update timestamp from IMU
-				updateTimestamp(ip.accel_ts());
+				m_clock->Update(ip.accel_ts());
 
 				// Process IMU data if logging is active
 				{
-					m_imu_packets_received[p.source]++;
-					std::lock_guard<std::mutex> lock(m_imuBufferMutex);
-					if(m_imuBuffer)
+					{
+						std::lock_guard<std::mutex> lock(m_statsMutex);
+						m_imu_packets_received[p.source]++;
+					}
+					if(m_imuIngest->IsAccepting())
 					{
 						LidarIMU imuData{};
 
@@ -416,7 +335,7 @@ void OusterClientImpl::dataThreadFunction()
 						imuData.gyro_z = M_PI * static_cast<float>(ip.av_z()) / 180.0f;
 						imuData.laser_id = static_cast<uint16_t>(p.source);
 						imuData.epoch_time = ip.accel_ts();
-						m_imuBuffer->emplace_back(imuData);
+						m_imuIngest->Append(imuData);
 					}
 				}
 			}
@@ -427,7 +346,7 @@ void OusterClientImpl::dataThreadFunction()
 				const auto& lp = static_cast<ouster::sensor::LidarPacket&>(p.packet());
 
 				// Update timestamp from Lidar
-				updateTimestamp(lp.col_timestamp(lp.nth_col(0)));
+				m_clock->Update(lp.col_timestamp(lp.nth_col(0)));
 
 				// Add the packet to the batch
 				if(m_batchers[p.source](lp, *m_scans[p.source]))
@@ -459,10 +378,9 @@ void OusterClientImpl::dataThreadFunction()
 
 void OusterClientImpl::processScan(const ouster::LidarScan& scan)
 {
-	std::lock_guard<std::mutex> lock(m_lidarBufferMutex);
-	if(!m_lidarBuffer)
+	if(!m_lidarIngest->IsAccepting())
 	{
-		return; // Not logging
+		return; // Not logging, no preview
 	}
 
 	// Find the source index for this scan
@@ -487,6 +405,9 @@ void OusterClientImpl::processScan(const ouster::LidarScan& scan)
 	}
 
 	const Eigen::Affine3d& transform = m_lidarToSensorTransforms[sourceIndex];
+	// scan is converted without lock and appended in one batch
+	thread_local LidarPointsBuffer staged;
+	staged.reserve(cloud.rows());
 	// Process each point
 	for(size_t i = 0; i < static_cast<size_t>(cloud.rows()); i++)
 	{
@@ -517,20 +438,9 @@ void OusterClientImpl::processScan(const ouster::LidarScan& scan)
 			point.intensity = reflectivityField->coeff(row, column);
 		}
 
-		m_lidarBuffer->push_back(point);
-	}
-}
-
-void OusterClientImpl::updateTimestamp(uint64_t timestamp)
-{
-	std::lock_guard<std::mutex> lock(m_timestampMutex);
-
-	m_currentTimestamp = timestamp;
-
-	if(m_sessionStart.has_value())
-	{
-		m_sessionElapsed = m_currentTimestamp - *m_sessionStart;
+		staged.push_back(point);
 	}
+	m_lidarIngest->Flush(staged);
 }
 
 } // namespace mandeye
\ No newline at end of file
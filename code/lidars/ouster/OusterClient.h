@@ -25,21 +25,12 @@ public:
 	void Init(const nlohmann::json& config) override;
 	nlohmann::json produceStatus() override;
 	bool startListener(const std::string& interfaceIp) override;
-	void startLog() override;
-	void stopLog() override;
 	bool isSynced() override
 	{
 		return false;
 	}
-	std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr> retrieveData() override;
 	std::unordered_map<uint32_t, std::string> getSerialNumberToLidarIdMapping() const override;
 
-	// TimeStampProvider overrides
-	double getTimestamp() override;
-	double getSessionDuration() override;
-	double getSessionStart() override;
-	void initializeDuration() override;
-
 private:
 	// Use PIMPL pattern to hide OusterSDK dependencies
 	std::unique_ptr<OusterClientImpl> m_impl;
@@ -16,8 +16,8 @@ nlohmann::json SickClient::produceStatus()
 	data["SickLidar"]["status"]["is_done"] = isDone.load(); // Current status of the data thread
 	data["counters"]["lidar"] = m_recivedPointMessages.load(); // Number of received point messages
 	data["counters"]["imu"] = m_recivedImuMessages.load();
-	data["SickLidar"]["status"]["buffer_lidar_size"] = m_bufferLidarPtr ? m_bufferLidarPtr->size() : 0;
-	data["SickLidar"]["status"]["buffer_imu_size"] = m_bufferIMUPtr ? m_bufferIMUPtr->size() : 0;
+	data["SickLidar"]["status"]["buffer_lidar_size"] = m_lidarIngest.Size();
+	data["SickLidar"]["status"]["buffer_imu_size"] = m_imuIngest.Size();
 	data["SickLidar"]["status"]["api_status"] = m_apiStatus;
 	data["SickLidar"]["status"]["api_status_message"] = m_apiStatusMessage;
 	return data;
@@ -63,7 +63,6 @@ bool SickClient::startListener(const std::string& interfaceIp)
 	SickScanApiRegisterCartesianPointCloudMsg(m_apiHandle, &SickClient::customizedPointCloudMsgCb);
 	SickScanApiRegisterImuMsg(m_apiHandle, &SickClient::imuCallback);
 
-	std::lock_guard<std::mutex> lock(m_bufferMutex);
 	// Simulate starting the listener
 	m_watchThread = std::thread(&SickClient::DataThreadFunction, this);
 	// wait 10 seconds for the API to initialize
@@ -102,10 +101,10 @@ void SickClient::imuCallback(SickScanApiHandle apiHandle, const SickScanImuMsg*
 	SickClient* instance = GetInstanceFromHandle(apiHandle);
 	if(instance)
 	{
+		instance->registerCurrentThread(mandeye_utils::ThreadRole::Ingest);
 		instance->m_recivedImuMessages.fetch_add(1);
 		// Here you can also add the IMU data to the buffer if needed
-		std::lock_guard<std::mutex> lock(instance->m_bufferMutex);
-		if(instance->m_bufferIMUPtr)
+		if(instance->m_imuIngest.IsAccepting())
 		{
 			LidarIMU imuData;
 			imuData.timestamp = ts;
@@ -120,7 +119,7 @@ void SickClient::imuCallback(SickScanApiHandle apiHandle, const SickScanImuMsg*
 			auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch());
 
 			imuData.epoch_time = millis.count();
-			instance->m_bufferIMUPtr->emplace_back(imuData);
+			instance->m_imuIngest.Append(imuData);
 		}
 	}
 	else
@@ -153,6 +152,7 @@ void SickClient::customizedPointCloudMsgCb(SickScanApiHandle apiHandle, const Si
 		std::cerr << "SickClient: Instance not found for apiHandle" << std::endl;
 		return;
 	}
+	instance->registerCurrentThread(mandeye_utils::ThreadRole::Ingest);
 //#define DEV
 #ifdef DEV
 	for(int i = 0; i < msg->fields.size; i++)
@@ -164,7 +164,7 @@ void SickClient::customizedPointCloudMsgCb(SickScanApiHandle apiHandle, const Si
 #endif
 	// log for debugging
 	instance->m_recivedPointMessages++;
-	if(instance->m_bufferLidarPtr)
+	if(instance->m_lidarIngest.IsAccepting())
 	{
 		int offsetX = -1;
 		int offsetY = -1;
@@ -216,6 +216,9 @@ void SickClient::customizedPointCloudMsgCb(SickScanApiHandle apiHandle, const Si
 		assert(offsetLidarNsec >= 0);
 		assert(offsetLidarSec >= 0);
 
+		// message is converted without lock and appended in one batch
+		thread_local LidarPointsBuffer staged;
+		staged.reserve(size_t(msg->height) * msg->width);
 		for(int rowId = 0; rowId < msg->height; rowId++)
 		{
 			const uint32_t rowOffset = rowId * msg->row_step;
@@ -240,48 +243,13 @@ void SickClient::customizedPointCloudMsgCb(SickScanApiHandle apiHandle, const Si
 				point.intensity = i;
 				point.timestamp = uint64_t(lidar_sec) * 1e9 + lidar_nsec; // Convert to nanoseconds
 				point.laser_id = 0;
-
-				std::lock_guard<std::mutex> lock(instance->m_bufferMutex);
-				instance->m_bufferLidarPtr->emplace_back(point);
+				staged.push_back(point);
 			}
 		}
+		instance->m_lidarIngest.Flush(staged);
 	}
 }
 
-void SickClient::startLog()
-{
-	std::cout << "SickClient: startLog called" << std::endl;
-	// Initialize buffers
-	std::lock_guard<std::mutex> lock(m_bufferMutex);
-	m_bufferLidarPtr = std::make_shared<LidarPointsBuffer>();
-	m_bufferIMUPtr = std::make_shared<LidarIMUBuffer>();
-	// Simulate starting log
-	std::cout << "SickClient: Logging started" << std::endl;
-}
-
-void SickClient::stopLog()
-{
-	std::lock_guard<std::mutex> lock(m_bufferMutex);
-	// Stop the data thread
-	m_bufferLidarPtr.reset();
-	m_bufferIMUPtr.reset();
-	std::cout << "SickLidar: stopLog called" << std::endl;
-}
-
-std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr> SickClient::retrieveData()
-{
-	std::cout << "SickLidar: retrieveData called" << std::endl;
-	// Return empty buffers for now
-
-	std::lock_guard<std::mutex> lock(m_bufferMutex);
-
-	LidarPointsBufferPtr returnPointerLidar{std::make_shared<LidarPointsBuffer>()};
-	LidarIMUBufferPtr returnPointerImu{std::make_shared<LidarIMUBuffer>()};
-	std::swap(m_bufferIMUPtr, returnPointerImu);
-	std::swap(m_bufferLidarPtr, returnPointerLidar);
-	return std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr>(returnPointerLidar, returnPointerImu);
-}
-
 void SickClient::DataThreadFunction()
 {
 	std::cout << "SickLidar: DataThreadFunction started" << std::endl;
@@ -25,14 +25,6 @@ public:
 
 	void stopListener() override;
 
-	//! Start log to memory data from Lidar and IMU
-	void startLog() override;
-
-	//! Stops log to memory data from Lidar and IMU
-	void stopLog() override;
-
-	std::pair<LidarPointsBufferPtr, LidarIMUBufferPtr> retrieveData() override;
-
 	// TimestampProvider overrides ...
 	double getTimestamp() override
 	{
@@ -59,9 +51,6 @@ private:
 	static void imuCallback(SickScanApiHandle apiHandle, const SickScanImuMsg* msg);
 	static SickClient* GetInstanceFromHandle(SickScanApiHandle apiHandle);
 	// Add any private members or methods if needed
-	std::mutex m_bufferMutex;
-	LidarPointsBufferPtr m_bufferLidarPtr;
-	LidarIMUBufferPtr m_bufferIMUPtr;
 	std::thread m_watchThread;
 	std::atomic_bool isDone{false}; // Flag to control the data thread
 	std::atomic_int m_recivedPointMessages{0}; // Counter for received point messages
@@ -1,10 +1,22 @@
 
+#include <algorithm>
 #include <chrono>
 #include <nlohmann/json.hpp>
+#include <future>
 #include <ostream>
 #include <stdint.h>
 #include <thread>
 
+#include "ChunkWriter.h"
+#include "DownloadServer.h"
+#include "EventQueue.h"
+#include "PreviewStream.h"
+#include "RecordingTimePredictor.h"
+#include "ShmStream.h"
+#include "SpoolMigrator.h"
+#include "StatusAggregator.h"
+#include "StatusPushServer.h"
+#include "pointcloud_writers.h"
 #include "save_data.h"
 #include "save_laz.h"
 #include "state.h"
@@ -12,6 +24,8 @@
 
 #include "lidars/BaseLidarClient.h"
 #include "lidars/LidarImplementations.h"
+#include "utils/Metrics.h"
+#include "utils/ThreadRoles.h"
 
 #include "compilation_constants.h"
 #include "gnss.h"
@@ -46,15 +60,30 @@ std::shared_ptr<BaseLidarClient> lidarClientPtr;
 std::shared_ptr<GNSSClient> gnssClientPtr;
 
 std::shared_ptr<FileSystemClient> fileSystemClientPtr;
+std::shared_ptr<SpoolMigrator> spoolMigratorPtr;
+std::shared_ptr<PointcloudCodecSelector> codecSelectorPtr;
 std::shared_ptr<Publisher> publisherPtr;
+std::shared_ptr<ChunkWriter> chunkWriterPtr;
+std::shared_ptr<PreviewStream> previewStreamPtr;
+std::shared_ptr<ShmStream> shmStreamPtr;
+std::shared_ptr<DownloadServer> downloadServerPtr;
+std::shared_ptr<StatusPushServer> statusPushServerPtr;
+std::shared_ptr<RecordingTimePredictor> recordingTimePredictorPtr;
 mandeye::LazStats lastFileSaveStats; // updated by savePointcloudData return value
+std::mutex lastFileSaveStatsLock;
 double usbWriteSpeed10Mb = 0.0;
 double usbWriteSpeed1Mb = 0.0;
 
 bool disableBuzzer = false;
+//! the .gnss text file is written next to the binary .gnsb log, "gnss_log": {"csv": false} leaves it out
+bool saveGnssCsv = true;
 std::string lidarSDKToUse;
 nlohmann::json configJson;
-mandeye::States app_state{mandeye::States::WAIT_FOR_RESOURCES};
+//! written only by the state machine thread, other threads push events to the event queue
+std::atomic<mandeye::States> app_state{mandeye::States::WAIT_FOR_RESOURCES};
+EventQueue eventQueue;
+//! serves /status from snapshots, declared after the globals its sources read
+StatusAggregator statusAggregator;
 
 using json = nlohmann::json;
 
@@ -100,66 +129,171 @@ MemInfo readMemInfo()
 	return info;
 }
 
-std::string produceReport(bool reportUSB = true)
+//! Registers sections of the HTTP status, each refreshed on a period matching how fast it changes
+void addStatusSources()
 {
-	json j;
-	j["name"] = "Mandeye";
-	j["hash"] = GIT_HASH;
-	j["version"] = MANDEYE_VERSION;
-	j["hardware"] = MANDEYE_HARDWARE_HEADER;
-	j["arch"] = SYSTEM_ARCH;
-	j["lidar_sdk"] = lidarSDKToUse;
-	j["buzzer"] = !disableBuzzer;
-	j["state"] = StatesToString.at(app_state);
-
-	j["cpu_temp_c"] = readCpuTemperature();
-	const auto mem = readMemInfo();
-	j["mem_total_mb"] = mem.total_mb;
-	j["mem_available_mb"] = mem.available_mb;
-	j["mem_used_mb"] = mem.total_mb - mem.available_mb;
-	j["swap_total_mb"] = mem.swap_total_mb;
-	j["swap_used_mb"] = mem.swap_total_mb - mem.swap_free_mb;
-	if(lidarClientPtr)
-	{
-		j["lidar"] = lidarClientPtr->produceStatus();
-	}
-	else
-	{
-		j["lidar"] = {};
-	}
-
-	if(gpioClientPtr)
-	{
-		j["gpio"] = gpioClientPtr->produceStatus();
-	}
-	j["fs_benchmark"]["write_speed_10mb"] = std::round(usbWriteSpeed10Mb * 100) / 100.0;
-	j["fs_benchmark"]["write_speed_1mb"] = std::round(usbWriteSpeed1Mb * 100) / 100.0;
-
-	if(fileSystemClientPtr && reportUSB)
-	{
-		j["fs"] = fileSystemClientPtr->produceStatus();
-	}
-	if(gnssClientPtr)
-	{
-		j["gnss"] = gnssClientPtr->produceStatus();
-	}
-	else
-	{
-		j["gnss"] = {};
-	}
-
-	j["lastLazStatus"] = lastFileSaveStats.produceStatus();
+	using namespace std::chrono_literals;
+	statusAggregator.AddSource("static", 1h, []() {
+		json j;
+		j["name"] = "Mandeye";
+		j["hash"] = GIT_HASH;
+		j["version"] = MANDEYE_VERSION;
+		j["hardware"] = MANDEYE_HARDWARE_HEADER;
+		j["arch"] = SYSTEM_ARCH;
+		j["lidar_sdk"] = lidarSDKToUse;
+		j["buzzer"] = !disableBuzzer;
+		return j;
+	});
+	statusAggregator.AddSource("state", 250ms, []() {
+		json j;
+		j["state"] = StatesToString.at(app_state);
+		return j;
+	});
+	statusAggregator.AddSource("system", 2s, []() {
+		json j;
+		j["cpu_temp_c"] = readCpuTemperature();
+		const auto mem = readMemInfo();
+		j["mem_total_mb"] = mem.total_mb;
+		j["mem_available_mb"] = mem.available_mb;
+		j["mem_used_mb"] = mem.total_mb - mem.available_mb;
+		j["swap_total_mb"] = mem.swap_total_mb;
+		j["swap_used_mb"] = mem.swap_total_mb - mem.swap_free_mb;
+		return j;
+	});
+	statusAggregator.AddSource("lidar", 500ms, []() {
+		json j;
+		if(lidarClientPtr)
+		{
+			j["lidar"] = lidarClientPtr->produceStatus();
+			j["lidar_buffers"] = lidarClientPtr->produceIngestStatus();
+		}
+		else
+		{
+			j["lidar"] = {};
+		}
+		return j;
+	});
+	statusAggregator.AddSource("gnss", 1s, []() {
+		json j;
+		if(gnssClientPtr)
+		{
+			j["gnss"] = gnssClientPtr->produceStatus();
+		}
+		else
+		{
+			j["gnss"] = {};
+		}
+		return j;
+	});
+	statusAggregator.AddSource("storage", 1s, []() {
+		json j;
+		j["fs_benchmark"]["write_speed_10mb"] = std::round(usbWriteSpeed10Mb * 100) / 100.0;
+		j["fs_benchmark"]["write_speed_1mb"] = std::round(usbWriteSpeed1Mb * 100) / 100.0;
+		{
+			std::lock_guard<std::mutex> lck(lastFileSaveStatsLock);
+			j["lastLazStatus"] = lastFileSaveStats.produceStatus();
+		}
+		if(spoolMigratorPtr)
+		{
+			j["spool"] = spoolMigratorPtr->produceStatus();
+		}
+		if(codecSelectorPtr)
+		{
+			j["pointcloud_codec"] = codecSelectorPtr->produceStatus();
+		}
+		if(chunkWriterPtr)
+		{
+			j["chunk_writer"] = chunkWriterPtr->produceStatus();
+		}
+		if(fileSystemClientPtr)
+		{
+			j["storage_benchmark"] = fileSystemClientPtr->GetStorageBenchmarkStatus();
+		}
+		if(recordingTimePredictorPtr)
+		{
+			j["recording_time"] = recordingTimePredictorPtr->produceStatus();
+		}
+		return j;
+	});
+	statusAggregator.AddSource("streams", 1s, []() {
+		json j;
+		if(gpioClientPtr)
+		{
+			j["gpio"] = gpioClientPtr->produceStatus();
+		}
+		if(publisherPtr)
+		{
+			j["publisher"] = publisherPtr->produceStatus();
+		}
+		if(previewStreamPtr)
+		{
+			j["preview"] = previewStreamPtr->produceStatus();
+		}
+		if(shmStreamPtr)
+		{
+			j["shm"] = shmStreamPtr->produceStatus();
+		}
+		if(downloadServerPtr)
+		{
+			j["download"] = downloadServerPtr->produceStatus();
+		}
+		if(statusPushServerPtr)
+		{
+			j["status_push"] = statusPushServerPtr->produceStatus();
+		}
+		j["threads"] = mandeye_utils::produceThreadPlanStatus();
+		j["events"] = eventQueue.produceStatus();
+		return j;
+	});
+	// walks the USB drive, only in /status_full
+	statusAggregator.AddSource(
+		"fs",
+		10s,
+		[]() {
+			json j;
+			if(fileSystemClientPtr)
+			{
+				j["fs"] = fileSystemClientPtr->produceStatus();
+			}
+			return j;
+		},
+		true);
+	statusAggregator.AddSource(
+		"status_aggregator", 5s, []() { return json{{"status_aggregator", statusAggregator.produceStatus()}}; }, true);
+}
 
-	std::ostringstream s;
-	s << std::setw(4) << j;
-	return s.str();
+//! Gauges of /metrics that are read on scrape, hot paths update their metrics themselves
+void addMetricsCollectors()
+{
+	auto& registry = mandeye_utils::metrics::Registry::Instance();
+	auto& cpuTemperature = registry.AddGauge("mandeye_cpu_temperature_celsius", "CPU temperature");
+	auto& memAvailable = registry.AddGauge("mandeye_memory_available_bytes", "Memory available");
+	auto& usbWriteSpeed = registry.AddGauge("mandeye_usb_write_speed_mb_s", "USB write speed measured at start (10 MB file)");
+	auto& bufferBytes = registry.AddGauge("mandeye_ingest_buffer_bytes", "Lidar points waiting for the next chunk", "stream=\"lidar\"");
+	auto& spoolBacklog = registry.AddGauge("mandeye_spool_backlog_bytes", "Bytes waiting for migration from spool");
+	auto& state = registry.AddGauge("mandeye_state", "State machine state (value of mandeye::States)");
+	registry.AddCollector([&]() {
+		cpuTemperature.Set(readCpuTemperature());
+		memAvailable.Set(double(readMemInfo().available_mb) * 1024 * 1024);
+		usbWriteSpeed.Set(usbWriteSpeed10Mb);
+		state.Set(static_cast<int>(app_state.load()));
+		if(lidarClientPtr)
+		{
+			// atomic published by the ingest threads, the scrape does not take the ingest lock
+			bufferBytes.Set(double(lidarClientPtr->GetBufferSize()) * sizeof(LidarPoint));
+		}
+		if(spoolMigratorPtr)
+		{
+			spoolBacklog.Set(spoolMigratorPtr->GetBacklogBytes());
+		}
+	});
 }
 
 bool StartScan()
 {
 	if(app_state == States::IDLE || app_state == States::STOPPED)
 	{
-		app_state = States::STARTING_SCAN;
+		eventQueue.Push(Events::START_SCAN);
 		return true;
 	}
 	return false;
@@ -168,7 +302,7 @@ bool StopScan()
 {
 	if(app_state == States::SCANNING)
 	{
-		app_state = States::STOPPING;
+		eventQueue.Push(Events::STOP_SCAN);
 		return true;
 	}
 	return false;
@@ -180,7 +314,19 @@ bool TriggerStopScan()
 {
 	if(app_state == States::IDLE || app_state == States::STOPPED)
 	{
-		app_state = States::STARTING_STOP_SCAN;
+		eventQueue.Push(Events::TRIGGER_STOP_SCAN);
+		return true;
+	}
+	return false;
+}
+
+bool TriggerContinousScanning()
+{
+	const States state = app_state;
+	if(state == States::IDLE || state == States::STOPPED || state == States::SCANNING || state == States::STOPPING_STAGE_1 ||
+	   state == States::STOPPING_STAGE_2)
+	{
+		eventQueue.Push(Events::TRIGGER_CONTINOUS_SCANNING);
 		return true;
 	}
 	return false;
@@ -191,7 +337,8 @@ std::chrono::steady_clock::time_point stoppingStage1StartDeadlineChangeLed;
 std::chrono::steady_clock::time_point stoppingStage2StartDeadline;
 std::chrono::steady_clock::time_point stoppingStage2StartDeadlineChangeLed;
 
-bool TriggerContinousScanning()
+//! Continous scanning button, a single click starts scanning, three clicks within 2 seconds stop it
+void HandleContinousScanningButton()
 {
 	if(app_state == States::IDLE || app_state == States::STOPPED)
 	{
@@ -203,21 +350,18 @@ bool TriggerContinousScanning()
 		}
 
 		app_state = States::STARTING_SCAN;
-		return true;
 	}
 	else if(app_state == States::SCANNING)
 	{
 #ifdef MANDEYE_COUNTINOUS_SCANNING_STOP_1_CLICK
 		app_state = States::STOPPING;
-		return true;
+		return;
 #endif //MANDEYE_COUNTINOUS_SCANNING_STOP_1_CLICK
 		app_state = States::STOPPING_STAGE_1;
 		//stoppingStage1Start = std::chrono::steady_clock::now();
 		stoppingStage1StartDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(2000);
 
 		stoppingStage1StartDeadlineChangeLed = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
-
-		return true;
 	}
 	else if(app_state == States::STOPPING_STAGE_1)
 	{
@@ -233,8 +377,6 @@ bool TriggerContinousScanning()
 
 			app_state = States::STOPPING_STAGE_2;
 		}
-
-		return true;
 	}
 	else if(app_state == States::STOPPING_STAGE_2)
 	{
@@ -243,12 +385,45 @@ bool TriggerContinousScanning()
 		{
 			app_state = States::STOPPING;
 		}
-		return true;
 	}
-	return false;
 }
 
-void saveStatusData(const std::string& directory, int chunk)
+//! Applies event to the state, called from the state machine thread only
+void HandleEvent(Events event)
+{
+	switch(event)
+	{
+	case Events::START_SCAN:
+		if(app_state == States::IDLE || app_state == States::STOPPED)
+		{
+			app_state = States::STARTING_SCAN;
+		}
+		break;
+	case Events::STOP_SCAN:
+		if(app_state == States::SCANNING)
+		{
+			app_state = States::STOPPING;
+		}
+		break;
+	case Events::TRIGGER_STOP_SCAN:
+		if(app_state == States::IDLE || app_state == States::STOPPED)
+		{
+			app_state = States::STARTING_STOP_SCAN;
+		}
+		break;
+	case Events::TRIGGER_CONTINOUS_SCANNING:
+		HandleContinousScanningButton();
+		break;
+	case Events::WRITER_ERROR:
+		app_state = States::USB_IO_ERROR;
+		break;
+	default:
+		// other events only wake up the state machine
+		break;
+	}
+}
+
+std::string saveStatusData(const std::string& directory, int chunk)
 {
 	using namespace std::chrono_literals;
 	char statusName[256];
@@ -256,21 +431,123 @@ void saveStatusData(const std::string& directory, int chunk)
 	std::filesystem::path lidarFilePath = std::filesystem::path(directory) / std::filesystem::path(statusName);
 	std::cout << "Savig status to " << lidarFilePath << std::endl;
 	std::ofstream lidarStream(lidarFilePath);
-	lidarStream << produceReport(false);
-	system("sync");
+	lidarStream << statusAggregator.GetSnapshot(false)->body;
+	closeOrThrow(lidarStream, lidarFilePath);
+	syncFileSystem();
+	return lidarFilePath.string();
+}
+
+//! Returns directory where chunk should be written, with two-tier storage it is a spool counterpart of the repository directory
+std::string GetChunkDirectory(const std::string& repositoryDirectory)
+{
+	if(spoolMigratorPtr)
+	{
+		const std::string spoolDirectory = spoolMigratorPtr->GetSpoolDirectory(repositoryDirectory);
+		if(!spoolDirectory.empty())
+		{
+			return spoolDirectory;
+		}
+	}
+	return repositoryDirectory;
+}
+
+//! Schedules background migration of a saved chunk from the spool to the repository
+void MigrateChunk(const std::string& chunkDirectory, const std::string& repositoryDirectory)
+{
+	if(spoolMigratorPtr && chunkDirectory != repositoryDirectory)
+	{
+		spoolMigratorPtr->EnqueueDirectory(chunkDirectory);
+	}
+}
+
+//! Saves point cloud chunk with the codec picked by the codec selector and records it in the session index
+//! @returns paths of the saved files, throws std::runtime_error if saving failed
+std::vector<std::string> savePointcloudChunk(LidarPointsBufferPtr buffer, const std::string& chunkDirectory, nlohmann::json& sessionIndex, int chunk)
+{
+	const std::string codec = codecSelectorPtr ? codecSelectorPtr->select(buffer->size()) : "laz";
+	const auto [fn, saveStats] = savePointcloudData(buffer, chunkDirectory, chunk, codec);
+	{
+		std::lock_guard<std::mutex> lck(lastFileSaveStatsLock);
+		lastFileSaveStats = saveStats;
+	}
+	if(codecSelectorPtr)
+	{
+		codecSelectorPtr->report(saveStats.m_codec, buffer->size(), saveStats.m_saveDurationSec1, saveStats.m_sizeMb);
+	}
+	return {fn, saveSessionIndex(sessionIndex, saveStats, chunkDirectory, chunk)};
+}
+
+//! Data of a chunk handed over to the chunk writer
+struct ChunkData
+{
+	LidarPointsBufferPtr m_lidarBuffer;
+	LidarIMUBufferPtr m_imuBuffer;
+	std::unordered_map<uint32_t, std::string> m_lidarList;
+	std::optional<GnssLog> m_gnss;
+	double m_durationSec{0}; //! recording time covered by the chunk, 0 for stop scans
+};
+
+//! Queues chunk to be saved by the chunk writer, session index has to outlive the job
+void SaveChunk(const std::string& repositoryDirectory, nlohmann::json& sessionIndex, int chunk, ChunkData data)
+{
+	if(publisherPtr)
+	{
+		publisherPtr->PublishChunk(chunk, repositoryDirectory);
+	}
+	chunkWriterPtr->Enqueue([repositoryDirectory, &sessionIndex, chunk, data = std::move(data)]() mutable {
+		const std::string chunkDirectory = GetChunkDirectory(repositoryDirectory);
+		std::vector<std::string> files = savePointcloudChunk(data.m_lidarBuffer, chunkDirectory, sessionIndex, chunk);
+		files.push_back(saveImuData(data.m_imuBuffer, chunkDirectory, chunk));
+		files.push_back(saveStatusData(chunkDirectory, chunk));
+		files.push_back(saveLidarList(data.m_lidarList, chunkDirectory, chunk));
+		if(data.m_gnss)
+		{
+			files.push_back(saveGnssBinaryData(*data.m_gnss, chunkDirectory, chunk));
+			if(saveGnssCsv)
+			{
+				files.push_back(saveGnssData(*data.m_gnss, chunkDirectory, chunk));
+			}
+			files.push_back(saveGnssRawData(*data.m_gnss, chunkDirectory, chunk));
+		}
+		if(fileSystemClientPtr)
+		{
+			fileSystemClientPtr->CatalogFiles(repositoryDirectory, files);
+		}
+		if(recordingTimePredictorPtr)
+		{
+			uint64_t bytes = 0;
+			for(const auto& file : files)
+			{
+				std::error_code ec;
+				const auto size = std::filesystem::file_size(file, ec);
+				bytes += ec ? 0 : size;
+			}
+			recordingTimePredictorPtr->ReportChunk(bytes, data.m_durationSec);
+		}
+		MigrateChunk(chunkDirectory, repositoryDirectory);
+	});
 }
 
 void stateWatcher()
 {
 	using namespace std::chrono_literals;
+	constexpr std::chrono::milliseconds defaultChunkInterval = 5s;
+	std::chrono::milliseconds chunkInterval = defaultChunkInterval;
+	const bool applyStoragePolicy = configJson.is_object() && configJson.contains("storage_benchmark")
+										? configJson["storage_benchmark"].value("apply_policy", true)
+										: true;
 	std::chrono::steady_clock::time_point chunkStart = std::chrono::steady_clock::now();
 	std::chrono::steady_clock::time_point stopScanDeadline = std::chrono::steady_clock::now();
 	std::chrono::steady_clock::time_point stopScanInitialDeadline = std::chrono::steady_clock::now();
+	bool stopScanLed = false;
+	bool spaceWarningGiven = false;
 	States oldState = States::IDLE;
 	std::string continousScanDirectory;
 	std::string stopScanDirectory;
 	int chunksInExperimentCS{0};
 	int chunksInExperimentSS{0};
+	nlohmann::json continousScanIndex;
+	nlohmann::json stopScanIndex;
 
 	int id_manifest = 0;
 	if(stopScanDirectory.empty() && fileSystemClientPtr)
@@ -307,10 +584,20 @@ void stateWatcher()
 		}
 		if(oldState != app_state)
 		{
+			statusAggregator.Invalidate("state");
+			if(downloadServerPtr)
+			{
+				// downloads compete with the chunk writer for the USB drive
+				downloadServerPtr->SetThrottled(app_state != States::IDLE && app_state != States::STOPPED &&
+												app_state != States::WAIT_FOR_RESOURCES);
+			}
 			std::cout << "State transtion from " << StatesToString.at(oldState) << " to " << StatesToString.at(app_state) << std::endl;
 		}
 		oldState = app_state;
 
+		// time when the state needs to run again, unless an event comes first
+		auto wakeup = std::chrono::steady_clock::time_point::max();
+
 		// call configured callback
 		hardware::ReportState(app_state);
 		if(app_state == States::LIDAR_ERROR)
@@ -328,9 +615,11 @@ void stateWatcher()
 				std::cout << "app_state == States::LIDAR_ERROR" << std::endl;
 				if(!disableBuzzer)
 				{
-					mandeye::gpioClientPtr->beep({2000, 100, 2000, 100, 2000, 100, 10000});
+					// the error pattern paces this state
+					std::this_thread::sleep_for(mandeye::gpioClientPtr->beep({2000, 100, 2000, 100, 2000, 100, 10000}));
 				}
 			}
+			wakeup = std::chrono::steady_clock::now();
 		}
 		if(app_state == States::USB_IO_ERROR)
 		{
@@ -347,17 +636,18 @@ void stateWatcher()
 				std::cout << "app_state == States::USB_IO_ERROR" << std::endl;
 				if(!disableBuzzer)
 				{
-					mandeye::gpioClientPtr->beep({2000, 100, 2000, 100, 2000, 100, 5000});
+					// the error pattern paces this state
+					std::this_thread::sleep_for(mandeye::gpioClientPtr->beep({2000, 100, 2000, 100, 2000, 100, 5000}));
 				}
 			}
+			wakeup = std::chrono::steady_clock::now();
 		}
 		else if(app_state == States::WAIT_FOR_RESOURCES)
 		{
-			if(!disableBuzzer)
+			if(!disableBuzzer && mandeye::gpioClientPtr)
 			{
 				mandeye::gpioClientPtr->beep({10}); // One very short beep to show that we are alive
 			}
-			std::this_thread::sleep_for(100ms);
 			std::lock_guard<std::mutex> l1(lidarClientPtrLock);
 			std::lock_guard<std::mutex> l2(gpioClientPtrLock);
 
@@ -394,6 +684,8 @@ void stateWatcher()
 			{
 				mandeye::publisherPtr->SetWorkingDirectory(stopScanDirectory, continousScanDirectory);
 			}
+			// resources are created by other threads, check again shortly
+			wakeup = std::chrono::steady_clock::now() + 100ms;
 		}
 		else if(app_state == States::IDLE)
 		{
@@ -401,13 +693,20 @@ void stateWatcher()
 			{
 				app_state = States::LIDAR_ERROR;
 			}
+			// spool backlog is not signaled with events, follow it while it is not empty
+			const bool isMigrating = spoolMigratorPtr && spoolMigratorPtr->GetBacklogFiles() > 0;
 			if(gpioClientPtr)
 			{
+				// copy data LED stays on until chunks are written and spool is migrated, USB should not be removed
+				const bool isWriting = chunkWriterPtr->GetPendingJobs() > 0;
 				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_STOP_SCAN, false);
-				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_COPY_DATA, false);
+				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_COPY_DATA, isMigrating || isWriting);
 				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_CONTINOUS_SCANNING, false);
 			}
-			std::this_thread::sleep_for(100ms);
+			if(isMigrating)
+			{
+				wakeup = std::chrono::steady_clock::now() + 1000ms;
+			}
 			if(hardware::Autostart && !isLidarError)
 			{
 				app_state = States::STARTING_SCAN;
@@ -416,6 +715,24 @@ void stateWatcher()
 		else if(app_state == States::STARTING_SCAN)
 		{
 			//chunksInExperiment = 0;
+			if(recordingTimePredictorPtr)
+			{
+				recordingTimePredictorPtr->Reset();
+			}
+			if(fileSystemClientPtr)
+			{
+				// the drive belongs to the recording
+				fileSystemClientPtr->CancelStorageBenchmark();
+				const auto policy = fileSystemClientPtr->GetStoragePolicy();
+				if(applyStoragePolicy && policy.valid)
+				{
+					chunkInterval = std::max(defaultChunkInterval, policy.chunkInterval);
+					if(codecSelectorPtr)
+					{
+						codecSelectorPtr->setStorageWriteRate(policy.sustainedWriteMBs);
+					}
+				}
+			}
 			if(gpioClientPtr)
 			{
 				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_STOP_SCAN, false);
@@ -453,38 +770,25 @@ void stateWatcher()
 				{
 					mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_CONTINOUS_SCANNING, true);
 				}
+				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_COPY_DATA, chunkWriterPtr->GetPendingJobs() > 0);
 			}
 
 			const auto now = std::chrono::steady_clock::now();
-			if(now - chunkStart > std::chrono::seconds(60))
-			{
-				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_CONTINOUS_SCANNING, false);
-				std::this_thread::sleep_for(1000ms);
-				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_CONTINOUS_SCANNING, true);
-				std::this_thread::sleep_for(1000ms);
-			}
-			if(now - chunkStart > std::chrono::seconds(600))
-			{
-				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_CONTINOUS_SCANNING, false);
-				std::this_thread::sleep_for(100ms);
-				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_CONTINOUS_SCANNING, true);
-				std::this_thread::sleep_for(100ms);
-			}
-			if(now - chunkStart > std::chrono::seconds(5) && app_state == States::SCANNING)
+			if(now - chunkStart >= chunkInterval && app_state == States::SCANNING)
 			{
 
 				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_COPY_DATA, true);
 
+				ChunkData chunk;
+				chunk.m_durationSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - chunkStart).count();
 				chunkStart = std::chrono::steady_clock::now();
 
-				auto [lidarBuffer, imuBuffer] = lidarClientPtr->retrieveData();
-				std::deque<std::string> gnssBuffer;
-				std::deque<std::string> gnssRawBuffer;
+				std::tie(chunk.m_lidarBuffer, chunk.m_imuBuffer) = lidarClientPtr->retrieveData();
+				chunk.m_lidarList = lidarClientPtr->getSerialNumberToLidarIdMapping();
 
 				if(gnssClientPtr)
 				{
-					gnssBuffer = gnssClientPtr->retrieveData();
-					gnssRawBuffer = gnssClientPtr->retrieveRawData();
+					chunk.m_gnss = gnssClientPtr->retrieveLog();
 				}
 				if(continousScanDirectory == "")
 				{
@@ -492,22 +796,34 @@ void stateWatcher()
 				}
 				else
 				{
-					auto [fn, saveStats] = savePointcloudData(lidarBuffer, continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-					if(saveStats)
-						lastFileSaveStats = *saveStats;
-					saveImuData(imuBuffer, continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-					saveStatusData(continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-					auto lidarList = lidarClientPtr->getSerialNumberToLidarIdMapping();
-					saveLidarList(lidarList, continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-					if(gnssClientPtr)
+					SaveChunk(continousScanDirectory, continousScanIndex, chunksInExperimentCS + chunksInExperimentSS, std::move(chunk));
+					chunksInExperimentCS++;
+				}
+			}
+			wakeup = chunkStart + chunkInterval;
+
+			if(recordingTimePredictorPtr && app_state == States::SCANNING)
+			{
+				const uint64_t pendingBytes = spoolMigratorPtr ? spoolMigratorPtr->GetBacklogBytes() : 0;
+				const double storageWriteMBs = fileSystemClientPtr ? fileSystemClientPtr->GetStoragePolicy().sustainedWriteMBs : 0;
+				// checked once per chunk, the storage policy may have lengthened the interval to 30 s
+				const auto level = recordingTimePredictorPtr->Update(pendingBytes, storageWriteMBs, chunkInterval);
+				if(level == RecordingTimePredictor::Level::Stop)
+				{
+					// stop while the last chunk still fits, rather than failing with USB_IO_ERROR mid-write
+					std::cout << "Repository drive is almost full, stopping scan" << std::endl;
+					app_state = States::STOPPING;
+				}
+				else if(level == RecordingTimePredictor::Level::Warning && !spaceWarningGiven)
+				{
+					std::cout << "Repository drive is running out of space: " << recordingTimePredictorPtr->produceStatus().dump()
+							  << std::endl;
+					if(!disableBuzzer && gpioClientPtr)
 					{
-						saveGnssData(gnssBuffer, continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-						saveGnssRawData(gnssRawBuffer, continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
+						mandeye::gpioClientPtr->beep({500, 200, 500, 200, 500});
 					}
-
-					mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_COPY_DATA, false);
-					chunksInExperimentCS++;
 				}
+				spaceWarningGiven = level != RecordingTimePredictor::Level::Ok;
 			}
 
 			if(app_state == States::STOPPING_STAGE_1)
@@ -531,6 +847,7 @@ void stateWatcher()
 				{
 					app_state = States::SCANNING;
 				}
+				wakeup = std::min({wakeup, stoppingStage1StartDeadlineChangeLed, stoppingStage1StartDeadline});
 			}
 
 			if(app_state == States::STOPPING_STAGE_2)
@@ -554,21 +871,22 @@ void stateWatcher()
 				{
 					app_state = States::SCANNING;
 				}
+				wakeup = std::min({wakeup, stoppingStage2StartDeadlineChangeLed, stoppingStage2StartDeadline});
 			}
-
-			std::this_thread::sleep_for(20ms);
 		}
 		else if(app_state == States::STOPPING)
 		{
 			mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_CONTINOUS_SCANNING, true);
 			mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_COPY_DATA, true);
 
-			auto [lidarBuffer, imuBuffer] = lidarClientPtr->retrieveData();
-			std::deque<std::string> gnssData;
+			ChunkData chunk;
+			chunk.m_durationSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - chunkStart).count();
+			std::tie(chunk.m_lidarBuffer, chunk.m_imuBuffer) = lidarClientPtr->retrieveData();
+			chunk.m_lidarList = lidarClientPtr->getSerialNumberToLidarIdMapping();
 			lidarClientPtr->stopLog();
 			if(gnssClientPtr)
 			{
-				gnssData = gnssClientPtr->retrieveData();
+				chunk.m_gnss = gnssClientPtr->retrieveLog();
 				gnssClientPtr->stopLog();
 			}
 
@@ -589,20 +907,9 @@ void stateWatcher()
 			}
 			else
 			{
-				auto [fn, saveStats] = savePointcloudData(lidarBuffer, continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-				if(saveStats)
-					lastFileSaveStats = *saveStats;
-				saveImuData(imuBuffer, continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-				saveStatusData(continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-				auto lidarList = lidarClientPtr->getSerialNumberToLidarIdMapping();
-				saveLidarList(lidarList, continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-
-				if(gnssClientPtr)
-				{
-					saveGnssData(gnssData, continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-				}
+				// copy data LED is turned off in IDLE when the writer is done
+				SaveChunk(continousScanDirectory, continousScanIndex, chunksInExperimentCS + chunksInExperimentSS, std::move(chunk));
 				chunksInExperimentCS++;
-				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_COPY_DATA, false);
 				app_state = States::IDLE;
 			}
 		}
@@ -637,10 +944,10 @@ void stateWatcher()
 
 			if(now < stopScanInitialDeadline)
 			{
-				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_STOP_SCAN, false);
-				std::this_thread::sleep_for(100ms);
-				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_STOP_SCAN, true);
-				std::this_thread::sleep_for(100ms);
+				// blink stop scan LED, scanner should not be moved yet
+				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_STOP_SCAN, stopScanLed);
+				stopScanLed = !stopScanLed;
+				wakeup = std::min(now + 100ms, stopScanInitialDeadline);
 			}
 			else
 			{
@@ -663,6 +970,7 @@ void stateWatcher()
 			{
 				app_state = States::STOPING_STOP_SCAN;
 			}
+			wakeup = stopScanDeadline;
 		}
 		else if(app_state == States::STOPING_STOP_SCAN)
 		{
@@ -670,12 +978,13 @@ void stateWatcher()
 			{
 				mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_COPY_DATA, true);
 			}
-			auto [lidarBuffer, imuBuffer] = lidarClientPtr->retrieveData();
-			std::deque<std::string> gnssData;
+			ChunkData chunk;
+			std::tie(chunk.m_lidarBuffer, chunk.m_imuBuffer) = lidarClientPtr->retrieveData();
+			chunk.m_lidarList = lidarClientPtr->getSerialNumberToLidarIdMapping();
 			lidarClientPtr->stopLog();
 			if(gnssClientPtr)
 			{
-				gnssData = gnssClientPtr->retrieveData();
+				chunk.m_gnss = gnssClientPtr->retrieveLog();
 				gnssClientPtr->stopLog();
 			}
 			if(stopScanDirectory.empty())
@@ -684,31 +993,27 @@ void stateWatcher()
 			}
 			else
 			{
-				auto [fn, saveStats] = savePointcloudData(lidarBuffer, stopScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-				if(saveStats)
-					lastFileSaveStats = *saveStats;
-				saveImuData(imuBuffer, stopScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-				saveStatusData(stopScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-
-				auto lidarList = lidarClientPtr->getSerialNumberToLidarIdMapping();
-				saveLidarList(lidarList, stopScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-
-				if(gnssClientPtr)
-				{
-					saveGnssData(gnssData, stopScanDirectory, chunksInExperimentCS + chunksInExperimentSS);
-				}
+				SaveChunk(stopScanDirectory, stopScanIndex, chunksInExperimentCS + chunksInExperimentSS, std::move(chunk));
 				chunksInExperimentSS++;
 
 				if(gpioClientPtr)
 				{
-					mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_COPY_DATA, false);
 					mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_STOP_SCAN, false);
 				}
 
 				app_state = States::IDLE;
 			}
 		}
+
+		// a transition runs the new state right away
+		if(oldState != app_state)
+		{
+			wakeup = std::chrono::steady_clock::now();
+		}
+		HandleEvent(eventQueue.WaitForEvent(wakeup));
 	}
+	// session indexes are owned by this function, queued chunks have to be written before leaving
+	chunkWriterPtr->WaitForIdle();
 }
 } // namespace mandeye
 
@@ -749,16 +1054,93 @@ struct PistacheServerHandler : public Http::Handler
 	HTTP_PROTOTYPE(PistacheServerHandler)
 	void onRequest(const Http::Request& request, Http::ResponseWriter writer) override
 	{
-		if(request.resource() == "/status" || request.resource() == "/json/status")
+		if(request.resource() == "/status" || request.resource() == "/json/status" || request.resource() == "/status_full" ||
+		   request.resource() == "/json/status_full")
+		{
+			const bool full = request.resource() == "/status_full" || request.resource() == "/json/status_full";
+			const auto snapshot = mandeye::statusAggregator.GetSnapshot(full);
+			writer.headers().addRaw(Http::Header::Raw("ETag", snapshot->etag));
+			writer.headers().addRaw(Http::Header::Raw("Cache-Control", "no-cache"));
+			const auto ifNoneMatch = request.headers().tryGetRaw("If-None-Match");
+			if(ifNoneMatch && ifNoneMatch->value() == snapshot->etag)
+			{
+				writer.send(Http::Code::Not_Modified);
+				return;
+			}
+			writer.send(Http::Code::Ok, snapshot->body);
+			return;
+		}
+		else if(request.resource() == "/json/catalog" && mandeye::fileSystemClientPtr)
+		{
+			const auto offset = request.query().get("offset");
+			const auto limit = request.query().get("limit");
+			try
+			{
+				const auto page = mandeye::fileSystemClientPtr->GetCatalogPage(offset ? std::stoul(*offset) : 0, limit ? std::stoul(*limit) : 1000);
+				writer.send(Http::Code::Ok, page.dump());
+			}
+			catch(const std::logic_error&)
+			{
+				writer.send(Http::Code::Bad_Request, "offset and limit are numbers");
+			}
+			return;
+		}
+		else if(request.resource() == "/json/storage_benchmark" && mandeye::fileSystemClientPtr)
+		{
+			writer.send(Http::Code::Ok, mandeye::fileSystemClientPtr->GetStorageBenchmarkStatus().dump());
+			return;
+		}
+		else if(request.resource() == "/trig/storage_benchmark" && mandeye::fileSystemClientPtr)
+		{
+			// writes gigabytes, only while the drive is not recording
+			if(mandeye::app_state != mandeye::States::IDLE && mandeye::app_state != mandeye::States::STOPPED)
+			{
+				writer.send(Http::Code::Conflict, "storage benchmark runs only in IDLE or STOPPED state");
+				return;
+			}
+			// the last scan may still be saved or migrated, the benchmark would compete with it and measure both
+			if(mandeye::chunkWriterPtr->GetPendingJobs() > 0 || (mandeye::spoolMigratorPtr && mandeye::spoolMigratorPtr->GetBacklogFiles() > 0))
+			{
+				writer.send(Http::Code::Conflict, "storage benchmark waits until chunks are saved and the spool is migrated");
+				return;
+			}
+			nlohmann::json options = mandeye::configJson.is_object() && mandeye::configJson.contains("storage_benchmark")
+										 ? mandeye::configJson["storage_benchmark"]
+										 : nlohmann::json::object();
+			try
+			{
+				for(const char* name : {"duration_sec", "max_mb", "fsync_samples", "small_files"})
+				{
+					const auto value = request.query().get(name);
+					if(value)
+					{
+						options[name] = std::stod(*value);
+					}
+				}
+			}
+			catch(const std::logic_error&)
+			{
+				writer.send(Http::Code::Bad_Request, "duration_sec, max_mb, fsync_samples and small_files are numbers");
+				return;
+			}
+			if(!mandeye::fileSystemClientPtr->StartStorageBenchmark(options))
+			{
+				writer.send(Http::Code::Conflict, "storage benchmark is already running");
+				return;
+			}
+			writer.send(Http::Code::Accepted, mandeye::fileSystemClientPtr->GetStorageBenchmarkStatus().dump());
+			return;
+		}
+		else if(request.resource() == "/trig/storage_benchmark_cancel" && mandeye::fileSystemClientPtr)
 		{
-			std::string p = mandeye::produceReport(false);
-			writer.send(Http::Code::Ok, p);
+			mandeye::fileSystemClientPtr->CancelStorageBenchmark();
+			writer.send(Http::Code::Ok, "");
 			return;
 		}
-		if(request.resource() == "/status_full" || request.resource() == "/json/status_full")
+		else if(request.resource() == "/metrics")
 		{
-			std::string p = mandeye::produceReport();
-			writer.send(Http::Code::Ok, p);
+			writer.headers().addRaw(Http::Header::Raw("Content-Type", "text/plain; version=0.0.4"));
+			writer.send(Http::Code::Ok, mandeye_utils::metrics::Registry::Instance().Render());
 			return;
 		}
 		else if(request.resource() == "/jquery.js")
@@ -778,6 +1160,27 @@ struct PistacheServerHandler : public Http::Handler
 			writer.send(Http::Code::Ok, "");
 			return;
 		}
+		else if(request.resource() == "/trig/sim_button")
+		{
+			// MANDEYE_GPIO_SIM only: press and release a button, e.g. ?name=BUTTON_STOP_SCAN&hold_ms=100
+			const auto name = request.query().get("name");
+			const auto hold = request.query().get("hold_ms");
+			const auto holdMs = std::chrono::milliseconds(hold ? std::atoi(hold->c_str()) : 100);
+			if(holdMs.count() <= 0)
+			{
+				writer.send(Http::Code::Bad_Request, "hold_ms must be positive");
+				return;
+			}
+			// no gpioClientPtrLock, the state machine holds it for up to a minute; injectEdge is thread safe
+			if(!name || !mandeye::gpioClientPtr || !mandeye::gpioClientPtr->injectEdge(*name, true) ||
+			   !mandeye::gpioClientPtr->injectEdge(*name, false, holdMs))
+			{
+				writer.send(Http::Code::Bad_Request, "needs MANDEYE_GPIO_SIM and name of a button");
+				return;
+			}
+			writer.send(Http::Code::Ok, "");
+			return;
+		}
 		else if(request.resource() == "/trig/stopscan")
 		{
 			mandeye::TriggerStopScan();
@@ -801,56 +1204,165 @@ int main(int argc, char** argv)
 	std::cout << "Buzzer is " << (mandeye::disableBuzzer ? "disabled" : "enabled") << std::endl;
 	std::cout << "Lidar SDK to use (from  MANDEYE_LIDAR_SDK env): " << mandeye::lidarSDKToUse << std::endl;
 
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Main);
+
+	mandeye::fileSystemClientPtr = std::make_shared<mandeye::FileSystemClient>(utils::getEnvString("MANDEYE_REPO", MANDEYE_REPO));
+	mandeye::configJson = mandeye::fileSystemClientPtr->GetConfig();
+	if(mandeye::configJson.is_object() && mandeye::configJson.contains("lidar_sdk"))
+	{
+		mandeye::lidarSDKToUse = mandeye::configJson["lidar_sdk"].get<std::string>();
+	}
+	std::cout << "Lidar SDK to use from config: " << mandeye::lidarSDKToUse << std::endl;
+
+	// apply thread plan before starting threads, so threads created by SDKs inherit the settings of their creator
+	if(mandeye::configJson.is_object() && mandeye::configJson.contains("threads"))
+	{
+		mandeye_utils::setThreadPlan(mandeye::configJson["threads"]);
+		std::cout << "Thread plan: " << mandeye::configJson["threads"].dump() << std::endl;
+	}
+
+	// created before any thread starts and never replaced, so threads read gpioClientPtr without synchronization
+	{
+		const bool simMode = utils::getEnvBool("MANDEYE_GPIO_SIM", MANDEYE_GPIO_SIM);
+		std::cout << "MANDEYE_GPIO_SIM : " << simMode << std::endl;
+		mandeye::gpioClientPtr = std::make_shared<mandeye::GpioClient>(simMode);
+	}
+
+	if(mandeye::configJson.is_object() && mandeye::configJson.contains("status_push") &&
+	   mandeye::configJson["status_push"].value("enabled", false))
+	{
+		mandeye::statusPushServerPtr = std::make_shared<mandeye::StatusPushServer>(mandeye::statusAggregator, mandeye::configJson["status_push"]);
+		std::cout << "Status push: " << mandeye::statusPushServerPtr->produceStatus().dump() << std::endl;
+	}
+
 	auto server = std::make_shared<Http::Endpoint>(addr);
 	std::thread http_thread1([&]() {
+		mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Http);
 		auto opts = Http::Endpoint::options().threads(1).flags(Tcp::Options::ReuseAddr);
 		server->init(opts);
 		server->setHandler(Http::make_handler<PistacheServerHandler>());
 		server->serve();
 	});
 
-	mandeye::fileSystemClientPtr = std::make_shared<mandeye::FileSystemClient>(utils::getEnvString("MANDEYE_REPO", MANDEYE_REPO));
-	mandeye::configJson = mandeye::fileSystemClientPtr->GetConfig();
-	if(mandeye::configJson.is_object() && mandeye::configJson.contains("lidar_sdk"))
+	if(mandeye::configJson.is_object())
 	{
-		mandeye::lidarSDKToUse = mandeye::configJson["lidar_sdk"].get<std::string>();
+		const std::string codec = mandeye::configJson.value("pointcloud_codec", "laz");
+		const double budget = mandeye::configJson.value("pointcloud_codec_budget_sec", 2.5);
+		mandeye::codecSelectorPtr = std::make_shared<mandeye::PointcloudCodecSelector>(codec, budget);
+	}
+	else
+	{
+		mandeye::codecSelectorPtr = std::make_shared<mandeye::PointcloudCodecSelector>("laz", 0);
+	}
+	std::cout << "Pointcloud codec: " << mandeye::codecSelectorPtr->produceStatus().dump() << std::endl;
+
+	if(mandeye::configJson.is_object() && mandeye::configJson.contains("spool"))
+	{
+		const auto& spoolConfig = mandeye::configJson["spool"];
+		const std::string spoolDirectory = spoolConfig.value("directory", "");
+		const double rateLimit = spoolConfig.value("rate_limit_mb_s", 0.0);
+		if(!spoolDirectory.empty())
+		{
+			std::cout << "Two-tier storage, spool: " << spoolDirectory << " rate limit: " << rateLimit << " MB/s" << std::endl;
+			// a file the repository drive does not take after all retries is an I/O error, as when saving directly
+			mandeye::spoolMigratorPtr = std::make_shared<mandeye::SpoolMigrator>(
+				spoolDirectory, utils::getEnvString("MANDEYE_REPO", MANDEYE_REPO), rateLimit, [](const std::string&) {
+					mandeye::eventQueue.Push(mandeye::Events::WRITER_ERROR);
+				});
+		}
+	}
+
+	if(mandeye::configJson.is_object() && mandeye::configJson.contains("gnss_log"))
+	{
+		mandeye::saveGnssCsv = mandeye::configJson["gnss_log"].value("csv", true);
 	}
-	std::cout << "Lidar SDK to use from config: " << mandeye::lidarSDKToUse << std::endl;
 
+	mandeye::recordingTimePredictorPtr = std::make_shared<mandeye::RecordingTimePredictor>(
+		utils::getEnvString("MANDEYE_REPO", MANDEYE_REPO),
+		mandeye::configJson.is_object() && mandeye::configJson.contains("recording_time") ? mandeye::configJson["recording_time"]
+																						 : nlohmann::json());
+
+	if(mandeye::configJson.is_object() && mandeye::configJson.contains("download") &&
+	   mandeye::configJson["download"].value("enabled", false))
+	{
+		mandeye::downloadServerPtr =
+			std::make_shared<mandeye::DownloadServer>(utils::getEnvString("MANDEYE_REPO", MANDEYE_REPO), mandeye::configJson["download"]);
+		std::cout << "Downloads: " << mandeye::downloadServerPtr->produceStatus().dump() << std::endl;
+	}
+
+	// status sources and metrics collectors read the clients from other threads, they start once all are created
+	std::promise<void> lidarReady;
+	std::promise<void> gpioReady;
 	std::thread thLivox([&]() {
+		mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Lidar);
 		{
 			std::lock_guard<std::mutex> l1(mandeye::lidarClientPtrLock);
 			mandeye::lidarClientPtr = mandeye::createLidarClient(mandeye::lidarSDKToUse, mandeye::configJson);
 		}
+		mandeye::lidarClientPtr->SetThreadRoleRegistrar(mandeye_utils::registerThreadRole);
+		if(mandeye::configJson.is_object() && mandeye::configJson.contains("preview") &&
+		   mandeye::configJson["preview"].value("enabled", false))
+		{
+			mandeye::previewStreamPtr = std::make_shared<mandeye::PreviewStream>(mandeye::configJson["preview"]);
+			std::cout << "Live preview: " << mandeye::previewStreamPtr->produceStatus().dump() << std::endl;
+		}
+		if(mandeye::configJson.is_object() && mandeye::configJson.contains("shm") && mandeye::configJson["shm"].value("enabled", false))
+		{
+			mandeye::shmStreamPtr = std::make_shared<mandeye::ShmStream>(mandeye::configJson["shm"]);
+			std::cout << "Shared-memory stream: " << mandeye::shmStreamPtr->produceStatus().dump() << std::endl;
+		}
+		// taps see batches on ingest threads, also when not logging
+		if(mandeye::previewStreamPtr || mandeye::shmStreamPtr)
+		{
+			mandeye::lidarClientPtr->SetLidarTap(
+				[preview = mandeye::previewStreamPtr, shm = mandeye::shmStreamPtr](const mandeye::LidarPoint* points, size_t count) {
+					if(preview)
+					{
+						preview->Feed(points, count);
+					}
+					if(shm)
+					{
+						shm->WritePoints(points, count);
+					}
+				});
+		}
+		if(mandeye::shmStreamPtr)
+		{
+			mandeye::lidarClientPtr->SetImuTap([shm = mandeye::shmStreamPtr](const mandeye::LidarIMU* samples, size_t count) {
+				shm->WriteImu(samples, count);
+			});
+		}
 		if(!mandeye::lidarClientPtr->startListener(utils::getEnvString("MANDEYE_LIVOX_LISTEN_IP", MANDEYE_LIVOX_LISTEN_IP)))
 		{
 			mandeye::isLidarError.store(true);
+			mandeye::eventQueue.Push(mandeye::Events::LIDAR_ERROR);
 		}
 
 		// intialize in this thread to prevent initialization fiasco
-		const std::string portName = hardware::GetGNSSPort();
+		// MANDEYE_GNSS_PORT points to another receiver or to the pty of mandeye_gnss_replay
+		const std::string portName = utils::getEnvString("MANDEYE_GNSS_PORT", hardware::GetGNSSPort());
 		const auto baud = hardware::GetGNSSBaudrate();
 		if(!portName.empty())
 		{
 			mandeye::gnssClientPtr = std::make_shared<mandeye::GNSSClient>();
 			mandeye::gnssClientPtr->SetTimeStampProvider(mandeye::lidarClientPtr);
-			mandeye::gnssClientPtr->startListener(portName, baud);
 
-			// set callback
+			// set callback, before the serial thread starts calling it
 			mandeye::gnssClientPtr->setDataCallback([&](const minmea_sentence_gga& gga) {
-				if(mandeye::gpioClientPtr && gga.fix_quality > 0 && gga.satellites_tracked > 5 &&
-				   !mandeye::disableBuzzer) // if any fix quality is available
+				if(gga.fix_quality > 0 && gga.satellites_tracked > 5 && !mandeye::disableBuzzer) // if any fix quality is available
 				{
-					std::lock_guard<std::mutex> l2(mandeye::gpioClientPtrLock);
-					mandeye::gpioClientPtr->setLed(hardware::LED::BUZZER, true);
-					std::this_thread::sleep_for(std::chrono::milliseconds(10));
-					mandeye::gpioClientPtr->setLed(hardware::LED::BUZZER, false);
+					// no gpioClientPtrLock, the state machine holds it for long; the pulse is scheduled, the serial thread does not wait
+					mandeye::gpioClientPtr->pulse(hardware::LED::BUZZER, std::chrono::milliseconds(10));
 				}
 			});
+			mandeye::gnssClientPtr->startListener(portName, baud);
 		}
 		// start zeromq publisher
-		mandeye::publisherPtr = std::make_shared<mandeye::Publisher>();
+		const std::string publisherEncoding =
+			mandeye::configJson.is_object() ? mandeye::configJson.value("publisher_encoding", "binary") : std::string("binary");
+		mandeye::publisherPtr = std::make_shared<mandeye::Publisher>(mandeye::Publisher::EncodingFromString(publisherEncoding));
 		mandeye::publisherPtr->SetTimeStampProvider(mandeye::lidarClientPtr);
+		lidarReady.set_value();
 		while(mandeye::isRunning)
 		{
 			std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -859,15 +1371,17 @@ int main(int argc, char** argv)
 		}
 	});
 
-	std::thread thStateMachine([&]() { mandeye::stateWatcher(); });
+	mandeye::chunkWriterPtr = std::make_shared<mandeye::ChunkWriter>([](bool success) {
+		mandeye::eventQueue.Push(success ? mandeye::Events::WRITER_DONE : mandeye::Events::WRITER_ERROR);
+	});
+	std::thread thStateMachine([&]() {
+		mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::StateMachine);
+		mandeye::stateWatcher();
+	});
 
 	std::thread thGpio([&]() {
 		std::lock_guard<std::mutex> l2(mandeye::gpioClientPtrLock);
 		using namespace std::chrono_literals;
-		const bool simMode = utils::getEnvBool("MANDEYE_GPIO_SIM", MANDEYE_GPIO_SIM);
-
-		std::cout << "MANDEYE_GPIO_SIM : " << simMode << std::endl;
-		mandeye::gpioClientPtr = std::make_shared<mandeye::GpioClient>(simMode);
 		for(int i = 0; i < 3; i++)
 		{
 			mandeye::gpioClientPtr->setLed(hardware::LED::LED_GPIO_STOP_SCAN, true);
@@ -889,8 +1403,15 @@ int main(int argc, char** argv)
 		mandeye::gpioClientPtr->addButtonCallback(hardware::BUTTON::BUTTON_STOP_SCAN, "BUTTON_STOP_SCAN", [&]() { mandeye::TriggerStopScan(); });
 		mandeye::gpioClientPtr->addButtonCallback(
 			hardware::BUTTON::BUTTON_CONTINOUS_SCANNING, "BUTTON_CONTINOUS_SCANNING", [&]() { mandeye::TriggerContinousScanning(); });
+		gpioReady.set_value();
 	});
 
+	lidarReady.get_future().wait();
+	gpioReady.get_future().wait();
+	mandeye::addStatusSources();
+	mandeye::addMetricsCollectors();
+	mandeye::statusAggregator.Start();
+
 	while(mandeye::isRunning)
 	{
 		using namespace std::chrono_literals;
@@ -899,6 +1420,7 @@ int main(int argc, char** argv)
 		if(ch == 'q')
 		{
 			mandeye::isRunning.store(false);
+			mandeye::eventQueue.Push(mandeye::Events::SHUTDOWN);
 		}
 		std::cout << "Press q -> quit, s -> start scan , e -> end scan" << std::endl;
 
@@ -920,8 +1442,33 @@ int main(int argc, char** argv)
 
 	server->shutdown();
 	http_thread1.join();
+	// sources read the clients reset below
+	mandeye::statusAggregator.Stop();
+	mandeye::statusPushServerPtr.reset();
 	std::cout << "joining thStateMachine" << std::endl;
 	thStateMachine.join();
+	// throttled by the state machine until it is joined
+	mandeye::downloadServerPtr.reset();
+	mandeye::chunkWriterPtr.reset();
+
+	if(mandeye::spoolMigratorPtr)
+	{
+		// with the repository drive gone the backlog never empties, what is left is migrated on the next start
+		const double shutdownTimeoutSec = mandeye::configJson["spool"].value("shutdown_timeout_sec", 60.0);
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+																	  std::chrono::duration<double>(shutdownTimeoutSec));
+		while(!mandeye::spoolMigratorPtr->WaitForEmptyBacklog(std::chrono::seconds(5)))
+		{
+			if(std::chrono::steady_clock::now() >= deadline)
+			{
+				std::cout << "Spool migration not done in " << shutdownTimeoutSec << " s, " << mandeye::spoolMigratorPtr->GetBacklogFiles()
+						  << " files left in spool for the next start" << std::endl;
+				break;
+			}
+			std::cout << "Waiting for spool migration, " << mandeye::spoolMigratorPtr->GetBacklogFiles() << " files left" << std::endl;
+		}
+		mandeye::spoolMigratorPtr.reset();
+	}
 
 	std::cout << "joining thLivox" << std::endl;
 	thLivox.join();
@@ -0,0 +1,165 @@
+#include "pointcloud_writers.h"
+#include "save_raw.h"
+#include <algorithm>
+#include <iostream>
+
+namespace mandeye
+{
+namespace
+{
+const std::vector<PointcloudWriter>& getWriters()
+{
+	static const std::vector<PointcloudWriter> writers = []() {
+		std::vector<PointcloudWriter> w;
+		w.push_back({"laz", ".laz", [](const std::string& fn, LidarPointsBufferPtr buffer) { return saveLaz(fn, buffer, true); }});
+		w.push_back({"las", ".las", [](const std::string& fn, LidarPointsBufferPtr buffer) { return saveLaz(fn, buffer, false); }});
+		w.push_back({"raw", ".bin", [](const std::string& fn, LidarPointsBufferPtr buffer) {
+						 return saveRaw(fn, buffer, RawCompression::NONE);
+					 }});
+		if(isRawCompressionAvailable(RawCompression::LZ4))
+		{
+			w.push_back({"raw_lz4", ".bin.lz4", [](const std::string& fn, LidarPointsBufferPtr buffer) {
+							 return saveRaw(fn, buffer, RawCompression::LZ4);
+						 }});
+		}
+		if(isRawCompressionAvailable(RawCompression::ZSTD))
+		{
+			w.push_back({"raw_zstd", ".bin.zst", [](const std::string& fn, LidarPointsBufferPtr buffer) {
+							 return saveRaw(fn, buffer, RawCompression::ZSTD);
+						 }});
+		}
+		return w;
+	}();
+	return writers;
+}
+
+//! Cheapest compressed writer, raw if there is no compression compiled in.
+//! Ordered by CPU cost: LZ4 is faster than zstd level 1, both are an order of magnitude cheaper than LAZ.
+std::string getFallbackWriter()
+{
+	for(const char* name : {"raw_lz4", "raw_zstd", "raw"})
+	{
+		if(getPointcloudWriter(name))
+		{
+			return name;
+		}
+	}
+	return "raw";
+}
+} // namespace
+
+const PointcloudWriter* getPointcloudWriter(const std::string& name)
+{
+	const auto& writers = getWriters();
+	auto it = std::find_if(writers.begin(), writers.end(), [&](const PointcloudWriter& w) { return w.m_name == name; });
+	if(it == writers.end())
+	{
+		return nullptr;
+	}
+	return &(*it);
+}
+
+std::vector<std::string> getPointcloudWriterNames()
+{
+	std::vector<std::string> names;
+	for(const auto& w : getWriters())
+	{
+		names.push_back(w.m_name);
+	}
+	return names;
+}
+
+PointcloudCodecSelector::PointcloudCodecSelector(const std::string& codec, double budgetSec)
+	: m_auto(codec == AutoCodecName)
+	, m_preferred("laz")
+	, m_fallback(getFallbackWriter())
+	, m_budgetSec(budgetSec)
+	, m_codec(codec)
+{
+	if(!m_auto && getPointcloudWriter(codec) == nullptr)
+	{
+		std::cerr << "Unknown pointcloud codec '" << codec << "', using " << m_preferred << std::endl;
+		m_codec = m_preferred;
+	}
+}
+
+std::string PointcloudCodecSelector::select(size_t pointsCount)
+{
+	std::lock_guard<std::mutex> lck{m_lock};
+	if(!m_auto)
+	{
+		return m_codec;
+	}
+	if(m_codec != m_preferred && ++m_chunksSinceProbe >= ProbeInterval)
+	{
+		m_chunksSinceProbe = 0;
+		return m_preferred;
+	}
+	// hysteresis: go back to preferred codec only if it would fit comfortably
+	const double predictedSec = m_preferredSecPerPoint * pointsCount;
+	const double budget = m_codec == m_preferred ? m_budgetSec : 0.75 * m_budgetSec;
+	if(predictedSec <= budget)
+	{
+		return m_preferred;
+	}
+	// on a drive that cannot take the larger output in time, falling back only moves the bottleneck:
+	// compare the whole save, encoding and writing to the drive, of both codecs
+	if(m_storageWriteMBs > 0)
+	{
+		const double preferredSaveSec = predictedSec + m_preferredMbPerPoint * pointsCount / m_storageWriteMBs;
+		const double fallbackSaveSec = (m_fallbackSecPerPoint + m_fallbackMbPerPoint / m_storageWriteMBs) * pointsCount;
+		if(fallbackSaveSec >= preferredSaveSec)
+		{
+			return m_preferred;
+		}
+	}
+	return m_fallback;
+}
+
+void PointcloudCodecSelector::report(const std::string& codec, size_t pointsCount, double durationSec, double sizeMb)
+{
+	if(!m_auto || pointsCount == 0)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lck{m_lock};
+	if(codec == m_preferred)
+	{
+		m_preferredSecPerPoint = durationSec / pointsCount;
+		m_preferredMbPerPoint = std::max(sizeMb, 0.0) / pointsCount;
+	}
+	else if(codec == m_fallback)
+	{
+		m_fallbackSecPerPoint = durationSec / pointsCount;
+		m_fallbackMbPerPoint = std::max(sizeMb, 0.0) / pointsCount;
+	}
+	m_codec = codec;
+}
+
+void PointcloudCodecSelector::setStorageWriteRate(double mbPerSec)
+{
+	std::lock_guard<std::mutex> lck{m_lock};
+	m_storageWriteMBs = mbPerSec;
+}
+
+nlohmann::json PointcloudCodecSelector::produceStatus() const
+{
+	std::lock_guard<std::mutex> lck{m_lock};
+	nlohmann::json data;
+	data["auto"] = m_auto;
+	data["codec"] = m_codec;
+	data["available"] = getPointcloudWriterNames();
+	if(m_auto)
+	{
+		data["preferred"] = m_preferred;
+		data["fallback"] = m_fallback;
+		data["budget_sec"] = m_budgetSec;
+		data["preferred_us_per_kpoint"] = m_preferredSecPerPoint * 1e9;
+		data["preferred_bytes_per_point"] = m_preferredMbPerPoint * 1024 * 1024;
+		data["fallback_us_per_kpoint"] = m_fallbackSecPerPoint * 1e9;
+		data["fallback_bytes_per_point"] = m_fallbackMbPerPoint * 1024 * 1024;
+		data["storage_write_mb_s"] = m_storageWriteMBs;
+	}
+	return data;
+}
+} // namespace mandeye
@@ -0,0 +1,71 @@
+#pragma once
+#include "lidars/BaseLidarClient.h"
+#include "save_laz.h"
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace mandeye
+{
+//! Point cloud writer, selectable by name from mandeye_config.json ("pointcloud_codec")
+struct PointcloudWriter
+{
+	std::string m_name; //! name used in config, e.g. "laz"
+	std::string m_extension; //! file extension, e.g. ".laz"
+	std::function<std::optional<LazStats>(const std::string& filename, LidarPointsBufferPtr buffer)> m_write;
+};
+
+//! Name of the codec that picks between writers in runtime
+constexpr char AutoCodecName[] = "auto";
+
+//! Returns writer with the given name, nullptr if there is no such writer (or it is not compiled in)
+const PointcloudWriter* getPointcloudWriter(const std::string& name);
+
+//! Returns names of all available writers
+std::vector<std::string> getPointcloudWriterNames();
+
+//! Picks codec for each chunk. In auto mode it falls back to the cheaper writer
+//! when saving with the preferred one takes longer than the budget.
+//! select() and report() are called by the chunk writer, produceStatus() by the status thread.
+class PointcloudCodecSelector
+{
+public:
+	//! @param codec name of the writer or "auto"
+	//! @param budgetSec in auto mode, the time that saving a chunk may take
+	PointcloudCodecSelector(const std::string& codec, double budgetSec);
+
+	//! Returns codec to be used for the chunk with given number of points
+	std::string select(size_t pointsCount);
+
+	//! Report the save duration and the file size of a chunk
+	void report(const std::string& codec, size_t pointsCount, double durationSec, double sizeMb);
+
+	//! Sustained write rate of the drive from the storage benchmark, 0 if unknown.
+	//! Fallback output is larger, on a slow drive it is used only if encoding and writing it is faster than with the preferred writer.
+	void setStorageWriteRate(double mbPerSec);
+
+	nlohmann::json produceStatus() const;
+
+private:
+	const bool m_auto{false};
+	const std::string m_preferred;
+	const std::string m_fallback;
+	const double m_budgetSec{0};
+	//! in fallback, preferred writer is retried once per this many chunks to refresh its cost
+	static constexpr int ProbeInterval = 12;
+
+	//! guards the state below
+	mutable std::mutex m_lock;
+	std::string m_codec;
+	//! last measured encoding cost and output size of the preferred writer
+	double m_preferredSecPerPoint{0};
+	double m_preferredMbPerPoint{0};
+	//! last measured encoding cost and output size of the fallback writer
+	double m_fallbackSecPerPoint{0};
+	double m_fallbackMbPerPoint{0};
+	double m_storageWriteMBs{0};
+	int m_chunksSinceProbe{0};
+};
+} // namespace mandeye
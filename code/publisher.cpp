@@ -1,70 +1,198 @@
 #include "publisher.h"
+#include "utils/ThreadRoles.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
 
 namespace mandeye
 {
-Publisher::Publisher()
-	: m_context(1)
+Publisher::Encoding Publisher::EncodingFromString(const std::string& name)
+{
+	return name == "json" ? Encoding::Json : Encoding::Binary;
+}
+
+Publisher::Publisher(Encoding encoding)
+	: m_encoding(encoding)
+	, m_context(1)
 	, m_publisher(m_context, ZMQ_PUB)
 {
+	// no conflate, it would let time ticks overwrite state and chunk messages and it breaks multipart
+	m_publisher.setsockopt(ZMQ_SNDHWM, 100);
 	m_publisher.bind("tcp://*:5556");
-	m_publisher.setsockopt(ZMQ_CONFLATE, 1); // Keep only the latest task
 	m_thread = std::thread(&Publisher::worker, this);
 }
 Publisher::~Publisher()
 {
-	m_running = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_cv.notify_one();
 	m_thread.join();
 	m_publisher.close();
 }
 
-void Publisher::publish(const nlohmann::json& data)
+void Publisher::send(const char* topic, const void* data, size_t size)
+{
+	try
+	{
+		m_publisher.send(zmq::buffer(topic, std::strlen(topic)), zmq::send_flags::sndmore);
+		m_publisher.send(zmq::buffer(data, size), zmq::send_flags::none);
+	}
+	catch(const zmq::error_t& e)
+	{
+		std::cerr << "Publisher: failed to send " << topic << " : " << e.what() << std::endl;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_sendErrors++;
+	}
+}
+
+void Publisher::send(const char* topic, const mandeye_utils::status::Status& status)
 {
-	auto dataMessage = data.dump();
-	zmq::message_t message(dataMessage.c_str(), dataMessage.size());
-	m_publisher.send(message, zmq::send_flags::none);
+	if(m_encoding == Encoding::Json)
+	{
+		const auto dataMessage = status.toJson().dump();
+		send(topic, dataMessage.data(), dataMessage.size());
+		return;
+	}
+	mandeye_utils::status::encode(status, m_encoded);
+	send(topic, m_encoded.data(), m_encoded.size());
+}
+
+void Publisher::send(const char* topic, const mandeye_utils::status::Chunk& chunk)
+{
+	if(m_encoding == Encoding::Json)
+	{
+		const auto dataMessage = chunk.toJson().dump();
+		send(topic, dataMessage.data(), dataMessage.size());
+		return;
+	}
+	mandeye_utils::status::encode(chunk, m_encoded);
+	send(topic, m_encoded.data(), m_encoded.size());
 }
 
 void Publisher::worker()
 {
+	mandeye_utils::registerThreadRole(mandeye_utils::ThreadRole::Publisher);
+	mandeye_utils::status::Status status;
+	std::deque<mandeye_utils::status::Chunk> chunks;
+	auto nextTick = std::chrono::steady_clock::now();
+	auto nextState = nextTick;
 	while(m_running)
 	{
-		std::this_thread::sleep_for(std::chrono::milliseconds(25));
-		const double time = GetTimeStamp();
-		const double elapsed = GetSessionDuration();
-		nlohmann::json data;
-		if(std::floor(time) != std::floor(m_lastTime))
+		bool sendState = false;
 		{
-			// longer report
 			std::unique_lock<std::mutex> lock(m_mutex);
-			data["time"] = static_cast<uint64_t>(time * 1e9);
-			data["dur"] = static_cast<uint64_t>(elapsed * 1e9);
-			data["stopScanDirectory"] = m_stopScanDirectory;
-			data["continousScanDirectory"] = m_continousScanDirectory;
-			data["mode"] = m_mode;
-			m_lastTime = time;
+			m_cv.wait_until(lock, std::min(nextTick, nextState), [&]() { return !m_running || m_stateChanged || !m_chunks.empty(); });
+			if(!m_running)
+			{
+				break;
+			}
+			std::swap(chunks, m_chunks);
+			const auto now = std::chrono::steady_clock::now();
+			sendState = m_stateChanged || now >= nextState;
+			if(sendState)
+			{
+				if(m_stateChanged)
+				{
+					const double latencyMs = std::chrono::duration<double, std::milli>(now - m_stateChangedAt).count();
+					m_maxStateLatencyMs = std::max(m_maxStateLatencyMs, latencyMs);
+				}
+				m_stateChanged = false;
+				status.stopScanDirectory = m_stopScanDirectory;
+				status.continousScanDirectory = m_continousScanDirectory;
+				status.mode = m_mode;
+			}
 		}
-		else
+
+		// chunk events first, they were queued before the state that followed them
+		for(const auto& chunk : chunks)
 		{
-			// short report
-			std::unique_lock<std::mutex> lock(m_mutex);
-			data["time"] = static_cast<uint64_t>(time * 1e9);
-			data["dur"] = static_cast<uint64_t>(elapsed * 1e9);
+			send(mandeye_utils::status::TopicChunk, chunk);
 		}
-		publish(data);
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		const auto now = std::chrono::steady_clock::now();
+		// clock in every time and state message, so any of them is enough to timestamp data
+		status.timeNs = static_cast<uint64_t>(GetTimeStamp() * 1e9);
+		status.durNs = static_cast<uint64_t>(GetSessionDuration() * 1e9);
+		status.clock = GetClockModel();
+		if(sendState)
+		{
+			status.hasState = true;
+			send(mandeye_utils::status::TopicState, status);
+			nextState = now + StateRepeatInterval;
+		}
+		const bool sendTick = now >= nextTick;
+		if(sendTick)
+		{
+			status.hasState = false;
+			send(mandeye_utils::status::TopicTime, status);
+			nextTick = now + TickInterval;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_sentChunk += chunks.size();
+		m_sentState += sendState ? 1 : 0;
+		m_sentTime += sendTick ? 1 : 0;
+		chunks.clear();
 	}
 }
 
 void Publisher::SetWorkingDirectory(const std::string& stopScanDirectory, const std::string& continousScanDirectory)
 {
-	std::unique_lock<std::mutex> lock(m_mutex);
-	m_stopScanDirectory = stopScanDirectory;
-	m_continousScanDirectory = continousScanDirectory;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if(m_stopScanDirectory == stopScanDirectory && m_continousScanDirectory == continousScanDirectory)
+		{
+			return;
+		}
+		m_stopScanDirectory = stopScanDirectory;
+		m_continousScanDirectory = continousScanDirectory;
+		m_stateChanged = true;
+		m_stateChangedAt = std::chrono::steady_clock::now();
+	}
+	m_cv.notify_one();
 }
 void Publisher::SetMode(const std::string& mode)
 {
-	std::unique_lock<std::mutex> lock(m_mutex);
-	m_mode = mode;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if(m_mode == mode)
+		{
+			return;
+		}
+		m_mode = mode;
+		m_stateChanged = true;
+		m_stateChangedAt = std::chrono::steady_clock::now();
+	}
+	m_cv.notify_one();
+}
+
+void Publisher::PublishChunk(int chunk, const std::string& directory)
+{
+	mandeye_utils::status::Chunk event;
+	event.chunk = static_cast<uint32_t>(chunk);
+	event.timeNs = static_cast<uint64_t>(GetTimeStamp() * 1e9);
+	event.directory = directory;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_chunks.push_back(std::move(event));
+	}
+	m_cv.notify_one();
+}
+
+nlohmann::json Publisher::produceStatus()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	nlohmann::json data;
+	data["encoding"] = m_encoding == Encoding::Json ? "json" : "binary";
+	data["sent_time"] = m_sentTime;
+	data["sent_state"] = m_sentState;
+	data["sent_chunk"] = m_sentChunk;
+	data["send_errors"] = m_sendErrors;
+	data["pending_chunks"] = m_chunks.size();
+	data["max_state_latency_ms"] = m_maxStateLatencyMs;
+	return data;
 }
 
 } // namespace mandeye
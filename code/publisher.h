@@ -1,35 +1,77 @@
 #pragma once
+#include "utils/StatusFormat.h"
 #include "utils/TimeStampReceiver.h"
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <thread>
 #include <zmq.hpp>
 namespace mandeye
 {
+//! Publishes status on ZeroMQ tcp://*:5556 in topics (see mandeye_utils::status):
+//! time tick every TickInterval, state immediately when mode or directories change (and every
+//! StateRepeatInterval for late subscribers), chunk events as soon as a chunk is cut.
 class Publisher : public mandeye_utils::TimeStampReceiver
 {
 public:
 	std::string_view ContinuesMode = "ContinuesMode";
 	std::string_view StopScanMode = "ChunkedMode";
-	Publisher();
+
+	//! Wire format of the status, see mandeye_utils::status
+	enum class Encoding
+	{
+		Binary,
+		Json
+	};
+	//! Encoding from name in config ("binary" or "json"), binary if unknown
+	static Encoding EncodingFromString(const std::string& name);
+
+	explicit Publisher(Encoding encoding = Encoding::Binary);
 	~Publisher();
 	Publisher(const Publisher&) = delete;
 	Publisher& operator=(const Publisher&) = delete;
-	void publish(const nlohmann::json& data);
+
+	static constexpr std::chrono::milliseconds TickInterval{100};
+	static constexpr std::chrono::milliseconds StateRepeatInterval{1000};
+
+	//! Changes are published right away, calling with unchanged values sends nothing
 	void SetWorkingDirectory(const std::string& stopScanDirectory, const std::string& continousScanDirectory);
 	void SetMode(const std::string& mode);
 
+	//! Publishes chunk event, time of the event is the lidar time of this call
+	void PublishChunk(int chunk, const std::string& directory);
+
+	nlohmann::json produceStatus();
+
 private:
 	void worker();
+	void send(const char* topic, const mandeye_utils::status::Status& status);
+	void send(const char* topic, const mandeye_utils::status::Chunk& chunk);
+	void send(const char* topic, const void* data, size_t size);
+
+	Encoding m_encoding;
+	std::vector<uint8_t> m_encoded;
 	std::atomic<bool> m_running{true};
 	std::string m_continousScanDirectory;
 	std::string m_stopScanDirectory;
 	std::string m_mode;
+	bool m_stateChanged{true};
+	std::chrono::steady_clock::time_point m_stateChangedAt;
+	std::deque<mandeye_utils::status::Chunk> m_chunks;
 	zmq::context_t m_context;
 	zmq::socket_t m_publisher;
 	std::thread m_thread;
 	std::mutex m_mutex;
-	double m_lastTime = 0;
+	std::condition_variable m_cv;
+
+	// statistics, guarded by m_mutex
+	uint64_t m_sentTime{0};
+	uint64_t m_sentState{0};
+	uint64_t m_sentChunk{0};
+	uint64_t m_sendErrors{0};
+	double m_maxStateLatencyMs{0};
 };
 } // namespace mandeye
\ No newline at end of file
@@ -1,43 +1,90 @@
 #include "save_data.h"
 #include "hardware_config/mandeye.h"
+#include "pointcloud_writers.h"
 #include "save_laz.h"
+#include "utils/Metrics.h"
 #include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 
 namespace mandeye
 {
 
-std::pair<std::string, std::optional<LazStats>> savePointcloudData(LidarPointsBufferPtr buffer, const std::string& directory, int chunk)
+void syncFileSystem()
+{
+	static auto& duration = mandeye_utils::metrics::Registry::Instance().AddHistogram(
+		"mandeye_sync_duration_seconds", "Duration of flushing file system buffers", {0.01, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5});
+	const auto start = std::chrono::steady_clock::now();
+	system("sync");
+	duration.Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+void closeOrThrow(std::ofstream& stream, const std::filesystem::path& path)
+{
+	if(stream.is_open())
+	{
+		stream.close();
+	}
+	if(!stream)
+	{
+		throw std::runtime_error("Failed to write " + path.string());
+	}
+}
+
+std::pair<std::string, LazStats>
+savePointcloudData(LidarPointsBufferPtr buffer, const std::string& directory, int chunk, const std::string& codec)
 {
 	using namespace std::chrono_literals;
+	const PointcloudWriter* writer = getPointcloudWriter(codec);
+	if(writer == nullptr)
+	{
+		std::cout << "Unknown pointcloud codec " << codec << ", using laz" << std::endl;
+		writer = getPointcloudWriter("laz");
+	}
 	char lidarName[256];
 
 	const auto start = std::chrono::steady_clock::now();
-	snprintf(lidarName, 256, "lidar%04d.laz", chunk);
+	snprintf(lidarName, 256, "lidar%04d%s", chunk, writer->m_extension.c_str());
 	std::filesystem::path lidarFilePath = std::filesystem::path(directory) / std::filesystem::path(lidarName);
 	std::cout << "Savig lidar buffer of size " << buffer->size() << " to " << lidarFilePath << std::endl;
-	auto saveStatus = saveLaz(lidarFilePath.string(), buffer);
+	auto saveStatus = writer->m_write(lidarFilePath.string(), buffer);
 
-	system("sync");
-	const auto end = std::chrono::steady_clock::now();
-	const std::chrono::duration<float> elapsed_seconds = end - start;
-	if(saveStatus)
-	{
-		saveStatus->m_saveDurationSec2 = elapsed_seconds.count();
-		hardware::OnSavedLaz(lidarFilePath);
-	}
-	else
+	if(!saveStatus)
 	{
-		std::cout << "Error saving laz file " << lidarFilePath << std::endl;
+		throw std::runtime_error("Error saving pointcloud file " + lidarFilePath.string());
 	}
-	return {lidarFilePath.string(), saveStatus};
+
+	syncFileSystem();
+	const auto end = std::chrono::steady_clock::now();
+	const std::chrono::duration<float> elapsed_seconds = end - start;
+	saveStatus->m_saveDurationSec2 = elapsed_seconds.count();
+	saveStatus->m_codec = writer->m_name;
+	hardware::OnSavedLaz(lidarFilePath);
+	return {lidarFilePath.string(), *saveStatus};
+}
+
+std::string saveSessionIndex(nlohmann::json& index, const LazStats& stats, const std::string& directory, int chunk)
+{
+	nlohmann::json entry = stats.produceStatus();
+	entry["chunk"] = chunk;
+	entry["filename"] = std::filesystem::path(stats.m_filename).filename().string();
+	index["chunks"].push_back(entry);
+
+	// replaced by rename, so downloads of a session being recorded never see a half written index
+	std::filesystem::path indexFilePath = std::filesystem::path(directory) / std::filesystem::path("session_index.json");
+	const std::filesystem::path partialPath = indexFilePath.string() + ".part";
+	std::ofstream indexStream(partialPath);
+	indexStream << std::setw(4) << index;
+	closeOrThrow(indexStream, partialPath);
+	std::filesystem::rename(partialPath, indexFilePath);
+	return indexFilePath.string();
 }
 
-void saveLidarList(const std::unordered_map<uint32_t, std::string>& lidars, const std::string& directory, int chunk)
+std::string saveLidarList(const std::unordered_map<uint32_t, std::string>& lidars, const std::string& directory, int chunk)
 {
 	using namespace std::chrono_literals;
 	char lidarName[256];
@@ -50,11 +97,12 @@ void saveLidarList(const std::unordered_map<uint32_t, std::string>& lidars, cons
 	{
 		lidarStream << id << " " << sn << "\n";
 	}
-	system("sync");
-	return;
+	closeOrThrow(lidarStream, lidarFilePath);
+	syncFileSystem();
+	return lidarFilePath.string();
 }
 
-void saveImuData(LidarIMUBufferPtr buffer, const std::string& directory, int chunk)
+std::string saveImuData(LidarIMUBufferPtr buffer, const std::string& directory, int chunk)
 {
 	using namespace std::chrono_literals;
 	char lidarName[256];
@@ -73,53 +121,59 @@ void saveImuData(LidarIMUBufferPtr buffer, const std::string& directory, int chu
 			   << p.laser_id << " " << p.epoch_time << "\n";
 		}
 	}
-	lidarStream << ss.rdbuf();
+	lidarStream << ss.str(); // streaming an empty rdbuf() would set failbit
 
-	lidarStream.close();
-	system("sync");
-	return;
+	closeOrThrow(lidarStream, lidarFilePath);
+	syncFileSystem();
+	return lidarFilePath.string();
 }
 
-void saveGnssData(std::deque<std::string>& buffer, const std::string& directory, int chunk)
+std::string saveGnssBinaryData(const GnssLog& log, const std::string& directory, int chunk)
+{
+	char gnssName[256];
+	snprintf(gnssName, 256, "gnss%04d.gnsb", chunk);
+	std::filesystem::path gnssFilePath = std::filesystem::path(directory) / std::filesystem::path(gnssName);
+	std::cout << "Savig gnss records of size " << log.records.size() << " to " << gnssFilePath << std::endl;
+	std::ofstream gnssStream(gnssFilePath.c_str(), std::ios::binary);
+	log.writeRecords(gnssStream);
+
+	closeOrThrow(gnssStream, gnssFilePath);
+	syncFileSystem();
+	return gnssFilePath.string();
+}
+
+std::string saveGnssData(const GnssLog& log, const std::string& directory, int chunk)
 {
 	using namespace std::chrono_literals;
 	char lidarName[256];
 	snprintf(lidarName, 256, "gnss%04d.gnss", chunk);
 	std::filesystem::path lidarFilePath = std::filesystem::path(directory) / std::filesystem::path(lidarName);
-	std::cout << "Savig gnss buffer of size " << buffer.size() << " to " << lidarFilePath << std::endl;
+	std::cout << "Savig gnss buffer of size " << log.records.size() << " to " << lidarFilePath << std::endl;
 	std::ofstream lidarStream(lidarFilePath.c_str());
 	std::stringstream ss;
+	log.writeFixes(ss);
+	lidarStream << ss.str(); // streaming an empty rdbuf() would set failbit
 
-	for(const auto& p : buffer)
-	{
-		ss << p;
-	}
-	lidarStream << ss.rdbuf();
-
-	lidarStream.close();
-	system("sync");
-	return;
+	closeOrThrow(lidarStream, lidarFilePath);
+	syncFileSystem();
+	return lidarFilePath.string();
 }
 
-void saveGnssRawData(std::deque<std::string>& buffer, const std::string& directory, int chunk)
+std::string saveGnssRawData(const GnssLog& log, const std::string& directory, int chunk)
 {
 	using namespace std::chrono_literals;
 	char lidarName[256];
 	snprintf(lidarName, 256, "gnss%04d.nmea", chunk);
 	std::filesystem::path lidarFilePath = std::filesystem::path(directory) / std::filesystem::path(lidarName);
-	std::cout << "Savig gnss raw buffer of size " << buffer.size() << " to " << lidarFilePath << std::endl;
+	std::cout << "Savig gnss raw buffer of size " << log.sentences.size() << " to " << lidarFilePath << std::endl;
 	std::ofstream lidarStream(lidarFilePath.c_str());
 	std::stringstream ss;
+	log.writeSentences(ss);
+	lidarStream << ss.str(); // streaming an empty rdbuf() would set failbit
 
-	for(const auto& p : buffer)
-	{
-		ss << p;
-	}
-	lidarStream << ss.rdbuf();
-
-	lidarStream.close();
-	system("sync");
-	return;
+	closeOrThrow(lidarStream, lidarFilePath);
+	syncFileSystem();
+	return lidarFilePath.string();
 }
 
 } // namespace mandeye
\ No newline at end of file
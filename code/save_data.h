@@ -1,16 +1,33 @@
 #pragma once
+#include "GnssLog.h"
 #include "lidars/BaseLidarClient.h"
 #include "save_laz.h"
 #include <deque>
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
 #include <optional>
 #include <string>
 #include <unordered_map>
 
 namespace mandeye
 {
-std::pair<std::string, std::optional<LazStats>> savePointcloudData(LidarPointsBufferPtr buffer, const std::string& directory, int chunk);
-void saveLidarList(const std::unordered_map<uint32_t, std::string>& lidars, const std::string& directory, int chunk);
-void saveImuData(LidarIMUBufferPtr buffer, const std::string& directory, int chunk);
-void saveGnssData(std::deque<std::string>& buffer, const std::string& directory, int chunk);
-void saveGnssRawData(std::deque<std::string>& buffer, const std::string& directory, int chunk);
+// functions saving a file return its path, they throw std::runtime_error if the file could not be written
+
+//! Closes stream, throws std::runtime_error if it failed to open or to write, e.g. drive is full or gone
+void closeOrThrow(std::ofstream& stream, const std::filesystem::path& path);
+
+//! Saves point cloud with the writer registered under codec name (see pointcloud_writers.h)
+std::pair<std::string, LazStats>
+savePointcloudData(LidarPointsBufferPtr buffer, const std::string& directory, int chunk, const std::string& codec = "laz");
+//! Appends chunk to session index and rewrites session_index.json in the directory
+std::string saveSessionIndex(nlohmann::json& index, const LazStats& stats, const std::string& directory, int chunk);
+std::string saveLidarList(const std::unordered_map<uint32_t, std::string>& lidars, const std::string& directory, int chunk);
+std::string saveImuData(LidarIMUBufferPtr buffer, const std::string& directory, int chunk);
+//! Typed binary log of the decoded sentences, gnssNNNN.gnsb, see utils/GnssFormat.h
+std::string saveGnssBinaryData(const GnssLog& log, const std::string& directory, int chunk);
+std::string saveGnssData(const GnssLog& log, const std::string& directory, int chunk);
+std::string saveGnssRawData(const GnssLog& log, const std::string& directory, int chunk);
+//! Flushes file system buffers (sync), its duration goes to metric mandeye_sync_duration_seconds
+void syncFileSystem();
 } // namespace mandeye
\ No newline at end of file
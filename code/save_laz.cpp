@@ -7,6 +7,7 @@ nlohmann::json mandeye::LazStats::produceStatus() const
 {
 	nlohmann::json status;
 	status["filename"] = m_filename;
+	status["codec"] = m_codec;
 	status["points_count"] = m_pointsCount;
 	status["save_duration_sec1"] = m_saveDurationSec1;
 	status["save_duration_sec2"] = m_saveDurationSec2;
@@ -14,7 +15,7 @@ nlohmann::json mandeye::LazStats::produceStatus() const
 	status["decimation_step"] = m_decimationStep;
 	return status;
 }
-std::optional<mandeye::LazStats> mandeye::saveLaz(const std::string& filename, LidarPointsBufferPtr buffer)
+std::optional<mandeye::LazStats> mandeye::saveLaz(const std::string& filename, LidarPointsBufferPtr buffer, bool compress)
 {
 	ZoneScoped;
 	TracyPlot("laz_buffer_points", (int64_t)buffer->size());
@@ -114,9 +115,8 @@ std::optional<mandeye::LazStats> mandeye::saveLaz(const std::string& filename, L
 
 	// optional: use the bounding box and the scale factor to create a "good" offset
 	// open the writer
-	laszip_BOOL compress = (strstr(filename.c_str(), ".laz") != 0);
 	const auto start = std::chrono::high_resolution_clock::now();
-	if(laszip_open_writer(laszip_writer, filename.c_str(), compress))
+	if(laszip_open_writer(laszip_writer, filename.c_str(), compress ? 1 : 0))
 	{
 		fprintf(stderr, "DLL ERROR: opening laszip writer for '%s'\n", filename.c_str());
 		return nullopt;
@@ -12,9 +12,12 @@ struct LazStats
 	float m_saveDurationSec1{-1.f};
 	uint64_t m_pointsCount{0};
 	std::string m_filename;
+	std::string m_codec; //! name of the writer used, see pointcloud_writers.h
 	int m_decimationStep{1};
 	nlohmann::json produceStatus() const;
 };
 
-std::optional<LazStats> saveLaz(const std::string& filename, LidarPointsBufferPtr buffer);
+//! Saves buffer as LAS 1.2 point format 1
+//! @param compress if true file is LAZ compressed, otherwise plain LAS is written
+std::optional<LazStats> saveLaz(const std::string& filename, LidarPointsBufferPtr buffer, bool compress = true);
 } // namespace mandeye
\ No newline at end of file
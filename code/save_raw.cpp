@@ -0,0 +1,277 @@
+#include "save_raw.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <tracy/Tracy.hpp>
+#include <vector>
+#ifdef MANDEYE_USE_LZ4
+#	include <lz4.h>
+#endif
+#ifdef MANDEYE_USE_ZSTD
+#	include <zstd.h>
+#endif
+
+namespace mandeye
+{
+namespace
+{
+constexpr uint32_t PointsPerBlock = 65536;
+
+//! Compresses block, returns false if compression failed or is not available
+bool compressBlock(RawCompression compression, const std::vector<char>& input, std::vector<char>& output)
+{
+	switch(compression)
+	{
+#ifdef MANDEYE_USE_LZ4
+	case RawCompression::LZ4:
+	{
+		output.resize(LZ4_compressBound(input.size()));
+		const int size = LZ4_compress_default(input.data(), output.data(), input.size(), output.size());
+		if(size <= 0)
+		{
+			return false;
+		}
+		output.resize(size);
+		return true;
+	}
+#endif
+#ifdef MANDEYE_USE_ZSTD
+	case RawCompression::ZSTD:
+	{
+		output.resize(ZSTD_compressBound(input.size()));
+		const size_t size = ZSTD_compress(output.data(), output.size(), input.data(), input.size(), 1);
+		if(ZSTD_isError(size))
+		{
+			return false;
+		}
+		output.resize(size);
+		return true;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+//! Decompresses block to its known raw size, returns false if the block is corrupted or compression is not available
+bool decompressBlock(RawCompression compression, const std::vector<char>& input, std::vector<char>& output)
+{
+	switch(compression)
+	{
+#ifdef MANDEYE_USE_LZ4
+	case RawCompression::LZ4:
+		return LZ4_decompress_safe(input.data(), output.data(), input.size(), output.size()) == static_cast<int>(output.size());
+#endif
+#ifdef MANDEYE_USE_ZSTD
+	case RawCompression::ZSTD:
+	{
+		const size_t size = ZSTD_decompress(output.data(), output.size(), input.data(), input.size());
+		return !ZSTD_isError(size) && size == output.size();
+	}
+#endif
+	default:
+		return false;
+	}
+}
+} // namespace
+
+bool isRawCompressionAvailable(RawCompression compression)
+{
+	switch(compression)
+	{
+	case RawCompression::NONE:
+		return true;
+	case RawCompression::LZ4:
+#ifdef MANDEYE_USE_LZ4
+		return true;
+#else
+		return false;
+#endif
+	case RawCompression::ZSTD:
+#ifdef MANDEYE_USE_ZSTD
+		return true;
+#else
+		return false;
+#endif
+	}
+	return false;
+}
+
+std::optional<LazStats> saveRaw(const std::string& filename, LidarPointsBufferPtr buffer, RawCompression compression)
+{
+	ZoneScoped;
+	if(!isRawCompressionAvailable(compression))
+	{
+		std::cerr << "Raw compression " << static_cast<uint32_t>(compression) << " is not compiled in" << std::endl;
+		return std::nullopt;
+	}
+	LazStats stats;
+	stats.m_filename = filename;
+	stats.m_pointsCount = buffer->size();
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	std::ofstream out(filename, std::ios::binary);
+	if(!out)
+	{
+		std::cerr << "Failed to open " << filename << " for writing" << std::endl;
+		return std::nullopt;
+	}
+
+	RawPointcloudHeader header;
+	header.m_recordSize = sizeof(RawPointRecord);
+	header.m_compression = static_cast<uint32_t>(compression);
+	header.m_pointsPerBlock = PointsPerBlock;
+	header.m_pointsCount = buffer->size();
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<char> block;
+	std::vector<char> compressed;
+	block.reserve(PointsPerBlock * sizeof(RawPointRecord));
+	auto it = buffer->begin();
+	while(it != buffer->end())
+	{
+		block.clear();
+		for(uint32_t i = 0; i < PointsPerBlock && it != buffer->end(); i++, it++)
+		{
+			RawPointRecord record;
+			record.x = it->x;
+			record.y = it->y;
+			record.z = it->z;
+			record.intensity = it->intensity;
+			record.timestamp = it->timestamp;
+			record.laser_id = it->laser_id;
+			record.line_id = it->line_id;
+			record.tag = it->tag;
+			const char* recordPtr = reinterpret_cast<const char*>(&record);
+			block.insert(block.end(), recordPtr, recordPtr + sizeof(record));
+		}
+
+		const std::vector<char>* stored = &block;
+		if(compression != RawCompression::NONE)
+		{
+			if(!compressBlock(compression, block, compressed))
+			{
+				std::cerr << "Failed to compress block of " << filename << std::endl;
+				return std::nullopt;
+			}
+			stored = &compressed;
+		}
+		const uint32_t sizes[2]{static_cast<uint32_t>(block.size()), static_cast<uint32_t>(stored->size())};
+		out.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+		out.write(stored->data(), stored->size());
+	}
+	out.close();
+	if(!out)
+	{
+		std::cerr << "Failed to write " << filename << std::endl;
+		return std::nullopt;
+	}
+
+	const auto end = std::chrono::high_resolution_clock::now();
+	const std::chrono::duration<float> elapsed_seconds = end - start;
+	stats.m_saveDurationSec1 = elapsed_seconds.count();
+	std::error_code ec;
+	const auto size = std::filesystem::file_size(filename, ec);
+	if(!ec)
+	{
+		stats.m_sizeMb = static_cast<float>(size) / (1024 * 1024);
+	}
+	return stats;
+}
+
+LidarPointsBufferPtr loadRaw(const std::string& filename)
+{
+	std::ifstream in(filename, std::ios::binary);
+	if(!in)
+	{
+		std::cerr << "Failed to open " << filename << std::endl;
+		return nullptr;
+	}
+	RawPointcloudHeader header;
+	const RawPointcloudHeader expected;
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if(!in || std::memcmp(header.m_magic, expected.m_magic, sizeof(header.m_magic)) != 0)
+	{
+		std::cerr << filename << " is not a raw point cloud" << std::endl;
+		return nullptr;
+	}
+	if(header.m_version != expected.m_version || header.m_recordSize != sizeof(RawPointRecord))
+	{
+		std::cerr << filename << " has unsupported version " << header.m_version << " or record size " << header.m_recordSize
+				  << std::endl;
+		return nullptr;
+	}
+	const auto compression = static_cast<RawCompression>(header.m_compression);
+	if(!isRawCompressionAvailable(compression))
+	{
+		std::cerr << "Raw compression " << header.m_compression << " of " << filename << " is not compiled in" << std::endl;
+		return nullptr;
+	}
+
+	auto buffer = std::make_shared<LidarPointsBuffer>();
+	buffer->reserve(header.m_pointsCount);
+	std::vector<char> block;
+	std::vector<char> stored;
+	const uint64_t maxBlockSize = static_cast<uint64_t>(header.m_pointsPerBlock) * sizeof(RawPointRecord);
+	while(buffer->size() < header.m_pointsCount)
+	{
+		uint32_t sizes[2];
+		in.read(reinterpret_cast<char*>(sizes), sizeof(sizes));
+		if(!in || sizes[0] % sizeof(RawPointRecord) != 0 || sizes[0] > maxBlockSize || sizes[1] > maxBlockSize * 2)
+		{
+			std::cerr << filename << " is truncated or corrupted after " << buffer->size() << " points" << std::endl;
+			return nullptr;
+		}
+		block.resize(sizes[0]);
+		if(compression == RawCompression::NONE)
+		{
+			if(sizes[1] == sizes[0])
+			{
+				in.read(block.data(), block.size());
+			}
+			if(!in || sizes[1] != sizes[0])
+			{
+				std::cerr << filename << " is truncated or corrupted after " << buffer->size() << " points" << std::endl;
+				return nullptr;
+			}
+		}
+		else
+		{
+			stored.resize(sizes[1]);
+			in.read(stored.data(), stored.size());
+			if(!in || !decompressBlock(compression, stored, block))
+			{
+				std::cerr << filename << " is truncated or corrupted after " << buffer->size() << " points" << std::endl;
+				return nullptr;
+			}
+		}
+		for(size_t offset = 0; offset < block.size(); offset += sizeof(RawPointRecord))
+		{
+			RawPointRecord record;
+			std::memcpy(&record, block.data() + offset, sizeof(record));
+			LidarPoint point;
+			point.x = record.x;
+			point.y = record.y;
+			point.z = record.z;
+			point.intensity = record.intensity;
+			point.timestamp = record.timestamp;
+			point.laser_id = record.laser_id;
+			point.line_id = record.line_id;
+			point.tag = record.tag;
+			buffer->push_back(point);
+		}
+		if(block.empty())
+		{
+			break;
+		}
+	}
+	if(buffer->size() != header.m_pointsCount)
+	{
+		std::cerr << filename << " holds " << buffer->size() << " points, header says " << header.m_pointsCount << std::endl;
+		return nullptr;
+	}
+	return buffer;
+}
+} // namespace mandeye
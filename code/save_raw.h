@@ -0,0 +1,51 @@
+#pragma once
+#include "lidars/BaseLidarClient.h"
+#include "save_laz.h"
+#include <optional>
+#include <string>
+namespace mandeye
+{
+//! Block compression used by the raw point cloud format
+enum class RawCompression : uint32_t
+{
+	NONE = 0,
+	LZ4 = 1,
+	ZSTD = 2,
+};
+
+//! Header of the raw point cloud file (little endian, packed).
+//! Header is followed by blocks: uint32 raw size, uint32 stored size, stored bytes.
+//! Raw block contains records of RawPointRecord, no decimation is applied.
+#pragma pack(push, 1)
+struct RawPointcloudHeader
+{
+	char m_magic[8]{'M', 'A', 'N', 'D', 'R', 'A', 'W', '\0'};
+	uint32_t m_version{1};
+	uint32_t m_recordSize{0};
+	uint32_t m_compression{0};
+	uint32_t m_pointsPerBlock{0};
+	uint64_t m_pointsCount{0};
+};
+
+struct RawPointRecord
+{
+	float x;
+	float y;
+	float z;
+	float intensity;
+	uint64_t timestamp;
+	uint16_t laser_id;
+	uint8_t line_id;
+	uint8_t tag;
+};
+#pragma pack(pop)
+
+//! Returns true if given compression was compiled in
+bool isRawCompressionAvailable(RawCompression compression);
+
+//! Saves buffer in the raw binary format, much cheaper on CPU than LAZ
+std::optional<LazStats> saveRaw(const std::string& filename, LidarPointsBufferPtr buffer, RawCompression compression);
+
+//! Loads file written by saveRaw, nullptr if it is not a raw point cloud, is truncated or its compression is not compiled in
+LidarPointsBufferPtr loadRaw(const std::string& filename);
+} // namespace mandeye
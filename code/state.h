@@ -37,4 +37,30 @@ const std::map<States, std::string> StatesToString{
 	{States::LIDAR_ERROR, "LIDAR_ERROR"},
 	{States::USB_IO_ERROR, "USB_IO_ERROR"},
 };
+
+//! Events that wake up the state machine
+enum class Events
+{
+	TIMER = 0, //! deadline set by the state machine has passed
+	START_SCAN = 10, //! HTTP or console request
+	STOP_SCAN = 20, //! HTTP or console request
+	TRIGGER_STOP_SCAN = 30, //! button or HTTP request
+	TRIGGER_CONTINOUS_SCANNING = 40, //! button
+	WRITER_DONE = 50, //! chunk writer finished a chunk
+	WRITER_ERROR = 60, //! chunk writer failed to save a chunk, or spool migration gave up on a file
+	LIDAR_ERROR = 70, //! lidar failed to start
+	SHUTDOWN = 100, //! program is closing
+};
+
+const std::map<Events, std::string> EventsToString{
+	{Events::TIMER, "TIMER"},
+	{Events::START_SCAN, "START_SCAN"},
+	{Events::STOP_SCAN, "STOP_SCAN"},
+	{Events::TRIGGER_STOP_SCAN, "TRIGGER_STOP_SCAN"},
+	{Events::TRIGGER_CONTINOUS_SCANNING, "TRIGGER_CONTINOUS_SCANNING"},
+	{Events::WRITER_DONE, "WRITER_DONE"},
+	{Events::WRITER_ERROR, "WRITER_ERROR"},
+	{Events::LIDAR_ERROR, "LIDAR_ERROR"},
+	{Events::SHUTDOWN, "SHUTDOWN"},
+};
 } // namespace mandeye
\ No newline at end of file
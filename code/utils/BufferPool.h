@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+namespace mandeye_utils
+{
+//! Pool of buffers that are recycled instead of freed, so in steady state no heap allocation is done for the data.
+//! A buffer handed out by Acquire goes back to the pool when the consumer (e.g. chunk writer) drops the last reference.
+//! Buffer has to be a vector-like container (clear, capacity, reserve, shrink_to_fit).
+template <typename Buffer>
+class BufferPool
+{
+public:
+	//! @param maxBuffers number of pooled buffers, when all are in use a temporary buffer is allocated
+	explicit BufferPool(size_t maxBuffers = 3)
+		: m_maxBuffers(maxBuffers)
+	{ }
+
+	//! Returns an empty buffer, keeping capacity of the recycled one
+	std::shared_ptr<Buffer> Acquire()
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		for(auto& buffer : m_buffers)
+		{
+			// pool holds the only reference, consumer is done with the buffer
+			if(buffer.use_count() == 1)
+			{
+				std::atomic_thread_fence(std::memory_order_acquire);
+				Recycle(*buffer);
+				m_recycled++;
+				return buffer;
+			}
+		}
+		auto buffer = std::make_shared<Buffer>();
+		buffer->reserve(m_lastSize);
+		m_allocated++;
+		if(m_buffers.size() < m_maxBuffers)
+		{
+			m_buffers.push_back(buffer);
+		}
+		else
+		{
+			// consumer is behind, this one is freed after use
+			m_overflows++;
+		}
+		return buffer;
+	}
+
+	nlohmann::json produceStatus()
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		nlohmann::json data;
+		size_t inUse = 0;
+		size_t capacity = 0;
+		for(const auto& buffer : m_buffers)
+		{
+			inUse += buffer.use_count() > 1 ? 1 : 0;
+			capacity += buffer->capacity();
+		}
+		data["pooled"] = m_buffers.size();
+		data["in_use"] = inUse;
+		data["capacity_mb"] = static_cast<double>(capacity * sizeof(typename Buffer::value_type)) / (1024 * 1024);
+		data["allocated"] = m_allocated;
+		data["recycled"] = m_recycled;
+		data["overflows"] = m_overflows;
+		return data;
+	}
+
+private:
+	//! Buffers much larger than their last use (e.g. after a long stop scan) are shrunk, not to keep the memory forever
+	void Recycle(Buffer& buffer)
+	{
+		const size_t size = buffer.size();
+		m_lastSize = size;
+		buffer.clear();
+		if(buffer.capacity() > MinShrinkCapacity && buffer.capacity() > 2 * size)
+		{
+			buffer.shrink_to_fit();
+			buffer.reserve(size);
+		}
+	}
+
+	static constexpr size_t MinShrinkCapacity = 1 << 16;
+
+	std::mutex m_mutex;
+	size_t m_maxBuffers;
+	std::vector<std::shared_ptr<Buffer>> m_buffers;
+	size_t m_lastSize{0};
+	uint64_t m_allocated{0};
+	uint64_t m_recycled{0};
+	uint64_t m_overflows{0};
+};
+} // namespace mandeye_utils
@@ -0,0 +1,239 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+namespace mandeye_utils
+{
+//! Linear model of the lidar clock against the host monotonic clock (steady_clock, CLOCK_MONOTONIC):
+//! lidar = refLidarNs + (host - refHostNs) * (1 + driftPpm * 1e-6)
+//! The offset includes the mean delivery latency of packets to the host.
+struct ClockModel
+{
+	bool valid{false};
+	int64_t refHostNs{0}; //! host monotonic time of reference point
+	uint64_t refLidarNs{0}; //! lidar time at reference point
+	double driftPpm{0}; //! lidar clock rate against host clock, in ppm
+	double accuracyNs{0}; //! largest residual of samples used for the fit
+	int64_t realtimeOffsetNs{0}; //! system_clock minus steady_clock at last sample
+	uint32_t samples{0}; //! samples used for the fit
+
+	//! Lidar time in nanoseconds for host monotonic time in nanoseconds
+	uint64_t toLidarNs(int64_t hostMonotonicNs) const
+	{
+		const double dt = double(hostMonotonicNs - refHostNs);
+		return refLidarNs + static_cast<int64_t>(std::llround(dt * (1.0 + driftPpm * 1e-6)));
+	}
+
+	uint64_t toLidarNs(std::chrono::steady_clock::time_point hostTime) const
+	{
+		return toLidarNs(std::chrono::duration_cast<std::chrono::nanoseconds>(hostTime.time_since_epoch()).count());
+	}
+
+	uint64_t toLidarNs(std::chrono::system_clock::time_point hostTime) const
+	{
+		return toLidarNs(std::chrono::duration_cast<std::chrono::nanoseconds>(hostTime.time_since_epoch()).count() - realtimeOffsetNs);
+	}
+
+	nlohmann::json toJson() const
+	{
+		nlohmann::json data;
+		data["valid"] = valid;
+		data["ref_host_ns"] = refHostNs;
+		data["ref_lidar_ns"] = refLidarNs;
+		data["drift_ppm"] = driftPpm;
+		data["accuracy_ns"] = accuracyNs;
+		data["realtime_offset_ns"] = realtimeOffsetNs;
+		data["samples"] = samples;
+		return data;
+	}
+
+	static ClockModel fromJson(const nlohmann::json& data)
+	{
+		ClockModel model;
+		model.valid = data.value("valid", false);
+		model.refHostNs = data.value("ref_host_ns", int64_t{0});
+		model.refLidarNs = data.value("ref_lidar_ns", uint64_t{0});
+		model.driftPpm = data.value("drift_ppm", 0.0);
+		model.accuracyNs = data.value("accuracy_ns", 0.0);
+		model.realtimeOffsetNs = data.value("realtime_offset_ns", int64_t{0});
+		model.samples = data.value("samples", uint32_t{0});
+		return model;
+	}
+};
+
+//! Fits ClockModel to (host, lidar) samples in a sliding window.
+//! Least squares fit, then samples further than 3 sigma (estimated with MAD) from the line are
+//! rejected and the line is fitted again. A sample far from the prediction (lidar clock jumped,
+//! e.g. PTP lock) restarts the window.
+class ClockModelFitter
+{
+public:
+	static constexpr size_t WindowSize = 128;
+	static constexpr size_t MinSamples = 4;
+	static constexpr double JumpThresholdNs = 100e6;
+	static constexpr double MinRejectThresholdNs = 1e3;
+
+	//! @returns fitted model, not valid until MinSamples are collected
+	ClockModel AddSample(int64_t hostMonotonicNs, int64_t hostRealtimeNs, uint64_t lidarNs)
+	{
+		if(m_model.valid)
+		{
+			const double error = double(int64_t(lidarNs - m_model.toLidarNs(hostMonotonicNs)));
+			if(std::abs(error) > JumpThresholdNs)
+			{
+				m_count = 0;
+				m_resets++;
+			}
+		}
+		m_samples[m_next] = {hostMonotonicNs, lidarNs};
+		m_next = (m_next + 1) % WindowSize;
+		m_count = std::min(m_count + 1, WindowSize);
+
+		m_model = Fit();
+		m_model.realtimeOffsetNs = hostRealtimeNs - hostMonotonicNs;
+		return m_model;
+	}
+
+	uint64_t GetResets() const
+	{
+		return m_resets;
+	}
+
+private:
+	struct Sample
+	{
+		int64_t hostNs;
+		uint64_t lidarNs;
+	};
+
+	struct Line
+	{
+		double slope{1.0};
+		double intercept{0.0};
+	};
+
+	//! Fits line to first count samples of the scratch buffers
+	Line FitLine(size_t count) const
+	{
+		const auto& x = m_x;
+		const auto& y = m_y;
+		const auto& use = m_use;
+		double n = 0, sx = 0, sy = 0;
+		for(size_t i = 0; i < count; i++)
+		{
+			if(use[i])
+			{
+				n++;
+				sx += x[i];
+				sy += y[i];
+			}
+		}
+		const double mx = sx / n;
+		const double my = sy / n;
+		double sxx = 0, sxy = 0;
+		for(size_t i = 0; i < count; i++)
+		{
+			if(use[i])
+			{
+				sxx += (x[i] - mx) * (x[i] - mx);
+				sxy += (x[i] - mx) * (y[i] - my);
+			}
+		}
+		Line line;
+		line.slope = sxx > 0 ? sxy / sxx : 1.0;
+		line.intercept = my - line.slope * mx;
+		return line;
+	}
+
+	//! Runs on every sample on the ingest thread, works in member scratch buffers without allocating
+	ClockModel Fit()
+	{
+		ClockModel model;
+		if(m_count < MinSamples)
+		{
+			return model;
+		}
+		// relative to newest sample, so doubles keep nanosecond precision
+		const Sample& ref = m_samples[(m_next + WindowSize - 1) % WindowSize];
+		auto& x = m_x;
+		auto& y = m_y;
+		auto& use = m_use;
+		for(size_t i = 0; i < m_count; i++)
+		{
+			const Sample& s = m_samples[(m_next + WindowSize - m_count + i) % WindowSize];
+			x[i] = double(s.hostNs - ref.hostNs);
+			y[i] = double(int64_t(s.lidarNs - ref.lidarNs));
+		}
+
+		std::fill(use.begin(), use.begin() + m_count, true);
+		Line line = FitLine(m_count);
+
+		auto& residuals = m_residuals;
+		auto& sorted = m_sorted;
+		for(size_t i = 0; i < m_count; i++)
+		{
+			residuals[i] = y[i] - (line.intercept + line.slope * x[i]);
+		}
+		const auto sortedEnd = std::copy(residuals.begin(), residuals.begin() + m_count, sorted.begin());
+		const auto sortedMiddle = sorted.begin() + m_count / 2;
+		std::nth_element(sorted.begin(), sortedMiddle, sortedEnd);
+		const double median = *sortedMiddle;
+		for(auto it = sorted.begin(); it != sortedEnd; ++it)
+		{
+			*it = std::abs(*it - median);
+		}
+		std::nth_element(sorted.begin(), sortedMiddle, sortedEnd);
+		const double sigma = 1.4826 * *sortedMiddle;
+		const double threshold = std::max(3.0 * sigma, MinRejectThresholdNs);
+
+		size_t inliers = 0;
+		for(size_t i = 0; i < m_count; i++)
+		{
+			use[i] = std::abs(residuals[i] - median) <= threshold;
+			inliers += use[i] ? 1 : 0;
+		}
+		if(inliers >= MinSamples)
+		{
+			line = FitLine(m_count);
+		}
+		else
+		{
+			std::fill(use.begin(), use.begin() + m_count, true);
+			inliers = m_count;
+		}
+
+		double accuracy = 0;
+		for(size_t i = 0; i < m_count; i++)
+		{
+			if(use[i])
+			{
+				accuracy = std::max(accuracy, std::abs(y[i] - (line.intercept + line.slope * x[i])));
+			}
+		}
+
+		model.valid = true;
+		model.refHostNs = ref.hostNs;
+		model.refLidarNs = ref.lidarNs + static_cast<int64_t>(std::llround(line.intercept));
+		model.driftPpm = (line.slope - 1.0) * 1e6;
+		model.accuracyNs = accuracy;
+		model.samples = static_cast<uint32_t>(inliers);
+		return model;
+	}
+
+	std::array<Sample, WindowSize> m_samples{};
+	//! scratch buffers of Fit, samples relative to the newest one
+	std::array<double, WindowSize> m_x{};
+	std::array<double, WindowSize> m_y{};
+	std::array<bool, WindowSize> m_use{};
+	std::array<double, WindowSize> m_residuals{};
+	std::array<double, WindowSize> m_sorted{};
+	size_t m_next{0};
+	size_t m_count{0};
+	uint64_t m_resets{0};
+	ClockModel m_model;
+};
+} // namespace mandeye_utils
@@ -0,0 +1,251 @@
+#pragma once
+#include "utils/UbxProtocol.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace mandeye_utils
+{
+//! Typed binary GNSS log (gnssNNNN.gnsb), one file per chunk.
+//! File is FileHeader followed by records: RecordHeader, then RecordHeader::size bytes of payload
+//! (one of the structs below, selected by RecordHeader::type). Unknown types are skipped by size,
+//! payloads may grow at the end in later versions. All fields little-endian.
+//! Numbers are kept as in the sentence, value / scale (scale 0: field was empty), so nothing is
+//! lost to rounding; coordinates are NMEA ddmm.mmmm with sign, see toCoord.
+//! UBX records carry the UBX payload as received (ubx::NavPvt, ...), their talker is empty.
+namespace gnss
+{
+constexpr uint32_t Magic = 0x4E47444D; // "MDGN"
+constexpr uint16_t Version = 1;
+
+enum class RecordType : uint16_t
+{
+	Gga = 1,
+	Rmc = 2,
+	Gst = 3,
+	Gsa = 4,
+	Vtg = 5,
+	UbxNavPvt = 16,
+	UbxNavHpposllh = 17,
+	UbxTimTp = 18,
+};
+
+#pragma pack(push, 1)
+struct FileHeader
+{
+	uint32_t magic{Magic};
+	uint16_t version{Version};
+	uint16_t headerSize{sizeof(FileHeader)};
+};
+
+struct RecordHeader
+{
+	uint16_t type; //! RecordType
+	uint16_t size; //! payload bytes
+	char talker[2]; //! talker of the sentence, e.g. "GP", "GN"
+	uint16_t reserved{0};
+	uint64_t laserTimestampNs; //! lidar time when the sentence was received
+	int64_t systemTimeMs; //! system time when the sentence was received
+};
+
+struct Float
+{
+	int32_t value;
+	int32_t scale;
+};
+
+struct Time
+{
+	int8_t hours; //! -1 if empty
+	int8_t minutes;
+	int8_t seconds;
+	int32_t microseconds;
+};
+
+struct Date
+{
+	int8_t day; //! -1 if empty
+	int8_t month;
+	int16_t year;
+};
+
+struct Gga
+{
+	Time time;
+	Float latitude;
+	Float longitude;
+	int8_t fixQuality;
+	int8_t satellitesTracked;
+	Float hdop;
+	Float altitude; //! meters above mean sea level
+	Float height; //! geoid separation
+	Float dgpsAge;
+};
+
+struct Rmc
+{
+	Time time;
+	Date date;
+	uint8_t valid;
+	Float latitude;
+	Float longitude;
+	Float speedKnots;
+	Float course;
+	Float variation;
+};
+
+//! Pseudorange error statistics, the accuracy estimate of the receiver
+struct Gst
+{
+	Time time;
+	Float rmsDeviation;
+	Float semiMajorDeviation; //! meters, 1 sigma
+	Float semiMinorDeviation;
+	Float semiMajorOrientation; //! degrees from true north
+	Float latitudeErrorDeviation; //! meters, 1 sigma
+	Float longitudeErrorDeviation;
+	Float altitudeErrorDeviation;
+};
+
+struct Gsa
+{
+	char mode; //! 'A' automatic, 'M' manual
+	int8_t fixType; //! 1 none, 2 2D, 3 3D
+	uint16_t sats[12]; //! PRNs of satellites used, 0 for empty slots; extended PRNs (e.g. BeiDou, QZSS) exceed 255
+	Float pdop;
+	Float hdop;
+	Float vdop;
+};
+
+struct Vtg
+{
+	Float trueTrackDegrees;
+	Float magneticTrackDegrees;
+	Float speedKnots;
+	Float speedKph;
+	char faaMode;
+};
+#pragma pack(pop)
+
+inline double toDouble(const Float& f)
+{
+	return f.scale == 0 ? NAN : static_cast<double>(f.value) / f.scale;
+}
+
+//! Degrees from NMEA ddmm.mmmm
+inline double toCoord(const Float& f)
+{
+	if(f.scale == 0)
+	{
+		return NAN;
+	}
+	const int64_t scale = static_cast<int64_t>(f.scale) * 100;
+	return static_cast<double>(f.value / scale) + static_cast<double>(f.value % scale) / (60.0 * f.scale);
+}
+
+//! Same float arithmetic as minmea_tofloat, for output identical to the .gnss files written so far
+inline float toFloatCompat(const Float& f)
+{
+	return f.scale == 0 ? NAN : static_cast<float>(f.value) / static_cast<float>(f.scale);
+}
+
+//! Same float arithmetic as minmea_tocoord
+inline float toCoordCompat(const Float& f)
+{
+	if(f.scale == 0 || f.scale > INT32_MAX / 100 || f.scale < INT32_MIN / 100)
+	{
+		return NAN;
+	}
+	const int32_t degrees = f.value / (f.scale * 100);
+	const int32_t minutes = f.value % (f.scale * 100);
+	return static_cast<float>(degrees) + static_cast<float>(minutes) / (60 * f.scale);
+}
+
+//! Writes a GGA record as line of the .gnss file: laser timestamp [ns], latitude, longitude, altitude, hdop,
+//! satellites, height, dgps age, time, fix quality, system time [ms]. Stream precision has to be set to 20.
+inline void writeGnssLine(std::ostream& out, const RecordHeader& header, const Gga& gga)
+{
+	out << header.laserTimestampNs << " ";
+	out << toCoordCompat(gga.latitude) << " ";
+	out << toCoordCompat(gga.longitude) << " ";
+	out << toFloatCompat(gga.altitude) << " ";
+	out << toFloatCompat(gga.hdop) << " ";
+	out << int(gga.satellitesTracked) << " ";
+	out << toFloatCompat(gga.height) << " ";
+	out << toFloatCompat(gga.dgpsAge) << " ";
+	out << int(gga.time.hours) << ":" << int(gga.time.minutes) << ":" << int(gga.time.seconds) << " ";
+	out << int(gga.fixQuality) << " ";
+	out << header.systemTimeMs << "\n";
+}
+
+//! Reads records of a log in memory. Returns false at the end or on a truncated record.
+class Reader
+{
+public:
+	Reader(const void* data, size_t size)
+		: m_data(static_cast<const uint8_t*>(data))
+		, m_size(size)
+	{
+		FileHeader fileHeader;
+		if(m_size >= sizeof(FileHeader))
+		{
+			std::memcpy(&fileHeader, m_data, sizeof(fileHeader));
+			m_valid = fileHeader.magic == Magic && fileHeader.version <= Version && fileHeader.headerSize >= sizeof(FileHeader);
+			m_offset = fileHeader.headerSize;
+		}
+	}
+
+	//! Reader of records without the file header, as kept in memory before saving
+	static Reader Records(const void* data, size_t size)
+	{
+		Reader reader(data, 0);
+		reader.m_size = size;
+		reader.m_offset = 0;
+		reader.m_valid = true;
+		return reader;
+	}
+
+	//! File header is of a known version
+	bool valid() const
+	{
+		return m_valid;
+	}
+
+	bool next(RecordHeader& header, const uint8_t*& payload)
+	{
+		if(!m_valid || m_offset + sizeof(RecordHeader) > m_size)
+		{
+			return false;
+		}
+		std::memcpy(&header, m_data + m_offset, sizeof(header));
+		if(m_offset + sizeof(RecordHeader) + header.size > m_size)
+		{
+			return false;
+		}
+		payload = m_data + m_offset + sizeof(RecordHeader);
+		m_offset += sizeof(RecordHeader) + header.size;
+		return true;
+	}
+
+	//! Copies payload into record, fields a shorter (older) payload does not have are zero
+	template <typename Record>
+	static Record get(const RecordHeader& header, const uint8_t* payload)
+	{
+		Record record;
+		std::memset(&record, 0, sizeof(record));
+		std::memcpy(&record, payload, std::min<size_t>(header.size, sizeof(record)));
+		return record;
+	}
+
+private:
+	const uint8_t* m_data;
+	size_t m_size;
+	size_t m_offset{0};
+	bool m_valid{false};
+};
+} // namespace gnss
+} // namespace mandeye_utils
@@ -0,0 +1,234 @@
+#pragma once
+#include "utils/BufferPool.h"
+#include "utils/Metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+namespace mandeye_utils
+{
+//! Ingest core shared by lidar adapters: buffer that producers (SDK callbacks) append to while logging,
+//! swapped out in one step by the consumer (retrieveData). Buffers come from a BufferPool.
+//! Producers should convert a whole packet/scan into a per-producer staging vector without lock
+//! and hand it over with Flush, so the lock is taken once per batch, not per sample.
+template <typename Sample>
+class IngestBuffer
+{
+public:
+	using Buffer = std::vector<Sample>;
+	using BufferPtr = std::shared_ptr<Buffer>;
+	//! Observer of samples handed over with Append or Flush, called on the producer thread outside of the lock
+	using Tap = std::function<void(const Sample* samples, size_t count)>;
+
+	//! @param maxPooledBuffers number of buffers kept in the pool
+	explicit IngestBuffer(size_t maxPooledBuffers = 3)
+		: m_pool(maxPooledBuffers)
+	{ }
+
+	//! Starts logging, samples appended from now on are kept
+	void Start()
+	{
+		BufferPtr buffer = m_pool.Acquire();
+		std::lock_guard<std::mutex> lck(m_mutex);
+		if(!m_buffer)
+		{
+			m_buffer = std::move(buffer);
+			m_size.store(0, std::memory_order_relaxed);
+		}
+		m_logging.store(true, std::memory_order_release);
+	}
+
+	//! Stops logging, samples in the active buffer are dropped, call Retrieve before to keep them
+	void Stop()
+	{
+		BufferPtr buffer;
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			m_logging.store(false, std::memory_order_release);
+			std::swap(buffer, m_buffer);
+			m_size.store(0, std::memory_order_relaxed);
+		}
+		// buffer goes back to the pool outside of the lock
+	}
+
+	//! Returns samples collected since last call and continues with an empty buffer.
+	//! When not logging, an empty buffer is returned.
+	BufferPtr Retrieve()
+	{
+		BufferPtr buffer = m_pool.Acquire();
+		std::lock_guard<std::mutex> lck(m_mutex);
+		if(m_buffer)
+		{
+			std::swap(buffer, m_buffer);
+			m_size.store(0, std::memory_order_relaxed);
+			m_retrieved++;
+			m_lastRetrievedSize = buffer->size();
+		}
+		return buffer;
+	}
+
+	//! True between Start and Stop
+	bool IsLogging() const
+	{
+		return m_logging.load(std::memory_order_acquire);
+	}
+
+	//! Cheap check for producers to skip converting data when nobody consumes it (not logging, no tap)
+	bool IsAccepting() const
+	{
+		return m_hasTap || IsLogging();
+	}
+
+	//! Sets observer of flushed batches, it sees them also when not logging.
+	//! Not synchronized with producers, has to be set before they start.
+	void SetTap(const Tap& tap)
+	{
+		m_tap = tap;
+		m_hasTap = static_cast<bool>(tap);
+	}
+
+	//! Sets metrics updated on every batch: samples handed over by laser_id of the batch, samples dropped.
+	//! Not synchronized with producers, has to be set before they start.
+	void SetMetrics(metrics::IndexedCounter* ingested, metrics::Counter* dropped)
+	{
+		m_ingestedMetric = ingested;
+		m_droppedMetric = dropped;
+	}
+
+	//! Appends single sample, prefer Flush for packets with many samples
+	void Append(const Sample& sample)
+	{
+		if(m_ingestedMetric)
+		{
+			m_ingestedMetric->Add(sample.laser_id);
+		}
+		{
+			auto lck = LockForAppend();
+			if(m_buffer)
+			{
+				m_buffer->push_back(sample);
+				m_size.store(m_buffer->size(), std::memory_order_relaxed);
+				CountBatch(1);
+			}
+			else if(!m_hasTap)
+			{
+				m_dropped++;
+				CountDropped(1);
+			}
+		}
+		if(m_hasTap)
+		{
+			m_tap(&sample, 1);
+		}
+	}
+
+	//! Appends staged samples in one batch and clears the staging vector, keeping its capacity
+	void Flush(std::vector<Sample>& staged)
+	{
+		if(staged.empty())
+		{
+			return;
+		}
+		// a batch is one packet, so it comes from a single lidar
+		if(m_ingestedMetric)
+		{
+			m_ingestedMetric->Add(staged.front().laser_id, staged.size());
+		}
+		{
+			auto lck = LockForAppend();
+			if(m_buffer)
+			{
+				m_buffer->insert(m_buffer->end(), staged.begin(), staged.end());
+				m_size.store(m_buffer->size(), std::memory_order_relaxed);
+				CountBatch(staged.size());
+			}
+			else if(!m_hasTap)
+			{
+				m_dropped += staged.size();
+				CountDropped(staged.size());
+			}
+		}
+		if(m_hasTap)
+		{
+			m_tap(staged.data(), staged.size());
+		}
+		staged.clear();
+	}
+
+	//! Number of samples in the active buffer, published by producers so readers (metrics, status) never take the lock
+	size_t Size() const
+	{
+		return m_size.load(std::memory_order_relaxed);
+	}
+
+	nlohmann::json produceStatus()
+	{
+		nlohmann::json data;
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			data["logging"] = m_buffer != nullptr;
+			data["size"] = m_buffer ? m_buffer->size() : 0;
+			data["appended"] = m_appended;
+			data["batches"] = m_batches;
+			data["max_batch"] = m_maxBatch;
+			data["dropped"] = m_dropped;
+			data["retrieved"] = m_retrieved;
+			data["last_retrieved_size"] = m_lastRetrievedSize;
+			data["contended"] = m_contended;
+		}
+		data["pool"] = m_pool.produceStatus();
+		return data;
+	}
+
+private:
+	//! Takes the lock, counting how often producer had to wait for the consumer
+	std::unique_lock<std::mutex> LockForAppend()
+	{
+		std::unique_lock<std::mutex> lck(m_mutex, std::try_to_lock);
+		if(!lck.owns_lock())
+		{
+			lck.lock();
+			m_contended++;
+		}
+		return lck;
+	}
+
+	void CountBatch(size_t count)
+	{
+		m_appended += count;
+		m_batches++;
+		m_maxBatch = std::max<uint64_t>(m_maxBatch, count);
+	}
+
+	void CountDropped(size_t count)
+	{
+		if(m_droppedMetric)
+		{
+			m_droppedMetric->Add(count);
+		}
+	}
+
+	BufferPool<Buffer> m_pool;
+	mutable std::mutex m_mutex;
+	std::atomic<bool> m_logging{false};
+	BufferPtr m_buffer;
+	//! size of m_buffer, written under m_mutex, read without it
+	std::atomic<size_t> m_size{0};
+	Tap m_tap;
+	bool m_hasTap{false};
+	metrics::IndexedCounter* m_ingestedMetric{nullptr};
+	metrics::Counter* m_droppedMetric{nullptr};
+
+	uint64_t m_appended{0};
+	uint64_t m_batches{0};
+	uint64_t m_maxBatch{0};
+	uint64_t m_dropped{0};
+	uint64_t m_retrieved{0};
+	uint64_t m_lastRetrievedSize{0};
+	uint64_t m_contended{0};
+};
+} // namespace mandeye_utils
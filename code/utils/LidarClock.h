@@ -0,0 +1,160 @@
+#pragma once
+#include "utils/ClockModel.h"
+#include "utils/SeqLock.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <nlohmann/json.hpp>
+
+namespace mandeye_utils
+{
+//! Lidar time, session start and host clock offset shared between the receive threads (writers)
+//! and everybody asking for the lidar time (GNSS, publisher, status).
+//! Writers never take a lock: the timestamp is a single atomic, the host clock is sampled at most
+//! once per interval and the (lidar, host) pair together with the fitted ClockModel is published
+//! with a seqlock, so readers never block the receive thread and always see a consistent snapshot.
+class LidarClock
+{
+public:
+	//! Pair of lidar time and host (system_clock) time sampled at the same moment, in nanoseconds
+	struct HostSample
+	{
+		uint64_t lidarNs{0};
+		int64_t hostNs{0};
+	};
+
+	//! @param hostSampleInterval minimal lidar time between two samples of the host clock
+	explicit LidarClock(std::chrono::nanoseconds hostSampleInterval = std::chrono::milliseconds(100))
+		: m_hostSampleIntervalNs(hostSampleInterval.count())
+	{ }
+
+	//! Called on every packet from any receive thread
+	void Update(uint64_t lidarNs)
+	{
+		m_timestampNs.store(lidarNs, std::memory_order_relaxed);
+
+		uint64_t lastSample = m_lastHostSampleNs.load(std::memory_order_relaxed);
+		if(lidarNs >= lastSample && lidarNs - lastSample < m_hostSampleIntervalNs)
+		{
+			return;
+		}
+		// seqlock and fitter have a single writer, other threads skip the sample instead of waiting
+		if(m_writerBusy.test_and_set(std::memory_order_acquire))
+		{
+			return;
+		}
+		m_lastHostSampleNs.store(lidarNs, std::memory_order_relaxed);
+		using namespace std::chrono;
+		const int64_t monotonicNs = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+		const int64_t hostNs = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+
+		Snapshot snapshot;
+		snapshot.sample.lidarNs = lidarNs;
+		snapshot.sample.hostNs = hostNs;
+		snapshot.model = m_fitter.AddSample(monotonicNs, hostNs, lidarNs);
+		m_snapshot.Store(snapshot);
+		m_hostSamples.fetch_add(1, std::memory_order_relaxed);
+		m_modelResets.store(m_fitter.GetResets(), std::memory_order_relaxed);
+		m_writerBusy.clear(std::memory_order_release);
+	}
+
+	//! Last lidar timestamp in nanoseconds
+	uint64_t GetTimestampNs() const
+	{
+		return m_timestampNs.load(std::memory_order_relaxed);
+	}
+
+	//! Starts the session at the current lidar time, only first call has an effect
+	void InitializeSession()
+	{
+		uint64_t expected = NoSession;
+		m_sessionStartNs.compare_exchange_strong(expected, GetTimestampNs(), std::memory_order_relaxed);
+	}
+
+	bool HasSession() const
+	{
+		return m_sessionStartNs.load(std::memory_order_relaxed) != NoSession;
+	}
+
+	//! Session start in nanoseconds, valid if HasSession
+	uint64_t GetSessionStartNs() const
+	{
+		return m_sessionStartNs.load(std::memory_order_relaxed);
+	}
+
+	//! Lidar time since session start in nanoseconds, 0 if there is no session
+	uint64_t GetSessionElapsedNs() const
+	{
+		const uint64_t start = m_sessionStartNs.load(std::memory_order_relaxed);
+		const uint64_t now = GetTimestampNs();
+		if(start == NoSession || now < start)
+		{
+			return 0;
+		}
+		return now - start;
+	}
+
+	//! Last consistent pair of lidar and host time
+	HostSample GetHostSample() const
+	{
+		return m_snapshot.Load().sample;
+	}
+
+	//! Model of the lidar clock, lets clients convert host time to lidar time without asking
+	ClockModel GetClockModel() const
+	{
+		return m_snapshot.Load().model;
+	}
+
+	//! Absolute difference between host and lidar clock in seconds at last host sample,
+	//! small value means lidar is synchronized with host (e.g. PTP)
+	double GetHostOffsetSec() const
+	{
+		const HostSample sample = GetHostSample();
+		if(sample.hostNs == 0)
+		{
+			return std::numeric_limits<double>::max();
+		}
+		return std::abs(double(sample.hostNs) - double(sample.lidarNs)) / 1e9;
+	}
+
+	nlohmann::json produceStatus() const
+	{
+		nlohmann::json data;
+		const Snapshot snapshot = m_snapshot.Load();
+		const HostSample& sample = snapshot.sample;
+		data["timestamp_s"] = double(GetTimestampNs()) / 1e9;
+		data["session_start_s"] = HasSession() ? double(GetSessionStartNs()) / 1e9 : -1.0;
+		data["session_elapsed_s"] = double(GetSessionElapsedNs()) / 1e9;
+		data["host_sample"]["lidar_s"] = double(sample.lidarNs) / 1e9;
+		data["host_sample"]["host_s"] = double(sample.hostNs) / 1e9;
+		data["host_offset_s"] = sample.hostNs != 0 ? std::abs(double(sample.hostNs) - double(sample.lidarNs)) / 1e9 : -1.0;
+		data["host_samples"] = m_hostSamples.load(std::memory_order_relaxed);
+		data["model"] = snapshot.model.toJson();
+		data["model"]["resets"] = m_modelResets.load(std::memory_order_relaxed);
+		return data;
+	}
+
+private:
+	static constexpr uint64_t NoSession = UINT64_MAX;
+
+	struct Snapshot
+	{
+		HostSample sample;
+		ClockModel model;
+	};
+
+	const uint64_t m_hostSampleIntervalNs;
+	std::atomic<uint64_t> m_timestampNs{0};
+	std::atomic<uint64_t> m_sessionStartNs{NoSession};
+
+	std::atomic<uint64_t> m_lastHostSampleNs{0};
+	std::atomic_flag m_writerBusy = ATOMIC_FLAG_INIT;
+	ClockModelFitter m_fitter; //! used only by the thread holding m_writerBusy
+	SeqLock<Snapshot> m_snapshot;
+	std::atomic<uint64_t> m_hostSamples{0};
+	std::atomic<uint64_t> m_modelResets{0};
+};
+} // namespace mandeye_utils
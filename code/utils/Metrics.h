@@ -0,0 +1,332 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mandeye_utils
+{
+//! Metrics in Prometheus text exposition format (served on /metrics).
+//! Updating a metric is a relaxed atomic operation, hot paths keep a reference obtained once from
+//! the Registry. Registration and rendering take the registry lock, updates never do.
+namespace metrics
+{
+
+//! Atomic double, fetch_add of std::atomic<double> is C++20
+class AtomicDouble
+{
+public:
+	void Store(double value)
+	{
+		m_bits.store(ToBits(value), std::memory_order_relaxed);
+	}
+
+	double Load() const
+	{
+		return FromBits(m_bits.load(std::memory_order_relaxed));
+	}
+
+	void Add(double value)
+	{
+		uint64_t expected = m_bits.load(std::memory_order_relaxed);
+		while(!m_bits.compare_exchange_weak(expected, ToBits(FromBits(expected) + value), std::memory_order_relaxed))
+		{ }
+	}
+
+private:
+	static uint64_t ToBits(double value)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+	static double FromBits(uint64_t bits)
+	{
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+	std::atomic<uint64_t> m_bits{0};
+};
+
+class Counter
+{
+public:
+	void Add(uint64_t value = 1)
+	{
+		m_value.fetch_add(value, std::memory_order_relaxed);
+	}
+	uint64_t Value() const
+	{
+		return m_value.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<uint64_t> m_value{0};
+};
+
+//! Counters for small integer label (e.g. laser_id), one slot per value, larger values share the last slot
+class IndexedCounter
+{
+public:
+	static constexpr size_t Slots = 16;
+
+	void Add(size_t index, uint64_t value = 1)
+	{
+		m_values[std::min(index, Slots - 1)].fetch_add(value, std::memory_order_relaxed);
+	}
+	uint64_t Value(size_t index) const
+	{
+		return m_values[index].load(std::memory_order_relaxed);
+	}
+
+private:
+	std::array<std::atomic<uint64_t>, Slots> m_values{};
+};
+
+class Gauge
+{
+public:
+	void Set(double value)
+	{
+		m_value.Store(value);
+	}
+	void Add(double value)
+	{
+		m_value.Add(value);
+	}
+	double Value() const
+	{
+		return m_value.Load();
+	}
+
+private:
+	AtomicDouble m_value;
+};
+
+//! Histogram with fixed bucket upper bounds, bucket counts are not cumulative until rendered
+class Histogram
+{
+public:
+	explicit Histogram(std::vector<double> bounds)
+		: m_bounds(std::move(bounds))
+		, m_buckets(new std::atomic<uint64_t>[m_bounds.size() + 1])
+	{
+		std::sort(m_bounds.begin(), m_bounds.end());
+		for(size_t i = 0; i <= m_bounds.size(); i++)
+		{
+			m_buckets[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void Observe(double value)
+	{
+		const size_t bucket = std::lower_bound(m_bounds.begin(), m_bounds.end(), value) - m_bounds.begin();
+		m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		m_sum.Add(value);
+	}
+
+	const std::vector<double>& Bounds() const
+	{
+		return m_bounds;
+	}
+	//! Count of bucket i, bucket Bounds().size() is +Inf
+	uint64_t BucketCount(size_t i) const
+	{
+		return m_buckets[i].load(std::memory_order_relaxed);
+	}
+	double Sum() const
+	{
+		return m_sum.Load();
+	}
+
+private:
+	std::vector<double> m_bounds;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+	AtomicDouble m_sum;
+};
+
+//! Owns all metrics of the process
+class Registry
+{
+public:
+	static Registry& Instance()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	//! Returns metric name{labels}, creating it on first call. labels are in exposition format, e.g. stream="lidar"
+	Counter& AddCounter(const std::string& name, const std::string& help, const std::string& labels = "")
+	{
+		return Add<Counter>(name, help, "counter", labels, m_counters);
+	}
+
+	//! Counter with one series per index, rendered with label indexLabel="<index>"
+	IndexedCounter& AddIndexedCounter(const std::string& name, const std::string& help, const std::string& indexLabel)
+	{
+		return Add<IndexedCounter>(name, help, "counter", indexLabel, m_indexedCounters);
+	}
+
+	Gauge& AddGauge(const std::string& name, const std::string& help, const std::string& labels = "")
+	{
+		return Add<Gauge>(name, help, "gauge", labels, m_gauges);
+	}
+
+	Histogram& AddHistogram(const std::string& name, const std::string& help, const std::vector<double>& bounds, const std::string& labels = "")
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		auto& family = Family(name, help, "histogram");
+		const auto it = family.histograms.find(labels);
+		if(it != family.histograms.end())
+		{
+			return *it->second;
+		}
+		m_histograms.push_back(std::make_unique<Histogram>(bounds));
+		family.histograms[labels] = m_histograms.back().get();
+		return *m_histograms.back();
+	}
+
+	//! Called before each rendering, to set gauges of values that are only read on demand (e.g. temperature)
+	void AddCollector(const std::function<void()>& collector)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_collectors.push_back(collector);
+	}
+
+	std::string Render()
+	{
+		std::vector<std::function<void()>> collectors;
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			collectors = m_collectors;
+		}
+		for(const auto& collector : collectors)
+		{
+			collector();
+		}
+
+		std::ostringstream out;
+		// default 6 significant digits would cut large counters like byte totals
+		out << std::setprecision(std::numeric_limits<double>::max_digits10);
+		std::lock_guard<std::mutex> lck(m_mutex);
+		for(const auto& [name, family] : m_families)
+		{
+			out << "# HELP " << name << ' ' << family.help << '\n';
+			out << "# TYPE " << name << ' ' << family.type << '\n';
+			for(const auto& [labels, counter] : family.counters)
+			{
+				out << name << Braces(labels) << ' ' << counter->Value() << '\n';
+			}
+			for(const auto& [labels, gauge] : family.gauges)
+			{
+				out << name << Braces(labels) << ' ' << gauge->Value() << '\n';
+			}
+			for(const auto& [label, counter] : family.indexedCounters)
+			{
+				for(size_t i = 0; i < IndexedCounter::Slots; i++)
+				{
+					const uint64_t value = counter->Value(i);
+					if(value > 0)
+					{
+						out << name << '{' << label << "=\"" << i << "\"} " << value << '\n';
+					}
+				}
+			}
+			for(const auto& [labels, histogram] : family.histograms)
+			{
+				const std::string prefix = labels.empty() ? "" : labels + ",";
+				uint64_t cumulative = 0;
+				for(size_t i = 0; i < histogram->Bounds().size(); i++)
+				{
+					cumulative += histogram->BucketCount(i);
+					out << name << "_bucket{" << prefix << "le=\"" << histogram->Bounds()[i] << "\"} " << cumulative << '\n';
+				}
+				cumulative += histogram->BucketCount(histogram->Bounds().size());
+				out << name << "_bucket{" << prefix << "le=\"+Inf\"} " << cumulative << '\n';
+				out << name << "_sum" << Braces(labels) << ' ' << histogram->Sum() << '\n';
+				out << name << "_count" << Braces(labels) << ' ' << cumulative << '\n';
+			}
+		}
+		return out.str();
+	}
+
+private:
+	struct MetricFamily
+	{
+		std::string help;
+		std::string type;
+		std::map<std::string, Counter*> counters;
+		std::map<std::string, Gauge*> gauges;
+		std::map<std::string, IndexedCounter*> indexedCounters;
+		std::map<std::string, Histogram*> histograms;
+
+		std::map<std::string, Counter*>& Series(Counter*)
+		{
+			return counters;
+		}
+		std::map<std::string, Gauge*>& Series(Gauge*)
+		{
+			return gauges;
+		}
+		std::map<std::string, IndexedCounter*>& Series(IndexedCounter*)
+		{
+			return indexedCounters;
+		}
+	};
+
+	Registry() = default;
+
+	static std::string Braces(const std::string& labels)
+	{
+		return labels.empty() ? "" : "{" + labels + "}";
+	}
+
+	MetricFamily& Family(const std::string& name, const std::string& help, const char* type)
+	{
+		auto& family = m_families[name];
+		if(family.type.empty())
+		{
+			family.help = help;
+			family.type = type;
+		}
+		return family;
+	}
+
+	template <typename Metric>
+	Metric& Add(const std::string& name, const std::string& help, const char* type, const std::string& labels, std::deque<Metric>& storage)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		auto& series = Family(name, help, type).Series(static_cast<Metric*>(nullptr));
+		const auto it = series.find(labels);
+		if(it != series.end())
+		{
+			return *it->second;
+		}
+		// deque keeps references stable
+		storage.emplace_back();
+		series[labels] = &storage.back();
+		return storage.back();
+	}
+
+	std::mutex m_mutex;
+	std::map<std::string, MetricFamily> m_families;
+	std::deque<Counter> m_counters;
+	std::deque<IndexedCounter> m_indexedCounters;
+	std::deque<Gauge> m_gauges;
+	std::deque<std::unique_ptr<Histogram>> m_histograms;
+	std::vector<std::function<void()>> m_collectors;
+};
+} // namespace metrics
+} // namespace mandeye_utils
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace mandeye_utils
+{
+//! Wire format of the decimated live point cloud preview (ZeroMQ, topic "preview").
+//! Message is two frames: topic, then payload = Header followed by Header::pointCount Points.
+//! All fields little-endian, coordinates in the lidar frame.
+namespace preview
+{
+constexpr char Topic[] = "preview";
+constexpr uint32_t Magic = 0x5650444D; // "MDPV"
+constexpr uint16_t Version = 1;
+
+#pragma pack(push, 1)
+struct Header
+{
+	uint32_t magic{Magic};
+	uint16_t version{Version};
+	uint16_t headerSize{sizeof(Header)};
+	uint32_t sequence{0}; //! incremented with every frame, gaps mean frames dropped by ZeroMQ
+	uint32_t pointCount{0};
+	uint64_t timestampNs{0}; //! lidar time of last point in the frame
+	float voxelSize{0}; //! decimation voxel size in meters
+	float scale{0}; //! meters per coordinate unit
+	uint32_t droppedPoints{0}; //! points over the bandwidth budget since the previous frame
+};
+
+struct Point
+{
+	int16_t x; //! x * scale in meters
+	int16_t y;
+	int16_t z;
+	uint8_t intensity;
+};
+#pragma pack(pop)
+
+//! Decodes payload, returns false if it is not a preview frame of known version
+inline bool decode(const void* data, size_t size, Header& header, std::vector<Point>& points)
+{
+	if(size < sizeof(Header))
+	{
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(Header));
+	if(header.magic != Magic || header.version != Version || header.headerSize < sizeof(Header))
+	{
+		return false;
+	}
+	if(size < header.headerSize + size_t(header.pointCount) * sizeof(Point))
+	{
+		return false;
+	}
+	points.resize(header.pointCount);
+	std::memcpy(points.data(), static_cast<const uint8_t*>(data) + header.headerSize, header.pointCount * sizeof(Point));
+	return true;
+}
+} // namespace preview
+} // namespace mandeye_utils
@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace mandeye_utils
+{
+//! Sequence lock publishing a small trivially copyable value from a single writer to many readers.
+//! Writer never waits, readers retry while a write is in progress.
+template <typename T>
+class SeqLock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock value has to be trivially copyable");
+
+public:
+	//! Has to be called by one writer at a time
+	void Store(const T& value)
+	{
+		std::array<uint64_t, Words> words{};
+		std::memcpy(words.data(), &value, sizeof(T));
+
+		const uint32_t seq = m_seq.load(std::memory_order_relaxed);
+		m_seq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for(size_t i = 0; i < Words; i++)
+		{
+			m_words[i].store(words[i], std::memory_order_relaxed);
+		}
+		m_seq.store(seq + 2, std::memory_order_release);
+	}
+
+	T Load() const
+	{
+		std::array<uint64_t, Words> words;
+		uint32_t seqBefore;
+		uint32_t seqAfter;
+		do
+		{
+			seqBefore = m_seq.load(std::memory_order_acquire);
+			for(size_t i = 0; i < Words; i++)
+			{
+				words[i] = m_words[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			seqAfter = m_seq.load(std::memory_order_relaxed);
+		} while((seqBefore & 1) || seqBefore != seqAfter);
+
+		T value;
+		std::memcpy(&value, words.data(), sizeof(T));
+		return value;
+	}
+
+private:
+	static constexpr size_t Words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	std::atomic<uint32_t> m_seq{0};
+	std::array<std::atomic<uint64_t>, Words> m_words{};
+};
+} // namespace mandeye_utils
@@ -0,0 +1,107 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace mandeye_utils
+{
+//! Layout of the shared-memory rings with the live point and IMU stream (POSIX shm, see ShmStream).
+//! One writer (control_program), any number of readers mapping the segment read-only.
+//! Segment is RingHeader followed by capacity records of recordSize bytes.
+//! Record i (counted from the start of the writer) is in slot i % capacity.
+//! Writer announces records it is about to overwrite in reserveIndex before copying and
+//! publishes them in writeIndex after, so a reader can check after reading a span that it was
+//! not overwritten meanwhile (see ShmRingReader in extras/utils).
+namespace shm
+{
+constexpr char PointsName[] = "/mandeye_points";
+constexpr char ImuName[] = "/mandeye_imu";
+//! ZeroMQ endpoint with notifications, topic is PointsName or ImuName, payload is writeIndex (uint64_t)
+constexpr char NotifyEndpoint[] = "ipc:///tmp/mandeye_shm";
+
+constexpr uint32_t Magic = 0x4853444D; // "MDSH"
+constexpr uint16_t Version = 1;
+
+#pragma pack(push, 1)
+struct Point
+{
+	uint64_t timestamp; //! lidar time in nanoseconds
+	float x; //! meters
+	float y;
+	float z;
+	float intensity;
+	uint16_t laser_id;
+	uint8_t line_id;
+	uint8_t tag;
+};
+
+struct Imu
+{
+	uint64_t timestamp; //! lidar time in nanoseconds
+	float gyro_x;
+	float gyro_y;
+	float gyro_z;
+	float acc_x;
+	float acc_y;
+	float acc_z;
+	uint16_t laser_id;
+};
+#pragma pack(pop)
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring indices are shared between processes");
+
+struct RingHeader
+{
+	uint32_t magic{Magic};
+	uint16_t version{Version};
+	uint16_t headerSize{sizeof(RingHeader)};
+	uint32_t recordSize{0};
+	uint32_t reserved{0};
+	uint64_t capacity{0}; //! records, power of two
+	uint64_t sessionId{0}; //! changes when the writer restarts, readers have to start over
+	alignas(64) std::atomic<uint64_t> reserveIndex{0}; //! records written or being written
+	alignas(64) std::atomic<uint64_t> writeIndex{0}; //! records completely written
+};
+
+//! Size of the segment for capacity records
+inline size_t segmentSize(uint64_t capacity, uint32_t recordSize)
+{
+	return sizeof(RingHeader) + capacity * recordSize;
+}
+
+inline uint8_t* records(RingHeader* header)
+{
+	return reinterpret_cast<uint8_t*>(header) + header->headerSize;
+}
+
+inline const uint8_t* records(const RingHeader* header)
+{
+	return reinterpret_cast<const uint8_t*>(header) + header->headerSize;
+}
+
+//! Appends count records converted from source with convert(const Source&) -> Record.
+//! Records are converted straight into the segment. Caller makes sure there is only one writer.
+template <typename Record, typename Source, typename Convert>
+void write(RingHeader* header, const Source* source, uint64_t count, Convert convert)
+{
+	if(count > header->capacity)
+	{
+		// only the newest records fit
+		source += count - header->capacity;
+		count = header->capacity;
+	}
+	const uint64_t first = header->writeIndex.load(std::memory_order_relaxed);
+	header->reserveIndex.store(first + count, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Record* ring = reinterpret_cast<Record*>(records(header));
+	const uint64_t mask = header->capacity - 1;
+	for(uint64_t i = 0; i < count; i++)
+	{
+		ring[(first + i) & mask] = convert(source[i]);
+	}
+
+	header->writeIndex.store(first + count, std::memory_order_release);
+}
+} // namespace shm
+} // namespace mandeye_utils
@@ -0,0 +1,256 @@
+#pragma once
+#include "utils/ClockModel.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace mandeye_utils
+{
+//! Binary wire format of the status published by control_program on ZeroMQ (tcp://*:5556).
+//! Every message is two frames: topic, then payload.
+//! Topics TopicTime and TopicState carry Header followed by the strings mode, stopScanDirectory and
+//! continousScanDirectory (lengths in the header, no terminators), TopicChunk carries ChunkHeader
+//! followed by the directory. All fields little-endian.
+//! Newer versions only append fields to the headers, readers skip to headerSize for the strings,
+//! so a reader of version 1 understands every later version.
+namespace status
+{
+constexpr uint32_t Magic = 0x5453444D; // "MDST"
+constexpr uint32_t ChunkMagic = 0x4B43444D; // "MDCK"
+constexpr uint16_t Version = 1;
+
+constexpr char TopicTime[] = "time"; //! periodic tick: time, duration and clock model
+constexpr char TopicState[] = "state"; //! sent on every mode or directory change and repeated periodically
+constexpr char TopicChunk[] = "chunk"; //! sent when a chunk is cut
+
+//! Header::flags
+constexpr uint32_t FlagHasState = 1u << 0; //! mode and directories are set
+
+#pragma pack(push, 1)
+struct Header
+{
+	uint32_t magic{Magic};
+	uint16_t version{Version};
+	uint16_t headerSize{sizeof(Header)};
+	uint32_t flags{0};
+	uint64_t timeNs{0}; //! lidar time
+	uint64_t durNs{0}; //! session duration
+	// mandeye_utils::ClockModel
+	int64_t clockRefHostNs{0};
+	uint64_t clockRefLidarNs{0};
+	double clockDriftPpm{0};
+	double clockAccuracyNs{0};
+	int64_t clockRealtimeOffsetNs{0};
+	uint32_t clockSamples{0};
+	uint8_t clockValid{0};
+	uint8_t reserved{0};
+	uint16_t modeLength{0};
+	uint16_t stopScanDirectoryLength{0};
+	uint16_t continousScanDirectoryLength{0};
+};
+
+struct ChunkHeader
+{
+	uint32_t magic{ChunkMagic};
+	uint16_t version{Version};
+	uint16_t headerSize{sizeof(ChunkHeader)};
+	uint32_t chunk{0}; //! index of the chunk in the session
+	uint64_t timeNs{0}; //! lidar time when the chunk was cut
+	uint16_t directoryLength{0};
+};
+#pragma pack(pop)
+
+//! Decoded status, same content as the JSON status (keys in toJson)
+struct Status
+{
+	uint64_t timeNs{0};
+	uint64_t durNs{0};
+	ClockModel clock;
+	bool hasState{false}; //! mode and directories are only sent in every few messages
+	std::string mode;
+	std::string stopScanDirectory;
+	std::string continousScanDirectory;
+
+	nlohmann::json toJson() const
+	{
+		nlohmann::json data;
+		data["time"] = timeNs;
+		data["dur"] = durNs;
+		data["clock"] = clock.toJson();
+		if(hasState)
+		{
+			data["mode"] = mode;
+			data["stopScanDirectory"] = stopScanDirectory;
+			data["continousScanDirectory"] = continousScanDirectory;
+		}
+		return data;
+	}
+
+	static Status fromJson(const nlohmann::json& data)
+	{
+		Status status;
+		status.timeNs = data.value("time", uint64_t{0});
+		status.durNs = data.value("dur", uint64_t{0});
+		if(data.contains("clock") && data["clock"].is_object())
+		{
+			status.clock = ClockModel::fromJson(data["clock"]);
+		}
+		status.hasState = data.contains("mode");
+		status.mode = data.value("mode", "");
+		status.stopScanDirectory = data.value("stopScanDirectory", "");
+		status.continousScanDirectory = data.value("continousScanDirectory", "");
+		return status;
+	}
+};
+
+//! Decoded chunk event
+struct Chunk
+{
+	uint32_t chunk{0};
+	uint64_t timeNs{0};
+	std::string directory;
+
+	nlohmann::json toJson() const
+	{
+		nlohmann::json data;
+		data["chunk"] = chunk;
+		data["time"] = timeNs;
+		data["directory"] = directory;
+		return data;
+	}
+
+	static Chunk fromJson(const nlohmann::json& data)
+	{
+		Chunk chunk;
+		chunk.chunk = data.value("chunk", uint32_t{0});
+		chunk.timeNs = data.value("time", uint64_t{0});
+		chunk.directory = data.value("directory", "");
+		return chunk;
+	}
+};
+
+//! Encodes status into out, reusing its capacity
+inline void encode(const Status& status, std::vector<uint8_t>& out)
+{
+	Header header;
+	header.timeNs = status.timeNs;
+	header.durNs = status.durNs;
+	header.clockRefHostNs = status.clock.refHostNs;
+	header.clockRefLidarNs = status.clock.refLidarNs;
+	header.clockDriftPpm = status.clock.driftPpm;
+	header.clockAccuracyNs = status.clock.accuracyNs;
+	header.clockRealtimeOffsetNs = status.clock.realtimeOffsetNs;
+	header.clockSamples = status.clock.samples;
+	header.clockValid = status.clock.valid ? 1 : 0;
+	if(status.hasState)
+	{
+		header.flags |= FlagHasState;
+		header.modeLength = static_cast<uint16_t>(std::min<size_t>(status.mode.size(), UINT16_MAX));
+		header.stopScanDirectoryLength = static_cast<uint16_t>(std::min<size_t>(status.stopScanDirectory.size(), UINT16_MAX));
+		header.continousScanDirectoryLength = static_cast<uint16_t>(std::min<size_t>(status.continousScanDirectory.size(), UINT16_MAX));
+	}
+	out.resize(sizeof(Header) + header.modeLength + header.stopScanDirectoryLength + header.continousScanDirectoryLength);
+	uint8_t* p = out.data();
+	std::memcpy(p, &header, sizeof(Header));
+	p += sizeof(Header);
+	std::memcpy(p, status.mode.data(), header.modeLength);
+	p += header.modeLength;
+	std::memcpy(p, status.stopScanDirectory.data(), header.stopScanDirectoryLength);
+	p += header.stopScanDirectoryLength;
+	std::memcpy(p, status.continousScanDirectory.data(), header.continousScanDirectoryLength);
+}
+
+//! Encodes chunk event into out, reusing its capacity
+inline void encode(const Chunk& chunk, std::vector<uint8_t>& out)
+{
+	ChunkHeader header;
+	header.chunk = chunk.chunk;
+	header.timeNs = chunk.timeNs;
+	header.directoryLength = static_cast<uint16_t>(std::min<size_t>(chunk.directory.size(), UINT16_MAX));
+	out.resize(sizeof(ChunkHeader) + header.directoryLength);
+	std::memcpy(out.data(), &header, sizeof(ChunkHeader));
+	std::memcpy(out.data() + sizeof(ChunkHeader), chunk.directory.data(), header.directoryLength);
+}
+
+//! True if message starts with a binary magic, otherwise it is JSON ("publisher_encoding": "json")
+inline bool isBinary(const void* data, size_t size)
+{
+	uint32_t magic = 0;
+	if(size < sizeof(magic))
+	{
+		return false;
+	}
+	std::memcpy(&magic, data, sizeof(magic));
+	return magic == Magic || magic == ChunkMagic;
+}
+
+//! Decodes message into status, reusing its string capacity. Strings are left as they were when the
+//! message carries no state. Returns false if it is not a binary status message.
+inline bool decode(const void* data, size_t size, Status& status)
+{
+	// fields of version 1 are required, later versions have a longer header
+	constexpr size_t MinHeaderSize = sizeof(Header);
+	if(size < MinHeaderSize)
+	{
+		return false;
+	}
+	Header header;
+	std::memcpy(&header, data, sizeof(Header));
+	if(header.magic != Magic || header.version < 1 || header.headerSize < MinHeaderSize)
+	{
+		return false;
+	}
+	const size_t stringsSize = size_t(header.modeLength) + header.stopScanDirectoryLength + header.continousScanDirectoryLength;
+	if(size < header.headerSize + stringsSize)
+	{
+		return false;
+	}
+	status.timeNs = header.timeNs;
+	status.durNs = header.durNs;
+	status.clock.valid = header.clockValid != 0;
+	status.clock.refHostNs = header.clockRefHostNs;
+	status.clock.refLidarNs = header.clockRefLidarNs;
+	status.clock.driftPpm = header.clockDriftPpm;
+	status.clock.accuracyNs = header.clockAccuracyNs;
+	status.clock.realtimeOffsetNs = header.clockRealtimeOffsetNs;
+	status.clock.samples = header.clockSamples;
+	status.hasState = (header.flags & FlagHasState) != 0;
+	if(status.hasState)
+	{
+		const char* p = static_cast<const char*>(data) + header.headerSize;
+		status.mode.assign(p, header.modeLength);
+		p += header.modeLength;
+		status.stopScanDirectory.assign(p, header.stopScanDirectoryLength);
+		p += header.stopScanDirectoryLength;
+		status.continousScanDirectory.assign(p, header.continousScanDirectoryLength);
+	}
+	return true;
+}
+
+//! Decodes chunk event, returns false if it is not a binary chunk message
+inline bool decode(const void* data, size_t size, Chunk& chunk)
+{
+	ChunkHeader header;
+	if(size < sizeof(ChunkHeader))
+	{
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(ChunkHeader));
+	if(header.magic != ChunkMagic || header.version < 1 || header.headerSize < sizeof(ChunkHeader))
+	{
+		return false;
+	}
+	if(size < size_t(header.headerSize) + header.directoryLength)
+	{
+		return false;
+	}
+	chunk.chunk = header.chunk;
+	chunk.timeNs = header.timeNs;
+	chunk.directory.assign(static_cast<const char*>(data) + header.headerSize, header.directoryLength);
+	return true;
+}
+} // namespace status
+} // namespace mandeye_utils
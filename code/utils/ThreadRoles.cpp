@@ -0,0 +1,236 @@
+#include "ThreadRoles.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace mandeye_utils
+{
+namespace
+{
+struct ThreadEntry
+{
+	std::string m_role;
+	pid_t m_tid{0};
+	std::vector<std::string> m_errors; //! errors of the last plan application
+};
+
+std::mutex registryMutex;
+std::vector<ThreadEntry> registry;
+nlohmann::json threadPlan;
+
+pid_t currentTid()
+{
+	return static_cast<pid_t>(::syscall(SYS_gettid));
+}
+
+//! Returns settings for the role, falling back to "default"
+nlohmann::json roleSettings(const std::string& role)
+{
+	if(!threadPlan.is_object())
+	{
+		return nullptr;
+	}
+	if(threadPlan.contains(role))
+	{
+		return threadPlan[role];
+	}
+	if(threadPlan.contains("default"))
+	{
+		return threadPlan["default"];
+	}
+	return nullptr;
+}
+
+void applyPlan(ThreadEntry& entry)
+{
+	entry.m_errors.clear();
+	if(!threadPlan.is_object() || threadPlan.empty())
+	{
+		return;
+	}
+	const nlohmann::json settings = roleSettings(entry.m_role);
+	auto addConfigError = [&](const std::string& what) {
+		entry.m_errors.push_back(what);
+		std::cerr << "Thread " << entry.m_role << " (" << entry.m_tid << ") " << entry.m_errors.back() << std::endl;
+	};
+	auto addError = [&](const std::string& what) {
+		addConfigError(what + ": " + std::strerror(errno));
+	};
+
+	// threads inherit affinity and scheduling of the creator, so a role without settings is reset to defaults
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	const int cpuCount = static_cast<int>(sysconf(_SC_NPROCESSORS_CONF));
+	if(settings.is_object() && settings.contains("cpus") && settings["cpus"].is_array())
+	{
+		for(const auto& cpu : settings["cpus"])
+		{
+			if(!cpu.is_number_integer())
+			{
+				addConfigError("cpus: not an integer: " + cpu.dump());
+				continue;
+			}
+			const int c = cpu.get<int>();
+			if(c >= 0 && c < cpuCount && c < CPU_SETSIZE)
+			{
+				CPU_SET(c, &cpus);
+			}
+		}
+	}
+	if(CPU_COUNT(&cpus) == 0)
+	{
+		for(int c = 0; c < cpuCount && c < CPU_SETSIZE; c++)
+		{
+			CPU_SET(c, &cpus);
+		}
+	}
+	if(sched_setaffinity(entry.m_tid, sizeof(cpus), &cpus) != 0)
+	{
+		addError("sched_setaffinity");
+	}
+
+	int fifoPriority = 0;
+	if(settings.is_object() && settings.contains("fifo_priority"))
+	{
+		if(settings["fifo_priority"].is_number_integer())
+		{
+			fifoPriority = settings["fifo_priority"].get<int>();
+		}
+		else
+		{
+			addConfigError("fifo_priority: not an integer: " + settings["fifo_priority"].dump());
+		}
+	}
+	if(fifoPriority > 0)
+	{
+		sched_param param{};
+		param.sched_priority = std::min(fifoPriority, sched_get_priority_max(SCHED_FIFO));
+		if(sched_setscheduler(entry.m_tid, SCHED_FIFO, &param) != 0)
+		{
+			addError("sched_setscheduler SCHED_FIFO");
+		}
+	}
+	else if(sched_getscheduler(entry.m_tid) != SCHED_OTHER)
+	{
+		sched_param param{};
+		if(sched_setscheduler(entry.m_tid, SCHED_OTHER, &param) != 0)
+		{
+			addError("sched_setscheduler SCHED_OTHER");
+		}
+	}
+
+	if(settings.is_object() && settings.contains("nice") && !settings["nice"].is_number_integer())
+	{
+		addConfigError("nice: not an integer: " + settings["nice"].dump());
+	}
+	else if(settings.is_object() && settings.contains("nice"))
+	{
+		// on Linux nice value is per thread
+		if(setpriority(PRIO_PROCESS, entry.m_tid, settings["nice"].get<int>()) != 0)
+		{
+			addError("setpriority");
+		}
+	}
+}
+
+//! Removes the entry of the owning thread from the registry when the thread exits
+struct RegistryGuard
+{
+	pid_t m_tid{currentTid()};
+	~RegistryGuard()
+	{
+		std::lock_guard<std::mutex> lck(registryMutex);
+		registry.erase(std::remove_if(registry.begin(), registry.end(), [&](const ThreadEntry& e) { return e.m_tid == m_tid; }),
+					   registry.end());
+	}
+};
+} // namespace
+
+void registerThreadRole(const std::string& role)
+{
+	// kernel limits thread name to 15 characters, visible in top -H
+	pthread_setname_np(pthread_self(), role.substr(0, 15).c_str());
+	thread_local RegistryGuard guard;
+
+	std::lock_guard<std::mutex> lck(registryMutex);
+	ThreadEntry entry;
+	entry.m_role = role;
+	entry.m_tid = currentTid();
+	applyPlan(entry);
+	auto it = std::find_if(registry.begin(), registry.end(), [&](const ThreadEntry& e) { return e.m_tid == entry.m_tid; });
+	if(it != registry.end())
+	{
+		*it = entry;
+		return;
+	}
+	registry.push_back(entry);
+}
+
+void setThreadPlan(const nlohmann::json& plan)
+{
+	std::lock_guard<std::mutex> lck(registryMutex);
+	threadPlan = plan;
+	for(auto& entry : registry)
+	{
+		applyPlan(entry);
+	}
+}
+
+nlohmann::json produceThreadPlanStatus()
+{
+	std::lock_guard<std::mutex> lck(registryMutex);
+	nlohmann::json data;
+	data["plan"] = threadPlan;
+	data["threads"] = nlohmann::json::array();
+	for(const auto& entry : registry)
+	{
+		nlohmann::json thread;
+		thread["role"] = entry.m_role;
+		thread["tid"] = entry.m_tid;
+		thread["errors"] = entry.m_errors;
+
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		if(sched_getaffinity(entry.m_tid, sizeof(cpus), &cpus) != 0)
+		{
+			// thread has finished
+			thread["alive"] = false;
+			data["threads"].push_back(thread);
+			continue;
+		}
+		thread["alive"] = true;
+		std::vector<int> cpuList;
+		for(int c = 0; c < CPU_SETSIZE; c++)
+		{
+			if(CPU_ISSET(c, &cpus))
+			{
+				cpuList.push_back(c);
+			}
+		}
+		thread["cpus"] = cpuList;
+
+		const int policy = sched_getscheduler(entry.m_tid);
+		thread["policy"] = policy == SCHED_FIFO ? "SCHED_FIFO" : policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER";
+		sched_param param{};
+		if(sched_getparam(entry.m_tid, &param) == 0)
+		{
+			thread["priority"] = param.sched_priority;
+		}
+		errno = 0;
+		const int nice = getpriority(PRIO_PROCESS, entry.m_tid);
+		if(errno == 0)
+		{
+			thread["nice"] = nice;
+		}
+		data["threads"].push_back(thread);
+	}
+	return data;
+}
+} // namespace mandeye_utils
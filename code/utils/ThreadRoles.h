@@ -0,0 +1,38 @@
+#pragma once
+#include <nlohmann/json.hpp>
+#include <string>
+
+namespace mandeye_utils
+{
+//! Thread roles used by control_program
+namespace ThreadRole
+{
+constexpr char Main[] = "main"; //! main thread, console input
+constexpr char Http[] = "http"; //! Pistache server, its workers inherit the settings
+constexpr char Lidar[] = "lidar"; //! lidar client setup, SDK internal threads inherit the settings
+constexpr char Ingest[] = "ingest"; //! threads that deliver lidar data (SDK callbacks, receive loops)
+constexpr char StateMachine[] = "state_machine"; //! state machine, LEDs and buzzer
+constexpr char Writer[] = "writer"; //! compresses and saves chunks
+constexpr char Gnss[] = "gnss"; //! serial port reader
+constexpr char Publisher[] = "publisher"; //! ZeroMQ publisher
+constexpr char Gpio[] = "gpio"; //! buttons read back
+constexpr char Spool[] = "spool"; //! spool to USB migration
+constexpr char Status[] = "status"; //! refreshes the HTTP status snapshot
+constexpr char Download[] = "download"; //! session download server
+constexpr char Catalog[] = "catalog"; //! session file catalog, inotify reader
+constexpr char Benchmark[] = "benchmark"; //! storage benchmark, runs on demand
+} // namespace ThreadRole
+
+//! Registers calling thread under the role and applies the plan of the role (if any).
+//! Threads created afterwards by the calling thread inherit its affinity and scheduling.
+void registerThreadRole(const std::string& role);
+
+//! Sets the thread plan and applies it to already registered threads.
+//! Plan maps role names (or "default") to settings, e.g.:
+//! { "ingest": {"cpus": [3], "fifo_priority": 50}, "state_machine": {"cpus": [0, 1, 2], "nice": 5} }
+//! "cpus" - allowed cores, "fifo_priority" - SCHED_FIFO priority (1-99), "nice" - nice value of SCHED_OTHER thread.
+void setThreadPlan(const nlohmann::json& plan);
+
+//! Produces status of registered threads with affinity and scheduling read back from the kernel
+nlohmann::json produceThreadPlanStatus();
+} // namespace mandeye_utils
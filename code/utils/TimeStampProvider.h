@@ -1,4 +1,5 @@
 #pragma once
+#include "utils/ClockModel.h"
 
 namespace mandeye_utils
 {
@@ -15,5 +16,11 @@ public:
 	virtual void initializeDuration() = 0;
 
 	virtual double getSessionStart() = 0;
+
+	//! Model of the provider clock against host monotonic clock, not valid if not supported
+	virtual ClockModel getClockModel()
+	{
+		return {};
+	}
 };
 } // namespace mandeye_utils
\ No newline at end of file
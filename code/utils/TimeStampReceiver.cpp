@@ -34,4 +34,13 @@ double TimeStampReceiver::GetSessionStart()
 	return 0.0;
 }
 
+ClockModel TimeStampReceiver::GetClockModel()
+{
+	if(m_timeStampProvider)
+	{
+		return m_timeStampProvider->getClockModel();
+	}
+	return {};
+}
+
 } // namespace mandeye_utils
@@ -1,4 +1,5 @@
 #pragma once
+#include "utils/ClockModel.h"
 #include <memory>
 namespace mandeye_utils
 {
@@ -12,6 +13,8 @@ public:
 	double GetTimeStamp();
 	double GetSessionDuration();
 	double GetSessionStart();
+	//! Returns the clock model of the provider
+	ClockModel GetClockModel();
 
 protected:
 	//! The timestamp provider
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace mandeye_utils
+{
+//! u-blox UBX binary protocol, the messages logged next to NMEA from F9P-class receivers.
+//! Frame: 0xB5 0x62, class, id, payload length (uint16), payload, checksum A and B over class to payload.
+//! All fields little-endian, payload structs below are the payloads as sent by the receiver.
+namespace ubx
+{
+constexpr uint8_t Sync1 = 0xB5;
+constexpr uint8_t Sync2 = 0x62;
+//! sync chars, class, id and length
+constexpr size_t HeaderSize = 6;
+constexpr size_t ChecksumSize = 2;
+//! longer frames are treated as corrupted, the largest message of interest (NAV-SAT with 64 satellites) is under 1 KB
+constexpr size_t MaxPayloadSize = 2048;
+
+constexpr uint8_t ClassNav = 0x01;
+constexpr uint8_t ClassTim = 0x0D;
+constexpr uint8_t IdNavPvt = 0x07;
+constexpr uint8_t IdNavHpposllh = 0x14;
+constexpr uint8_t IdTimTp = 0x01;
+
+#pragma pack(push, 1)
+//! UBX-NAV-PVT, navigation solution
+struct NavPvt
+{
+	uint32_t iTOW; //! GPS time of week of the navigation epoch [ms]
+	uint16_t year;
+	uint8_t month;
+	uint8_t day;
+	uint8_t hour;
+	uint8_t min;
+	uint8_t sec;
+	uint8_t valid; //! bit 0 date valid, bit 1 time valid, bit 2 fully resolved
+	uint32_t tAcc; //! time accuracy [ns]
+	int32_t nano; //! fraction of second [ns], -1e9..1e9
+	uint8_t fixType; //! 0 none, 2 2D, 3 3D, 4 GNSS + dead reckoning, 5 time only
+	uint8_t flags; //! bit 0 gnssFixOK, bits 6-7 carrier solution: 1 float, 2 fixed
+	uint8_t flags2;
+	uint8_t numSV;
+	int32_t lon; //! [1e-7 deg]
+	int32_t lat; //! [1e-7 deg]
+	int32_t height; //! above ellipsoid [mm]
+	int32_t hMSL; //! above mean sea level [mm]
+	uint32_t hAcc; //! [mm]
+	uint32_t vAcc; //! [mm]
+	int32_t velN; //! [mm/s]
+	int32_t velE;
+	int32_t velD;
+	int32_t gSpeed; //! ground speed [mm/s]
+	int32_t headMot; //! heading of motion [1e-5 deg]
+	uint32_t sAcc; //! speed accuracy [mm/s]
+	uint32_t headAcc; //! [1e-5 deg]
+	uint16_t pDOP; //! [0.01]
+	uint16_t flags3;
+	uint8_t reserved0[4];
+	int32_t headVeh; //! [1e-5 deg]
+	int16_t magDec; //! [1e-2 deg]
+	uint16_t magAcc;
+};
+
+//! UBX-NAV-HPPOSLLH, high precision position: lon + lonHp * 1e-2 in 1e-7 deg
+struct NavHpposllh
+{
+	uint8_t version;
+	uint8_t reserved0[2];
+	uint8_t flags; //! bit 0 invalidLlh
+	uint32_t iTOW; //! [ms]
+	int32_t lon; //! [1e-7 deg]
+	int32_t lat; //! [1e-7 deg]
+	int32_t height; //! above ellipsoid [mm]
+	int32_t hMSL; //! [mm]
+	int8_t lonHp; //! [1e-9 deg]
+	int8_t latHp; //! [1e-9 deg]
+	int8_t heightHp; //! [0.1 mm]
+	int8_t hMSLHp; //! [0.1 mm]
+	uint32_t hAcc; //! [0.1 mm]
+	uint32_t vAcc; //! [0.1 mm]
+};
+
+//! UBX-TIM-TP, time of the next time pulse
+struct TimTp
+{
+	uint32_t towMS; //! time of week of the pulse [ms]
+	uint32_t towSubMS; //! [2^-32 ms]
+	int32_t qErr; //! quantization error of the pulse [ps]
+	uint16_t week;
+	uint8_t flags; //! bit 0 time base UTC (else GNSS)
+	uint8_t refInfo;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(NavPvt) == 92, "UBX-NAV-PVT payload is 92 bytes");
+static_assert(sizeof(NavHpposllh) == 36, "UBX-NAV-HPPOSLLH payload is 36 bytes");
+static_assert(sizeof(TimTp) == 16, "UBX-TIM-TP payload is 16 bytes");
+
+//! 8-bit Fletcher checksum over class, id, length and payload
+inline void checksum(const uint8_t* data, size_t size, uint8_t& a, uint8_t& b)
+{
+	a = 0;
+	b = 0;
+	for(size_t i = 0; i < size; i++)
+	{
+		a += data[i];
+		b += a;
+	}
+}
+
+//! Writes a frame of the payload to out, which has room for HeaderSize + size + ChecksumSize bytes.
+//! Returns the frame size.
+inline size_t writeFrame(uint8_t* out, uint8_t messageClass, uint8_t id, const void* payload, uint16_t size)
+{
+	out[0] = Sync1;
+	out[1] = Sync2;
+	out[2] = messageClass;
+	out[3] = id;
+	out[4] = static_cast<uint8_t>(size & 0xFF);
+	out[5] = static_cast<uint8_t>(size >> 8);
+	const uint8_t* bytes = static_cast<const uint8_t*>(payload);
+	for(size_t i = 0; i < size; i++)
+	{
+		out[HeaderSize + i] = bytes[i];
+	}
+	checksum(out + 2, HeaderSize - 2 + size, out[HeaderSize + size], out[HeaderSize + size + 1]);
+	return HeaderSize + size + ChecksumSize;
+}
+} // namespace ubx
+} // namespace mandeye_utils
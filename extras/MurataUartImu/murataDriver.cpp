@@ -1,3 +1,4 @@
+#include "../utils/ExtrasUtils.h"
 #include <chrono>
 #include <cmath>
 #include <cstdint>
@@ -10,7 +11,6 @@
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <thread>
-#include <zmq.hpp>
 
 namespace fs = std::filesystem;
 
@@ -117,42 +117,19 @@ nlohmann::json getConfig(const std::string& configPath)
 // ── ZMQ subscriber thread ────────────────────────────────────────────────────
 void clientThread()
 {
-	try
-	{
-		zmq::context_t ctx(1);
-		zmq::socket_t sock(ctx, zmq::socket_type::sub);
-		sock.connect("tcp://localhost:5556");
-		sock.set(zmq::sockopt::subscribe, "");
-		sock.set(zmq::sockopt::conflate, 1);
-		std::cout << "Connected to tcp://localhost:5556" << std::endl;
-
-		while(true)
+	mandeye::extras::startStatusListener([](const mandeye_utils::status::Status& status) {
+		std::lock_guard<std::mutex> lk(state::stateMutex);
+		state::timestamp = status.timeNs;
+		if(status.hasState)
 		{
-			zmq::message_t msg;
-			if(!sock.recv(msg, zmq::recv_flags::none))
-				continue;
-
-			auto j = nlohmann::json::parse(std::string(static_cast<char*>(msg.data()), msg.size()));
-			if(!j.is_object())
-				continue;
-
-			std::lock_guard<std::mutex> lk(state::stateMutex);
-			if(j.contains("time"))
-				state::timestamp = j["time"].get<uint64_t>();
-			if(j.contains("mode"))
+			if(status.mode != state::modeName)
 			{
-				state::modeName = j["mode"].get<std::string>();
+				state::modeName = status.mode;
 				state::hashCode = std::hash<std::string>{}(state::modeName);
 			}
-			if(j.contains("continousScanDirectory"))
-				state::continuousScanTarget = j["continousScanDirectory"].get<std::string>();
+			state::continuousScanTarget = status.continousScanDirectory;
 		}
-	}
-	catch(const zmq::error_t& e)
-	{
-		std::cerr << "ZMQ error: " << e.what() << std::endl;
-		std::abort();
-	}
+	});
 }
 
 // ── Row stored in memory ──────────────────────────────────────────────────────
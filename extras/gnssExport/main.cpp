@@ -0,0 +1,272 @@
+#include "utils/GnssFormat.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Exports the binary GNSS logs (gnssNNNN.gnsb) of control_program to text.
+// Default: gnssNNNN.gnss next to each log, in the format control_program writes with "gnss_log": {"csv": true}.
+// --all: additionally one CSV per sentence or UBX message type with a header line, gnssNNNN_gga.csv, gnssNNNN_nav_pvt.csv, ...
+// Arguments are .gnsb files or directories, directories are searched recursively.
+
+namespace gnss = mandeye_utils::gnss;
+
+namespace
+{
+
+std::ostream& operator<<(std::ostream& out, const gnss::Time& time)
+{
+	if(time.hours < 0)
+	{
+		return out;
+	}
+	return out << std::setfill('0') << std::setw(2) << int(time.hours) << ":" << std::setw(2) << int(time.minutes) << ":"
+			   << std::setw(2) << int(time.seconds) << "." << std::setw(6) << time.microseconds << std::setfill(' ');
+}
+
+std::ostream& operator<<(std::ostream& out, const gnss::Date& date)
+{
+	if(date.day < 0)
+	{
+		return out;
+	}
+	return out << std::setfill('0') << std::setw(4) << date.year << "-" << std::setw(2) << int(date.month) << "-" << std::setw(2)
+			   << int(date.day) << std::setfill(' ');
+}
+
+//! Empty fields stay empty in the CSV
+std::string number(double value)
+{
+	if(std::isnan(value))
+	{
+		return "";
+	}
+	std::ostringstream ss;
+	ss << std::setprecision(12) << value;
+	return ss.str();
+}
+
+std::string character(char c)
+{
+	return c ? std::string(1, c) : std::string();
+}
+
+//! One CSV file per record type, opened on the first record of the type
+struct CsvWriter
+{
+	gnss::RecordType type;
+	const char* suffix;
+	const char* header;
+	std::function<void(std::ostream&, const gnss::RecordHeader&, const uint8_t*)> write;
+	std::ofstream stream;
+};
+
+std::vector<CsvWriter> makeCsvWriters()
+{
+	std::vector<CsvWriter> writers;
+	writers.push_back({gnss::RecordType::Gga,
+					   "gga",
+					   "timestamp_ns,system_time_ms,talker,time,latitude,longitude,fix_quality,satellites,hdop,altitude,height,dgps_age",
+					   [](std::ostream& out, const gnss::RecordHeader& h, const uint8_t* p) {
+						   const auto r = gnss::Reader::get<gnss::Gga>(h, p);
+						   out << r.time << "," << number(gnss::toCoord(r.latitude)) << "," << number(gnss::toCoord(r.longitude)) << ","
+							   << int(r.fixQuality) << "," << int(r.satellitesTracked) << "," << number(gnss::toDouble(r.hdop)) << ","
+							   << number(gnss::toDouble(r.altitude)) << "," << number(gnss::toDouble(r.height)) << ","
+							   << number(gnss::toDouble(r.dgpsAge));
+					   }});
+	writers.push_back({gnss::RecordType::Rmc,
+					   "rmc",
+					   "timestamp_ns,system_time_ms,talker,time,date,valid,latitude,longitude,speed_knots,course,variation",
+					   [](std::ostream& out, const gnss::RecordHeader& h, const uint8_t* p) {
+						   const auto r = gnss::Reader::get<gnss::Rmc>(h, p);
+						   out << r.time << "," << r.date << "," << int(r.valid) << "," << number(gnss::toCoord(r.latitude)) << ","
+							   << number(gnss::toCoord(r.longitude)) << "," << number(gnss::toDouble(r.speedKnots)) << ","
+							   << number(gnss::toDouble(r.course)) << "," << number(gnss::toDouble(r.variation));
+					   }});
+	writers.push_back({gnss::RecordType::Gst,
+					   "gst",
+					   "timestamp_ns,system_time_ms,talker,time,rms_deviation,semi_major_deviation,semi_minor_deviation,"
+					   "semi_major_orientation,latitude_error,longitude_error,altitude_error",
+					   [](std::ostream& out, const gnss::RecordHeader& h, const uint8_t* p) {
+						   const auto r = gnss::Reader::get<gnss::Gst>(h, p);
+						   out << r.time << "," << number(gnss::toDouble(r.rmsDeviation)) << ","
+							   << number(gnss::toDouble(r.semiMajorDeviation)) << "," << number(gnss::toDouble(r.semiMinorDeviation)) << ","
+							   << number(gnss::toDouble(r.semiMajorOrientation)) << ","
+							   << number(gnss::toDouble(r.latitudeErrorDeviation)) << ","
+							   << number(gnss::toDouble(r.longitudeErrorDeviation)) << ","
+							   << number(gnss::toDouble(r.altitudeErrorDeviation));
+					   }});
+	writers.push_back({gnss::RecordType::Gsa,
+					   "gsa",
+					   "timestamp_ns,system_time_ms,talker,mode,fix_type,satellites,pdop,hdop,vdop",
+					   [](std::ostream& out, const gnss::RecordHeader& h, const uint8_t* p) {
+						   const auto r = gnss::Reader::get<gnss::Gsa>(h, p);
+						   out << character(r.mode) << "," << int(r.fixType) << ",";
+						   bool first = true;
+						   for(uint16_t sat : r.sats)
+						   {
+							   if(sat != 0)
+							   {
+								   out << (first ? "" : " ") << int(sat);
+								   first = false;
+							   }
+						   }
+						   out << "," << number(gnss::toDouble(r.pdop)) << "," << number(gnss::toDouble(r.hdop)) << ","
+							   << number(gnss::toDouble(r.vdop));
+					   }});
+	writers.push_back({gnss::RecordType::Vtg,
+					   "vtg",
+					   "timestamp_ns,system_time_ms,talker,true_track,magnetic_track,speed_knots,speed_kph,faa_mode",
+					   [](std::ostream& out, const gnss::RecordHeader& h, const uint8_t* p) {
+						   const auto r = gnss::Reader::get<gnss::Vtg>(h, p);
+						   out << number(gnss::toDouble(r.trueTrackDegrees)) << "," << number(gnss::toDouble(r.magneticTrackDegrees))
+							   << "," << number(gnss::toDouble(r.speedKnots)) << "," << number(gnss::toDouble(r.speedKph)) << ","
+							   << character(r.faaMode);
+					   }});
+	writers.push_back({gnss::RecordType::UbxNavPvt,
+					   "nav_pvt",
+					   "timestamp_ns,system_time_ms,talker,itow_ms,date,time,fix_type,carrier_solution,satellites,latitude,longitude,"
+					   "height,altitude,horizontal_accuracy,vertical_accuracy,vel_n,vel_e,vel_d,speed,heading,pdop",
+					   [](std::ostream& out, const gnss::RecordHeader& h, const uint8_t* p) {
+						   const auto r = gnss::Reader::get<mandeye_utils::ubx::NavPvt>(h, p);
+						   const gnss::Date date{static_cast<int8_t>(r.day), static_cast<int8_t>(r.month), static_cast<int16_t>(r.year)};
+						   // nano is negative just before the full second, shown as that second
+						   const gnss::Time time{static_cast<int8_t>(r.hour), static_cast<int8_t>(r.min), static_cast<int8_t>(r.sec),
+												 std::max<int32_t>(0, r.nano / 1000)};
+						   out << r.iTOW << "," << date << "," << time << "," << int(r.fixType) << "," << (r.flags >> 6) << ","
+							   << int(r.numSV) << "," << number(r.lat * 1e-7) << "," << number(r.lon * 1e-7) << ","
+							   << number(r.height * 1e-3) << "," << number(r.hMSL * 1e-3) << "," << number(r.hAcc * 1e-3) << ","
+							   << number(r.vAcc * 1e-3) << "," << number(r.velN * 1e-3) << "," << number(r.velE * 1e-3) << ","
+							   << number(r.velD * 1e-3) << "," << number(r.gSpeed * 1e-3) << "," << number(r.headMot * 1e-5) << ","
+							   << number(r.pDOP * 1e-2);
+					   }});
+	writers.push_back({gnss::RecordType::UbxNavHpposllh,
+					   "nav_hpposllh",
+					   "timestamp_ns,system_time_ms,talker,itow_ms,invalid,latitude,longitude,height,altitude,horizontal_accuracy,"
+					   "vertical_accuracy",
+					   [](std::ostream& out, const gnss::RecordHeader& h, const uint8_t* p) {
+						   const auto r = gnss::Reader::get<mandeye_utils::ubx::NavHpposllh>(h, p);
+						   std::ostringstream ss;
+						   ss << std::setprecision(15) << r.iTOW << "," << (r.flags & 1) << "," << r.lat * 1e-7 + r.latHp * 1e-9 << ","
+							  << r.lon * 1e-7 + r.lonHp * 1e-9 << "," << r.height * 1e-3 + r.heightHp * 1e-4 << ","
+							  << r.hMSL * 1e-3 + r.hMSLHp * 1e-4 << "," << r.hAcc * 1e-4 << "," << r.vAcc * 1e-4;
+						   out << ss.str();
+					   }});
+	writers.push_back({gnss::RecordType::UbxTimTp,
+					   "tim_tp",
+					   "timestamp_ns,system_time_ms,talker,week,tow_ms,tow_sub_ms,quantization_error_ps,utc",
+					   [](std::ostream& out, const gnss::RecordHeader& h, const uint8_t* p) {
+						   const auto r = gnss::Reader::get<mandeye_utils::ubx::TimTp>(h, p);
+						   out << r.week << "," << r.towMS << "," << number(r.towSubMS / 4294967296.0) << "," << r.qErr << ","
+							   << (r.flags & 1);
+					   }});
+	return writers;
+}
+
+bool exportFile(const std::filesystem::path& path, bool all)
+{
+	std::ifstream in(path, std::ios::binary);
+	const std::string data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+	gnss::Reader reader(data.data(), data.size());
+	if(!reader.valid())
+	{
+		std::cerr << path << ": not a GNSS log of a supported version" << std::endl;
+		return false;
+	}
+
+	std::filesystem::path gnssPath = path;
+	gnssPath.replace_extension(".gnss");
+	std::ofstream gnssStream(gnssPath);
+	gnssStream << std::setprecision(20);
+
+	auto writers = all ? makeCsvWriters() : std::vector<CsvWriter>();
+	size_t records = 0;
+	size_t fixes = 0;
+	gnss::RecordHeader header;
+	const uint8_t* payload;
+	while(reader.next(header, payload))
+	{
+		records++;
+		if(header.type == static_cast<uint16_t>(gnss::RecordType::Gga))
+		{
+			gnss::writeGnssLine(gnssStream, header, gnss::Reader::get<gnss::Gga>(header, payload));
+			fixes++;
+		}
+		auto writer = std::find_if(writers.begin(), writers.end(), [&header](const CsvWriter& writer) {
+			return static_cast<uint16_t>(writer.type) == header.type;
+		});
+		if(writer == writers.end())
+		{
+			continue;
+		}
+		if(!writer->stream.is_open())
+		{
+			const std::string csvName = path.stem().string() + "_" + writer->suffix + ".csv";
+			writer->stream.open(path.parent_path() / csvName);
+			writer->stream << writer->header << "\n";
+		}
+		writer->stream << header.laserTimestampNs << "," << header.systemTimeMs << "," << character(header.talker[0])
+					   << character(header.talker[1]) << ",";
+		writer->write(writer->stream, header, payload);
+		writer->stream << "\n";
+	}
+	std::cout << path.string() << ": " << records << " records, " << fixes << " fixes" << std::endl;
+	return true;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	bool all = false;
+	std::vector<std::filesystem::path> files;
+	for(int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--all")
+		{
+			all = true;
+		}
+		else if(arg.empty() || arg[0] == '-')
+		{
+			std::cout << "Usage: " << argv[0] << " [--all] <file.gnsb|directory>..." << std::endl;
+			return arg == "--help" || arg == "-h" ? 0 : 1;
+		}
+		else if(std::filesystem::is_directory(arg))
+		{
+			for(const auto& entry : std::filesystem::recursive_directory_iterator(arg))
+			{
+				if(entry.is_regular_file() && entry.path().extension() == ".gnsb")
+				{
+					files.push_back(entry.path());
+				}
+			}
+		}
+		else
+		{
+			files.push_back(arg);
+		}
+	}
+	if(files.empty())
+	{
+		std::cout << "Usage: " << argv[0] << " [--all] <file.gnsb|directory>..." << std::endl;
+		return 1;
+	}
+	std::sort(files.begin(), files.end());
+
+	int failed = 0;
+	for(const auto& file : files)
+	{
+		if(!exportFile(file, all))
+		{
+			failed++;
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,290 @@
+#include "utils/UbxProtocol.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Feeds a pseudo terminal with GNSS data, for testing control_program without a receiver:
+//   mandeye_gnss_replay --link /tmp/ttyGNSS capture.bin
+//   MANDEYE_GNSS_PORT=/tmp/ttyGNSS control_program
+// Replays a raw capture of a receiver (e.g. cat /dev/ttyACM0 > capture.bin), NMEA and UBX mixed, paced at the baud rate.
+// --synthetic HZ: generates epochs of GGA, RMC, GST, UBX NAV-PVT, NAV-HPPOSLLH and TIM-TP instead, slowly moving north.
+
+namespace ubx = mandeye_utils::ubx;
+
+namespace
+{
+
+std::string nmea(const std::string& body)
+{
+	unsigned char checksum = 0;
+	for(char c : body)
+	{
+		checksum ^= static_cast<unsigned char>(c);
+	}
+	char tail[8];
+	snprintf(tail, sizeof(tail), "*%02X\r\n", checksum);
+	return "$" + body + tail;
+}
+
+//! NMEA ddmm.mmmmm of degrees
+std::string nmeaCoord(double degrees, int degreeDigits)
+{
+	const double absolute = std::fabs(degrees);
+	const int whole = static_cast<int>(absolute);
+	char text[32];
+	snprintf(text, sizeof(text), "%0*d%08.5f", degreeDigits, whole, (absolute - whole) * 60.0);
+	return text;
+}
+
+template <typename Payload>
+void appendUbx(std::vector<uint8_t>& out, uint8_t messageClass, uint8_t id, const Payload& payload)
+{
+	uint8_t frame[ubx::HeaderSize + sizeof(Payload) + ubx::ChecksumSize];
+	const size_t size = ubx::writeFrame(frame, messageClass, id, &payload, sizeof(Payload));
+	out.insert(out.end(), frame, frame + size);
+}
+
+//! One epoch of the synthetic receiver, epoch counts from 0 at 12:00:00
+std::vector<uint8_t> syntheticEpoch(uint64_t epoch, int hz)
+{
+	const uint32_t epochMs = static_cast<uint32_t>(epoch * 1000 / hz);
+	const uint32_t iTOW = 3 * 86400000u + 12 * 3600000u + epochMs; // Wednesday noon
+	const int seconds = 12 * 3600 + epochMs / 1000;
+	const int hours = seconds / 3600 % 24;
+	const int minutes = seconds / 60 % 60;
+	const int second = seconds % 60;
+	const int centiseconds = epochMs % 1000 / 10;
+	const double latitude = 52.2296756 + epochMs * 1e-9; // 0.1 m/s north
+	const double longitude = 21.0122287;
+	const double altitude = 110.25;
+
+	char time[16];
+	snprintf(time, sizeof(time), "%02d%02d%02d.%02d", hours, minutes, second, centiseconds);
+	const std::string lat = nmeaCoord(latitude, 2) + ",N";
+	const std::string lon = nmeaCoord(longitude, 3) + ",E";
+
+	std::string text;
+	text += nmea(std::string("GNGGA,") + time + "," + lat + "," + lon + ",4,18,0.6," + std::to_string(altitude) + ",M,34.5,M,1.0,0000");
+	text += nmea(std::string("GNRMC,") + time + ",A," + lat + "," + lon + ",0.194,0.0,191026,,,R,V");
+	text += nmea(std::string("GNGST,") + time + ",0.9,0.012,0.010,45.0,0.011,0.010,0.018");
+	std::vector<uint8_t> out(text.begin(), text.end());
+
+	ubx::NavPvt pvt{};
+	pvt.iTOW = iTOW;
+	pvt.year = 2026;
+	pvt.month = 10;
+	pvt.day = 19;
+	pvt.hour = hours;
+	pvt.min = minutes;
+	pvt.sec = second;
+	pvt.valid = 0x07;
+	pvt.tAcc = 20;
+	pvt.nano = static_cast<int32_t>(epochMs % 1000) * 1000000;
+	pvt.fixType = 3;
+	pvt.flags = 0x01 | (2 << 6);
+	pvt.numSV = 18;
+	pvt.lon = static_cast<int32_t>(std::lround(longitude * 1e7));
+	pvt.lat = static_cast<int32_t>(std::lround(latitude * 1e7));
+	pvt.height = static_cast<int32_t>((altitude + 34.5) * 1e3);
+	pvt.hMSL = static_cast<int32_t>(altitude * 1e3);
+	pvt.hAcc = 14;
+	pvt.vAcc = 20;
+	pvt.velN = 100;
+	pvt.gSpeed = 100;
+	pvt.sAcc = 30;
+	pvt.headAcc = 500000;
+	pvt.pDOP = 120;
+	appendUbx(out, ubx::ClassNav, ubx::IdNavPvt, pvt);
+
+	ubx::NavHpposllh hp{};
+	hp.iTOW = iTOW;
+	hp.lon = pvt.lon;
+	hp.lat = static_cast<int32_t>(latitude * 1e7);
+	hp.latHp = static_cast<int8_t>(std::lround((latitude * 1e7 - hp.lat) * 100));
+	hp.height = pvt.height;
+	hp.hMSL = pvt.hMSL;
+	hp.hAcc = 140;
+	hp.vAcc = 200;
+	appendUbx(out, ubx::ClassNav, ubx::IdNavHpposllh, hp);
+
+	if(epochMs % 1000 == 0)
+	{
+		ubx::TimTp tp{};
+		tp.towMS = iTOW + 1000;
+		tp.qErr = -1200;
+		tp.week = 2440;
+		tp.flags = 0x01;
+		appendUbx(out, ubx::ClassTim, ubx::IdTimTp, tp);
+	}
+	return out;
+}
+
+bool writeAll(int fd, const uint8_t* data, size_t size)
+{
+	while(size > 0)
+	{
+		const ssize_t written = ::write(fd, data, size);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			// EIO while no one has the other side open, the data is dropped like on a real serial line
+			return errno == EIO || errno == EAGAIN;
+		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+int openPty(const std::string& link)
+{
+	const int fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+	{
+		std::cerr << "Cannot create pseudo terminal : " << strerror(errno) << std::endl;
+		return -1;
+	}
+	termios tio;
+	tcgetattr(fd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(fd, TCSANOW, &tio);
+	const std::string slave = ptsname(fd);
+	std::cout << "Serial port: " << slave << std::endl;
+	if(!link.empty())
+	{
+		::unlink(link.c_str());
+		if(::symlink(slave.c_str(), link.c_str()) != 0)
+		{
+			std::cerr << "Cannot link " << link << " : " << strerror(errno) << std::endl;
+			close(fd);
+			return -1;
+		}
+		std::cout << "Linked to " << link << std::endl;
+	}
+	return fd;
+}
+
+void usage(const char* name)
+{
+	std::cout << "Usage: " << name << " [--link PATH] [--baud N] [--loop] <capture>" << std::endl;
+	std::cout << "       " << name << " [--link PATH] --synthetic HZ" << std::endl;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	std::string link;
+	std::string capture;
+	int baud = 115200;
+	int synthetic = 0;
+	bool loop = false;
+	for(int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--link" && i + 1 < argc)
+		{
+			link = argv[++i];
+		}
+		else if(arg == "--baud" && i + 1 < argc)
+		{
+			baud = std::max(1200, std::atoi(argv[++i]));
+		}
+		else if(arg == "--synthetic" && i + 1 < argc)
+		{
+			synthetic = std::max(1, std::min(100, std::atoi(argv[++i])));
+		}
+		else if(arg == "--loop")
+		{
+			loop = true;
+		}
+		else if(!arg.empty() && arg[0] != '-' && capture.empty())
+		{
+			capture = arg;
+		}
+		else
+		{
+			usage(argv[0]);
+			return arg == "--help" || arg == "-h" ? 0 : 1;
+		}
+	}
+	if(capture.empty() == (synthetic == 0))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<uint8_t> data;
+	if(!capture.empty())
+	{
+		std::ifstream in(capture, std::ios::binary);
+		data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		if(data.empty())
+		{
+			std::cerr << "Nothing to replay in " << capture << std::endl;
+			return 1;
+		}
+	}
+
+	const int fd = openPty(link);
+	if(fd < 0)
+	{
+		return 1;
+	}
+
+	auto next = std::chrono::steady_clock::now();
+	if(synthetic > 0)
+	{
+		for(uint64_t epoch = 0;; epoch++)
+		{
+			const auto bytes = syntheticEpoch(epoch, synthetic);
+			if(!writeAll(fd, bytes.data(), bytes.size()))
+			{
+				std::cerr << "Write failed : " << strerror(errno) << std::endl;
+				break;
+			}
+			next += std::chrono::microseconds(1000000 / synthetic);
+			std::this_thread::sleep_until(next);
+		}
+	}
+	else
+	{
+		// 10 bits per byte on the line, written in blocks of about 10 ms
+		const size_t block = std::max<size_t>(1, baud / 10 / 100);
+		do
+		{
+			for(size_t offset = 0; offset < data.size(); offset += block)
+			{
+				const size_t size = std::min(block, data.size() - offset);
+				if(!writeAll(fd, data.data() + offset, size))
+				{
+					std::cerr << "Write failed : " << strerror(errno) << std::endl;
+					close(fd);
+					return 1;
+				}
+				next += std::chrono::microseconds(size * 10 * 1000000 / baud);
+				std::this_thread::sleep_until(next);
+			}
+		} while(loop);
+	}
+	if(!link.empty())
+	{
+		::unlink(link.c_str());
+	}
+	close(fd);
+	return 0;
+}
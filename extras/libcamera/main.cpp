@@ -190,16 +190,14 @@ struct HelloHandler : public Http::Handler
 
 void clientThread()
 {
-	mandeye::extras::startZeroMQListener([](const nlohmann::json& j) {
-		std::lock_guard<std::mutex> lck(global::stateMutex);
-		if(j.contains(mandeye::extras::keys::MODE))
-		{
-			global::state = j[mandeye::extras::keys::MODE].get<std::string>();
-		}
-		if(j.contains(mandeye::extras::keys::CONTINUOUS_SCAN_DIRECTORY))
+	mandeye::extras::startStatusListener([](const mandeye_utils::status::Status& status) {
+		if(!status.hasState)
 		{
-			global::continousScanTarget = j[mandeye::extras::keys::CONTINUOUS_SCAN_DIRECTORY].get<std::string>();
+			return;
 		}
+		std::lock_guard<std::mutex> lck(global::stateMutex);
+		global::state = status.mode;
+		global::continousScanTarget = status.continousScanDirectory;
 	});
 }
 
@@ -119,19 +119,13 @@ ScanStats scanDirectory(const std::string& path)
 
 void clientThread()
 {
-	mandeye::extras::startZeroMQListener([](const nlohmann::json& j) {
+	mandeye::extras::startStatusListener([](const mandeye_utils::status::Status& status) {
 		std::lock_guard<std::mutex> lck(state::stateMutex);
-		if(j.contains(mandeye::extras::keys::TIME))
+		state::timestamp = status.timeNs;
+		if(status.hasState)
 		{
-			state::timestamp = j[mandeye::extras::keys::TIME].get<uint64_t>();
-		}
-		if(j.contains(mandeye::extras::keys::MODE))
-		{
-			state::modeName = j[mandeye::extras::keys::MODE].get<std::string>();
-		}
-		if(j.contains(mandeye::extras::keys::CONTINUOUS_SCAN_DIRECTORY))
-		{
-			state::continuousScanTarget = j[mandeye::extras::keys::CONTINUOUS_SCAN_DIRECTORY].get<std::string>();
+			state::modeName = status.mode;
+			state::continuousScanTarget = status.continousScanDirectory;
 		}
 	});
 }
@@ -2,6 +2,7 @@
 import zmq
 import time
 import json
+import struct
 import os
 from picamera2 import Picamera2
 import time
@@ -17,6 +18,25 @@ received_mode = ""
 received_command = None
 received_data_continous = ""
 Blacklisted = ['FrameDurationLimits']
+
+# Binary status of control_program, see code/utils/StatusFormat.h
+STATUS_HEADER = struct.Struct("<IHHIQQqQddqIBBHHH")
+STATUS_MAGIC = 0x5453444D
+STATUS_HAS_STATE = 1
+
+def decode_message(message):
+    if len(message) >= STATUS_HEADER.size and struct.unpack_from("<I", message)[0] == STATUS_MAGIC:
+        fields = STATUS_HEADER.unpack_from(message)
+        header_size, flags, time_ns = fields[2], fields[3], fields[4]
+        mode_len, stop_len, continous_len = fields[14:17]
+        data = {'time': time_ns}
+        if flags & STATUS_HAS_STATE:
+            offset = header_size
+            data['mode'] = message[offset:offset + mode_len].decode()
+            offset += mode_len + stop_len
+            data['continousScanDirectory'] = message[offset:offset + continous_len].decode()
+        return data
+    return json.loads(message)
 def load_json_config(file_path):
     """
     Loads and parses the JSON configuration from the specified file.
@@ -85,8 +105,8 @@ def threadedZmqClient():
     socket = context.socket(zmq.SUB)
     socket.connect("tcp://localhost:5556") # mandeye controller
     socket.connect("tcp://localhost:5557") # web client
+    # controller sends [topic][payload], web client a single frame; no conflate, it breaks multipart
     socket.setsockopt_string(zmq.SUBSCRIBE, "")
-    socket.setsockopt(zmq.CONFLATE,1)
     print("Subscriber connected and listening for messages...")
     while True:
         global received_mode
@@ -94,9 +114,11 @@ def threadedZmqClient():
         global received_timestamp
         global received_data_continous
         # Wait for a message
-        message = socket.recv_string()
+        parts = socket.recv_multipart()
+        if len(parts) > 1 and parts[0] == b"chunk":
+            continue
         try:
-            data = json.loads(message)
+            data = decode_message(parts[-1])
             if 'command' in data:
                 with received_lock:
                     received_command = data['command']
@@ -0,0 +1,110 @@
+#include "save_laz.h"
+#include "save_raw.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Converts chunks saved by the raw point cloud codecs of control_program (lidarNNNN.bin, .bin.lz4, .bin.zst) to LAZ.
+// Default: lidarNNNN.laz next to each chunk, as control_program writes with the "laz" codec.
+// --las: uncompressed lidarNNNN.las instead.
+// Arguments are raw chunks or directories, directories are searched recursively. Existing outputs are not overwritten.
+
+namespace
+{
+const std::vector<std::string> RawExtensions{".bin", ".bin.lz4", ".bin.zst"};
+
+//! Returns the extension of a raw chunk, empty if the file is not one
+std::string rawExtension(const std::filesystem::path& path)
+{
+	const std::string name = path.filename().string();
+	for(const auto& extension : RawExtensions)
+	{
+		if(name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0)
+		{
+			return extension;
+		}
+	}
+	return "";
+}
+
+bool convertFile(const std::filesystem::path& file, bool compress)
+{
+	const std::string extension = rawExtension(file);
+	if(extension.empty())
+	{
+		std::cerr << file << " is not a raw chunk" << std::endl;
+		return false;
+	}
+	const std::string name = file.filename().string();
+	const std::filesystem::path output = file.parent_path() / (name.substr(0, name.size() - extension.size()) + (compress ? ".laz" : ".las"));
+	if(std::filesystem::exists(output))
+	{
+		std::cout << "Skipping " << file << ", " << output << " exists" << std::endl;
+		return true;
+	}
+	const auto buffer = mandeye::loadRaw(file.string());
+	if(!buffer)
+	{
+		return false;
+	}
+	const auto stats = mandeye::saveLaz(output.string(), buffer, compress);
+	if(!stats)
+	{
+		std::cerr << "Failed to write " << output << std::endl;
+		return false;
+	}
+	std::cout << file << " -> " << output << ", " << stats->m_pointsCount << " points" << std::endl;
+	return true;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	bool compress = true;
+	std::vector<std::filesystem::path> files;
+	for(int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--las")
+		{
+			compress = false;
+		}
+		else if(arg.empty() || arg[0] == '-')
+		{
+			std::cout << "Usage: " << argv[0] << " [--las] <lidarNNNN.bin[.lz4|.zst]|directory>..." << std::endl;
+			return arg == "--help" || arg == "-h" ? 0 : 1;
+		}
+		else if(std::filesystem::is_directory(arg))
+		{
+			for(const auto& entry : std::filesystem::recursive_directory_iterator(arg))
+			{
+				if(entry.is_regular_file() && !rawExtension(entry.path()).empty())
+				{
+					files.push_back(entry.path());
+				}
+			}
+		}
+		else
+		{
+			files.push_back(arg);
+		}
+	}
+	if(files.empty())
+	{
+		std::cout << "Usage: " << argv[0] << " [--las] <lidarNNNN.bin[.lz4|.zst]|directory>..." << std::endl;
+		return 1;
+	}
+	std::sort(files.begin(), files.end());
+
+	int failed = 0;
+	for(const auto& file : files)
+	{
+		if(!convertFile(file, compress))
+		{
+			failed++;
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -105,7 +105,7 @@ void GNSSClient::worker()
 					double laserTimestamp = 0.0;
 					{
 						std::lock_guard<std::mutex> lock(m_laserTsMutex);
-						laserTimestamp = m_laserTimestamp;
+						laserTimestamp = m_clockModel.valid ? m_clockModel.toLidarNs(std::chrono::steady_clock::now()) : m_laserTimestamp;
 					}
 					m_dataCallback(RawEntryToLine(line, laserTimestamp));
 				}
@@ -130,6 +130,12 @@ void GNSSClient::setLaserTimestamp(uint64_t laserTimestamp)
 	m_laserTimestamp = laserTimestamp;
 }
 
+void GNSSClient::setClockModel(const mandeye_utils::ClockModel& clockModel)
+{
+	std::lock_guard<std::mutex> lock(m_laserTsMutex);
+	m_clockModel = clockModel;
+}
+
 //! Convert a minmea_sentence_gga to a CSV line
 std::string GNSSClient::GgaToCsvLine(const minmea_sentence_gga& gga, uint64_t laserTimestamp)
 {
@@ -6,6 +6,7 @@
 
 #include "minmea.h"
 #include "ntrip.h"
+#include "utils/ClockModel.h"
 #include "utils/TimeStampReceiver.h"
 #include <SerialPort.h>
 #include <SerialStream.h>
@@ -47,9 +48,13 @@ public:
 
 	void setLaserTimestamp(uint64_t laserTimestamp);
 
+	//! Set lidar clock model, when valid it is used instead of last laser timestamp
+	void setClockModel(const mandeye_utils::ClockModel& clockModel);
+
 private:
 	std::mutex m_laserTsMutex;
 	uint64_t m_laserTimestamp{0};
+	mandeye_utils::ClockModel m_clockModel;
 
 	std::mutex m_bufferMutex;
 	std::string m_lastLine;
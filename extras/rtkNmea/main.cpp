@@ -46,20 +46,15 @@ std::string continuousScanTarget;
 } // namespace state
 void clientThread()
 {
-	mandeye::extras::startZeroMQListener([](const nlohmann::json& j) {
+	mandeye::extras::startStatusListener([](const mandeye_utils::status::Status& status) {
 		std::lock_guard<std::mutex> lck(state::stateMutex);
-		if(j.contains(mandeye::extras::keys::TIME))
+		state::timestamp = static_cast<double>(status.timeNs);
+		global::gnssClient.setLaserTimestamp(state::timestamp);
+		global::gnssClient.setClockModel(status.clock);
+		if(status.hasState)
 		{
-			state::timestamp = j[mandeye::extras::keys::TIME].get<double>();
-			global::gnssClient.setLaserTimestamp(state::timestamp);
-		}
-		if(j.contains(mandeye::extras::keys::MODE))
-		{
-			state::modeName = j[mandeye::extras::keys::MODE].get<std::string>();
-		}
-		if(j.contains(mandeye::extras::keys::CONTINUOUS_SCAN_DIRECTORY))
-		{
-			state::continuousScanTarget = j[mandeye::extras::keys::CONTINUOUS_SCAN_DIRECTORY].get<std::string>();
+			state::modeName = status.mode;
+			state::continuousScanTarget = status.continousScanDirectory;
 		}
 	});
 }
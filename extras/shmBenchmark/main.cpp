@@ -0,0 +1,195 @@
+#include "../utils/ShmReader.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Measures how fast a consumer reads the shared-memory point stream in place.
+// Default: attaches to the live /mandeye_points ring of control_program ("shm" enabled in the config).
+// --self: runs its own writer thread at full speed into a private ring, to measure the upper bound.
+
+namespace
+{
+constexpr char SelfTestName[] = "/mandeye_points_benchmark";
+constexpr uint64_t SelfTestCapacity = 1 << 20;
+constexpr size_t WriterBatch = 96; // points in a Livox packet
+
+struct Stats
+{
+	uint64_t records{0};
+	uint64_t spans{0};
+	uint64_t torn{0};
+	double checksum{0};
+};
+
+//! Consumes spans for duration, touching every point like a real consumer would
+Stats consume(mandeye::extras::ShmPointReader& reader, std::chrono::seconds duration, bool wait)
+{
+	Stats stats;
+	const auto end = std::chrono::steady_clock::now() + duration;
+	auto nextReport = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+	uint64_t lastRecords = 0;
+	while(std::chrono::steady_clock::now() < end)
+	{
+		auto span = reader.Peek(65536);
+		if(span.count == 0)
+		{
+			if(wait)
+			{
+				reader.Raw().WaitForData(100);
+			}
+			continue;
+		}
+		double sum = 0;
+		for(size_t i = 0; i < span.count; i++)
+		{
+			sum += span.data[i].x + span.data[i].y + span.data[i].z;
+		}
+		if(reader.Release(span))
+		{
+			stats.records += span.count;
+			stats.checksum += sum;
+		}
+		else
+		{
+			stats.torn++;
+		}
+		stats.spans++;
+
+		const auto now = std::chrono::steady_clock::now();
+		if(now >= nextReport)
+		{
+			std::cout << "  " << (stats.records - lastRecords) / 1e6 << " Mpts/s, lost " << reader.Raw().GetLost() << std::endl;
+			lastRecords = stats.records;
+			nextReport += std::chrono::seconds(1);
+		}
+	}
+	return stats;
+}
+
+mandeye_utils::shm::RingHeader* createSelfTestRing(size_t& size)
+{
+	shm_unlink(SelfTestName);
+	const int fd = shm_open(SelfTestName, O_CREAT | O_RDWR, 0600);
+	if(fd < 0)
+	{
+		return nullptr;
+	}
+	size = mandeye_utils::shm::segmentSize(SelfTestCapacity, sizeof(mandeye_utils::shm::Point));
+	if(ftruncate(fd, size) != 0)
+	{
+		close(fd);
+		return nullptr;
+	}
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(memory == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	auto* header = new(memory) mandeye_utils::shm::RingHeader();
+	header->recordSize = sizeof(mandeye_utils::shm::Point);
+	header->capacity = SelfTestCapacity;
+	header->sessionId = getpid();
+	return header;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	bool selfTest = false;
+	int seconds = 10;
+	for(int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--self")
+		{
+			selfTest = true;
+		}
+		else if((arg == "--seconds" || arg == "-s") && i + 1 < argc)
+		{
+			seconds = std::max(1, std::atoi(argv[++i]));
+		}
+		else
+		{
+			std::cout << "Usage: " << argv[0] << " [--self] [--seconds N]" << std::endl;
+			return arg == "--help" || arg == "-h" ? 0 : 1;
+		}
+	}
+
+	size_t selfTestSize = 0;
+	mandeye_utils::shm::RingHeader* selfTestRing = nullptr;
+	std::atomic<bool> writing{true};
+	std::atomic<uint64_t> written{0};
+	std::thread writer;
+	if(selfTest)
+	{
+		selfTestRing = createSelfTestRing(selfTestSize);
+		if(!selfTestRing)
+		{
+			std::cerr << "Cannot create " << SelfTestName << " : " << strerror(errno) << std::endl;
+			return 1;
+		}
+		writer = std::thread([&]() {
+			std::vector<mandeye_utils::shm::Point> batch(WriterBatch);
+			for(size_t i = 0; i < batch.size(); i++)
+			{
+				batch[i] = {i, 1.0f, 2.0f, 3.0f, 100.0f, 0, 0, 0};
+			}
+			while(writing)
+			{
+				mandeye_utils::shm::write<mandeye_utils::shm::Point>(
+					selfTestRing, batch.data(), batch.size(), [](const mandeye_utils::shm::Point& p) { return p; });
+				written.fetch_add(batch.size(), std::memory_order_relaxed);
+			}
+		});
+	}
+
+	mandeye::extras::ShmPointReader reader;
+	const std::string name = selfTest ? SelfTestName : mandeye_utils::shm::PointsName;
+	if(!reader.Open(name))
+	{
+		std::cerr << "Cannot open " << name << ", is control_program running with \"shm\" enabled?" << std::endl;
+		writing = false;
+		if(writer.joinable())
+		{
+			writer.join();
+		}
+		return 1;
+	}
+
+	std::cout << "Reading " << name << " (" << reader.Raw().GetCapacity() << " points) for " << seconds << " s" << std::endl;
+	const auto start = std::chrono::steady_clock::now();
+	const Stats stats = consume(reader, std::chrono::seconds(seconds), !selfTest);
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	writing = false;
+	if(writer.joinable())
+	{
+		writer.join();
+	}
+
+	const double mb = double(stats.records) * sizeof(mandeye_utils::shm::Point) / (1024 * 1024);
+	std::cout << "Points read : " << stats.records << std::endl;
+	std::cout << "Throughput  : " << stats.records / elapsed / 1e6 << " Mpts/s, " << mb / elapsed << " MB/s" << std::endl;
+	std::cout << "Spans       : " << stats.spans << ", avg " << (stats.spans ? stats.records / stats.spans : 0) << " points" << std::endl;
+	std::cout << "Lost        : " << reader.Raw().GetLost() << " (overrun), torn spans " << stats.torn << std::endl;
+	if(selfTest)
+	{
+		std::cout << "Written     : " << written.load() / elapsed / 1e6 << " Mpts/s" << std::endl;
+		munmap(selfTestRing, selfTestSize);
+		shm_unlink(SelfTestName);
+	}
+	std::cout << "Checksum    : " << stats.checksum << std::endl;
+	return 0;
+}
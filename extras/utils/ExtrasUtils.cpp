@@ -14,31 +14,52 @@ std::string getEnvString(const std::string& env, const std::string& def)
 	return std::string{env_p};
 }
 
-void startZeroMQListener(const StatusCallback& callback)
+mandeye_utils::ClockModel getClockModel(const nlohmann::json& status)
+{
+	if(!status.contains(keys::CLOCK) || !status[keys::CLOCK].is_object())
+	{
+		return {};
+	}
+	return mandeye_utils::ClockModel::fromJson(status[keys::CLOCK]);
+}
+
+namespace
+{
+//! Receives time and state messages forever, calls handler with the payload of each message
+void receiveStatus(const std::function<void(const zmq::message_t&)>& handler)
 {
 	try
 	{
 		zmq::context_t context(1);
 		zmq::socket_t socket(context, zmq::socket_type::sub);
 		socket.connect(keys::ZMQ_ENDPOINT);
-		socket.set(zmq::sockopt::subscribe, "");
-		socket.set(zmq::sockopt::conflate, 1);
+		// no conflate, it drops state messages between time ticks and does not support multipart
+		socket.set(zmq::sockopt::subscribe, mandeye_utils::status::TopicTime);
+		socket.set(zmq::sockopt::subscribe, mandeye_utils::status::TopicState);
 
 		std::cout << "Connected to " << keys::ZMQ_ENDPOINT << std::endl;
 		std::cout << "Waiting for messages..." << std::endl;
 
 		while(true)
 		{
-			zmq::message_t message;
-			auto result = socket.recv(message, zmq::recv_flags::none);
-			if(result)
+			zmq::message_t topic;
+			if(!socket.recv(topic, zmq::recv_flags::none))
+			{
+				continue;
+			}
+			if(!topic.more())
+			{
+				continue; // not a topic + payload message
+			}
+			zmq::message_t payload;
+			if(socket.recv(payload, zmq::recv_flags::none))
+			{
+				handler(payload);
+			}
+			// drop frames added by newer publishers
+			while(payload.more())
 			{
-				const std::string msg_str(static_cast<char*>(message.data()), message.size());
-				const nlohmann::json j = nlohmann::json::parse(msg_str);
-				if(j.is_object())
-				{
-					callback(j);
-				}
+				socket.recv(payload, zmq::recv_flags::none);
 			}
 		}
 	}
@@ -48,5 +69,54 @@ void startZeroMQListener(const StatusCallback& callback)
 		std::abort();
 	}
 }
+} // namespace
+
+void startZeroMQListener(const StatusCallback& callback)
+{
+	mandeye_utils::status::Status status;
+	receiveStatus([&](const zmq::message_t& message) {
+		if(mandeye_utils::status::decode(message.data(), message.size(), status))
+		{
+			callback(status.toJson());
+			return;
+		}
+		const std::string msg_str(static_cast<const char*>(message.data()), message.size());
+		const nlohmann::json j = nlohmann::json::parse(msg_str, nullptr, false);
+		if(j.is_object())
+		{
+			callback(j);
+		}
+	});
+}
+
+void startStatusListener(const StatusMessageCallback& callback)
+{
+	mandeye_utils::status::Status status;
+	receiveStatus([&](const zmq::message_t& message) {
+		if(mandeye_utils::status::isBinary(message.data(), message.size()))
+		{
+			if(mandeye_utils::status::decode(message.data(), message.size(), status))
+			{
+				callback(status);
+			}
+			return;
+		}
+		// JSON publisher
+		const std::string msg_str(static_cast<const char*>(message.data()), message.size());
+		const nlohmann::json j = nlohmann::json::parse(msg_str, nullptr, false);
+		if(j.is_object())
+		{
+			auto parsed = mandeye_utils::status::Status::fromJson(j);
+			if(!parsed.hasState)
+			{
+				parsed.mode = status.mode;
+				parsed.stopScanDirectory = status.stopScanDirectory;
+				parsed.continousScanDirectory = status.continousScanDirectory;
+			}
+			status = std::move(parsed);
+			callback(status);
+		}
+	});
+}
 
 } // namespace mandeye::extras
\ No newline at end of file
@@ -1,4 +1,6 @@
 #pragma once
+#include "utils/ClockModel.h"
+#include "utils/StatusFormat.h"
 #include <functional>
 #include <nlohmann/json.hpp>
 #include <string>
@@ -11,6 +13,7 @@ constexpr const char* ZMQ_ENDPOINT = "tcp://localhost:5556";
 constexpr const char* MODE = "mode";
 constexpr const char* CONTINUOUS_SCAN_DIRECTORY = "continousScanDirectory";
 constexpr const char* TIME = "time";
+constexpr const char* CLOCK = "clock";
 constexpr const char* MODE_SCANNING = "SCANNING";
 constexpr const char* MODE_STOPPING = "STOPPING";
 } // namespace keys
@@ -18,10 +21,20 @@ constexpr const char* MODE_STOPPING = "STOPPING";
 //! Returns environment variable value or default
 std::string getEnvString(const std::string& env, const std::string& def);
 
+//! Returns lidar clock model published by control_program, not valid if message has none.
+//! With valid model lidar time of an event is model.toLidarNs(std::chrono::steady_clock::now()).
+mandeye_utils::ClockModel getClockModel(const nlohmann::json& status);
+
 using StatusCallback = std::function<void(const nlohmann::json&)>;
+using StatusMessageCallback = std::function<void(const mandeye_utils::status::Status&)>;
 
-//! Connects a ZeroMQ SUB socket to ZMQ_ENDPOINT and calls callback with the raw message string.
-//! Blocks forever; aborts on ZMQ error.
+//! Connects a ZeroMQ SUB socket to ZMQ_ENDPOINT, subscribes to the time and state topics and calls
+//! callback with each status as JSON. Accepts binary and JSON payloads. Blocks forever; aborts on ZMQ error.
 void startZeroMQListener(const StatusCallback& callback);
 
+//! Same as startZeroMQListener, but calls callback with the decoded status without going through JSON.
+//! The status object is reused between calls, mode and directories keep their last received values
+//! (status.hasState tells if this message carried them).
+void startStatusListener(const StatusMessageCallback& callback);
+
 } // namespace mandeye::extras
\ No newline at end of file
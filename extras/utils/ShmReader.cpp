@@ -0,0 +1,171 @@
+#include "ShmReader.h"
+#include <algorithm>
+#include <cstddef>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zmq.hpp>
+
+namespace mandeye::extras
+{
+
+struct ShmRingReader::Notifier
+{
+	zmq::context_t context{1};
+	zmq::socket_t socket{context, zmq::socket_type::sub};
+};
+
+ShmRingReader::ShmRingReader() = default;
+
+ShmRingReader::~ShmRingReader()
+{
+	Close();
+}
+
+bool ShmRingReader::Open(const std::string& name, uint32_t recordSize)
+{
+	Close();
+	const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if(fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(mandeye_utils::shm::RingHeader))
+	{
+		close(fd);
+		return false;
+	}
+	void* memory = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(memory == MAP_FAILED)
+	{
+		return false;
+	}
+	const auto* header = static_cast<const mandeye_utils::shm::RingHeader*>(memory);
+	const bool valid = header->magic == mandeye_utils::shm::Magic && header->version >= 1 &&
+					   header->headerSize >= sizeof(mandeye_utils::shm::RingHeader) && header->recordSize == recordSize &&
+					   header->capacity > 0 && (header->capacity & (header->capacity - 1)) == 0 &&
+					   size_t(st.st_size) >= header->headerSize + header->capacity * header->recordSize;
+	if(!valid)
+	{
+		std::cerr << "ShmRingReader: " << name << " has unexpected layout" << std::endl;
+		munmap(memory, st.st_size);
+		return false;
+	}
+	m_header = header;
+	m_size = st.st_size;
+	m_name = name;
+	m_sessionId = header->sessionId;
+	m_readIndex = header->writeIndex.load(std::memory_order_acquire);
+	m_lost = 0;
+	return true;
+}
+
+void ShmRingReader::Close()
+{
+	if(m_header)
+	{
+		munmap(const_cast<mandeye_utils::shm::RingHeader*>(m_header), m_size);
+		m_header = nullptr;
+	}
+	m_notifier.reset();
+}
+
+ShmRingReader::Span ShmRingReader::Peek(size_t maxRecords)
+{
+	Span span;
+	if(!m_header)
+	{
+		return span;
+	}
+	const uint64_t capacity = m_header->capacity;
+	const uint64_t writeIndex = m_header->writeIndex.load(std::memory_order_acquire);
+	if(writeIndex - m_readIndex > capacity)
+	{
+		m_lost += writeIndex - capacity - m_readIndex;
+		m_readIndex = writeIndex - capacity;
+	}
+	const uint64_t slot = m_readIndex & (capacity - 1);
+	span.first = m_readIndex;
+	span.count = static_cast<size_t>(std::min<uint64_t>({writeIndex - m_readIndex, capacity - slot, maxRecords}));
+	span.data = mandeye_utils::shm::records(m_header) + slot * m_header->recordSize;
+	return span;
+}
+
+bool ShmRingReader::Release(const Span& span)
+{
+	if(!m_header || span.count == 0)
+	{
+		return true;
+	}
+	// records were read before the writer's reservation is checked
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const uint64_t reserveIndex = m_header->reserveIndex.load(std::memory_order_relaxed);
+	const uint64_t capacity = m_header->capacity;
+	if(reserveIndex > span.first + capacity)
+	{
+		const uint64_t oldest = reserveIndex - capacity;
+		m_lost += std::min<uint64_t>(oldest, span.first + span.count) - span.first;
+		m_readIndex = std::max(m_readIndex, oldest);
+		return false;
+	}
+	m_readIndex = span.first + span.count;
+	return true;
+}
+
+bool ShmRingReader::WaitForData(int timeoutMs)
+{
+	if(!m_header)
+	{
+		return false;
+	}
+	if(m_header->writeIndex.load(std::memory_order_acquire) != m_readIndex)
+	{
+		return true;
+	}
+	if(!m_notifier)
+	{
+		m_notifier = std::make_unique<Notifier>();
+		m_notifier->socket.connect(mandeye_utils::shm::NotifyEndpoint);
+		m_notifier->socket.set(zmq::sockopt::subscribe, m_name);
+	}
+	m_notifier->socket.set(zmq::sockopt::rcvtimeo, timeoutMs);
+	zmq::message_t message;
+	if(!m_notifier->socket.recv(message, zmq::recv_flags::none))
+	{
+		return m_header->writeIndex.load(std::memory_order_acquire) != m_readIndex;
+	}
+	// drop queued notifications, the write index is read from the segment
+	do
+	{
+		while(message.more())
+		{
+			m_notifier->socket.recv(message, zmq::recv_flags::none);
+		}
+	} while(m_notifier->socket.recv(message, zmq::recv_flags::dontwait));
+	return true;
+}
+
+bool ShmRingReader::IsStale() const
+{
+	if(!m_header)
+	{
+		return true;
+	}
+	// writer unlinks the segment on restart, a new one has a new session
+	const int fd = shm_open(m_name.c_str(), O_RDONLY, 0);
+	if(fd < 0)
+	{
+		return true;
+	}
+	uint64_t sessionId = 0;
+	const bool stale = pread(fd, &sessionId, sizeof(sessionId), offsetof(mandeye_utils::shm::RingHeader, sessionId)) != sizeof(sessionId) ||
+					   sessionId != m_sessionId;
+	close(fd);
+	return stale;
+}
+
+} // namespace mandeye::extras
@@ -0,0 +1,117 @@
+#pragma once
+#include "utils/ShmRing.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace mandeye::extras
+{
+
+//! Reads a shared-memory ring of control_program (mandeye_utils::shm) in place, without copying.
+//! Usage: Peek a span, process records, then Release it. Release returns false if the writer
+//! overwrote the span while it was processed; the records must be discarded then.
+//! A reader that falls behind more than the ring capacity skips to the oldest record still
+//! available, skipped records are counted in GetLost.
+class ShmRingReader
+{
+public:
+	//! Contiguous records in the segment
+	struct Span
+	{
+		const uint8_t* data{nullptr};
+		size_t count{0};
+		uint64_t first{0}; //! index of the first record
+	};
+
+	ShmRingReader();
+	~ShmRingReader();
+	ShmRingReader(const ShmRingReader&) = delete;
+	ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+	//! Maps segment read-only, returns false if it does not exist or has unexpected layout.
+	//! Reading starts with records written from now on.
+	bool Open(const std::string& name, uint32_t recordSize);
+	void Close();
+	bool IsOpen() const
+	{
+		return m_header != nullptr;
+	}
+
+	//! Available records, at most maxRecords, empty span if there are none
+	Span Peek(size_t maxRecords);
+
+	//! Marks span as read, false if it was overwritten meanwhile
+	bool Release(const Span& span);
+
+	//! Blocks until writer announces new records or timeout passes, false on timeout.
+	//! Readers that poll with Peek don't need it.
+	bool WaitForData(int timeoutMs);
+
+	//! True if writer restarted since Open, reader has to Open again
+	bool IsStale() const;
+
+	uint64_t GetLost() const
+	{
+		return m_lost;
+	}
+	uint64_t GetCapacity() const
+	{
+		return m_header ? m_header->capacity : 0;
+	}
+
+private:
+	struct Notifier;
+
+	const mandeye_utils::shm::RingHeader* m_header{nullptr};
+	size_t m_size{0};
+	std::string m_name;
+	uint64_t m_sessionId{0};
+	uint64_t m_readIndex{0};
+	uint64_t m_lost{0};
+	std::unique_ptr<Notifier> m_notifier;
+};
+
+//! ShmRingReader with typed records
+template <typename Record>
+class ShmReader
+{
+public:
+	struct Span
+	{
+		const Record* data{nullptr};
+		size_t count{0};
+		ShmRingReader::Span raw;
+	};
+
+	bool Open(const std::string& name)
+	{
+		return m_reader.Open(name, sizeof(Record));
+	}
+
+	Span Peek(size_t maxRecords)
+	{
+		Span span;
+		span.raw = m_reader.Peek(maxRecords);
+		span.data = reinterpret_cast<const Record*>(span.raw.data);
+		span.count = span.raw.count;
+		return span;
+	}
+
+	bool Release(const Span& span)
+	{
+		return m_reader.Release(span.raw);
+	}
+
+	ShmRingReader& Raw()
+	{
+		return m_reader;
+	}
+
+private:
+	ShmRingReader m_reader;
+};
+
+using ShmPointReader = ShmReader<mandeye_utils::shm::Point>;
+using ShmImuReader = ShmReader<mandeye_utils::shm::Imu>;
+
+} // namespace mandeye::extras
@@ -0,0 +1,20 @@
+import struct
+import zmq
+
+# Header of the live preview frame, see code/utils/PreviewFormat.h
+HEADER = struct.Struct("<IHHIIQffI")
+POINT = struct.Struct("<hhhB")
+MAGIC = 0x5650444D
+
+context = zmq.Context()
+socket = context.socket(zmq.SUB)
+socket.connect("tcp://localhost:5558")
+socket.setsockopt_string(zmq.SUBSCRIBE, "preview")
+
+while True:
+    topic, payload = socket.recv_multipart()
+    magic, version, header_size, sequence, count, timestamp, voxel, scale, dropped = HEADER.unpack_from(payload)
+    if magic != MAGIC or version != 1:
+        continue
+    points = [(x * scale, y * scale, z * scale, i) for x, y, z, i in POINT.iter_unpack(payload[header_size:header_size + count * POINT.size])]
+    print("Frame", sequence, "points", len(points), "dropped", dropped, "lidar time", timestamp / 1e9)
@@ -1,14 +1,41 @@
+import json
+import struct
 import zmq
 
-# Set up ZeroMQ context and subscriber socket
+# Binary status of control_program, see code/utils/StatusFormat.h
+STATUS_HEADER = struct.Struct("<IHHIQQqQddqIBBHHH")
+STATUS_MAGIC = 0x5453444D
+STATUS_HAS_STATE = 1
+CHUNK_HEADER = struct.Struct("<IHHIQH")
+CHUNK_MAGIC = 0x4B43444D
+
+def decode_message(message):
+    if len(message) >= CHUNK_HEADER.size and struct.unpack_from("<I", message)[0] == CHUNK_MAGIC:
+        _, _, header_size, chunk, time_ns, directory_len = CHUNK_HEADER.unpack_from(message)
+        return {'chunk': chunk, 'time': time_ns, 'directory': message[header_size:header_size + directory_len].decode()}
+    if len(message) >= STATUS_HEADER.size and struct.unpack_from("<I", message)[0] == STATUS_MAGIC:
+        fields = STATUS_HEADER.unpack_from(message)
+        header_size, flags, time_ns, dur_ns = fields[2], fields[3], fields[4], fields[5]
+        mode_len, stop_len, continous_len = fields[14:17]
+        data = {'time': time_ns, 'dur': dur_ns, 'clock': {'valid': bool(fields[12]), 'drift_ppm': fields[8]}}
+        if flags & STATUS_HAS_STATE:
+            strings = message[header_size:header_size + mode_len + stop_len + continous_len].decode()
+            data['mode'] = strings[:mode_len]
+            data['stopScanDirectory'] = strings[mode_len:mode_len + stop_len]
+            data['continousScanDirectory'] = strings[mode_len + stop_len:]
+        return data
+    # control_program with "publisher_encoding": "json"
+    return json.loads(message)
+
+# Set up ZeroMQ context and subscriber socket, messages are [topic][payload]
 context = zmq.Context()
 socket = context.socket(zmq.SUB)
 socket.connect("tcp://localhost:5556")
-socket.setsockopt_string(zmq.SUBSCRIBE, "")
-socket.setsockopt(zmq.CONFLATE,1)
+for topic in ("time", "state", "chunk"):
+    socket.setsockopt_string(zmq.SUBSCRIBE, topic)
 
 
 while True:
     # Wait for a message
-    message = socket.recv_string()
-    print("Received message:", message)
+    topic, message = socket.recv_multipart()
+    print("Received", topic.decode(), ":", decode_message(message))